@@ -1497,8 +1497,6 @@ void BExtractorView::MopRemoveRoadNodes(const DPoint2 &start, const DPoint2 &end
 	BExtractorDoc* doc = GetDocument();
 	DRECT drect(start.x, start.y, end.x, end.y);
 	TNode *pNode;
-	TNode *pNext;
-	TNode *pPreviousNode = NULL;
 	CRect screen_rect;
 	int size = UTM_sdx(15.0f);
 	CPoint screenPoint;
@@ -1506,11 +1504,10 @@ void BExtractorView::MopRemoveRoadNodes(const DPoint2 &start, const DPoint2 &end
 
 	drect.Sort();
 
-	pNode = doc->m_Links.GetFirstNode();
-
-	while (NULL != pNode)
+	// Go from the end, since removing a node moves the last node into its place
+	for (int n = doc->m_Links.NumNodes() - 1; n >= 0; n--)
 	{
-		pNext = pNode->m_pNext;
+		pNode = doc->m_Links.GetNode(n);
 		if (drect.ContainsPoint(pNode->m_p))
 		{
 			// Remove any roads starting or terminating at this node
@@ -1532,9 +1529,6 @@ void BExtractorView::MopRemoveRoadNodes(const DPoint2 &start, const DPoint2 &end
 			}
 			doc->m_Links.RemoveNode(pNode);
 		}
-		else
-			pPreviousNode = pNode;
-		pNode = pNext;
 	}
 
 	Invalidate();
@@ -13,8 +13,10 @@
 #include "vtlib/core/Building3d.h"
 #include "vtlib/core/PagedLodGrid.h"
 #include "vtlib/core/PickEngines.h"
+#include "vtlib/core/Profiler.h"
 #include "vtlib/core/TiledGeom.h"
 #include "vtlib/core/MapOverviewEngine.h"
+#include "vtlib/core/ModelCache.h"
 #include "vtdata/vtLog.h"
 #include "vtdata/PolyChecker.h"
 #include "vtdata/DataPath.h"
@@ -45,6 +47,7 @@ Enviro::Enviro() : vtTerrainScene()
 
 	m_bOnTerrain = false;
 	m_bEarthShade = false;
+	m_bBenchmarkVehicles = false;
 
 	m_pGlobeContainer = NULL;
 	m_bGlobeFlat = false;
@@ -72,6 +75,10 @@ Enviro::Enviro() : vtTerrainScene()
 	m_fMessageTime = 0.0f;
 	m_pHUD = NULL;
 	m_pHUDMessage = NULL;
+	m_pProfileGeode = NULL;
+	m_pProfileText = NULL;
+	m_bShowProfile = false;
+	m_fProfileUpdate = 0.0f;
 
 	// plants
 	m_pSpeciesList = NULL;
@@ -143,6 +150,9 @@ void Enviro::Shutdown()
 
 	m_pTopDownCamera = NULL;
 
+	// The vehicles refer to the terrains they are on
+	m_Vehicles.Clear();
+
 	// Clean up the rest of the TerrainScene container
 	vtGetScene()->SetRoot(NULL);
 	CleanupScene();
@@ -176,6 +186,9 @@ void Enviro::StartupArgument(int i, const char *str)
 
 	else if(!strncmp(str, "-neutral", 8))
 		g_Options.m_bStartInNeutral = true;
+
+	else if(!strcmp(str, "-benchmark_vehicles"))
+		m_bBenchmarkVehicles = true;
 }
 
 void Enviro::LoadAllTerrainDescriptions()
@@ -262,7 +275,12 @@ void Enviro::LoadGlobalContent()
 			VTLOG("  Error: %s\n", str.c_str());
 		}
 		if (success)
+		{
 			VTLOG("   Load successful, %d items\n", con.NumItems());
+
+			// Start loading the content's models, while the terrains load
+			vtGetModelCache()->Prewarm(con);
+		}
 		else
 			VTLOG1("   Load not successful.\n");
 	}
@@ -290,6 +308,8 @@ void Enviro::DoControl()
 			m_fMessageTime = 0.0f;
 		}
 	}
+	if (m_bShowProfile)
+		UpdateProfileOverlay();
 	if (m_state == AS_Initializing)
 	{
 		m_iInitStep++;
@@ -1930,38 +1950,28 @@ void Enviro::OnMouseLeftUpBox(vtMouseEvent &event)
 			FBox3 bbox;
 			for (uint j = 0; j < fset->NumEntities(); j++)
 			{
-				vtFeature *feat = fset->GetFeature(j);
-				vtVisual *viz = alay->GetViz(feat);
-				if (!viz)
-					continue;
-
 				// Control key extends selection
 				if (!(event.flags & VT_CONTROL))
 					fset->Select(j, false);
 
-				bool bSelected = false;
-				for (uint k = 0; k < viz->m_meshes.size(); k++)
+				// The bounds work whether or not the layer is batched
+				if (!alay->GetFeatureBounds(j, bbox))
+					continue;
+				FPoint3 center = bbox.Center();
+
+				// Account for potential vertical exaggeration
+				center.y *= fVerticalExag;
+
+				// Project 3d pos to 2d window pos
+				FPoint3 frustump = viewmat.PreMult(center);
+
+				// If inside the window box
+				if (select_box.ContainsPoint(frustump.x, frustump.y) &&
+					frustump.z > 0 &&
+					frustump.z < 1)		// and in front of camera
 				{
-					vtMesh *mesh = viz->m_meshes[k];
-					mesh->GetBoundBox(bbox);
-					FPoint3 center = bbox.Center();
-
-					// Account for potential vertical exaggeration
-					center.y *= fVerticalExag;
-
-					// Project 3d pos to 2d window pos
-					FPoint3 frustump = viewmat.PreMult(center);
-
-					// If inside the window box
-					if (select_box.ContainsPoint(frustump.x, frustump.y) &&
-						frustump.z > 0 &&
-						frustump.z < 1)		// and in front of camera
-					{
-						bSelected = true;
-					}
-				}
-				if (bSelected)
 					fset->Select(j, true);
+				}
 			}
 			// Make the selected meshes yellow
 			alay->UpdateVisualSelection();
@@ -2962,6 +2972,48 @@ void Enviro::SetHUDMessageText(const char *message)
 		m_pHUDMessage->SetText(message);
 }
 
+/**
+ * Show the times measured by the profiler as text on the HUD.  This turns
+ * on the profiler, if it isn't already on.
+ */
+void Enviro::ShowProfileOverlay(bool bShow)
+{
+	m_bShowProfile = bShow;
+	if (bShow)
+	{
+		vtGetProfiler()->SetEnabled(true);
+		if (!m_pProfileGeode && m_pArial)
+		{
+			m_pProfileGeode = new vtGeode;
+			m_pProfileGeode->setName("Profile");
+			m_pHUD->GetContainer()->addChild(m_pProfileGeode);
+			m_pProfileText = new vtTextMesh(m_pArial, 14);
+			m_pProfileGeode->AddTextMesh(m_pProfileText, 0);
+		}
+		m_fProfileUpdate = 0.0f;
+		UpdateProfileOverlay();
+	}
+	if (m_pProfileGeode)
+		m_pProfileGeode->SetEnabled(bShow);
+}
+
+void Enviro::UpdateProfileOverlay()
+{
+	// Twice a second is often enough to read
+	const float now = vtGetTime();
+	if (!m_pProfileText || now - m_fProfileUpdate < 0.5f)
+		return;
+	m_fProfileUpdate = now;
+
+	vtString str;
+	vtGetProfiler()->GetSummary(str);
+	m_pProfileText->SetText(str);
+
+	// Keep it in the top left corner of the window
+	IPoint2 size = vtGetScene()->GetWindowSize();
+	m_pProfileText->SetPosition(FPoint3(3, size.y - 16, 0));
+}
+
 void Enviro::ShowVerticalLine(bool bShow)
 {
 	if (bShow)
@@ -3218,24 +3270,18 @@ CarEngine *Enviro::CreateGroundVehicle(const VehicleOptions &opt)
 
 	pTerr->PlantModelAtPoint(car, DPoint2(epos.x, epos.y));
 
-	CarEnginePtr pEng = new CarEngine(car, pTerr->GetHeightField());
-	if (!pEng->Valid())
-		return NULL;
-
-	// add the engine to the terrain's engines
-	pTerr->AddEngine(pEng);
-
 	// add the vehicle to the terrain's vehicles
-	m_Vehicles.AddEngine(pEng);
+	CarEngine *pEng = m_Vehicles.AddVehicle(car, pTerr);
+	if (!pEng)
+		return NULL;
 
 	// notify framework
 	AddVehicle(pEng);
 
-	pEng->setName("drive");
-	return pEng.get();
+	return pEng;
 }
 
-void Enviro::CreateSomeTestVehicles(vtTerrain *pTerrain)
+void Enviro::CreateSomeTestVehicles(vtTerrain *pTerrain, uint iNum)
 {
 	vtRoadMap3d *pRoadMap = pTerrain->GetRoadMap();
 
@@ -3254,37 +3300,37 @@ void Enviro::CreateSomeTestVehicles(vtTerrain *pTerrain)
 	}
 	const uint numv = vnames.size();
 
-	// put one of each at the center of the terrain
+	if (numv == 0)
+		return;
+
+	// put them in rows at the center of the terrain
 	const DPoint2 center = pTerrain->GetHeightField()->GetEarthExtents().GetCenter();
+	const uint per_row = 10;
 
 	// add some test vehicles
-	for (uint i = 0; i < numv; i++)
+	for (uint i = 0; i < iNum; i++)
 	{
 		const RGBf color(1.0f, 1.0f, 1.0f);	// white
 
-		// Create some of each land vehicle type
-		Vehicle *car = m_VehicleManager.CreateVehicle(vnames[i], color);
+		// Cycle through the land vehicle types
+		Vehicle *car = m_VehicleManager.CreateVehicle(vnames[i % numv], color);
 		if (car)
 		{
 			pTerrain->addNode(car);
-			pTerrain->PlantModelAtPoint(car, center + DPoint2(i*10, 0));
-
-			CarEnginePtr pEng = new CarEngine(car, pTerrain->GetHeightField());
-			if (!pEng->Valid())
-				continue;
-
-			pEng->setName(vtString("drive") + vnames[i]);
-
-			// add the engine to the terrain's engines
-			pTerrain->AddEngine(pEng);
+			pTerrain->PlantModelAtPoint(car, center +
+				DPoint2((i % per_row) * 10, (i / per_row) * 10));
 
 			// add the vehicle to the terrain's vehicles
-			m_Vehicles.AddEngine(pEng);
+			CarEngine *pEng = m_Vehicles.AddVehicle(car, pTerrain);
+			if (!pEng)
+				continue;
 
 			// notify framework
 			AddVehicle(pEng);
 		}
 	}
+	if (m_bBenchmarkVehicles)
+		m_Vehicles.Benchmark();
 }
 
 
@@ -224,6 +224,7 @@ public:
 	CarEngine *CreateGroundVehicle(const VehicleOptions &opt);
 	VehicleManager m_VehicleManager;
 	VehicleSet m_Vehicles;
+	bool m_bBenchmarkVehicles;	// log simulation speed when distributing
 
 	// import
 	bool ImportModelFromKML(const char *kmlfile);
@@ -244,6 +245,8 @@ public:
 	// UI
 	void UpdateCompass();
 	void SetHUDMessageText(const char *message);
+	void ShowProfileOverlay(bool bShow);
+	bool GetShowProfileOverlay() { return m_bShowProfile; }
 	void ShowVerticalLine(bool bShow);
 	bool GetShowVerticalLine();
 
@@ -305,7 +308,7 @@ public:
 	void ToggleDemo();
 	vtGroup *m_pDemoGroup;
 	vtGeode *m_pDemoTrails;
-	void CreateSomeTestVehicles(vtTerrain *pTerrain);
+	void CreateSomeTestVehicles(vtTerrain *pTerrain, uint iNum);
 	void MakeOverlayGlobe(vtImage *image, bool progress_callback(int) = NULL);
 
 protected:
@@ -419,6 +422,13 @@ protected:
 	vtFontPtr		m_pArial;
 	float			m_fMessageStart, m_fMessageTime;
 
+	// Profiler overlay
+	void UpdateProfileOverlay();
+	vtGeode			*m_pProfileGeode;
+	vtTextMesh		*m_pProfileText;
+	bool			m_bShowProfile;
+	float			m_fProfileUpdate;
+
 	vtGeode		*m_pLegendGeom;
 	bool		m_bCreatedLegend;
 
@@ -62,9 +62,7 @@
 #include "wxosg/SceneGraphDlg.h"
 #include "wxosg/TimeDlg.h"
 
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
 #include "PerformanceMonitor.h"
-#endif
 
 #include "../Options.h"
 #include "EnviroGUI.h"	// for GetCurrentTerrain
@@ -187,13 +185,11 @@ void EnviroFrame::CreateUI()
 	m_pStatusBar->UpdateText();
 	PositionStatusBar();
 
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
 	// Stop crash in update toolbar
 	m_pCameraDlg = NULL;
 	m_pLocationDlg = NULL;
 	m_pLODDlg = NULL;
 	m_pPerformanceMonitorDlg = NULL;
-#endif
 
 	// An array of values to tell wxWidgets how to make our OpenGL context.
 	std::vector<int> gl_attribs;
@@ -258,9 +254,7 @@ void EnviroFrame::CreateUI()
 	m_pVehicleDlg = new VehicleDlg(this, -1, _("Vehicles"));
 	m_pDriveDlg = new DriveDlg(this);
 	m_pProfileDlg = NULL;
-	#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-    m_pPerformanceMonitorDlg = new CPerformanceMonitorDialog(this, wxID_ANY, _("Performance Monitor"));
-    #endif
+	m_pPerformanceMonitorDlg = new CPerformanceMonitorDialog(this, wxID_ANY, _("Performance Monitor"));
 	m_pVIADlg = new VIADlg(this);
 
 #if wxVERSION_NUMBER < 2900		// before 2.9.0
@@ -303,9 +297,7 @@ EnviroFrame::~EnviroFrame()
 	delete m_pLocationDlg;
 	delete m_pInstanceDlg;
 	delete m_pLayerDlg;
-	#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-    delete m_pPerformanceMonitorDlg;
-    #endif
+	delete m_pPerformanceMonitorDlg;
 	delete m_pVIADlg;
 
 	delete m_pStatusBar;
@@ -1354,6 +1346,9 @@ void EnviroFrame::UpdateStatus()
 
 	if (m_pLocationDlg && m_pLocationDlg->IsShown())
 		m_pLocationDlg->Update();
+
+	if (m_pPerformanceMonitorDlg && m_pPerformanceMonitorDlg->IsShown())
+		m_pPerformanceMonitorDlg->UpdateCounters();
 }
 
 void EnviroFrame::UpdateLODInfo()
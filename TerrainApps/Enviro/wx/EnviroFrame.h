@@ -39,9 +39,7 @@ class vtFeatureSet;
 class vtStructInstance;
 class vtTerrain;
 class vtTimeEngine;
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
 class CPerformanceMonitorDialog;
-#endif
 class VIADlg;
 
 // some shortcuts
@@ -218,9 +216,7 @@ protected:
 
 
 	void OnSceneGraph(wxCommandEvent& event);
-	#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
 	void OnPerformanceMonitor(wxCommandEvent& event);
-	#endif
 	void OnSceneTerrain(wxCommandEvent& event);
 	void OnUpdateSceneTerrain(wxUpdateUIEvent& event);
 	void OnSceneSpace(wxCommandEvent& event);
@@ -343,9 +339,7 @@ public:
 	ProfileDlg			*m_pProfileDlg;
 	VehicleDlg			*m_pVehicleDlg;
 	DriveDlg			*m_pDriveDlg;
-	#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-    CPerformanceMonitorDialog *m_pPerformanceMonitorDlg;
-    #endif
+	CPerformanceMonitorDialog *m_pPerformanceMonitorDlg;
 	VIADlg				*m_pVIADlg;
 
 	MouseMode			m_ToggledMode;
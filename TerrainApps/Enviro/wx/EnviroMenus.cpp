@@ -183,9 +183,7 @@ EVT_MENU(ID_SCENE_SPACE,		EnviroFrame::OnSceneSpace)
 EVT_UPDATE_UI(ID_SCENE_SPACE,	EnviroFrame::OnUpdateSceneSpace)
 EVT_MENU(ID_SCENE_SAVE,			EnviroFrame::OnSceneSave)
 EVT_MENU(ID_SCENE_EPHEMERIS,	EnviroFrame::OnSceneEphemeris)
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-EVT_MENU(ID_SCENE_PERFMON,	    EnviroFrame::OnPerformanceMonitor)
-#endif
+EVT_MENU(ID_SCENE_PERFMON,		EnviroFrame::OnPerformanceMonitor)
 EVT_MENU(ID_TIME_DIALOG,		EnviroFrame::OnTimeDialog)
 EVT_MENU(ID_TIME_STOP,			EnviroFrame::OnTimeStop)
 EVT_MENU(ID_TIME_FASTER,		EnviroFrame::OnTimeFaster)
@@ -337,9 +335,7 @@ void EnviroFrame::CreateMenus()
 
 	m_pSceneMenu = new wxMenu;
 	m_pSceneMenu->Append(ID_SCENE_SCENEGRAPH, _("Scene Graph"));
-    #ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-    m_pSceneMenu->Append(ID_SCENE_PERFMON, _("Performance Monitor"));
-    #endif
+	m_pSceneMenu->Append(ID_SCENE_PERFMON, _("Performance Monitor"));
 	m_pSceneMenu->AppendSeparator();
 	m_pSceneMenu->Append(ID_SCENE_TERRAIN, _("Go to Terrain...\tCtrl+G"));
 	if (m_bEnableEarth)
@@ -1326,12 +1322,10 @@ void EnviroFrame::OnSceneGraph(wxCommandEvent& event)
 	m_pSceneGraphDlg->Show(true);
 }
 
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
 void EnviroFrame::OnPerformanceMonitor(wxCommandEvent& event)
 {
 	m_pPerformanceMonitorDlg->Show(true);
 }
-#endif
 
 void EnviroFrame::OnSceneTerrain(wxCommandEvent& event)
 {
@@ -1719,7 +1713,7 @@ void EnviroFrame::OnTerrainDistribVehicles(wxCommandEvent& event)
 	if (num == -1)
 		return;
 
-	g_App.CreateSomeTestVehicles(pTerr);
+	g_App.CreateSomeTestVehicles(pTerr, num);
 }
 
 void EnviroFrame::OnTerrainWriteElevation(wxCommandEvent& event)
@@ -1769,7 +1763,6 @@ void EnviroFrame::OnTerrainWriteElevation(wxCommandEvent& event)
 
 void EnviroFrame::OnTerrainAddContour(wxCommandEvent& event)
 {
-#if SUPPORT_QUIKGRID
 	vtTerrain *pTerr = g_App.GetCurrentTerrain();
 	if (!pTerr)
 		return;
@@ -1819,14 +1812,16 @@ void EnviroFrame::OnTerrainAddContour(wxCommandEvent& event)
 		cc.GenerateContour(dlg.m_fElevSingle);
 	else
 		cc.GenerateContours(dlg.m_fElevEvery);
-	cc.Finish();
+
+	OpenProgressDialog(_("Generating Contours"), _T(""), false, this);
+	cc.Finish(progress_callback);
+	CloseProgressDialog();
 
 	// show the geometry
 	pTerr->CreateAbstractLayerVisuals(alay);
 
 	// and show it in the layers dialog
 	m_pLayerDlg->RefreshTreeContents();	// full refresh
-#endif
 }
 
 void EnviroFrame::OnUpdateIsDynTerrain(wxUpdateUIEvent& event)
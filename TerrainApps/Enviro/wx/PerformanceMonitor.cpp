@@ -1,273 +1,171 @@
-/////////////////////////////////////////////////////////////////////////////
-// Name:        PerformanceMonitor.cpp
-// Author:      XX
-// Created:     XX/XX/XX
-// Copyright:   XX
-/////////////////////////////////////////////////////////////////////////////
-
-#if defined(__GNUG__) && !defined(NO_GCC_PRAGMA)
-    #pragma implementation "PerformanceMonitor.cpp"
-#endif
+//
+// PerformanceMonitor.cpp
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
 
 // For compilers that support precompilation, includes "wx/wx.h".
 #include "wx/wxprec.h"
 
-#ifdef __BORLANDC__
-    #pragma hdrstop
-#endif
-
-#include "PerformanceMonitor.h"
-
-#if NVPERFSDK_FOUND
-#include "NVPerfSDK.h"
+#ifndef WX_PRECOMP
+#include "wx/wx.h"
 #endif
 
 #include "vtlib/vtlib.h"
-class vtStructInstance;
-#include "EnviroFrame.h"
-#include "wx/valgen.h"
+#include "vtlib/core/Profiler.h"
+#include "vtdata/FileFilters.h"
+#include "wxosg/Canvas.h"		// for EnableContinuousRendering
 
-#if NVPERFSDK_FOUND
-typedef struct _CounterInfo
+#include "EnviroGUI.h"			// for g_App
+#include "PerformanceMonitor.h"
+
+enum
 {
-    UINT CounterIndex;
-    NVPMCOUNTERTYPE CounterType;
-    NVPMCOUNTERVALUE CounterValue;
-    NVPMCOUNTERDISPLAYHINT CounterDisplayHint;
-    UINT64 CounterMax;
-} CounterInfo;
-#endif
+	ID_PM_OVERLAY = wxID_HIGHEST + 1,
+	ID_PM_SAVE_TRACE,
+	ID_PM_RESET
+};
 
-// WDR: class implementations
+enum
+{
+	PM_COL_SECTION,
+	PM_COL_MEAN,
+	PM_COL_MEDIAN,
+	PM_COL_P95,
+	PM_COL_P99,
+	PM_COL_MAX
+};
 
 //----------------------------------------------------------------------------
 // CPerformanceMonitorDialog
 //----------------------------------------------------------------------------
 
-bool CPerformanceMonitorDialog::m_NVPMInitialised = false;
-
-
+BEGIN_EVENT_TABLE(CPerformanceMonitorDialog, PerformanceMonitorDlgBase)
+	EVT_MENU( ID_PM_OVERLAY, CPerformanceMonitorDialog::OnOverlay )
+	EVT_MENU( ID_PM_SAVE_TRACE, CPerformanceMonitorDialog::OnSaveTrace )
+	EVT_MENU( ID_PM_RESET, CPerformanceMonitorDialog::OnReset )
+END_EVENT_TABLE()
 
 CPerformanceMonitorDialog::CPerformanceMonitorDialog( wxWindow *parent, wxWindowID id, const wxString &title,
-    const wxPoint &position, const wxSize& size, long style ) :
-    PerformanceMonitorDlgBase( parent, id, title, position, size, style )
+	const wxPoint &position, const wxSize& size, long style ) :
+	PerformanceMonitorDlgBase( parent, id, title, position, size, style )
 {
-#if NVPERFSDK_FOUND
-
-    UINT NumCounters;
-
-    // WDR: dialog function PerformanceMonitorDialogFunc for CPerformanceMonitorDialog
-    PerformanceMonitorDialogFunc( this, TRUE );
-
-    wxListCtrl *pList = GetPmListctrl();
-
-    pList->InsertColumn(0, _T("Value"));
-    pList->InsertColumn(1, _T("Status"));
-    pList->InsertColumn(2, _T("Description"));
-    pList->SetColumnWidth(2, wxLIST_AUTOSIZE);
-
-    if (m_NVPMInitialised)
-    {
-        if (NVPM_OK == NVPMGetNumCounters(&NumCounters))
-        {
-            UINT CounterIndex;
-            UINT StringBufferLength = 1023;
-            char StringBuffer[1024];
-            UINT64 AttributeValue;
-            for (CounterIndex = 0; CounterIndex < NumCounters; CounterIndex++)
-            {
-                StringBufferLength = 1023;
-                if (NVPM_OK == NVPMGetCounterAttribute(CounterIndex, NVPMA_COUNTER_TYPE, &AttributeValue))
-                {
-                    if ((NVPM_CT_GPU == AttributeValue) || (NVPM_CT_OGL == AttributeValue))
-                    {
-                        if (NVPM_OK == NVPMGetCounterDescription(CounterIndex, StringBuffer, &StringBufferLength))
-                        {
-                            // Put this counter in the List
-                            // Cosmetic memory leak here !!
-                            CounterInfo *pInfo = new CounterInfo;
-                            pInfo->CounterType = (NVPMCOUNTERTYPE)AttributeValue;
-                            pInfo->CounterIndex = CounterIndex;
-                            NVPMGetCounterAttribute(CounterIndex, NVPMA_COUNTER_VALUE, (UINT64*)&pInfo->CounterValue);
-                            NVPMGetCounterAttribute(CounterIndex, NVPMA_COUNTER_DISPLAY_HINT, (UINT64*)&pInfo->CounterDisplayHint);
-                            NVPMGetCounterAttribute(CounterIndex, NVPMA_COUNTER_MAX, &pInfo->CounterMax);
-                            wxString Description(StringBuffer, wxConvUTF8);
-                            wxListItem ListItem;
-                            ListItem.SetMask(wxLIST_MASK_TEXT);
-                            ListItem.SetId(pList->GetItemCount());
-                            ListItem.SetColumn(2);
-                            ListItem.SetText(Description);
-                            pList->InsertItem(ListItem);
-                            pList->SetItemPtrData(ListItem.GetId(), (wxUIntPtr)pInfo);
-                            ListItem.SetColumn(1);
-                            ListItem.SetText(wxString(_T("Off")));
-                            pList->SetItem(ListItem);
-                        }
-                    }
-                }
-            }
-            if (NumCounters > 0)
-                pList->SetColumnWidth(2, wxLIST_AUTOSIZE);
-        }
-    }
-
-#endif
-}
-
-void CPerformanceMonitorDialog::NVPM_init()
-{
-#if NVPERFSDK_FOUND
-
-    if (NVPM_OK != NVPMInit())
-        return;
-    m_NVPMInitialised = true;
-
-#endif
+	m_pm_listctrl->InsertColumn(PM_COL_SECTION, _("Section"));
+	m_pm_listctrl->InsertColumn(PM_COL_MEAN, _("Mean (ms)"), wxLIST_FORMAT_RIGHT);
+	m_pm_listctrl->InsertColumn(PM_COL_MEDIAN, _("Median"), wxLIST_FORMAT_RIGHT);
+	m_pm_listctrl->InsertColumn(PM_COL_P95, _("95%"), wxLIST_FORMAT_RIGHT);
+	m_pm_listctrl->InsertColumn(PM_COL_P99, _("99%"), wxLIST_FORMAT_RIGHT);
+	m_pm_listctrl->InsertColumn(PM_COL_MAX, _("Max"), wxLIST_FORMAT_RIGHT);
+	m_pm_listctrl->SetColumnWidth(PM_COL_SECTION, 200);
+
+	m_text212->SetLabel(_("Right click for options"));
 }
 
-void CPerformanceMonitorDialog::NVPM_shutdown()
+/**
+ * The profiler only runs while this dialog or the on-screen overlay is
+ * showing, so it costs nothing the rest of the time.
+ */
+bool CPerformanceMonitorDialog::Show(bool show)
 {
-#if NVPERFSDK_FOUND
-
-    m_NVPMInitialised = false;
-    NVPMShutdown();
-
-#endif
+	bool result = PerformanceMonitorDlgBase::Show(show);
+	UpdateEnabled();
+	return result;
 }
 
-void CPerformanceMonitorDialog::NVPM_frame()
+void CPerformanceMonitorDialog::UpdateEnabled()
 {
-#if NVPERFSDK_FOUND
-
-    if (m_NVPMInitialised)
-    {
-        CPerformanceMonitorDialog *pPM = GetFrame()->m_pPerformanceMonitorDlg;
-
-        if (NULL != pPM)
-        {
-            pPM->UpdateCounters();
-        }
-    }
-
-#endif
+	vtGetProfiler()->SetEnabled(IsShown() || g_App.GetShowProfileOverlay());
 }
 
+/**
+ * Fill the list with the latest statistics: one row for the whole frame,
+ * then one for each section.
+ */
 void CPerformanceMonitorDialog::UpdateCounters()
 {
-#if NVPERFSDK_FOUND
-
-    NVPMRESULT Result = NVPM_OK;
-    if (m_NVPMInitialised)
-    {
-        wxListCtrl *pList = GetPmListctrl();
-        UINT Count = pList->GetItemCount();
-#ifdef _MSC_VER
-		// Stupid broken compiler
-		NVPMSampleValue *Values = new NVPMSampleValue[Count];
-#else
-        NVPMSampleValue Values[Count];
-#endif
-        if (NVPM_OK == (Result = NVPMSample(Values, &Count)))
-        {
-            UINT Index;
-
-            for (Index = 0; Index < Count; Index++)
-            {
-                long ListIndex;
-                long ItemCount = pList->GetItemCount();
-                // This could probably be made quicker with a wrap search
-                CounterInfo *pInfo;
-                UINT TargetCounterIndex = Values[Index].unCounterIndex;
-                for (ListIndex = 0; ListIndex < ItemCount; ListIndex++)
-                {
-                    pInfo = (CounterInfo*)pList->GetItemData(ListIndex);
-                    CounterInfo TestInfo = *pInfo;
-                    if (pInfo->CounterIndex == TargetCounterIndex)
-                        break;
-                }
-                if (ListIndex < ItemCount)
-                {
-                    wxListItem ListItem;
-                    wxString Value;
-                    switch(pInfo->CounterValue)
-                    {
-                        case NVPM_CV_PERCENT:
-                            switch(pInfo->CounterDisplayHint)
-                            {
-                                case NVPM_CDH_PERCENT:
-                                    Value << Values[Index].ulValue << _T("%");
-                                    break;
-                                case NVPM_CDH_RAW:
-                                    Value << Values[Index].ulValue << _T("%");
-                                    break;
-                            }
-                            break;
-                        case NVPM_CV_RAW:
-                            switch(pInfo->CounterDisplayHint)
-                            {
-                                case NVPM_CDH_PERCENT:
-                                    if (0 == Values[Index].ulCycles)
-                                        Values[Index].ulCycles = 1;
-                                    Value << Values[Index].ulValue * 100 / Values[Index].ulCycles << _T("%");
-                                    break;
-                                case NVPM_CDH_RAW:
-                                    Value << Values[Index].ulValue;
-                                    break;
-                            }
-                            break;
-                    }
-
-                    ListItem.SetMask(wxLIST_MASK_TEXT);
-                    ListItem.SetId(ListIndex);
-                    ListItem.SetColumn(0);
-                    ListItem.SetText(Value);
-                    pList->SetItem(ListItem);
-                }
-            }
-        }
-#ifdef _MSC_VER
-		// Stupid broken compiler
-		delete Values;
-#endif
-    }
-
-#endif
+	vtProfiler *profiler = vtGetProfiler();
+
+	std::vector<vtString> names;
+	std::vector<vtProfileStats> rows;
+	vtProfileStats stats;
+	if (profiler->GetFrameStats(stats))
+	{
+		names.push_back("Frame");
+		rows.push_back(stats);
+	}
+	const int sections = profiler->NumSections();
+	for (int i = 0; i < sections; i++)
+	{
+		if (!profiler->GetStats(i, stats))
+			continue;
+		names.push_back(profiler->GetSectionName(i));
+		rows.push_back(stats);
+	}
+
+	wxListCtrl *pList = m_pm_listctrl;
+	pList->Freeze();
+	while (pList->GetItemCount() > (int) rows.size())
+		pList->DeleteItem(pList->GetItemCount() - 1);
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		const long item = (long) i;
+		if (item >= pList->GetItemCount())
+			pList->InsertItem(item, wxEmptyString);
+
+		const vtProfileStats &s = rows[i];
+		wxString str;
+		pList->SetItem(item, PM_COL_SECTION, wxString(names[i], wxConvUTF8));
+		str.Printf(_T("%.2f"), s.m_fMean);
+		pList->SetItem(item, PM_COL_MEAN, str);
+		str.Printf(_T("%.2f"), s.m_fMedian);
+		pList->SetItem(item, PM_COL_MEDIAN, str);
+		str.Printf(_T("%.2f"), s.m_fP95);
+		pList->SetItem(item, PM_COL_P95, str);
+		str.Printf(_T("%.2f"), s.m_fP99);
+		pList->SetItem(item, PM_COL_P99, str);
+		str.Printf(_T("%.2f"), s.m_fMax);
+		pList->SetItem(item, PM_COL_MAX, str);
+	}
+	pList->Thaw();
 }
 
-// WDR: handler implementations for CPerformanceMonitorDialog
+// Handlers
 
 void CPerformanceMonitorDialog::OnListItemRightClick( wxListEvent &event )
 {
-#if NVPERFSDK_FOUND
-
-    NVPMRESULT Result = NVPM_OK;
-    if (m_NVPMInitialised)
-    {
-        wxListCtrl *pList = GetPmListctrl();
-        wxListItem ListItem;
-        UINT CounterIndex = ((CounterInfo*)pList->GetItemData(event.GetIndex()))->CounterIndex;
+	wxMenu popmenu;
+	popmenu.AppendCheckItem(ID_PM_OVERLAY, _("Show Overlay"));
+	popmenu.Check(ID_PM_OVERLAY, g_App.GetShowProfileOverlay());
+	popmenu.Append(ID_PM_SAVE_TRACE, _("Save Trace..."));
+	popmenu.Append(ID_PM_RESET, _("Reset"));
+	PopupMenu(&popmenu);
+}
 
-        ListItem.SetId(event.GetIndex());
-        ListItem.SetColumn(1);
-        ListItem.SetMask(wxLIST_MASK_TEXT);
-        pList->GetItem(ListItem);
-        if (ListItem.GetText().IsSameAs(_T("On")))
-        {
-            ListItem.SetText(_T("Off"));
-            pList->SetItem(ListItem);
-            ListItem.SetColumn(0);
-            ListItem.SetText(_T(""));
-            pList->SetItem(ListItem);
-            Result = NVPMRemoveCounter(CounterIndex);
-        }
-        else
-        {
+void CPerformanceMonitorDialog::OnOverlay( wxCommandEvent &event )
+{
+	g_App.ShowProfileOverlay(event.IsChecked());
+	UpdateEnabled();
+}
 
-            ListItem.SetText(_T("On"));
-            pList->SetItem(ListItem);
-            Result = NVPMAddCounter(CounterIndex);
-        }
-    }
+void CPerformanceMonitorDialog::OnSaveTrace( wxCommandEvent &event )
+{
+	EnableContinuousRendering(false);
+	wxFileDialog saveFile(this, _("Save Trace"), _T(""), _T("trace.json"),
+		FSTRING_JSON, wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+	bool bResult = (saveFile.ShowModal() == wxID_OK);
+	EnableContinuousRendering(true);
+	if (!bResult)
+		return;
+
+	vtString fname = (const char *) saveFile.GetPath().mb_str(wxConvUTF8);
+	if (!vtGetProfiler()->WriteChromeTrace(fname))
+		wxMessageBox(_("Couldn't write the trace file."));
+}
 
-#endif
+void CPerformanceMonitorDialog::OnReset( wxCommandEvent &event )
+{
+	vtGetProfiler()->Reset();
+	UpdateCounters();
 }
+
@@ -1,56 +1,46 @@
-/////////////////////////////////////////////////////////////////////////////
-// Name:        PerformanceMonitor.h
-// Author:      XX
-// Created:     XX/XX/XX
-// Copyright:   XX
-/////////////////////////////////////////////////////////////////////////////
+//
+// PerformanceMonitor.h
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
 
 #ifndef __PerformanceMonitor_H__
 #define __PerformanceMonitor_H__
 
-#if defined(__GNUG__) && !defined(NO_GCC_PRAGMA)
-    #pragma interface "PerformanceMonitor.cpp"
-#endif
-
-#ifndef WX_PRECOMP
-    #include "wx/wx.h"
-#endif
-
 #include "EnviroUI.h"
 
-// WDR: class declarations
-
 //----------------------------------------------------------------------------
 // CPerformanceMonitorDialog
 //----------------------------------------------------------------------------
 
+/**
+ * Shows where the frame time goes, from the vtlib profiler: the mean, median
+ * and percentile times of each profiled section over the recent frames.
+ */
 class CPerformanceMonitorDialog: public PerformanceMonitorDlgBase
 {
 public:
-    // constructors and destructors
-    CPerformanceMonitorDialog( wxWindow *parent, wxWindowID id, const wxString &title,
-        const wxPoint& pos = wxDefaultPosition,
-        const wxSize& size = wxDefaultSize,
-        long style = wxDEFAULT_DIALOG_STYLE );
-
-    // WDR: method declarations for CPerformanceMonitorDailog
-    wxListCtrl* GetPmListctrl()  { return (wxListCtrl*) FindWindow( ID_PM_LISTCTRL ); }
+	// constructors and destructors
+	CPerformanceMonitorDialog( wxWindow *parent, wxWindowID id, const wxString &title,
+		const wxPoint& pos = wxDefaultPosition,
+		const wxSize& size = wxDefaultSize,
+		long style = wxDEFAULT_DIALOG_STYLE );
 
-    // Static functions
-    static void NVPM_init();
-    static void NVPM_shutdown();
-    static void NVPM_frame();
+	virtual bool Show(bool show = true);
+	void UpdateCounters();
 
 private:
-    // WDR: member variable declarations for CPerformanceMonitorDialog
+	// handlers
+	virtual void OnListItemRightClick( wxListEvent &event );
+	void OnOverlay( wxCommandEvent &event );
+	void OnSaveTrace( wxCommandEvent &event );
+	void OnReset( wxCommandEvent &event );
 
-private:
-    // WDR: handler declarations for CPerformanceMonitorDialog
-    virtual void OnListItemRightClick( wxListEvent &event );
+	void UpdateEnabled();
 
-private:
-    void UpdateCounters();
-    static bool m_NVPMInitialised;
+	DECLARE_EVENT_TABLE()
 };
 
-#endif
+#endif	// __PerformanceMonitor_H__
+
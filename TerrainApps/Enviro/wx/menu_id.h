@@ -62,9 +62,7 @@ enum
 	ID_NAV_PANO,
 
 	ID_SCENE_SCENEGRAPH,
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-    ID_SCENE_PERFMON,
-#endif
+	ID_SCENE_PERFMON,
 	ID_SCENE_TERRAIN,
 	ID_SCENE_SPACE,
 	ID_SCENE_SAVE,
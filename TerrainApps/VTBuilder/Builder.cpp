@@ -18,6 +18,7 @@
 #include "vtdata/DataPath.h"
 #include "vtdata/MaterialDescriptor.h"
 #include <float.h>	// for FLT_MIN
+#include <algorithm>
 
 #include "Builder.h"
 #include "Tin2d.h"
@@ -618,6 +619,11 @@ void Builder::CheckOptionBounds()
 	if (g_Options.GetValueInt(TAG_SAMPLING_N) > 32)
 		g_Options.SetValueInt(TAG_SAMPLING_N, 32);
 
+	int filter;
+	if (!g_Options.GetValueInt(TAG_SAMPLING_FILTER, filter) ||
+		filter < ISF_NEAREST || filter > ISF_BOX)
+		g_Options.SetValueInt(TAG_SAMPLING_FILTER, ISF_BOX, true);
+
 	int mp;
 	if (!g_Options.GetValueInt(TAG_MAX_MEGAPIXELS, mp))
 		mp = 16;
@@ -672,6 +678,7 @@ void Builder::SetOptionDefaults()
 	g_Options.SetValueBool(TAG_REPRO_TO_FLOAT_NEVER, false, true);
 
 	g_Options.SetValueInt(TAG_SAMPLING_N, 1, true);
+	g_Options.SetValueInt(TAG_SAMPLING_FILTER, ISF_BOX, true);
 	g_Options.SetValueInt(TAG_ELEV_MAX_SIZE, 4096, true);
 	g_Options.SetValueInt(TAG_MAX_MEGAPIXELS, 16, true);
 	g_Options.SetValueBool(TAG_BLACK_TRANSP, false, true);
@@ -835,8 +842,6 @@ bool Builder::SampleCurrentTerrains(vtElevLayer *pTarget)
 	pTarget->GetExtent(area);
 	const DPoint2 &step = pTarget->GetGrid()->GetSpacing();
 
-	const int layers = m_Layers.size();
-	float fData = 0, fBestData;
 	const IPoint2 Size = pTarget->GetGrid()->GetDimensions();
 
 	// Create progress dialog for the slow part
@@ -858,28 +863,65 @@ bool Builder::SampleCurrentTerrains(vtElevLayer *pTarget)
 	for (size_t lay = 0; lay < relevant_elevs.size(); lay++)
 		relevant_elevs[lay]->SetupTinTriangleBins(50);	// target 50 tris per bin
 
-	// iterate through the heixels of the new terrain
-	DPoint2 p;
+	// The output grid is stored column by column, so we fill it in bands of
+	//  columns.  For each band, only the layers which overlap it are
+	//  consulted, and the columns within a band are sampled in parallel.
+	vtElevationGrid *pGrid = pTarget->GetGrid();
+	const int iBandSize = 32;
+	std::vector<vtElevLayer*> band_elevs;
+	std::vector<bool> was_sticky;
 	wxString str;
-	for (int i = 0; i < Size.x; i++)
+	for (int i0 = 0; i0 < Size.x; i0 += iBandSize)
 	{
-		if ((i % 10) == 0)
+		const int i1 = std::min(i0 + iBandSize, Size.x);
+
+		str.Printf(_T("%d / %d"), i0, Size.x);
+		if (UpdateProgressDialog(i0*100/Size.x, str))
 		{
-			str.Printf(_T("%d / %d"), i, Size.x);
-			if (UpdateProgressDialog(i*100/Size.x, str))
-			{
-				CloseProgressDialog();
-				return false;
-			}
+			CloseProgressDialog();
+			return false;
+		}
+
+		// Which layers overlap this band, in order of increasing priority
+		const DRECT band(area.left + i0 * step.x, area.top,
+						 area.left + (i1 - 1) * step.x, area.bottom);
+		band_elevs.clear();
+		for (size_t e = 0; e < relevant_elevs.size(); e++)
+		{
+			DRECT layer_extent;
+			relevant_elevs[e]->GetExtent(layer_extent);
+			if (band.OverlapsRect(layer_extent))
+				band_elevs.push_back(relevant_elevs[e]);
 		}
-		p.x = area.left + (i * step.x);
-		for (int j = 0; j < Size.y; j++)
+
+		// Page in any data the band needs, here on the main thread.  The
+		//  band's layers are made sticky so that loading one of them can't
+		//  evict another.
+		was_sticky.resize(band_elevs.size());
+		for (size_t e = 0; e < band_elevs.size(); e++)
+		{
+			was_sticky[e] = band_elevs[e]->GetSticky();
+			band_elevs[e]->SetSticky(true);
+		}
+		for (size_t e = 0; e < band_elevs.size(); e++)
 		{
-			p.y = area.bottom + (j * step.y);
+			if (band_elevs[e]->HasData())
+				ElevCacheTouch(band_elevs[e]);
+			else if (ElevCacheLoadData(band_elevs[e]))
+				band_elevs[e]->SetupTinTriangleBins(50);
+		}
+		for (size_t e = 0; e < band_elevs.size(); e++)
+			band_elevs[e]->SetSticky(was_sticky[e]);
 
-			// find some data for this point
-			fBestData = ElevLayerArrayValue(relevant_elevs, p);
-			pTarget->GetGrid()->SetFValue(i, j, fBestData);
+		// Sample each column of the band as a batch
+		#pragma omp parallel for schedule(dynamic)
+		for (int i = i0; i < i1; i++)
+		{
+			std::vector<float> column(Size.y);
+			ElevLayerArrayValues(band_elevs, DPoint2(area.left + i * step.x, area.bottom),
+				DPoint2(0, step.y), Size.y, &column[0]);
+			for (int j = 0; j < Size.y; j++)
+				pGrid->SetFValue(i, j, column[j]);
 		}
 	}
 	CloseProgressDialog();
@@ -1226,75 +1268,123 @@ void Builder::CarveWithCulture(vtElevLayer *pElev, float margin)
 //
 bool Builder::SampleCurrentImages(vtImageLayer *pTargetLayer)
 {
+	VTLOG1(" SampleCurrentImages\n");
+	clock_t tm1 = clock();
+
 	vtImage *pTarget = pTargetLayer->GetImage();
 
 	DRECT area;
 	pTarget->GetExtent(area);
 	const DPoint2 &step = pTarget->GetSpacing();
 
-	int i, j, l, layers = m_Layers.size();
 	const IPoint2 Size = pTarget->GetDimensions();
 
 	// Create progress dialog for the slow part
 	OpenProgressDialog(_("Sampling Image Layers"), _T(""), true);
 
-	vtImage **images = new vtImage *[LayersOfType(LT_IMAGE)];
-	int g, num_image = 0;
-	for (l = 0; l < layers; l++)
+	std::vector<vtImage*> images;
+	for (uint l = 0; l < m_Layers.size(); l++)
 	{
 		vtLayer *lp = m_Layers[l];
 		if (lp->GetType() == LT_IMAGE)
-			images[num_image++] = ((vtImageLayer *)lp)->GetImage();
+			images.push_back(((vtImageLayer *)lp)->GetImage());
 	}
+	const int num_image = (int) images.size();
 
 	double dRes = step.x;
 
-	// Get ready to multisample
+	// Get ready to multisample.  The offsets are computed once, and each
+	//  source image is always read from the same overview.
+	const ImageSampleFilter filter =
+		(ImageSampleFilter) g_Options.GetValueInt(TAG_SAMPLING_FILTER);
 	DLine2 offsets;
 	int iNSampling = g_Options.GetValueInt(TAG_SAMPLING_N);
-	MakeSampleOffsets(step, iNSampling, offsets);
-	dRes /= iNSampling;
+	if (filter == ISF_BOX)
+	{
+		MakeSampleOffsets(step, iNSampling, offsets);
+		dRes /= iNSampling;
+	}
 
-	// iterate through the pixels of the new image
-	DPoint2 p;
-	RGBAi rgba, sampled;
-	int count;
-	for (j = 0; j < Size.y; j++)
+	// The GDAL line buffer for out-of-memory images can only be used by one
+	//  thread, so we can only sample in parallel if every source is in memory.
+	std::vector<int> bitmaps(num_image);
+	std::vector<DRECT> extents(num_image);
+	bool bConcurrent = true;
+	for (int g = 0; g < num_image; g++)
+	{
+		bitmaps[g] = images[g]->FindBitmapForResolution(dRes);
+		if (bitmaps[g] >= 0 && !images[g]->IsBitmapInMemory(bitmaps[g]))
+			bConcurrent = false;
+
+		// Samples may fall up to half a pixel outside the image
+		const DPoint2 spacing = images[g]->GetSpacing();
+		images[g]->GetExtent(extents[g]);
+		extents[g].Grow(spacing.x, spacing.y);
+	}
+	VTLOG("  %d images, filter %d, %s\n", num_image, filter,
+		bConcurrent ? "parallel" : "serial");
+
+	// Work through the output in square blocks, so that each block only
+	//  needs to consider the images which overlap it.
+	const int iBlock = 64;
+	const int iBlocksX = (Size.x + iBlock - 1) / iBlock;
+	for (int j0 = 0; j0 < Size.y; j0 += iBlock)
 	{
-		if (UpdateProgressDialog(j*100/Size.y))
+		if (UpdateProgressDialog(j0*100/Size.y))
 		{
 			// Cancel
 			CloseProgressDialog();
 			return false;
 		}
+		const int j1 = std::min(j0 + iBlock, Size.y);
 
-		// Sample at the pixel centers, which are 1/2 pixel in from extents
-		p.y = area.bottom + (step.y/2) + (j * step.y);
-
-		for (i = 0; i < Size.x; i++)
+		#pragma omp parallel for schedule(dynamic) if (bConcurrent)
+		for (int bx = 0; bx < iBlocksX; bx++)
 		{
-			p.x = area.left + (step.x/2) + (i * step.x);
-
-			// find some data for this point
-			count = 0;
-			for (g = 0; g < num_image; g++)
+			const int i0 = bx * iBlock;
+			const int i1 = std::min(i0 + iBlock, Size.x);
+
+			// Which images overlap this block, in order of drawing
+			const DRECT block(area.left + i0 * step.x, area.bottom + j1 * step.y,
+							  area.left + i1 * step.x, area.bottom + j0 * step.y);
+			std::vector<int> overlapping;
+			for (int g = 0; g < num_image; g++)
+				if (bitmaps[g] >= 0 && block.OverlapsRect(extents[g]))
+					overlapping.push_back(g);
+
+			DPoint2 p;
+			RGBAi rgba;
+			for (int j = j0; j < j1; j++)
 			{
-				// take image that's on top (last in list)
-				if (images[g]->GetMultiSample(p, offsets, sampled, dRes))
+				// Sample at the pixel centers, which are 1/2 pixel in from extents
+				p.y = area.bottom + (step.y/2) + (j * step.y);
+
+				for (int i = i0; i < i1; i++)
 				{
-					rgba = sampled;
-					count++;
+					p.x = area.left + (step.x/2) + (i * step.x);
+
+					// take image that's on top (last in list)
+					bool bFound = false;
+					for (int o = (int) overlapping.size() - 1; o >= 0 && !bFound; o--)
+					{
+						const int g = overlapping[o];
+						bFound = images[g]->GetFilteredSample(p, bitmaps[g], filter, offsets, rgba);
+					}
+					if (bFound)
+						pTarget->SetRGBA(i, Size.y-1-j, rgba);
+					else
+						// write NODATA (black, with no alpha, for now)
+						pTarget->SetRGBA(i, Size.y-1-j, 0, 0, 0, 0);
 				}
 			}
-			if (count)
-				pTarget->SetRGBA(i, Size.y-1-j, rgba);
-			else
-				// write NODATA (black, with no alpha, for now)
-				pTarget->SetRGBA(i, Size.y-1-j, 0, 0, 0, 0);
 		}
 	}
 	CloseProgressDialog();
-	delete images;
+
+	clock_t tm2 = clock();
+	float time = ((float)tm2 - tm1)/CLOCKS_PER_SEC;
+	VTLOG(" SampleCurrentImages: %.3f seconds.\n", time);
+
 	return true;
 }
 
@@ -1848,6 +1938,20 @@ bool Builder::ConfirmValidCRS(vtProjection *pProj)
 }
 
 
+/**
+ * Mark the layers of a set which have their data in memory as recently used,
+ *  so that the elevation cache keeps them.  Call this once before sampling
+ *  the set with ElevLayerArrayValue.
+ */
+void ElevLayerArrayTouch(std::vector<vtElevLayer*> &elevs)
+{
+	for (uint g = 0; g < elevs.size(); g++)
+	{
+		if (elevs[g]->HasData())
+			ElevCacheTouch(elevs[g]);
+	}
+}
+
 /**
  * From a set of elevation layers, pick the valid elevation that occurs latest
  *  in the set.
@@ -1866,7 +1970,8 @@ float ElevLayerArrayValue(std::vector<vtElevLayer*> &elevs, const DPoint2 &p)
 		if (!ext.ContainsPoint(p, true))
 			continue;
 
-		// Check if elevation data is in memory
+		// Check if elevation data is in memory.  Layers which already are
+		//  were marked as recently used by ElevLayerArrayTouch.
 		if (!elev->HasData())
 		{
 			bool success = ElevCacheLoadData(elev);
@@ -1898,6 +2003,36 @@ float ElevLayerArrayValue(std::vector<vtElevLayer*> &elevs, const DPoint2 &p)
 	return fBestData;
 }
 
+/**
+ * Sample a set of elevation layers at a line of evenly spaced points,
+ * p0 + k * step for k from 0 to count-1.  Later layers in the array take
+ * priority over earlier ones, as with ElevLayerArrayValue.
+ *
+ * Unlike ElevLayerArrayValue, this does not page in any data, so it is safe
+ * to call from several threads at once; layers which are not in memory are
+ * skipped.
+ */
+void ElevLayerArrayValues(std::vector<vtElevLayer*> &elevs, const DPoint2 &p0,
+						  const DPoint2 &step, int count, float *values)
+{
+	for (int k = 0; k < count; k++)
+		values[k] = INVALID_ELEVATION;
+
+	for (uint g = 0; g < elevs.size(); g++)
+	{
+		vtElevLayer *elev = elevs[g];
+		if (!elev->HasData())
+			continue;
+
+		vtElevationGrid *grid = elev->GetGrid();
+		vtTin2d *tin = elev->GetTin();
+		if (grid)
+			grid->GetFilteredValues(p0, step, count, values);
+		else if (tin)
+			tin->FindAltitudesOnEarth(p0, step, count, values);
+	}
+}
+
 void ElevLayerArrayRange(std::vector<vtElevLayer*> &elevs,
 						 float &minval, float &maxval)
 {
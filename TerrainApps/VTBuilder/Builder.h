@@ -181,6 +181,7 @@ public:
 	// Import
 	void ImportData(LayerType ltype);
 	int ImportDataFromArchive(LayerType ltype, const wxString &fname_org, bool bRefresh);
+	bool ImportArchiveMembers(LayerType ltype, const wxString &fname_in, int &layer_count);
 
 	bool ImportLayersFromFile(LayerType ltype, const wxString &strFileName,
 		LayerArray &layers, bool bRefresh = false, bool bWarn = false);
@@ -276,7 +277,10 @@ protected:
 extern Builder *g_bld;
 
 wxString GetImportFilterString(LayerType ltype);
+void ElevLayerArrayTouch(std::vector<vtElevLayer*> &elevs);
 float ElevLayerArrayValue(std::vector<vtElevLayer*> &elevs, const DPoint2 &p);
+void ElevLayerArrayValues(std::vector<vtElevLayer*> &elevs, const DPoint2 &p0,
+						  const DPoint2 &step, int count, float *values);
 void ElevLayerArrayRange(std::vector<vtElevLayer*> &elevs,
 						 float &minval, float &maxval);
 
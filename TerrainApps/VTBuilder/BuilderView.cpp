@@ -81,6 +81,7 @@ BuilderView::BuilderView(wxWindow *parent, wxWindowID id, const wxPoint& pos,
 
 	m_bSkipNextRefresh = false;
 	m_bGotFirstIdle = false;
+	m_PrefetchArea.SetRect(0, 0, 0, 0);
 
 	m_bCrossSelect = false;
 	m_bShowMap = true;
@@ -1859,6 +1860,19 @@ void BuilderView::OnIdle(wxIdleEvent& event)
 
 	int i, iLayers = g_bld->NumLayers();
 
+	// Take any elevation data which was prefetched in the background, and
+	//  if the view has moved, prefetch the elevation around it.
+	if (ElevCachePoll() > 0)
+		g_bld->RefreshStatusBar();
+	DRECT view = GetWorldRect();
+	if (view != m_PrefetchArea)
+	{
+		m_PrefetchArea = view;
+		std::vector<vtElevLayer*> elevs;
+		g_bld->ElevLayerArray(elevs);
+		ElevCachePrefetchArea(elevs, view);
+	}
+
 	// Check to see if any elevation layers needs drawing
 	bool bNeedDraw = false;
 	bool bDrew = false;
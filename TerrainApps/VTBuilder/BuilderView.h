@@ -209,6 +209,7 @@ protected:
 	void BeginDistance();
 
 	bool m_bGotFirstIdle;
+	DRECT m_PrefetchArea;	// view area for which elevation was last prefetched
 	bool m_bSkipNextDraw;
 	bool m_bSkipNextRefresh;
 	wxSize m_previous_size;
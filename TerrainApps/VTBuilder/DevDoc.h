@@ -67,6 +67,10 @@ a few of the most potentially useful classes and methods:
 		<td>TAG_SAMPLING_N</td>
 		<td>Set to N for NxN multisampling for imagery.</td>
 	</tr>
+	<tr>
+		<td>TAG_SAMPLING_FILTER</td>
+		<td>Filter used when sampling image layers together: 0 nearest, 1 bilinear, 2 box (NxN multisampling).</td>
+	</tr>
 	<tr>
 		<td>TAG_BLACK_TRANSP</td>
 		<td>Treat black pixels in image layers as transparent, when sampling.</td>
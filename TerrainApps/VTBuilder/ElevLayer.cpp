@@ -12,12 +12,17 @@
 #endif
 
 #include <wx/file.h>
+#include <wx/thread.h>
+
+#include <algorithm>
+#include <deque>
 
 #include "vtdata/config_vtdata.h"
 #include "vtdata/DataPath.h"
 #include "vtdata/ElevationGrid.h"
 #include "vtdata/FileFilters.h"
 #include "vtdata/FilePath.h"
+#include "vtdata/Gridder.h"
 #include "vtdata/vtDIB.h"
 #include "vtdata/vtLog.h"
 #include "vtui/Helper.h"	// for FormatCoord
@@ -34,12 +39,6 @@
 #include "Tin2d.h"
 #include "vtBitmap.h"
 
-#if SUPPORT_QUIKGRID
-  #include "vtdata/QuikGrid.h"
-  // QuikGrid includes
-  #include "scatdata.h"
-  #include "xpand.h"
-#endif
 
 
 ////////////////////////////////////////////////////////////////////
@@ -282,7 +281,7 @@ bool vtElevLayer::GetAreaExtent(DRECT &rect)
 	return false;
 }
 
-int vtElevLayer::GetMemoryUsed() const
+size_t vtElevLayer::GetMemoryUsed() const
 {
 	if (m_pGrid)
 		return m_pGrid->MemoryUsed();
@@ -292,7 +291,7 @@ int vtElevLayer::GetMemoryUsed() const
 	return 0;
 }
 
-int vtElevLayer::MemoryNeededToLoad() const
+size_t vtElevLayer::MemoryNeededToLoad() const
 {
 	if (m_pGrid)
 		return m_pGrid->MemoryNeededToLoad();
@@ -1030,6 +1029,22 @@ bool vtElevLayer::ImportFromFile(const wxString &strFileName,
 	if (!success)
 		return false;
 
+	return ConfirmImport(err);
+}
+
+/**
+ * Use a grid which has already been read, such as from inside an archive.
+ * As with ImportFromFile, the user is asked for a CRS and extents if the
+ * grid lacks them.  The layer takes ownership of the grid.
+ */
+bool vtElevLayer::ImportFromGrid(vtElevationGrid *grid, vtElevError *err)
+{
+	m_pGrid = grid;
+	return ConfirmImport(err);
+}
+
+bool vtElevLayer::ConfirmImport(vtElevError *err)
+{
 	vtProjection *pProj;
 	if (m_pGrid)
 		pProj = &m_pGrid->GetProjection();
@@ -1100,13 +1115,18 @@ bool vtElevLayer::ImportFromFile(const wxString &strFileName,
 	return true;
 }
 
-//
-// Use the QuikGrid library to generate a grid from a set of 3D points.
-//
+/**
+ * Generate a grid from a set of 3D points.
+ *
+ * \param set The points, which must be a 3D point feature set.
+ * \param size The size of the grid, which covers the extents of the points.
+ * \param method How to interpolate the points; see vtPointGridder.
+ * \param fDistanceRatio For IDW, the search radius, in multiples of the
+ *		mean spacing of the points.
+ */
 bool vtElevLayer::CreateFromPoints(vtFeatureSet *set, const IPoint2 &size,
-								   float fDistanceRatio)
+								   int method, float fDistanceRatio)
 {
-#if SUPPORT_QUIKGRID
 	vtFeatureSetPoint3D *fsp3 = dynamic_cast<vtFeatureSetPoint3D *>(set);
 	if (!fsp3)
 		return false;
@@ -1114,74 +1134,23 @@ bool vtElevLayer::CreateFromPoints(vtFeatureSet *set, const IPoint2 &size,
 	DRECT extent;
 	fsp3->ComputeExtent(extent);
 
-	int iMaxSize = fsp3->NumEntities();
-	ScatData sdata(iMaxSize);
-	DPoint3 p;
-	for (int i = 0; i < iMaxSize; i++)
-	{
-		fsp3->GetPoint(i, p);
-		sdata.SetNext(p.x, p.y, p.z);
-	}
-
-	// Make a SurfaceGrid to hold the results
-	DPoint2 spacing(extent.Width() / (size.x-1), extent.Height() / (size.y-1));
-
-	SurfaceGrid Zgrid(size.x, size.y);
-	for (int x = 0; x < size.x; x++)
-		Zgrid.xset(x, extent.left + spacing.x * x);
-	for (int y = 0; y < size.y; y++)
-		Zgrid.yset(y, extent.bottom + spacing.y * y);
-
-	// "When any new points will not contributed more than 1/(scan bandwidth cutoff)
-	//   towards the value of a grid intersection scanning will cease in that
-	//   direction. "
-	int x1 = XpandScanRatio();		// default 16, valid values 1..100
-
-	// "The Distance cutoff specifies a percent of the Density Distance"
-	int x2 = XpandDensityRatio();	// default 150, valid values 1..10000
-	int x3 = XpandEdgeFactor();		// default 100, valid values 1..10000
-	float x4 = XpandUndefinedZ();
-	long x5 = XpandSample();
+	m_pGrid = new vtElevationGrid(extent, size, true, set->GetAtProjection());
 
-	XpandDensityRatio((int) (fDistanceRatio * 100));
+	vtPointGridder gridder;
+	gridder.SetMethod((vtPointGridder::Method) method);
+	gridder.SetDistanceCutoff(fDistanceRatio);
 
-	// Do the expand operation, gradually so we get progress
-	XpandInit(Zgrid, sdata);
-	int count = 0, total = size.x * size.y;
-	while (XpandPoint( Zgrid, sdata))
+	vtPointSourceFeatures source(fsp3);
+	if (!gridder.Grid(source, *m_pGrid, progress_callback))
 	{
-		if ((count % 100) == 0)
-		{
-			if (progress_callback(count * 99 / total))
-			{
-				// user cancelled
-				return false;
-			}
-		}
-		count++;
+		delete m_pGrid;
+		m_pGrid = NULL;
+		return false;
 	}
-
-	// copy the result to a ElevationGrid
-	m_pGrid = new vtElevationGrid(extent, size, true, set->GetAtProjection());
-
-	for (int x = 0; x < size.x; x++)
-		for (int y = 0; y < size.y; y++)
-		{
-			float value = Zgrid.z(x,y);
-			if (value == -99999)
-				m_pGrid->SetFValue(x, y, INVALID_ELEVATION);
-			else
-				m_pGrid->SetFValue(x, y, value);
-		}
-
 	m_pGrid->ComputeHeightExtents();
 	m_pGrid->SetupLocalCS();
 
 	return true;
-#else
-	// No QuikGrid
-	return false;
-#endif
 }
 
 void vtElevLayer::SetGrid(vtElevationGrid *grid)
@@ -1360,9 +1329,9 @@ void vtElevLayer::GetPropertyText(wxString &strIn)
 					num_unknown, num_unknown * 100.0f / (cols*rows));
 				result += str;
 			}
-			int mem = m_pGrid->MemoryUsed();
-			str.Printf(_("Size in memory: %d bytes (%.1f MB)\n"),
-				mem, (float)mem / 1024 / 1024);
+			size_t mem = m_pGrid->MemoryUsed();
+			str.Printf(_("Size in memory: %.0f bytes (%.1f MB)\n"),
+				(double)mem, (float)mem / 1024 / 1024);
 			result += str;
 		}
 		else
@@ -1396,9 +1365,9 @@ void vtElevLayer::GetPropertyText(wxString &strIn)
 			str.Printf(_T("%.2f, %.2f\n"), minh, maxh);
 		result += str;
 
-		int mem_bytes = m_pTin->GetMemoryUsed();
-		str.Printf(_T("Size in memory: %d bytes (%0.1f Kb, %0.1f Mb)\n"),
-			mem_bytes, (float)mem_bytes/1024, (float)mem_bytes/1024/1024);
+		size_t mem_bytes = m_pTin->GetMemoryUsed();
+		str.Printf(_T("Size in memory: %.0f bytes (%0.1f Kb, %0.1f Mb)\n"),
+			(double)mem_bytes, (float)mem_bytes/1024, (float)mem_bytes/1024/1024);
 		result += str;
 
 		LinearUnits units = m_pTin->m_proj.GetUnits();
@@ -1950,8 +1919,295 @@ bool MatchTilingToResolution(const DRECT &original_area, const DPoint2 &resoluti
 	return true;
 }
 
-// Pool of most-recently-used elevation layers, to keep in memory when paging
-std::vector<vtElevLayer*> g_ElevMRU;
+////////////////////////////////////////////////////////////////////
+// Elevation cache
+//
+// When delayed loading is on (m_iElevMemLimit != -1), only the headers of
+//  elevation files are read when they are opened.  The data is paged in
+//  when it is needed, and layers are paged out again in least-recently-used
+//  order to stay within the memory limit.
+//
+// Grids near the current view can also be prefetched by a background
+//  thread.  The thread loads each one into a temporary grid of its own; the
+//  main thread then swaps the data into the layer (ElevCachePoll), so a
+//  layer is never touched by two threads at once.
+
+// Layers with data in memory, least recently used first
+static std::vector<vtElevLayer*> g_ElevMRU;
+
+static ElevCacheStats g_ElevStats;
+
+static ElevCacheBytes ElevCacheLimitBytes()
+{
+	if (vtElevLayer::m_iElevMemLimit < 0)
+		return (ElevCacheBytes) -1;
+	return (ElevCacheBytes) vtElevLayer::m_iElevMemLimit << 20;
+}
+
+static ElevCacheBytes ElevCacheResidentBytes()
+{
+	ElevCacheBytes mem = 0;
+	for (size_t i = 0; i < g_ElevMRU.size(); i++)
+		mem += g_ElevMRU[i]->GetMemoryUsed();
+	return mem;
+}
+
+// Free unsticky layers, least recently used first, until 'needed' more
+//  bytes would fit within the limit.  Returns false if that isn't possible.
+static bool ElevCacheMakeRoom(ElevCacheBytes needed)
+{
+	const ElevCacheBytes limit = ElevCacheLimitBytes();
+	ElevCacheBytes mem = ElevCacheResidentBytes() + needed;
+
+	VTLOG("  ElevCache needs %.1f MB, limit is %d MB\n",
+		(double)mem / (1024*1024), vtElevLayer::m_iElevMemLimit);
+
+	size_t i = 0;
+	while (mem > limit && i < g_ElevMRU.size())
+	{
+		vtElevLayer *elay = g_ElevMRU[i];
+		if (elay->GetSticky())
+		{
+			i++;
+			continue;
+		}
+		mem -= elay->GetMemoryUsed();
+
+		VTLOG("  Freeing '%s', need %.1f MB\n",
+			(const char *) StartOfFilenameWX(elay->GetLayerFilename()).ToAscii(),
+			(double)mem / (1024*1024));
+
+		elay->FreeData();
+		g_ElevMRU.erase(g_ElevMRU.begin() + i);
+		g_ElevStats.evictions++;
+	}
+	return (mem <= limit);
+}
+
+////////////////////////////////////////////////////////////////////
+// Prefetch thread
+
+struct ElevPrefetch
+{
+	vtElevLayer *layer;
+	vtString fname;
+	ElevCacheBytes bytes;
+	vtElevationGrid *grid;	// set when loaded
+};
+
+// All of the following are guarded by g_PrefetchMutex
+static wxMutex g_PrefetchMutex;
+static std::deque<ElevPrefetch> g_PrefetchQueue;
+static std::vector<ElevPrefetch> g_PrefetchDone;
+static ElevPrefetch g_PrefetchCurrent;
+static bool g_bPrefetchBusy = false;		// g_PrefetchCurrent is being loaded
+static bool g_bPrefetchDiscard = false;	// throw away g_PrefetchCurrent when done
+static bool g_bPrefetchRunning = false;	// the thread exists
+static bool g_bPrefetchStop = false;
+
+static bool PrefetchProgress(int)
+{
+	// Returning true cancels the load
+	wxMutexLocker lock(g_PrefetchMutex);
+	return g_bPrefetchStop || g_bPrefetchDiscard;
+}
+
+class ElevPrefetchThread : public wxThread
+{
+public:
+	ElevPrefetchThread() : wxThread(wxTHREAD_DETACHED) {}
+
+	virtual ExitCode Entry()
+	{
+		while (true)
+		{
+			vtString fname;
+			{
+				wxMutexLocker lock(g_PrefetchMutex);
+				if (g_bPrefetchStop || g_PrefetchQueue.empty())
+				{
+					g_bPrefetchRunning = false;
+					return 0;
+				}
+				g_PrefetchCurrent = g_PrefetchQueue.front();
+				g_PrefetchQueue.pop_front();
+				g_bPrefetchBusy = true;
+				g_bPrefetchDiscard = false;
+				fname = g_PrefetchCurrent.fname;
+			}
+
+			vtElevationGrid *grid = new vtElevationGrid;
+			bool success = grid->LoadFromBT(fname, PrefetchProgress);
+
+			wxMutexLocker lock(g_PrefetchMutex);
+			g_bPrefetchBusy = false;
+			if (success && !g_bPrefetchDiscard && !g_bPrefetchStop)
+			{
+				g_PrefetchCurrent.grid = grid;
+				g_PrefetchDone.push_back(g_PrefetchCurrent);
+			}
+			else
+				delete grid;
+		}
+		return 0;
+	}
+};
+
+// Must be called with g_PrefetchMutex held.
+static bool PrefetchIsPending(vtElevLayer *elev)
+{
+	if (g_bPrefetchBusy && g_PrefetchCurrent.layer == elev)
+		return true;
+	for (size_t i = 0; i < g_PrefetchQueue.size(); i++)
+		if (g_PrefetchQueue[i].layer == elev)
+			return true;
+	for (size_t i = 0; i < g_PrefetchDone.size(); i++)
+		if (g_PrefetchDone[i].layer == elev)
+			return true;
+	return false;
+}
+
+/**
+ * Ask the background thread to load data for some layers, in order of
+ * preference.  Only layers whose data fits in the memory that is free now
+ * are loaded; prefetching never causes other layers to be paged out.
+ * Any earlier requests which haven't started yet are forgotten.
+ */
+void ElevCachePrefetch(const std::vector<vtElevLayer*> &layers)
+{
+	if (vtElevLayer::m_iElevMemLimit == -1)
+		return;		// Everything is already in memory
+
+	const ElevCacheBytes limit = ElevCacheLimitBytes();
+	ElevCacheBytes used = ElevCacheResidentBytes();
+
+	wxMutexLocker lock(g_PrefetchMutex);
+	g_PrefetchQueue.clear();
+
+	if (g_bPrefetchBusy)
+		used += g_PrefetchCurrent.bytes;
+	for (size_t i = 0; i < g_PrefetchDone.size(); i++)
+		used += g_PrefetchDone[i].bytes;
+
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		vtElevLayer *elev = layers[i];
+
+		// Only grids can be prefetched, and only when they aren't loaded yet
+		if (!elev->GetGrid() || elev->HasData() || PrefetchIsPending(elev))
+			continue;
+
+		const ElevCacheBytes bytes = elev->MemoryNeededToLoad();
+		if (used + bytes > limit)
+			continue;
+		used += bytes;
+
+		ElevPrefetch req;
+		req.layer = elev;
+		req.fname = (const char *) elev->GetLayerFilename().mb_str(wxConvUTF8);
+		req.bytes = bytes;
+		req.grid = NULL;
+		g_PrefetchQueue.push_back(req);
+	}
+
+	if (!g_PrefetchQueue.empty() && !g_bPrefetchRunning)
+	{
+		ElevPrefetchThread *thread = new ElevPrefetchThread;
+		if (thread->Create() == wxTHREAD_NO_ERROR && thread->Run() == wxTHREAD_NO_ERROR)
+			g_bPrefetchRunning = true;
+		else
+		{
+			VTLOG1("ElevCache: couldn't start prefetch thread.\n");
+			delete thread;
+			g_PrefetchQueue.clear();
+		}
+	}
+}
+
+/**
+ * Prefetch the grids which are in or near a view area, nearest first.
+ */
+void ElevCachePrefetchArea(const std::vector<vtElevLayer*> &elevs, const DRECT &view)
+{
+	// Consider the view, and an area around it as large again on each side
+	DRECT area = view;
+	area.Grow(view.Width(), view.Height());
+	const DPoint2 center = view.GetCenter();
+
+	std::vector<std::pair<double, vtElevLayer*> > nearby;
+	for (size_t i = 0; i < elevs.size(); i++)
+	{
+		DRECT ext;
+		elevs[i]->GetExtent(ext);
+		if (area.OverlapsRect(ext))
+			nearby.push_back(std::make_pair((ext.GetCenter() - center).Length(), elevs[i]));
+	}
+	std::sort(nearby.begin(), nearby.end());
+
+	std::vector<vtElevLayer*> layers(nearby.size());
+	for (size_t i = 0; i < nearby.size(); i++)
+		layers[i] = nearby[i].second;
+	ElevCachePrefetch(layers);
+}
+
+/**
+ * Hand any data which the prefetch thread has finished loading to the
+ * layers which asked for it.  Call this on the main thread, often.
+ *
+ * \return The number of layers which received data.
+ */
+int ElevCachePoll()
+{
+	std::vector<ElevPrefetch> done;
+	{
+		wxMutexLocker lock(g_PrefetchMutex);
+		done.swap(g_PrefetchDone);
+	}
+	const ElevCacheBytes limit = ElevCacheLimitBytes();
+	int adopted = 0;
+	for (size_t i = 0; i < done.size(); i++)
+	{
+		vtElevLayer *elev = done[i].layer;
+		vtElevationGrid *grid = elev->GetGrid();
+		if (grid && !elev->HasData() &&
+			ElevCacheResidentBytes() + done[i].bytes <= limit &&
+			grid->SwapData(*done[i].grid))
+		{
+			g_ElevMRU.push_back(elev);
+			g_ElevStats.prefetched++;
+			adopted++;
+		}
+		delete done[i].grid;
+	}
+	return adopted;
+}
+
+/**
+ * Stop the prefetch thread and discard anything it has loaded.  Call this
+ * before the layers are deleted when the application closes.
+ */
+void ElevCacheShutdown()
+{
+	{
+		wxMutexLocker lock(g_PrefetchMutex);
+		g_bPrefetchStop = true;
+		g_PrefetchQueue.clear();
+	}
+	while (true)
+	{
+		{
+			wxMutexLocker lock(g_PrefetchMutex);
+			if (!g_bPrefetchRunning)
+				break;
+		}
+		wxMilliSleep(5);
+	}
+	for (size_t i = 0; i < g_PrefetchDone.size(); i++)
+		delete g_PrefetchDone[i].grid;
+	g_PrefetchDone.clear();
+}
+
+////////////////////////////////////////////////////////////////////
 
 bool ElevCacheOpen(vtElevLayer *pLayer, const char *fname, vtElevError *err)
 {
@@ -1983,56 +2239,59 @@ bool ElevCacheOpen(vtElevLayer *pLayer, const char *fname, vtElevError *err)
 	}
 }
 
-bool ElevCacheLoadData(vtElevLayer *elev)
+/**
+ * Mark a layer whose data is in memory as the most recently used.
+ */
+void ElevCacheTouch(vtElevLayer *elev)
 {
-	wxString fname = elev->GetLayerFilename();
-	vtString fname_utf8 = (const char *)fname.mb_str(wxConvUTF8);
-
-	VTLOG("ElevCache needs '%s':\n", StartOfFilename(fname_utf8));
-
-	size_t num_loaded = g_ElevMRU.size();
-
-	int mem = 0;
-	for (size_t i = 0; i < num_loaded; i++)
-		mem += g_ElevMRU[i]->GetMemoryUsed();
-
-	// Consider memory needs of new layer's data
-	mem += elev->MemoryNeededToLoad();
-
-	VTLOG("  ElevCache needs %d bytes (%.1f MB, limit is %d MB)\n", mem,
-		(float)mem / (1024*1024), vtElevLayer::m_iElevMemLimit);
+	g_ElevStats.hits++;
+	std::vector<vtElevLayer*>::iterator it =
+		std::find(g_ElevMRU.begin(), g_ElevMRU.end(), elev);
+	if (it != g_ElevMRU.end() && it + 1 != g_ElevMRU.end())
+	{
+		g_ElevMRU.erase(it);
+		g_ElevMRU.push_back(elev);
+	}
+}
 
-	bool bGo = true;
-	while (bGo && mem > (vtElevLayer::m_iElevMemLimit * 1024 * 1024))
+bool ElevCacheLoadData(vtElevLayer *elev)
+{
+	// The prefetch thread may already have this layer, or be loading it
+	while (true)
 	{
-		// Look for a layer we can unload, starting with the least recently
-		// used (LRU) at the start of list
-		size_t i;
-		for (i = 0; i < g_ElevMRU.size(); i++)
+		bool bWait;
 		{
-			vtElevLayer *elay = g_ElevMRU[i];
-			if (!elay->GetSticky())
+			wxMutexLocker lock(g_PrefetchMutex);
+			bWait = (g_bPrefetchBusy && g_PrefetchCurrent.layer == elev);
+			for (size_t i = 0; i < g_PrefetchQueue.size(); i++)
 			{
-				// Found one
-				mem -= elay->GetMemoryUsed();
-
-				VTLOG("  Freeing '%s', Need %d bytes (%.1f MB)\n",
-					(const char *) StartOfFilenameWX(elay->GetLayerFilename()).ToAscii(),
-					mem, (float)mem / (1024*1024));
-
-				elay->FreeData();
-				g_ElevMRU.erase(g_ElevMRU.begin() + i);
-				break;
+				if (g_PrefetchQueue[i].layer == elev)
+				{
+					g_PrefetchQueue.erase(g_PrefetchQueue.begin() + i);
+					break;
+				}
 			}
 		}
-		// If we went all the way through the list without finding a layer
-		//  we can unload, then give up
-		if (i == g_ElevMRU.size())
+		ElevCachePoll();
+		if (elev->HasData())
 		{
-			VTLOG(" No more unloadable layers, will now exceed cache size.\n");
-			bGo = false;
+			ElevCacheTouch(elev);
+			return true;
 		}
+		if (!bWait)
+			break;
+		wxMilliSleep(5);
 	}
+	g_ElevStats.misses++;
+
+	wxString fname = elev->GetLayerFilename();
+	vtString fname_utf8 = (const char *)fname.mb_str(wxConvUTF8);
+
+	VTLOG("ElevCache needs '%s':\n", StartOfFilename(fname_utf8));
+
+	// Consider memory needs of new layer's data
+	if (!ElevCacheMakeRoom(elev->MemoryNeededToLoad()))
+		VTLOG(" No more unloadable layers, will now exceed cache size.\n");
 
 	VTLOG1("  ElevCache loading.\n");
 	if (elev->GetGrid())
@@ -2053,7 +2312,6 @@ bool ElevCacheLoadData(vtElevLayer *elev)
 	}
 
 	// most recently used goes to the end of the list
-	//  (to be precise, it is the most recently loaded)
 	g_ElevMRU.push_back(elev);
 
 	return true;
@@ -2061,6 +2319,28 @@ bool ElevCacheLoadData(vtElevLayer *elev)
 
 void ElevCacheRemove(vtElevLayer *elev)
 {
+	{
+		wxMutexLocker lock(g_PrefetchMutex);
+		if (g_bPrefetchBusy && g_PrefetchCurrent.layer == elev)
+			g_bPrefetchDiscard = true;
+		for (size_t i = 0; i < g_PrefetchQueue.size(); )
+		{
+			if (g_PrefetchQueue[i].layer == elev)
+				g_PrefetchQueue.erase(g_PrefetchQueue.begin() + i);
+			else
+				i++;
+		}
+		for (size_t i = 0; i < g_PrefetchDone.size(); )
+		{
+			if (g_PrefetchDone[i].layer == elev)
+			{
+				delete g_PrefetchDone[i].grid;
+				g_PrefetchDone.erase(g_PrefetchDone.begin() + i);
+			}
+			else
+				i++;
+		}
+	}
 	for (size_t i = 0; i < g_ElevMRU.size(); i++)
 	{
 		if (g_ElevMRU[i] == elev)
@@ -2071,3 +2351,16 @@ void ElevCacheRemove(vtElevLayer *elev)
 	}
 }
 
+void ElevCacheGetStats(ElevCacheStats &stats)
+{
+	stats = g_ElevStats;
+	stats.resident_layers = (int) g_ElevMRU.size();
+	stats.resident_bytes = ElevCacheResidentBytes();
+	stats.limit_bytes = ElevCacheLimitBytes();
+
+	wxMutexLocker lock(g_PrefetchMutex);
+	stats.pending = (int) (g_PrefetchQueue.size() + g_PrefetchDone.size());
+	if (g_bPrefetchBusy)
+		stats.pending++;
+}
+
@@ -53,8 +53,8 @@ public:
 	bool AskForSaveFilename();
 	bool GetAreaExtent(DRECT &rect);
 
-	int GetMemoryUsed() const;
-	int MemoryNeededToLoad() const;
+	size_t GetMemoryUsed() const;
+	size_t MemoryNeededToLoad() const;
 	void FreeData();
 	bool HasData();
 
@@ -79,7 +79,9 @@ public:
 	bool GetHeightExtents(float &fMinHeight, float &fMaxHeight) const;
 	bool ImportFromFile(const wxString &strFileName, bool progress_callback(int) = NULL,
 		vtElevError *err = NULL);
-	bool CreateFromPoints(vtFeatureSet *set, const IPoint2 &size, float fDistanceRatio);
+	bool ImportFromGrid(vtElevationGrid *grid, vtElevError *err = NULL);
+	bool CreateFromPoints(vtFeatureSet *set, const IPoint2 &size, int method,
+		float fDistanceRatio);
 
 	// grid operations
 	void SetGrid(vtElevationGrid *grid);
@@ -105,12 +107,15 @@ public:
 	static ElevDrawOptions m_draw;
 	static bool m_bDefaultGZip;
 
-	// only this many elevation files may be loaded, the rest are paged out on an LRU basis
+	// only this many MB of elevation data may be loaded, the rest are paged
+	//  out on an LRU basis (-1 means no limit)
 	static int m_iElevMemLimit;
 
 	bool NeedsDraw();
 
 protected:
+	bool ConfirmImport(vtElevError *err);
+
 	// We can store either a grid or a TIN, so at most one of these two
 	//  pointers will be set:
 	vtElevationGrid	*m_pGrid;
@@ -133,9 +138,29 @@ FPoint3 LightDirection(float angle, float direction);
 bool MatchTilingToResolution(const DRECT &original_area, const DPoint2 &resolution,
 							int &iTileSize, bool bGrow, bool bShrink, DRECT &new_area,
 							IPoint2 &tiling);
+
+// Elevation cache, which pages layer data in and out of memory.  Its byte
+//  counts are 64-bit even on 32-bit systems, where the total of all the
+//  layers can be much more than size_t holds.
+typedef unsigned long long ElevCacheBytes;
+
+struct ElevCacheStats
+{
+	ElevCacheStats() : hits(0), misses(0), prefetched(0), evictions(0),
+		resident_layers(0), pending(0), resident_bytes(0), limit_bytes(0) {}
+	int hits, misses, prefetched, evictions;
+	int resident_layers, pending;
+	ElevCacheBytes resident_bytes, limit_bytes;
+};
 bool ElevCacheOpen(vtElevLayer *pLayer, const char *fname, vtElevError *err);
 bool ElevCacheLoadData(vtElevLayer *elev);
+void ElevCacheTouch(vtElevLayer *elev);
 void ElevCacheRemove(vtElevLayer *elev);
+void ElevCachePrefetch(const std::vector<vtElevLayer*> &layers);
+void ElevCachePrefetchArea(const std::vector<vtElevLayer*> &elevs, const DRECT &view);
+int ElevCachePoll();
+void ElevCacheShutdown();
+void ElevCacheGetStats(ElevCacheStats &stats);
 
 #endif	// ELEVLAYER_H
 
@@ -851,6 +851,7 @@ bool Builder::SampleElevationToTileset(BuilderView *pView, TilingOptions &opts,
 
 			// If we are paging, don't page out any of the necessary layers
 			FlagStickyLayers(relevant_elevs);
+			ElevLayerArrayTouch(relevant_elevs);
 
 			// Estimate what tile resolution is appropriate.
 			//  If we can produce a lower resolution, then we can produce fewer lods.
@@ -195,6 +195,7 @@ MainFrame::MainFrame(wxFrame *frame, const wxString& title,
 MainFrame::~MainFrame()
 {
 	VTLOG1("Frame destructor\n");
+	ElevCacheShutdown();
 	WriteXML("VTBuilder.xml");
 
 	m_mgr.UnInit();
@@ -856,6 +857,7 @@ public:
 	{
 		m_elevs.clear();
 		m_frame->ElevLayerArray(m_elevs);
+		ElevLayerArrayTouch(m_elevs);
 	}
 	float GetElevation(const DPoint2 &p)
 	{
@@ -75,6 +75,7 @@ protected:
 	void OnDymaxTexture(wxCommandEvent &event);
 	void OnDymaxMap(wxCommandEvent &event);
 	void OnProcessBillboard(wxCommandEvent &event);
+	void OnPackTileset(wxCommandEvent &event);
 	void OnElevCopy(wxCommandEvent& event);
 	void OnElevPasteNew(wxCommandEvent& event);
 	void OnGeocode(wxCommandEvent &event);
@@ -166,6 +167,7 @@ protected:
 	void OnSelectHwy(wxCommandEvent& event);
 	void OnRoadClean(wxCommandEvent& event);
 	void OnRoadGuess(wxCommandEvent& event);
+	void OnRoadRouteBenchmark(wxCommandEvent& event);
 	void OnRoadFlatten(wxCommandEvent& event);
 
 	void OnUpdateSelectLink(wxUpdateUIEvent& event);
@@ -450,6 +452,7 @@ public:
 
 extern MainFrame *GetMainFrame();
 wxString GetImportFilterString(LayerType ltype);
+void ElevLayerArrayTouch(std::vector<vtElevLayer*> &elevs);
 float ElevLayerArrayValue(std::vector<vtElevLayer*> &elevs, const DPoint2 &p);
 void ElevLayerArrayRange(std::vector<vtElevLayer*> &elevs,
 						 float &minval, float &maxval);
@@ -19,11 +19,13 @@
 
 #include "vtdata/config_vtdata.h"
 #include "vtdata/ChunkLOD.h"
+#include "vtdata/ContourBuilder.h"
 #include "vtdata/DataPath.h"
 #include "vtdata/ElevationGrid.h"
 #include "vtdata/FileFilters.h"
+#include "vtdata/Gridder.h"
 #include "vtdata/Icosa.h"
-#include "vtdata/QuikGrid.h"
+#include "vtdata/RoadRouter.h"
 #include "vtdata/TripDub.h"
 #include "vtdata/Version.h"
 #include "vtdata/vtDIB.h"
@@ -34,6 +36,7 @@
 #include "vtui/ContourDlg.h"
 #include "vtui/ProfileDlg.h"
 #include "vtui/ProjectionDlg.h"
+#include "minidata/TilePack.h"
 
 #include "gdal_priv.h"
 
@@ -84,6 +87,7 @@ EVT_MENU(ID_SPECIAL_BATCH,	MainFrame::OnBatchConvert)
 EVT_MENU(ID_SPECIAL_DYMAX_TEXTURES,	MainFrame::OnDymaxTexture)
 EVT_MENU(ID_SPECIAL_DYMAX_MAP,	MainFrame::OnDymaxMap)
 EVT_MENU(ID_SPECIAL_PROCESS_BILLBOARD,	MainFrame::OnProcessBillboard)
+EVT_MENU(ID_SPECIAL_PACK_TILESET,	MainFrame::OnPackTileset)
 EVT_MENU(ID_SPECIAL_GEOCODE,	MainFrame::OnGeocode)
 EVT_MENU(ID_SPECIAL_RUN_TEST,	MainFrame::OnRunTest)
 EVT_MENU(ID_FILE_EXIT,		MainFrame::OnQuit)
@@ -171,6 +175,7 @@ EVT_MENU(ID_ROAD_SHOWNODES,		MainFrame::OnRoadShowNodes)
 EVT_MENU(ID_ROAD_SELECTHWY,		MainFrame::OnSelectHwy)
 EVT_MENU(ID_ROAD_CLEAN,			MainFrame::OnRoadClean)
 EVT_MENU(ID_ROAD_GUESS,			MainFrame::OnRoadGuess)
+EVT_MENU(ID_ROAD_ROUTE_BENCHMARK,	MainFrame::OnRoadRouteBenchmark)
 
 EVT_UPDATE_UI(ID_ROAD_SELECTROAD,	MainFrame::OnUpdateSelectLink)
 EVT_UPDATE_UI(ID_ROAD_SELECTNODE,	MainFrame::OnUpdateSelectNode)
@@ -393,6 +398,7 @@ void MainFrame::CreateMenus()
 	specialMenu->Append(ID_SPECIAL_DYMAX_TEXTURES, _("Create Dymaxion Textures"));
 	specialMenu->Append(ID_SPECIAL_DYMAX_MAP, _("Create Dymaxion Map"));
 	specialMenu->Append(ID_SPECIAL_PROCESS_BILLBOARD, _("Process Billboard Texture"));
+	specialMenu->Append(ID_SPECIAL_PACK_TILESET, _("Pack Tileset into Single File"));
 	specialMenu->Append(ID_SPECIAL_GEOCODE, _("Geocode"));
 	specialMenu->Append(ID_SPECIAL_RUN_TEST, _("Run test"));
 	specialMenu->Append(ID_ELEV_COPY, _("Copy Elevation Layer to Clipboard"));
@@ -496,6 +502,7 @@ void MainFrame::CreateMenus()
 	roadMenu->AppendSeparator();
 	roadMenu->Append(ID_ROAD_CLEAN, _("Clean RoadMap"), _("Clean"));
 	roadMenu->Append(ID_ROAD_GUESS, _("Guess Intersection Types"));
+	roadMenu->Append(ID_ROAD_ROUTE_BENCHMARK, _("Routing Benchmark"));
 	m_pMenuBar->Append(roadMenu, _("&Roads"));
 	m_iLayerMenu[LT_ROAD] = menu_num;
 	menu_num++;
@@ -823,11 +830,42 @@ void MainFrame::OnElevFlip(wxCommandEvent &event)
 	m_pView->Refresh();
 }
 
+// Make a grid from the points of a source, with about one node for each
+//  point, by IDW as "Generate Grid from 3D Points" does by default.
+static bool GridFromPoints(vtPointSource &source, const vtProjection &proj,
+	vtElevationGrid &grid, bool progress_callback(int))
+{
+	int iPoints;
+	DRECT extent;
+	if (!source.CountPoints(iPoints, &extent) || iPoints < 3 ||
+		extent.Width() <= 0 || extent.Height() <= 0)
+		return false;
+
+	const double spacing = sqrt(extent.Width() * extent.Height() / iPoints);
+	IPoint2 size((int) (extent.Width() / spacing) + 1,
+		(int) (extent.Height() / spacing) + 1);
+	if (size.x < 2) size.x = 2;
+	if (size.y < 2) size.y = 2;
+	if (size.x > 8192) size.x = 8192;
+	if (size.y > 8192) size.y = 8192;
+	if (!grid.Create(extent, size, true, proj))
+		return false;
+
+	vtPointGridder gridder;
+	gridder.SetMethod(vtPointGridder::IDW);
+	gridder.SetDistanceCutoff(1.5);
+	if (!gridder.Grid(source, grid, progress_callback))
+		return false;
+	grid.ComputeHeightExtents();
+	return true;
+}
+
 void MainFrame::OnBatchConvert(wxCommandEvent &event)
 {
 	wxArrayString aChoices;
 	aChoices.push_back(_("Import elevation grid data, write BT"));
 	aChoices.push_back(_("Import 3D point data, produce a TIN and write ITF"));
+	aChoices.push_back(_("Import 3D point data, produce a grid and write BT"));
 
 	int result = wxGetSingleChoiceIndex(_("Choose operation:"),
 		_T("Batch processing"), aChoices, this);
@@ -893,11 +931,9 @@ void MainFrame::OnBatchConvert(wxCommandEvent &event)
 		}
 		else if (result == 1)
 		{
-			vtFeatureSet *pSet = g_bld->ImportPointsFromXYZ(name1.c_str(), progress_callback_minor);
-			if (!pSet)
-				continue;
-			vtFeatureSetPoint3D *setpo3 = dynamic_cast<vtFeatureSetPoint3D *>(pSet);
-			if (!setpo3)
+			// Stream the points from the file, rather than importing them
+			vtPointSourceXYZ source;
+			if (!source.Open(name1.c_str()))
 				continue;
 
 			msg.Printf(_T("%d: Creating TIN"), count);
@@ -905,7 +941,12 @@ void MainFrame::OnBatchConvert(wxCommandEvent &event)
 				break;	// cancel
 
 			// points -> TIN algorithm -> TIN
-			vtTin2d *tin = new vtTin2d(setpo3);
+			vtTin2d *tin = new vtTin2d(source, 0.0f, progress_callback_minor);
+			if (tin->NumTris() == 0)
+			{
+				delete tin;
+				continue;
+			}
 
 			// inherit CRS from application
 			vtProjection proj;
@@ -934,7 +975,39 @@ void MainFrame::OnBatchConvert(wxCommandEvent &event)
 
 			// clean up
 			delete pEL;
-			delete pSet;
+		}
+		else if (result == 2)
+		{
+			// Stream the points from the file, rather than importing them
+			vtPointSourceXYZ source;
+			if (!source.Open(name1.c_str()))
+				continue;
+
+			msg.Printf(_T("%d: Creating grid"), count);
+			if (UpdateProgressDialog2(count * 99 / total, 0, msg))
+				break;	// cancel
+
+			// inherit CRS from application
+			vtProjection proj;
+			g_bld->GetProjection(proj);
+
+			vtElevationGrid grid;
+			if (!GridFromPoints(source, proj, grid, progress_callback_minor))
+				continue;
+
+			vtString name2 = path2.c_str();
+			name2 += "/";
+			name2 += it.filename().c_str();
+			RemoveFileExtensions(name2);
+			name2 += ".bt";
+
+			msg.Printf(_T("%d: Write "), count);
+			msg += wxString((const char *) name2, wxConvUTF8);
+			if (UpdateProgressDialog2(count * 99 / total, 0, msg))
+				break;	// cancel
+
+			if (grid.SaveToBT(name2, progress_callback_minor))
+				succeeded++;
 		}
 	}
 	msg.Printf(_T("Successfully wrote %d files"), succeeded);
@@ -958,6 +1031,51 @@ void MainFrame::OnProcessBillboard(wxCommandEvent &event)
 	DoProcessBillboard();
 }
 
+void MainFrame::OnPackTileset(wxCommandEvent &event)
+{
+	wxFileDialog loadFile(NULL, _("Choose Tileset to Pack"), _T(""), _T(""),
+		FSTRING_INI, wxFD_OPEN);
+	if (loadFile.ShowModal() != wxID_OK)
+		return;
+
+	vtString ini_fname = (const char *) loadFile.GetPath().mb_str(wxConvUTF8);
+
+	// We only need the size of the tileset from its description
+	int cols = 0, rows = 0;
+	FILE *fp = vtFileOpen(ini_fname, "rb");
+	if (fp)
+	{
+		char buf[4096];
+		while (fgets(buf, 4096, fp))
+		{
+			if (!strncmp(buf, "Columns", 7))
+				sscanf(buf, "Columns=%d\n", &cols);
+			if (!strncmp(buf, "Rows", 4))
+				sscanf(buf, "Rows=%d\n", &rows);
+		}
+		fclose(fp);
+	}
+	if (cols == 0 || rows == 0)
+	{
+		DisplayAndLog("Couldn't read tileset description.");
+		return;
+	}
+
+	// The tiles are in a folder with the same name as the .ini file
+	vtString folder = ini_fname;
+	RemoveFileExtensions(folder);
+	vtString pack_fname = folder + TILEPACK_EXTENSION;
+
+	OpenProgressDialog(_("Packing Tileset"), loadFile.GetPath(), false, this);
+	bool success = WriteTilePack(folder, cols, rows, pack_fname, progress_callback);
+	CloseProgressDialog();
+
+	if (success)
+		DisplayAndLog("Wrote %s", (const char *) pack_fname);
+	else
+		DisplayAndLog("Couldn't write tile pack.");
+}
+
 void MainFrame::OnGeocode(wxCommandEvent &event)
 {
 	DoGeocode();
@@ -1937,6 +2055,35 @@ void MainFrame::OnRoadGuess(wxCommandEvent &event)
 	m_pView->Refresh();
 }
 
+void MainFrame::OnRoadRouteBenchmark(wxCommandEvent &event)
+{
+	vtRoadLayer *pRL = GetActiveRoadLayer();
+	if (!pRL) return;
+
+	// Time random queries with each method, without and with preprocessing
+	const int queries = 1000;
+	vtRoadRouter router;
+	router.SetRoadMap(pRL);
+
+	router.SetMethod(RM_ASTAR);
+	const double rate_astar = router.Benchmark(queries);
+	router.SetMethod(RM_BIDIRECTIONAL);
+	const double rate_bidir = router.Benchmark(queries);
+
+	OpenProgressDialog(_("Building Contraction Hierarchy"), _T(""), false, this);
+	clock_t tm1 = clock();
+	router.BuildHierarchy(progress_callback);
+	clock_t tm2 = clock();
+	CloseProgressDialog();
+
+	router.SetMethod(RM_HIERARCHY);
+	const double rate_ch = router.Benchmark(queries);
+
+	DisplayAndLog("Routing on %d nodes, queries per second:\n"
+		"A*: %.0f\nBidirectional: %.0f\nContraction hierarchy: %.0f (preprocessing took %.1f seconds)",
+		pRL->NumNodes(), rate_astar, rate_bidir, rate_ch, (float) (tm2 - tm1) / CLOCKS_PER_SEC);
+}
+
 void MainFrame::OnUpdateRoadFlatten(wxUpdateUIEvent& event)
 {
 	vtElevLayer *pE = (vtElevLayer *)GetMainFrame()->FindLayerOfType(LT_ELEVATION);
@@ -2305,7 +2452,24 @@ void MainFrame::OnElevToTin(wxCommandEvent& event)
 	vtElevLayer *pEL1 = GetActiveElevLayer();
 	vtElevationGrid *grid = pEL1->GetGrid();
 
-	vtTin2d *tin = new vtTin2d(grid);
+	// Simplify the surface to within a tolerance, or use every heixel
+	wxString str = wxGetTextFromUser(
+		_("Maximum vertical error, to use fewer heixels (0 to use them all):"),
+		_("Convert to TIN"), _T("0"), this);
+	if (str == _T(""))
+		return;
+	float fMaxError = atof(str.mb_str(wxConvUTF8));
+
+	OpenProgressDialog(_("Converting to TIN"), _T(""), false, this);
+	vtTin2d *tin = new vtTin2d(grid, fMaxError, progress_callback);
+	CloseProgressDialog();
+	if (tin->NumTris() == 0)
+	{
+		delete tin;
+		DisplayAndLog("Couldn't make a TIN from the grid.");
+		return;
+	}
+
 	vtElevLayer *pEL = new vtElevLayer;
 	pEL->SetTin(tin);
 
@@ -2331,7 +2495,6 @@ void MainFrame::OnElevContours(wxCommandEvent& event)
 	VTLOG("OnElevContours: using grid of size %d x %d, spacing %lf * %lf\n",
 		size.x, size.y, grid->GetSpacing().x, grid->GetSpacing().y);
 
-#if SUPPORT_QUIKGRID
 	ContourDlg dlg(this, -1, _("Add Contours"));
 
 	// Put any existing raw polyline layers in the drop-down choice
@@ -2380,17 +2543,19 @@ void MainFrame::OnElevContours(wxCommandEvent& event)
 
 	vtFeatureSetLineString *fsls = (vtFeatureSetLineString *) raw->GetFeatureSet();
 
-	VTLOG1(" Setting up ContourConverter\n");
-	ContourConverter cc;
-	if (!cc.Setup(grid, fsls))
-		return;
-
-	VTLOG1(" GenerateContour\n");
+	vtContourBuilder cb;
 	if (dlg.m_bSingle)
-		cc.GenerateContour(dlg.m_fElevSingle);
+		cb.AddLevel(dlg.m_fElevSingle);
 	else
-		cc.GenerateContours(dlg.m_fElevEvery);
-	cc.Finish();
+		cb.AddLevels(*grid, dlg.m_fElevEvery);
+
+	VTLOG1(" Generating contours\n");
+	OpenProgressDialog(_("Generating Contours"), _T(""), true, this);
+	bool success = cb.Build(*grid, progress_callback);
+	CloseProgressDialog();
+	if (!success)
+		return;
+	cb.AddToFeatures(fsls);
 
 	// The contour generator tends to make a lot of extra points. Clean them up.
 	// Use an epsilon based on the grid's spacing; anything smaller than that is
@@ -2401,7 +2566,6 @@ void MainFrame::OnElevContours(wxCommandEvent& event)
 	VTLOG(" Removed %d points, done\n", removed);
 
 	m_pView->Refresh();
-#endif // SUPPORT_QUIKGRID
 }
 
 void MainFrame::OnElevCarve(wxCommandEvent &event)
@@ -3625,7 +3789,19 @@ void MainFrame::OnRawGenerateTIN(wxCommandEvent& event)
 	vtFeatureSetPoint3D *setpo3 = dynamic_cast<vtFeatureSetPoint3D *>(pSet);
 	vtFeatureSetPolygon *setpg = dynamic_cast<vtFeatureSetPolygon *>(pSet);
 	if (setpo3)
-		tin = new vtTin2d(setpo3);
+	{
+		// Optionally, decimate the points
+		wxString str = wxGetTextFromUser(
+			_("Maximum vertical error, to use fewer points (0 to use them all):"),
+			_("Generate TIN"), _T("0"), this);
+		if (str == _T(""))
+			return;
+		float fMaxError = atof(str.mb_str(wxConvUTF8));
+
+		OpenProgressDialog(_("Generating TIN"), _T(""), false, this);
+		tin = new vtTin2d(setpo3, fMaxError, progress_callback);
+		CloseProgressDialog();
+	}
 	else if (setpg)
 	{
 		uint n = setpg->NumFields();
@@ -3905,6 +4081,7 @@ void MainFrame::OnRawGenElevation(wxCommandEvent& event)
 	dlg.m_Size.y = 512;
 	dlg.RecomputeSize();
 	dlg.m_fDistanceCutoff = 1.5f;
+	dlg.m_iMethod = vtPointGridder::IDW;
 
 	int ret = dlg.ShowModal();
 	if (ret == wxID_CANCEL)
@@ -3915,7 +4092,7 @@ void MainFrame::OnRawGenElevation(wxCommandEvent& event)
 	OpenProgressDialog(_T("Creating Grid"), _T(""), true);
 	int xsize = 800;
 	int ysize = 300;
-	if (el->CreateFromPoints(pSet, dlg.m_Size, dlg.m_fDistanceCutoff))
+	if (el->CreateFromPoints(pSet, dlg.m_Size, dlg.m_iMethod, dlg.m_fDistanceCutoff))
 		AddLayerWithCheck(el);
 	else
 		delete el;
@@ -13,6 +13,7 @@
 #include "wx/wxprec.h"
 
 #include "GenGridDlg.h"
+#include "vtdata/Gridder.h"
 #include "vtui/AutoDialog.h"
 
 // WDR: class implementations
@@ -28,6 +29,8 @@ BEGIN_EVENT_TABLE(GenGridDlg,GenGridDlgBase)
 	EVT_TEXT( ID_SPACINGY, GenGridDlg::OnSpacingXY )
 	EVT_TEXT( ID_SIZEY, GenGridDlg::OnSizeXY )
 	EVT_TEXT( ID_SIZEY, GenGridDlg::OnSizeXY )
+	EVT_CHOICE( ID_GRID_METHOD, GenGridDlg::OnMethod )
+	EVT_INIT_DIALOG( GenGridDlg::OnInitDialog )
 END_EVENT_TABLE()
 
 GenGridDlg::GenGridDlg( wxWindow *parent, wxWindowID id, const wxString &title,
@@ -47,6 +50,7 @@ GenGridDlg::GenGridDlg( wxWindow *parent, wxWindowID id, const wxString &title,
 	AddNumValidator(this, ID_SIZEX, &m_Size.x);
 	AddNumValidator(this, ID_SIZEY, &m_Size.y);
 	AddNumValidator(this, ID_TEXT_DIST_CUTOFF, &m_fDistanceCutoff);
+	AddValidator(this, ID_GRID_METHOD, &m_iMethod);
 
 	GetSizer()->SetSizeHints(this);
 }
@@ -57,9 +61,27 @@ void GenGridDlg::RecomputeSize()
 	m_fSpacingY = m_fAreaY / m_Size.y;
 }
 
+// The distance cutoff only applies to inverse distance weighting
+void GenGridDlg::UpdateEnabling()
+{
+	m_text_dist_cutoff->Enable(m_iMethod == vtPointGridder::IDW);
+}
+
 
 // WDR: handler implementations for GenGridDlg
 
+void GenGridDlg::OnInitDialog( wxInitDialogEvent& event )
+{
+	wxDialog::OnInitDialog(event);
+	UpdateEnabling();
+}
+
+void GenGridDlg::OnMethod( wxCommandEvent &event )
+{
+	TransferDataFromWindow();
+	UpdateEnabling();
+}
+
 void GenGridDlg::OnSizeXY( wxCommandEvent &event )
 {
 	if (m_bSetting)
@@ -33,6 +33,7 @@ public:
 	wxTextCtrl* GetSpacingX()  { return (wxTextCtrl*) FindWindow( ID_SPACINGX ); }
 
 	void RecomputeSize();
+	void UpdateEnabling();
 
 	double  m_fSpacingX;
 	double  m_fSpacingY;
@@ -40,6 +41,7 @@ public:
 	double  m_fAreaX;
 	double  m_fAreaY;
 	float m_fDistanceCutoff;
+	int m_iMethod;		// a vtPointGridder::Method
 
 private:
 	// WDR: member variable declarations for GenGridDlg
@@ -49,6 +51,8 @@ private:
 	// WDR: handler declarations for GenGridDlg
 	void OnSizeXY( wxCommandEvent &event );
 	void OnSpacingXY( wxCommandEvent &event );
+	void OnMethod( wxCommandEvent &event );
+	void OnInitDialog( wxInitDialogEvent& event );
 
 private:
 	DECLARE_EVENT_TABLE()
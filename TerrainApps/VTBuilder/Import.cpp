@@ -118,8 +118,9 @@ void Builder::ImportData(LayerType ltype)
 
 /**
  * Import data of a given type from a file, which can potentially be an
- * archive file.  If it's an archive, it will be unarchived to a temporary
- * folder, and the contents will be imported.
+ * archive file.  If it's an archive, its contents are imported from inside
+ * it if possible (see ImportArchiveMembers), otherwise it will be unarchived
+ * to a temporary folder, and the contents will be imported.
  *
  * \return Number of layers created during the import.
  */
@@ -170,6 +171,11 @@ int Builder::ImportDataFromArchive(LayerType ltype, const wxString &fname_in,
 		return num_imported;
 	}
 
+	// Most contents can be read where they are, without expanding the archive
+	int layer_count = 0;
+	if (ImportArchiveMembers(ltype, fname_in, layer_count))
+		return layer_count;
+
 	// try to uncompress
 	wxString path, prepend_path;
 	path = GetTempFolderName(fname_in.mb_str(wxConvUTF8));
@@ -195,7 +201,6 @@ int Builder::ImportDataFromArchive(LayerType ltype, const wxString &fname_in,
 		num_files = ExpandZip(str1, str2, progress_callback);
 	CloseProgressDialog();
 
-	int layer_count = 0;
 	VTLOG(" Unarchived %d files.\n", num_files);
 	if (num_files < 1)
 	{
@@ -374,6 +379,172 @@ int Builder::ImportDataFromArchive(LayerType ltype, const wxString &fname_in,
 	return layer_count;
 }
 
+// Elevation formats which can be read from inside an archive
+static const char *s_ArchiveGridExts[] = { ".asc", ".bil", ".bt", ".dem",
+	".dt0", ".dt1", ".dt2", ".dte", ".grd", ".hgt", ".png", ".ter", ".tif",
+	".tiff", NULL };
+
+// Image formats which can be read from inside an archive
+static const char *s_ArchiveImageExts[] = { ".ecw", ".img", ".jp2", ".jpg",
+	".png", ".tif", ".tiff", NULL };
+
+// Files which accompany data files, and are read along with them
+static const char *s_ArchiveSidecarExts[] = { ".aux", ".blw", ".dbf", ".hdr",
+	".htm", ".html", ".jgw", ".pgw", ".prj", ".shx", ".stx", ".tfw", ".txt",
+	".xml", NULL };
+
+static bool HasExtension(const vtString &ext, const char **exts)
+{
+	for (int i = 0; exts[i] != NULL; i++)
+	{
+		if (!ext.CompareNoCase(exts[i]))
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Import the contents of an archive by reading each member from inside it,
+ * with no temporary copy.  This works when all the members are elevation
+ * grids, images, or shapefiles, which are read with GDAL and OGR.  The
+ * grids are read on several threads at once.
+ *
+ * \param layer_count	Receives the number of layers created.
+ *
+ * \return false if the archive's contents must be expanded to be imported,
+ *	for example SDTS and TIGER data, whose readers expect a folder of files,
+ *	or if none of the members could be read from inside the archive.
+ */
+bool Builder::ImportArchiveMembers(LayerType ltype, const wxString &fname_in,
+								   int &layer_count)
+{
+	vtArchive archive;
+	if (!archive.Open(fname_in.mb_str(wxConvUTF8)))
+		return false;
+
+	// Decide how to read each member
+	std::vector<uint> grids, images, features;
+	for (uint i = 0; i < archive.NumEntries(); i++)
+	{
+		const vtArchiveEntry &entry = archive.GetEntry(i);
+		if (entry.m_bDirectory)
+			continue;
+		vtString ext = GetExtension(entry.m_name, false);
+
+		if (HasExtension(ext, s_ArchiveSidecarExts))
+			continue;
+		else if ((ltype == LT_ELEVATION || ltype == LT_UNKNOWN) &&
+			HasExtension(ext, s_ArchiveGridExts))
+			grids.push_back(i);
+		else if (ltype == LT_IMAGE && HasExtension(ext, s_ArchiveImageExts))
+			images.push_back(i);
+		else if ((ltype == LT_RAW || ltype == LT_UNKNOWN) &&
+			!ext.CompareNoCase(".shp"))
+			features.push_back(i);
+		else
+			return false;
+	}
+	if (grids.empty() && images.empty() && features.empty())
+		return false;
+
+	VTLOG(" Reading %d members from inside the archive.\n",
+		(int) (grids.size() + images.size() + features.size()));
+	vtString archive_name = (const char *) fname_in.mb_str(wxConvUTF8);
+	std::vector<vtLayer *> layers;
+
+	// Read the grids in parallel.  Any questions for the user (about CRS or
+	//  extents) are asked afterwards, on this thread.
+	std::vector<vtElevationGrid *> loaded(grids.size(), (vtElevationGrid *) NULL);
+	vtThreadFlag cancel;
+	if (!grids.empty())
+	{
+		// Set up GDAL before the threads need it
+		g_GDALWrapper.RequestGDALFormats();
+
+		OpenProgressDialog(_("Reading archive"), fname_in, true, m_pParentWindow);
+		int iDone = 0;
+		#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < (int) grids.size(); i++)
+		{
+			if (cancel.IsSet())
+				continue;
+			vtElevationGrid *grid = new vtElevationGrid;
+			if (grid->LoadFromFile(archive.GetVirtualPath(grids[i])))
+				loaded[i] = grid;
+			else
+				delete grid;
+
+			const int iCount = vtAtomicIncrement(iDone);
+			if (vtIsFirstThread() && UpdateProgressDialog(iCount * 99 / (int) grids.size()))
+				cancel.Set();
+		}
+		CloseProgressDialog();
+
+		for (uint i = 0; i < grids.size(); i++)
+		{
+			if (!loaded[i])
+				continue;
+			if (cancel.IsSet())
+			{
+				// No layer owns the grid yet
+				delete loaded[i];
+				continue;
+			}
+			vtElevLayer *pEL = new vtElevLayer;
+			if (pEL->ImportFromGrid(loaded[i]))
+			{
+				pEL->SetLayerFilename(wxString(archive.GetEntry(grids[i]).m_name, wxConvUTF8));
+				layers.push_back(pEL);
+			}
+			else
+				delete pEL;		// and the grid with it
+		}
+	}
+
+	// The readers for images and features may ask questions, so they read
+	//  one member at a time.
+	for (uint i = 0; i < images.size(); i++)
+	{
+		wxString path(archive.GetVirtualPath(images[i]), wxConvUTF8);
+		vtLayer *pLayer = ImportImage(path);
+		if (pLayer)
+		{
+			pLayer->SetLayerFilename(wxString(archive.GetEntry(images[i]).m_name, wxConvUTF8));
+			layers.push_back(pLayer);
+		}
+	}
+	for (uint i = 0; i < features.size(); i++)
+	{
+		vtRawLayer *pRL = new vtRawLayer;
+		pRL->SetLayerFilename(wxString(archive.GetVirtualPath(features[i]), wxConvUTF8));
+		if (pRL->OnLoad())
+		{
+			pRL->SetLayerFilename(wxString(archive.GetEntry(features[i]).m_name, wxConvUTF8));
+			layers.push_back(pRL);
+		}
+		else
+			delete pRL;
+	}
+
+	for (uint i = 0; i < layers.size(); i++)
+	{
+		if (AddLayerWithCheck(layers[i], true))
+		{
+			layers[i]->SetImportedFrom(fname_in);
+			layer_count++;
+		}
+		else
+			delete layers[i];
+	}
+	if (layer_count == 0 && !cancel.IsSet())
+	{
+		// Perhaps the readers can manage with the expanded files instead
+		VTLOG1(" Couldn't import anything from inside the archive.\n");
+		return false;
+	}
+	return true;
+}
+
 /**
  * ImportLayersFromFile: the main import method.
  *
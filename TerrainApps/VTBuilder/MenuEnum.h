@@ -20,6 +20,7 @@ enum
 	ID_SPECIAL_DYMAX_TEXTURES,
 	ID_SPECIAL_DYMAX_MAP,
 	ID_SPECIAL_PROCESS_BILLBOARD,
+	ID_SPECIAL_PACK_TILESET,
 	ID_SPECIAL_GEOCODE,
 	ID_SPECIAL_RUN_TEST,
 
@@ -79,6 +80,7 @@ enum
 	ID_ROAD_SELECTHWY,
 	ID_ROAD_CLEAN,
 	ID_ROAD_GUESS,
+	ID_ROAD_ROUTE_BENCHMARK,
 
 	ID_TOWER_ADD,
 	ID_TOWER_SELECT,
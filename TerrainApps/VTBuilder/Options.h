@@ -17,6 +17,7 @@
 #define TAG_REPRO_TO_FLOAT_ALWAYS "ReproToFloatAlways"
 #define TAG_REPRO_TO_FLOAT_NEVER "ReproToFloatNever"
 #define TAG_SAMPLING_N "MultiSampleN"
+#define TAG_SAMPLING_FILTER "ImageSampleFilter"	// enum ImageSampleFilter
 #define TAG_ELEV_MAX_SIZE "ElevMaxRenderSize"
 #define TAG_MAX_MEGAPIXELS "MaxMegapixels"
 #define TAG_BLACK_TRANSP "BlackAsTransparent"
@@ -4,7 +4,7 @@
 // contains methods of RoadMapEdit used for fixing and
 //  cleaning the roadmap topology
 //
-// Copyright (c) 2001-2008 Virtual Terrain Project
+// Copyright (c) 2001-2013 Virtual Terrain Project
 // Free for all uses, see license.txt for details.
 //
 
@@ -69,14 +69,10 @@ void NodeEdit::EnforceLinkEndpoints()
 //
 int RoadMapEdit::MergeRedundantNodes(bool bDegrees, bool progress_callback(int))
 {
-	NodeEdit *prev = NULL, *next;
-	DPoint2 diff;
 	int removed = 0;
 
-	int nodes = NumNodes();
-	float total = (float)nodes * nodes / 2;
-	int count1 = 0, count = 0, count_tick, count_last_tick = 0;
-	float tick_size = (float)total / 100;
+	const int nodes = NumNodes();
+	int count_tick, count_last_tick = 0;
 	double tolerance, tolerance_squared;
 
 	if (bDegrees)
@@ -85,53 +81,39 @@ int RoadMapEdit::MergeRedundantNodes(bool bDegrees, bool progress_callback(int))
 		tolerance = TOLERANCE_METERS;
 	tolerance_squared = tolerance * tolerance;
 
-	NodeEdit *pN, *pN2;
+	// Use a grid so that each node only looks at the nodes near it
+	BuildNodeGrid(tolerance);
 
-	for (pN = GetFirstNode(); pN && pN->GetNext(); pN = next)
+	// Go from the end, since removing a node moves the last node into its place
+	for (int i = nodes - 1; i >= 0; i--)
 	{
-		count1++;
-		next = pN->GetNext();
-		bool remove = false;
-		for (pN2 = next; pN2; pN2 = pN2->GetNext())
-		{
-			diff = pN2->Pos() - pN->Pos();
-			if (diff.LengthSquared() < tolerance_squared)
-			{
-				remove = true;
-				break;
-			}
-		}
-		count += (nodes - count1);
-		count_tick = (int) (count / tick_size);
-		if (count_tick > count_last_tick)
+		NodeEdit *pN = GetNode(i);
+		NodeEdit *pN2 = (NodeEdit *) FindNodeAtPoint(pN->Pos(), tolerance, pN);
+
+		count_tick = (nodes - i) * 100 / nodes;
+		if (progress_callback != NULL && count_tick > count_last_tick)
 		{
 			count_last_tick = count_tick;
 			progress_callback(count_tick);
 		}
-		if (remove)
+		if (pN2 && (pN2->Pos() - pN->Pos()).LengthSquared() < tolerance_squared)
 		{
 			// we've got a pair that need to be merged
 			//new point is placed between the 2 original points
-			pN2->SetPos((pN2->Pos() + pN->Pos()) / 2.0f);
+			MoveNode(pN2, (pN2->Pos() + pN->Pos()) / 2.0f);
 
 			// we're going to remove the "pN" node
 			// inform any roads which may have referenced it
 			ReplaceNode(pN, pN2);
-
-			// to remove pN, link around it
-			if (prev)
-				prev->SetNext(next);
-			else
-				m_pFirstNode = next;
-			delete pN;
+			RemoveNode(pN);
 
 			// for the roads that now end in pN2, move their end points
 			pN2->EnforceLinkEndpoints();
 			removed++;
 		}
-		else
-			prev = pN;
 	}
+	ClearNodeGrid();
+
 	VTLOG(" Removed %i nodes\n", removed);
 	return removed;
 }
@@ -150,12 +132,11 @@ int RoadMapEdit::RemoveDegenerateLinks()
 {
 	int count = 0;
 
-	LinkEdit *prevL = NULL, *nextL;
-
-	for (LinkEdit *pL = GetFirstLink(); pL; pL = nextL)
+	// Go from the end, since removing a link moves the last link into its place
+	for (int i = NumLinks() - 1; i >= 0; i--)
 	{
+		LinkEdit *pL = GetLink(i);
 		bool bad = false;
-		nextL = pL->GetNext();
 
 		// Does it start and end at same node?
 		if (pL->GetNode(0) == pL->GetNode(1))
@@ -170,21 +151,11 @@ int RoadMapEdit::RemoveDegenerateLinks()
 		}
 		if (bad)
 		{
-			// remove it
-			if (prevL)
-				prevL->SetNext(nextL);
-			else
-				m_pFirstLink = nextL;
-
-			// notify the nodes that the road is gone
-			pL->GetNode(0)->DetachLink(pL);
-			pL->GetNode(1)->DetachLink(pL);
-
-			delete pL;
+			// notify the nodes that the road is gone, and remove it
+			DetachLink(pL);
+			RemoveLink(pL);
 			count++;
 		}
-		else
-			prevL = pL;
 	}
 	VTLOG(" Removed %i degenerate links.\n", count);
 	return count;
@@ -251,32 +222,23 @@ int RoadMapEdit::CleanLinkPoints(double epsilon)
 int RoadMapEdit::DeleteDanglingLinks()
 {
 	NodeEdit *pN1, *pN2;
-	LinkEdit *pR = GetFirstLink();
-	LinkEdit *prev = NULL, *next;
 	int count = 0;
-	while (pR)
+
+	// Go from the end, since removing a link moves the last link into its place
+	for (int i = NumLinks() - 1; i >= 0; i--)
 	{
-		next = pR->GetNext();
+		LinkEdit *pR = GetLink(i);
 		pN1 = pR->GetNode(0);
 		pN2 = pR->GetNode(1);
 		if ((pN1 == pN2 && pR->GetSize() <4) ||
 			(pR->GetSize() < 2))
 		{
 			//delete the road!
-			if (prev)
-				prev->SetNext(next);
-			else
-				m_pFirstLink = next;
-
 			pN1->DetachLink(pR);
 			pN2->DetachLink(pR);
-			delete pR;
+			RemoveLink(pR);
 			count++;
 		}
-		else
-			prev = pR;
-
-		pR = next;
 	}
 	return count;
 }
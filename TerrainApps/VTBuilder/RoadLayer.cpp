@@ -98,26 +98,8 @@ bool vtRoadLayer::AppendDataFrom(vtLayer *pL)
 
 	vtRoadLayer *pFrom = (vtRoadLayer *)pL;
 
-	// add nodes to our list
-	TNode *n = pFrom->GetFirstNode();
-	while (n)
-	{
-		TNode *next = n->GetNext();
-		n->SetNext(m_pFirstNode);
-		m_pFirstNode = n;
-		n = next;
-	}
-	// add links to our list
-	TLink *r = pFrom->GetFirstLink();
-	while (r)
-	{
-		TLink *next = r->GetNext();
-		r->SetNext(m_pFirstLink);
-		m_pFirstLink = r;
-		r = next;
-	}
-	pFrom->m_pFirstLink = NULL;
-	pFrom->m_pFirstNode = NULL;
+	// take the nodes and links into our lists
+	TakeElements(*pFrom);
 
 	ComputeExtents();
 
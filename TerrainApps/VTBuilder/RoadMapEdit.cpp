@@ -544,37 +544,27 @@ DRECT *RoadMapEdit::DeleteSelected(int &nDeleted)
 
 	DRECT* array = new DRECT[nDeleted];
 
-	LinkEdit *prevLink = NULL;
-	LinkEdit *tmpLink;
-	LinkEdit *curLink = GetFirstLink();
 	TNode *tmpNode;
 	int n = 0;
 
-	while (curLink)
+	// Go from the end, since removing a link moves the last link into its place
+	for (int i = NumLinks() - 1; i >= 0; i--)
 	{
-		tmpLink = curLink;
-		curLink = curLink->GetNext();
+		LinkEdit *tmpLink = GetLink(i);
 		if (tmpLink->IsSelected())
 		{
 			//delete the link
 			array[n] = tmpLink->m_extent;
 			n++;
 
-			if (prevLink)
-				prevLink->SetNext(curLink);
-			else
-				m_pFirstLink = curLink;
-
 			tmpNode = tmpLink->GetNode(0);
 			if (tmpNode)
 				tmpNode->DetachLink(tmpLink);
 			tmpNode = tmpLink->GetNode(1);
 			if (tmpNode)
 				tmpNode->DetachLink(tmpLink);
-			delete tmpLink;
+			RemoveLink(tmpLink);
 		}
-		else
-			prevLink = tmpLink;
 	}
 	m_bValidExtents = false;
 
@@ -849,22 +839,8 @@ LinkEdit *RoadMapEdit::FindLink(const DPoint2 &point, float error)
 
 void RoadMapEdit::DeleteSingleLink(LinkEdit *pDeleteLink)
 {
-	LinkEdit *prev = NULL;
-	for (LinkEdit *curLink = GetFirstLink(); curLink; curLink = curLink->GetNext())
-	{
-		if (curLink == pDeleteLink)
-		{
-			if (prev)
-				prev->SetNext(curLink->GetNext());
-			else
-				m_pFirstLink = curLink->GetNext();
-			curLink->GetNode(0)->DetachLink(curLink);
-			curLink->GetNode(1)->DetachLink(curLink);
-			delete curLink;
-			return;
-		}
-		prev = curLink;
-	}
+	DetachLink(pDeleteLink);
+	RemoveLink(pDeleteLink);
 }
 
 void RoadMapEdit::ReplaceNode(NodeEdit *pN, NodeEdit *pN2)
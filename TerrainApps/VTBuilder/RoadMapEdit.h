@@ -124,8 +124,10 @@ public:
 	~RoadMapEdit();
 
 	// overrides for virtual methods
-	LinkEdit *GetFirstLink() { return (LinkEdit *)m_pFirstLink; }
-	NodeEdit *GetFirstNode() { return (NodeEdit *)m_pFirstNode; }
+	LinkEdit *GetFirstLink() { return (LinkEdit *)vtRoadMap::GetFirstLink(); }
+	NodeEdit *GetFirstNode() { return (NodeEdit *)vtRoadMap::GetFirstNode(); }
+	LinkEdit *GetLink(int i) { return (LinkEdit *)m_Links[i]; }
+	NodeEdit *GetNode(int i) { return (NodeEdit *)m_Nodes[i]; }
 	NodeEdit *NewNode() { return new NodeEdit; }
 	LinkEdit *NewLink() { return new LinkEdit; }
 
@@ -18,6 +18,7 @@
 #include "Frame.h"
 #include "StatusBar.h"
 #include "BuilderView.h"
+#include "ElevLayer.h"
 #include "vtui/Helper.h"	// for FormatCoord
 
 
@@ -32,7 +33,8 @@ MyStatusBar::MyStatusBar(wxWindow *parent) : wxStatusBar(parent, -1)
 		65,		// Datum
 		200,	// Units
 		208,	// Coordinates of cursor
-		86		// Elevation under cursor
+		86,		// Elevation under cursor
+		150		// Elevation cache
 	};
 
 	SetFieldsCount(Field_Max);
@@ -138,6 +140,23 @@ void MyStatusBar::SetTexts(MainFrame *frame)
 		SetStatusText(_("Mouse"), Field_Mouse);
 		SetStatusText(_T(""), Field_Height);
 	}
+
+	// Elevation cache, if paging is on
+	ElevCacheStats stats;
+	ElevCacheGetStats(stats);
+	if (vtElevLayer::m_iElevMemLimit == -1)
+		str = _T("");
+	else
+	{
+		const int accesses = stats.hits + stats.misses;
+		str.Printf(_("Cache %.0f/%.0f MB, %d%% hit"),
+			(double) stats.resident_bytes / (1024*1024),
+			(double) stats.limit_bytes / (1024*1024),
+			accesses ? stats.hits * 100 / accesses : 100);
+		if (stats.pending)
+			str += wxString::Format(_T(" (+%d)"), stats.pending);
+	}
+	SetStatusText(str, Field_Cache);
 //	VTLOG(" Done.\n");
 }
 
@@ -37,6 +37,7 @@ private:
 		Field_HUnits,
 		Field_Mouse,
 		Field_Height,
+		Field_Cache,
 		Field_Max
 	};
 
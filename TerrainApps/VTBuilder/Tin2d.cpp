@@ -16,6 +16,8 @@
 
 #include "vtdata/ElevationGrid.h"
 #include "vtdata/Features.h"
+#include "vtdata/Gridder.h"
+#include "vtdata/TinBuilder.h"
 #include "vtdata/Triangulate.h"
 #include "vtdata/vtLog.h"
 
@@ -33,10 +35,18 @@ vtTin2d::~vtTin2d()
 }
 
 /**
- Create a TIN from a grid, by simply triangulating all the valid heixels
- in the grid.
+ Create a TIN from a grid.  With no error tolerance, this simply triangulates
+ all the valid heixels in the grid.  Otherwise, only as many heixels are used
+ as are needed to stay within the tolerance, which is usually far fewer.
+
+ \param grid		The grid.
+ \param fMaxError	The most vertical distance to allow between any heixel
+	and the surface of the TIN, or zero to use every heixel.
+ \param progress_callback	If supplied, this function will be called back
+	with a value of 0 to 100 as the operation progresses.
  */
-vtTin2d::vtTin2d(vtElevationGrid *grid)
+vtTin2d::vtTin2d(vtElevationGrid *grid, float fMaxError,
+				 bool progress_callback(int))
 {
 	m_fEdgeLen = NULL;
 	m_bConstrain = false;
@@ -45,6 +55,14 @@ vtTin2d::vtTin2d(vtElevationGrid *grid)
 	grid->GetDimensions(cols, rows);
 	m_proj = grid->GetProjection();
 
+	if (fMaxError > 0)
+	{
+		vtTinBuilder builder;
+		builder.SetMaxError(fMaxError);
+		builder.Build(*grid, *this, progress_callback);
+		return;
+	}
+
 	// This isn't an optimal algorithm, but it's not a common operation, so
 	// cpu/mem efficiency isn't vital.
 	//
@@ -95,103 +113,45 @@ vtTin2d::vtTin2d(vtElevationGrid *grid)
 	ComputeExtents();
 }
 
-#define ANSI_DECLARATORS
-#define REAL double
-extern "C" {
-#include "vtdata/triangle/triangle.h"
-}
-
 /**
- * Create a TIN from a set of 3D points, using the Triangle library to derive
- *  the set of triangles from the points.
+ * Create a TIN from a set of 3D points, by Delaunay triangulation.
+ *
+ * \param set			The points.
+ * \param fMaxError	If not zero, only use as many of the points as are needed
+ *	to keep the surface within this vertical distance of every point.
+ * \param progress_callback	If supplied, this function will be called back
+ *	with a value of 0 to 100 as the operation progresses.
  */
-vtTin2d::vtTin2d(vtFeatureSetPoint3D *set)
+vtTin2d::vtTin2d(vtFeatureSetPoint3D *set, float fMaxError,
+				 bool progress_callback(int))
 {
 	m_fEdgeLen = NULL;
 	m_bConstrain = false;
 
-	struct triangulateio in, out;
-	int i;
-	DPoint3 p3;
-
-	// point list
-	in.numberofpoints = set->NumEntities();
-	in.pointlist = (REAL *) malloc(in.numberofpoints * 2 * sizeof(REAL));
-	in.numberofpointattributes = 1;
-	in.pointattributelist = (REAL *) malloc(in.numberofpoints * sizeof(REAL));
+	vtPointSourceFeatures source(set);
+	vtTinBuilder builder;
+	builder.SetMaxError(fMaxError);
+	builder.Build(source, *this, progress_callback);
 
-	for ( i = 0; i < in.numberofpoints; ++i )
-	{
-		set->GetPoint(i, p3);
-		in.pointlist[2*i] = p3.x;
-		in.pointlist[2*i + 1] = p3.y;
-
-		in.pointattributelist[i] = p3.z;
-	}
-
-	in.pointmarkerlist = (int *) NULL;
-	in.numberoftriangles = 0;
-
-	// no segment list
-	in.numberofsegments = 0;
-	in.segmentlist = (int *) NULL;
-	in.segmentmarkerlist = (int *) NULL;
-
-	// no holes or regions
-	in.numberofholes = 0;
-	in.holelist = (REAL *) NULL;
-	in.numberofregions = 0;
-	in.regionlist = (REAL *) NULL;
-
-	// prep the output structures
-	out.pointlist = (REAL *) NULL;        // Not needed if -N switch used.
-	out.pointattributelist = (REAL *) NULL;
-	out.pointmarkerlist = (int *) NULL;   // Not needed if -N or -B switch used.
-	out.trianglelist = (int *) NULL;      // Not needed if -E switch used.
-	out.triangleattributelist = (REAL *) NULL;
-	out.neighborlist = (int *) NULL;      // Needed only if -n switch used.
-	out.segmentlist = (int *) NULL;
-	out.segmentmarkerlist = (int *) NULL;
-	out.edgelist = (int *) NULL;          // Needed only if -e switch used.
-	out.edgemarkerlist = (int *) NULL;    // Needed if -e used and -B not used.
-
-	// Triangulate the points.  Switches are chosen:
-	// number everything from zero (z),
-	triangulate("z", &in, &out, NULL);
-
-	// now copy the triangle results back into vtdata structures
-	for ( i = 0; i < out.numberofpoints; ++i )
-	{
-		float z = out.pointattributelist[i];
-		AddVert(DPoint2(out.pointlist[2*i], out.pointlist[2*i + 1]), z);
-	}
-	for ( i = 0; i < out.numberoftriangles; ++i )
-	{
-		int n1 = out.trianglelist[i * 3];
-		int n2 = out.trianglelist[i * 3 + 1];
-		int n3 = out.trianglelist[i * 3 + 2];
-		AddTri(n1, n2, n3);
-	}
-	// free mem allocated to the "Triangle" structures
-	free(in.pointlist);
-	free(in.pointattributelist);
-
-	free(out.pointlist);
-	free(out.pointattributelist);
-	free(out.pointmarkerlist);
-	free(out.trianglelist);
-	free(out.triangleattributelist);
-	free(out.neighborlist);
-	free(out.segmentlist);
-	free(out.segmentmarkerlist);
-	free(out.edgelist);
-	free(out.edgemarkerlist);
-
-	ComputeExtents();
 	// Adopt CRS from the featureset
 	m_proj = set->GetAtProjection();
 }
 
+/**
+ * Create a TIN from a source of 3D points, such as a large XYZ file, by
+ *  Delaunay triangulation.  See the other constructor for the parameters.
+ */
+vtTin2d::vtTin2d(vtPointSource &source, float fMaxError,
+				 bool progress_callback(int))
+{
+	m_fEdgeLen = NULL;
+	m_bConstrain = false;
+
+	vtTinBuilder builder;
+	builder.SetMaxError(fMaxError);
+	builder.Build(source, *this, progress_callback);
+}
+
 /**
  Construct a TIN from polygons.  The polygons features are triangulated and
  assigned a height, either from the feature fields, or a fixed height.
@@ -269,9 +229,9 @@ void vtTin2d::MakeOutline()
 	}
 }
 
-int vtTin2d::GetMemoryUsed() const
+size_t vtTin2d::GetMemoryUsed() const
 {
-	int bytes = 0;
+	size_t bytes = 0;
 
 	bytes += sizeof(vtTin2d);
 	bytes += sizeof(DPoint2) * m_vert.GetSize();
@@ -13,6 +13,7 @@
 class vtElevationGrid;
 class vtFeatureSetPoint3D;
 class vtFeatureSetPolygon;
+class vtPointSource;
 
 #include <set>
 
@@ -63,8 +64,12 @@ public:
 	vtTin2d();
 	~vtTin2d();
 
-	vtTin2d(vtElevationGrid *grid);
-	vtTin2d(vtFeatureSetPoint3D *set);
+	vtTin2d(vtElevationGrid *grid, float fMaxError = 0.0f,
+		bool progress_callback(int) = NULL);
+	vtTin2d(vtFeatureSetPoint3D *set, float fMaxError = 0.0f,
+		bool progress_callback(int) = NULL);
+	vtTin2d(vtPointSource &source, float fMaxError = 0.0f,
+		bool progress_callback(int) = NULL);
 	vtTin2d(vtFeatureSetPolygon *set, int iFieldNum, float fHeight = 0.0f);
 
 	void DrawTin(wxDC *pDC, vtScaledView *pView);
@@ -73,7 +78,7 @@ public:
 	void FreeEdgeLengths();
 	void SetConstraint(bool bConstrain, double fMaxEdge);
 	void MakeOutline();
-	int GetMemoryUsed() const;
+	size_t GetMemoryUsed() const;
 
 	double *m_fEdgeLen;
 	bool m_bConstrain;
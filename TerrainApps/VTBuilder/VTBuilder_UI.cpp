@@ -398,6 +398,21 @@ GenGridDlgBase::GenGridDlgBase( wxWindow* parent, wxWindowID id, const wxString&
 	
 	sbSizer40->Add( bSizer178, 0, wxALIGN_CENTER_VERTICAL, 5 );
 	
+	wxBoxSizer* bSizer181;
+	bSizer181 = new wxBoxSizer( wxHORIZONTAL );
+	
+	m_text67 = new wxStaticText( this, ID_TEXT, _("Interpolation:"), wxDefaultPosition, wxDefaultSize, 0 );
+	m_text67->Wrap( -1 );
+	bSizer181->Add( m_text67, 0, wxALIGN_CENTER|wxALL, 5 );
+	
+	wxString m_choice_methodChoices[] = { _("Mean of the points in each cell"), _("Lowest point in each cell"), _("Highest point in each cell"), _("Inverse distance weighted"), _("Linear (triangulated)") };
+	int m_choice_methodNChoices = sizeof( m_choice_methodChoices ) / sizeof( wxString );
+	m_choice_method = new wxChoice( this, ID_GRID_METHOD, wxDefaultPosition, wxDefaultSize, m_choice_methodNChoices, m_choice_methodChoices, 0 );
+	m_choice_method->SetSelection( 3 );
+	bSizer181->Add( m_choice_method, 1, wxALIGN_CENTER|wxALL, 5 );
+	
+	sbSizer40->Add( bSizer181, 0, wxEXPAND|wxALIGN_CENTER_VERTICAL, 5 );
+	
 	wxBoxSizer* bSizer179;
 	bSizer179 = new wxBoxSizer( wxHORIZONTAL );
 	
@@ -278,6 +278,7 @@ class NodeDlgView;
 #define ID_SPACING_Y 1233
 #define ID_GRID_X 1234
 #define ID_GRID_Y 1235
+#define ID_GRID_METHOD 1236
 
 ///////////////////////////////////////////////////////////////////////////////
 /// Class ChunkDlgBase
@@ -387,6 +388,8 @@ class GenGridDlgBase : public wxDialog
 		wxStaticText* m_text65;
 		wxTextCtrl* m_sizex;
 		wxTextCtrl* m_sizey;
+		wxStaticText* m_text67;
+		wxChoice* m_choice_method;
 		wxStaticText* m_text66;
 		wxTextCtrl* m_text_dist_cutoff;
 		wxButton* m_ok;
@@ -33,7 +33,9 @@ extern "C" {
 vtBitmap::vtBitmap()
 {
 	m_pBitmap = NULL;
-#if !USE_DIBSECTIONS
+#if USE_DIBSECTIONS
+	m_pScanline = NULL;
+#else
 	m_pImage = NULL;
 #endif
 }
@@ -188,6 +190,26 @@ uint vtBitmap::GetDepth() const
 	return 24;
 }
 
+bool vtBitmap::GetPixelSpan(vtPixelSpan &span) const
+{
+#if USE_DIBSECTIONS
+	if (!m_pScanline)
+		return false;
+	span.m_pOrigin = m_pScanline;
+	span.m_iStride = m_iScanlineWidth;
+	span.m_Format = PF_BGR24;
+#else
+	if (!m_pImage)
+		return false;
+	span.m_pOrigin = m_pImage->GetData();
+	span.m_iStride = m_pImage->GetWidth() * 3;
+	span.m_Format = PF_RGB24;
+#endif
+	span.m_Size = GetSize();
+	span.m_pPalette = NULL;
+	return true;
+}
+
 //
 // If we aren't using DIBSections, then we don't have direct access to the
 // image data, so we must copy from the image to the bitmap when we want
@@ -43,6 +43,7 @@ public:
 
 	IPoint2 GetSize() const;
 	uint GetDepth() const;
+	bool GetPixelSpan(vtPixelSpan &span) const;
 
 	void ContentsChanged();
 
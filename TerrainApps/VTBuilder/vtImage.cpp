@@ -835,7 +835,11 @@ int vtImage::NumBitmapsOnDisk()
 	return count;
 }
 
-void vtImage::GetRGBA(int x, int y, RGBAi &rgba, double dRes)
+/**
+ * Choose which bitmap (the base image, or one of its overviews) best
+ * matches a desired resolution.  Returns -1 if none are available.
+ */
+int vtImage::FindBitmapForResolution(double dRes) const
 {
 	int closest_bitmap = -1;
 	double diff = 1E9;
@@ -871,7 +875,12 @@ void vtImage::GetRGBA(int x, int y, RGBAi &rgba, double dRes)
 			}
 		}
 	}
+	return closest_bitmap;
+}
 
+void vtImage::GetRGBA(int x, int y, RGBAi &rgba, double dRes)
+{
+	int closest_bitmap = FindBitmapForResolution(dRes);
 	if (closest_bitmap < 0)
 	{
 		// safety measure for missing overviews
@@ -879,14 +888,17 @@ void vtImage::GetRGBA(int x, int y, RGBAi &rgba, double dRes)
 		return;
 	}
 
-	if (closest_bitmap != 0)
-	{
-		// get smaller coordinates from subsampled view
-		x >>= closest_bitmap;
-		y >>= closest_bitmap;
-	}
+	// get smaller coordinates from subsampled view
+	GetBitmapRGBA(closest_bitmap, x >> closest_bitmap, y >> closest_bitmap, rgba);
+}
 
-	const BitmapInfo &bm = m_Bitmaps[closest_bitmap];
+/**
+ * Get a pixel from a specific bitmap, in that bitmap's own pixel coordinates.
+ * For bitmaps in memory, this is safe to call from several threads at once.
+ */
+void vtImage::GetBitmapRGBA(int bitmap, int x, int y, RGBAi &rgba)
+{
+	const BitmapInfo &bm = m_Bitmaps[bitmap];
 	if (bm.m_pBitmap)
 	{
 		// get pixel from bitmap in memory
@@ -897,11 +909,122 @@ void vtImage::GetRGBA(int x, int y, RGBAi &rgba, double dRes)
 	else if (bm.m_bOnDisk)
 	{
 		// support for out-of-memory image
-		RGBAi *data = m_linebuf.GetScanlineFromBuffer(y, closest_bitmap);
+		RGBAi *data = m_linebuf.GetScanlineFromBuffer(y, bitmap);
 		rgba = data[x];
 	}
 }
 
+/**
+ * Find the pixel of a bitmap which contains a given point.  Points up to
+ * half a pixel outside the image are snapped to the edge.
+ */
+bool vtImage::GetNearestPixel(const DPoint2 &p, int bitmap, int &ix, int &iy) const
+{
+	const DPoint2 &spacing = m_Bitmaps[bitmap].m_Spacing;
+	const IPoint2 &size = m_Bitmaps[bitmap].m_Size;
+
+	double u = (p.x - m_Extents.left) / spacing.x;
+	if (u < -0.5 || u > size.x+0.5) return false; // check extents
+	if (u < 0.5) u = 0.5; // adjust left edge
+	if (u > size.x-0.5) u = size.x-0.5; // adjust right edge
+	ix = (int) u;
+
+	double v = (m_Extents.top - p.y) / spacing.y;
+	if (v < -0.5 || v > size.y+0.5) return false; // check extents
+	if (v < 0.5) v = 0.5; // adjust top edge
+	if (v > size.y-0.5) v = size.y-0.5; // adjust bottom edge
+	iy = (int) v;
+	return true;
+}
+
+bool vtImage::GetBilinearSample(const DPoint2 &p, int bitmap, RGBAi &rgba)
+{
+	const DPoint2 &spacing = m_Bitmaps[bitmap].m_Spacing;
+	const IPoint2 &size = m_Bitmaps[bitmap].m_Size;
+
+	// Position relative to the pixel centers
+	double u = (p.x - m_Extents.left) / spacing.x - 0.5;
+	double v = (m_Extents.top - p.y) / spacing.y - 0.5;
+	if (u < -1.0 || u > size.x || v < -1.0 || v > size.y)
+		return false;
+	if (u < 0) u = 0;
+	if (u > size.x-1) u = size.x-1;
+	if (v < 0) v = 0;
+	if (v > size.y-1) v = size.y-1;
+
+	const int x0 = (int) u, y0 = (int) v;
+	const int x1 = (x0 < size.x-1) ? x0+1 : x0;
+	const int y1 = (y0 < size.y-1) ? y0+1 : y0;
+	const double fx = u - x0, fy = v - y0;
+
+	const int xs[4] = { x0, x1, x0, x1 };
+	const int ys[4] = { y0, y0, y1, y1 };
+	const double weights[4] = { (1-fx)*(1-fy), fx*(1-fy), (1-fx)*fy, fx*fy };
+
+	double r = 0, g = 0, b = 0, a = 0, total = 0;
+	RGBAi color;
+	for (int k = 0; k < 4; k++)
+	{
+		GetBitmapRGBA(bitmap, xs[k], ys[k], color);
+		if (bTreatBlackAsTransparent && color == RGBAi(0,0,0,255))
+			continue;
+		r += color.r * weights[k];
+		g += color.g * weights[k];
+		b += color.b * weights[k];
+		a += color.a * weights[k];
+		total += weights[k];
+	}
+	if (total == 0)
+		return false;
+
+	rgba.Set((short) (r / total + 0.5), (short) (g / total + 0.5),
+		(short) (b / total + 0.5), (short) (a / total + 0.5));
+	return true;
+}
+
+/**
+ * Sample the image at a point, from a bitmap chosen in advance with
+ * FindBitmapForResolution.  For ISF_BOX, the point is sampled at each of
+ * the offsets (see MakeSampleOffsets) and the results averaged.
+ *
+ * \return true if the point is on the image.
+ */
+bool vtImage::GetFilteredSample(const DPoint2 &p, int bitmap,
+	ImageSampleFilter filter, const DLine2 &offsets, RGBAi &rgba)
+{
+	int ix, iy;
+	if (filter == ISF_BILINEAR)
+		return GetBilinearSample(p, bitmap, rgba);
+
+	if (filter == ISF_NEAREST || offsets.GetSize() < 2)
+	{
+		if (!GetNearestPixel(p, bitmap, ix, iy))
+			return false;
+		GetBitmapRGBA(bitmap, ix, iy, rgba);
+		return !(bTreatBlackAsTransparent && rgba == RGBAi(0,0,0,255));
+	}
+
+	RGBAi color;
+	rgba.Set(0,0,0,0);
+	int count = 0;
+	for (uint i = 0; i < offsets.GetSize(); i++)
+	{
+		if (!GetNearestPixel(p + offsets[i], bitmap, ix, iy))
+			continue;
+		GetBitmapRGBA(bitmap, ix, iy, color);
+		if (bTreatBlackAsTransparent && color == RGBAi(0,0,0,255))
+			continue;
+		rgba += color;
+		count++;
+	}
+	if (count)
+	{
+		rgba /= count;
+		return true;
+	}
+	return false;
+}
+
 void vtImage::SetRGBA(int x, int y, uchar r, uchar g, uchar b, uchar a)
 {
 	// this method clearly only works for in-memory images
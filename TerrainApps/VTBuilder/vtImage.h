@@ -82,6 +82,14 @@ public:
 	DPoint2 m_Spacing;		// spatial resolution in earth units/pixel
 };
 
+/** How to sample an image when resampling it into another. */
+enum ImageSampleFilter
+{
+	ISF_NEAREST,	// a single sample of the nearest pixel
+	ISF_BILINEAR,	// interpolate between the four nearest pixels
+	ISF_BOX			// average of NxN nearest samples (see MakeSampleOffsets)
+};
+
 //////////////////////////////////////////////////////////
 
 class vtImage
@@ -122,6 +130,14 @@ public:
 	bool GetColorSolid(const DPoint2 &p, RGBAi &rgb, double dRes = 0.0);
 	bool GetMultiSample(const DPoint2 &p, const DLine2 &offsets, RGBAi &rgb, double dRes = 0.0);
 	void GetRGBA(int x, int y, RGBAi &rgb, double dRes = 0.0);
+
+	// Lower-level sampling, for use when the bitmap (overview) to sample
+	//  from has been chosen in advance with FindBitmapForResolution.
+	int FindBitmapForResolution(double dRes) const;
+	bool IsBitmapInMemory(int bitmap) const { return m_Bitmaps[bitmap].m_pBitmap != NULL; }
+	void GetBitmapRGBA(int bitmap, int x, int y, RGBAi &rgba);
+	bool GetFilteredSample(const DPoint2 &p, int bitmap, ImageSampleFilter filter,
+		const DLine2 &offsets, RGBAi &rgba);
 	void SetRGBA(int x, int y, uchar r, uchar g, uchar b, uchar a = 255);
 	void SetRGBA(int x, int y, const RGBAi &rgb);
 	void ReplaceColor(const RGBi &rgb1, const RGBi &rgb2);
@@ -160,6 +176,8 @@ public:
 protected:
 	void SetDefaults();
 	void CleanupGDALUsage();
+	bool GetNearestPixel(const DPoint2 &p, int bitmap, int &ix, int &iy) const;
+	bool GetBilinearSample(const DPoint2 &p, int bitmap, RGBAi &rgba);
 
 	vtProjection	m_proj;
 
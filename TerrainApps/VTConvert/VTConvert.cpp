@@ -11,6 +11,12 @@
 #include "vtdata/ElevationGrid.h"
 #include "vtdata/FilePath.h"
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
 void print_help()
 {
 	printf("VTConvert, a command-line tool for converting geodata.\n");
@@ -30,6 +36,8 @@ void print_help()
 	printf("  -indir in        Indicates the input directory.\n");
 	printf("  -outdir out      Indicates the output directory.\n");
 	printf("  -gzip            Write output directly to a .gz file\n");
+	printf("  -bench           Time loading infile, with the fast text parser\n"
+		"                    and with stdio, and write nothing.\n");
 	printf("\n");
 	printf("If outfile is not specified, it is derived from infile.\n");
 	printf("If outfile has a trailing slash, it is assumed to be a\n"
@@ -70,10 +78,52 @@ void Convert(vtString &fname_in, vtString &fname_out, bool bGZip)
 	}
 }
 
+// Wall clock time, in seconds
+double WallTime()
+{
+#ifdef WIN32
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (double) count.QuadPart / freq.QuadPart;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1E6;
+#endif
+}
+
+/**
+ * Compare the speed of loading a text elevation file (ASC, XYZ or DSAA)
+ * from a memory mapping, in parallel, with reading it through stdio.
+ */
+void Benchmark(const vtString &fname_in)
+{
+	const double mb = GetFileSize(fname_in) / (1024.0 * 1024.0);
+	printf("%s: %.1f MB\n", (const char *) fname_in, mb);
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		vtElevationGrid::s_bMapTextFiles = (pass == 0);
+		vtElevationGrid grid;
+		const double start = WallTime();
+		const bool success = grid.LoadFromFile(fname_in);
+		const double seconds = WallTime() - start;
+
+		const char *method = (pass == 0) ? "mapped" : "stdio ";
+		if (success)
+			printf("  %s: %7.2f s, %8.1f MB/s\n", method, seconds, mb / seconds);
+		else
+			printf("  %s: failed to load\n", method);
+	}
+	vtElevationGrid::s_bMapTextFiles = true;
+}
+
 int main(int argc, char **argv)
 {
 	vtString str, fname_in, fname_out, dirname_in, dirname_out;
 	bool bGZip = false;
+	bool bBench = false;
 
 	for (int i = 0; i < argc; i++)
 	{
@@ -107,12 +157,21 @@ int main(int argc, char **argv)
 		{
 			bGZip = true;
 		}
+		else if (str == "-bench")
+		{
+			bBench = true;
+		}
 	}
 	if (fname_in == "" && dirname_in == "")
 	{
 		printf("Didn't get an input.  Try -h for help.\n");
 		return 0;
 	}
+	if (bBench)
+	{
+		Benchmark(fname_in);
+		return 0;
+	}
 
 	// Check if output is a directory
 	vtString last = fname_out.Right(1);
@@ -0,0 +1,403 @@
+//
+// Name:     vtBench/app.cpp
+// Purpose:  Headless rendering benchmark for vtlib.  Loads a terrain into an
+//	offscreen context, flies the camera along a recorded path with a fixed
+//	timestep, and reports how long the frames took.
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include "vtlib/vtlib.h"
+
+#include <osgViewer/Viewer>
+
+#include "vtlib/core/AnimPath.h"
+#include "vtlib/core/DynTerrain.h"
+#include "vtlib/core/PagedLodGrid.h"
+#include "vtlib/core/Profiler.h"
+#include "vtlib/core/Terrain.h"
+#include "vtlib/core/TerrainScene.h"
+#include "vtlib/core/TiledGeom.h"
+#include "vtdata/DataPath.h"
+#include "vtdata/FilePath.h"
+#include "vtdata/vtLog.h"
+
+#if WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Options, from the command line
+struct BenchOptions
+{
+	BenchOptions()
+	{
+		width = 1024;
+		height = 768;
+		step = 1.0f / 30;
+		frames = 0;
+		warmup = 30;
+	}
+	vtString terrain;	// .xml terrain parameters
+	vtString path;		// .vtap camera path
+	vtString results;	// optional file to write the results to
+	vtString trace;		// optional Chrome trace file
+	vtStringArray datapaths;
+	int width, height;
+	float step;			// seconds of flight per frame
+	int frames;			// 0 to fly the whole path
+	int warmup;			// frames to render before measuring
+};
+
+// What we measure
+struct BenchResults
+{
+	BenchResults()
+	{
+		frames = 0;
+		seconds = 0;
+		triangles = 0;
+		max_triangles = 0;
+		tile_vertices = 0;
+		tiles_loaded = 0;
+		structures_loaded = 0;
+		peak_memory = 0;
+	}
+	int frames;
+	double seconds;
+	vtProfileStats frame;
+	double triangles;		// mean per frame, from a dynamic terrain
+	int max_triangles;
+	double tile_vertices;	// mean per frame, from a tiled terrain
+	int tiles_loaded;
+	int structures_loaded;
+	long peak_memory;		// KB
+};
+
+// Make sure the GPU has finished each frame, so it is counted in the
+//  frame's time.
+class FinishDrawCallback : public osg::Camera::DrawCallback
+{
+public:
+	virtual void operator()(osg::RenderInfo &renderInfo) const { glFinish(); }
+};
+
+/**
+ * The peak memory used by this process so far, in kilobytes.
+ */
+long GetPeakMemory()
+{
+#if WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0;
+	return (long) (pmc.PeakWorkingSetSize / 1024);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;	// bytes
+#else
+	return usage.ru_maxrss;			// kilobytes
+#endif
+#endif
+}
+
+/**
+ * Make an offscreen graphics context.  A pbuffer is tried first; if the
+ * platform can't make one, we fall back on an undecorated window, which
+ * works under a virtual X server such as Xvfb.
+ */
+osg::GraphicsContext *CreateOffscreenContext(int width, int height)
+{
+	osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+	traits->x = 0;
+	traits->y = 0;
+	traits->width = width;
+	traits->height = height;
+	traits->red = traits->green = traits->blue = traits->alpha = 8;
+	traits->depth = 24;
+	traits->windowDecoration = false;
+	traits->doubleBuffer = false;
+	traits->sharedContext = 0;
+	traits->pbuffer = true;
+
+	osg::GraphicsContext *gc = osg::GraphicsContext::createGraphicsContext(traits.get());
+	if (gc)
+	{
+		VTLOG1("Using a pbuffer.\n");
+		return gc;
+	}
+	traits->pbuffer = false;
+	traits->doubleBuffer = true;
+	gc = osg::GraphicsContext::createGraphicsContext(traits.get());
+	if (gc)
+		VTLOG1("Couldn't make a pbuffer, using a window.\n");
+	return gc;
+}
+
+bool ParseArgs(int argc, char **argv, BenchOptions &opt)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		vtString arg = argv[i];
+		bool bMore = (i + 1 < argc);
+		if (arg == "-width" && bMore)
+			opt.width = atoi(argv[++i]);
+		else if (arg == "-height" && bMore)
+			opt.height = atoi(argv[++i]);
+		else if (arg == "-step" && bMore)
+			opt.step = (float) atof(argv[++i]);
+		else if (arg == "-frames" && bMore)
+			opt.frames = atoi(argv[++i]);
+		else if (arg == "-warmup" && bMore)
+			opt.warmup = atoi(argv[++i]);
+		else if (arg == "-results" && bMore)
+			opt.results = argv[++i];
+		else if (arg == "-trace" && bMore)
+			opt.trace = argv[++i];
+		else if (arg == "-datapath" && bMore)
+			opt.datapaths.push_back(vtString(argv[++i]));
+		else if (arg[0] == '-')
+			return false;
+		else if (opt.terrain == "")
+			opt.terrain = arg;
+		else if (opt.path == "")
+			opt.path = arg;
+		else
+			return false;
+	}
+	return (opt.terrain != "" && opt.path != "" && opt.width > 0 &&
+		opt.height > 0 && opt.step > 0);
+}
+
+void Usage()
+{
+	printf("Usage: vtBench [options] terrain.xml flight.vtap\n"
+		"Options:\n"
+		"  -width <pixels>, -height <pixels>  Size of the offscreen view (1024 x 768)\n"
+		"  -step <seconds>     Time along the path for each frame (1/30)\n"
+		"  -frames <n>         Number of frames to measure (the whole path)\n"
+		"  -warmup <n>         Frames to render before measuring (30)\n"
+		"  -datapath <dir>     Add a VTP data path, to find the terrain's data\n"
+		"  -results <file>     Also write the results to a file, as JSON\n"
+		"  -trace <file>       Write a Chrome trace of the measured frames\n");
+}
+
+vtTerrain *CreateTerrain(vtTerrainScene *terrscene, const BenchOptions &opt)
+{
+	vtString pfile = opt.terrain;
+	if (!vtFileExists(pfile))
+		pfile = FindFileOnPaths(vtGetDataPath(), "Terrains/" + opt.terrain);
+	if (pfile == "")
+	{
+		printf("Couldn't find terrain parameters %s\n", (const char *) opt.terrain);
+		return NULL;
+	}
+	vtTerrain *pTerr = new vtTerrain;
+	pTerr->SetParamFile(pfile);
+	if (!pTerr->LoadParams())
+	{
+		printf("Couldn't read terrain parameters %s\n", (const char *) pfile);
+		return NULL;
+	}
+	terrscene->AppendTerrain(pTerr);
+	if (!terrscene->BuildTerrain(pTerr))
+	{
+		printf("Terrain creation failed: %s\n", (const char *) pTerr->GetLastError());
+		return NULL;
+	}
+	terrscene->SetCurrentTerrain(pTerr);
+	return pTerr;
+}
+
+/**
+ * Render one frame, as Enviro would, and add what was drawn to the results.
+ */
+void RenderFrame(vtTerrain *pTerr, BenchResults *results)
+{
+	vtGetScene()->DoUpdate();
+	pTerr->DoStructurePaging();
+
+	if (!results)
+		return;
+	results->frames++;
+	if (pTerr->GetDynTerrain())
+	{
+		const int tris = pTerr->GetDynTerrain()->NumDrawnTriangles();
+		results->triangles += tris;
+		if (tris > results->max_triangles)
+			results->max_triangles = tris;
+	}
+	if (pTerr->GetTiledGeom())
+		results->tile_vertices += pTerr->GetTiledGeom()->m_iVertexCount;
+}
+
+void WriteResults(FILE *fp, const BenchOptions &opt, const BenchResults &r, bool bJSON)
+{
+	const char *fmt = bJSON ? "  \"%s\": %.3f,\n" : "%-24s %12.3f\n";
+	const char *ifmt = bJSON ? "  \"%s\": %ld,\n" : "%-24s %12ld\n";
+
+	if (bJSON)
+	{
+		fprintf(fp, "{\n  \"terrain\": %s,\n  \"path\": %s,\n",
+			(const char *) vtJSONString(opt.terrain),
+			(const char *) vtJSONString(opt.path));
+	}
+	fprintf(fp, ifmt, "frames", (long) r.frames);
+	fprintf(fp, ifmt, "width", (long) opt.width);
+	fprintf(fp, ifmt, "height", (long) opt.height);
+	fprintf(fp, fmt, "seconds", r.seconds);
+	fprintf(fp, fmt, "frame_ms_mean", r.frame.m_fMean);
+	fprintf(fp, fmt, "frame_ms_median", r.frame.m_fMedian);
+	fprintf(fp, fmt, "frame_ms_p95", r.frame.m_fP95);
+	fprintf(fp, fmt, "frame_ms_p99", r.frame.m_fP99);
+	fprintf(fp, fmt, "frame_ms_max", r.frame.m_fMax);
+	fprintf(fp, fmt, "triangles_mean", r.frames ? r.triangles / r.frames : 0);
+	fprintf(fp, ifmt, "triangles_max", (long) r.max_triangles);
+	fprintf(fp, fmt, "tile_vertices_mean", r.frames ? r.tile_vertices / r.frames : 0);
+	fprintf(fp, ifmt, "tiles_loaded", (long) r.tiles_loaded);
+	fprintf(fp, ifmt, "structures_loaded", (long) r.structures_loaded);
+	if (bJSON)
+		fprintf(fp, "  \"peak_memory_kb\": %ld\n}\n", r.peak_memory);
+	else
+		fprintf(fp, "%-24s %12ld\n", "peak_memory_kb", r.peak_memory);
+}
+
+int main(int argc, char **argv)
+{
+	BenchOptions opt;
+	if (!ParseArgs(argc, argv, opt))
+	{
+		Usage();
+		return 2;
+	}
+
+	VTSTARTLOG("debug.txt");
+	VTLOG("vtBench\n");
+
+	vtStringArray paths = opt.datapaths;
+	paths.push_back(vtString("../../../Data/"));
+	paths.push_back(vtString("../../Data/"));
+	paths.push_back(vtString("../Data/"));
+	paths.push_back(vtString("Data/"));
+	vtSetDataPath(paths);
+
+	// Make a scene and a viewer, drawing offscreen on a single thread so the
+	//  results are repeatable.
+	vtScene *pScene = vtGetScene();
+	pScene->Init(argc, argv);
+	osgViewer::Viewer *viewer = pScene->getViewer();
+	viewer->setThreadingModel(osgViewer::Viewer::SingleThreaded);
+
+	osg::ref_ptr<osg::GraphicsContext> gc = CreateOffscreenContext(opt.width, opt.height);
+	if (!gc.valid())
+	{
+		printf("Couldn't create an offscreen graphics context.\n");
+		return 1;
+	}
+	osg::Camera *camera = viewer->getCamera();
+	camera->setGraphicsContext(gc.get());
+	camera->setViewport(0, 0, opt.width, opt.height);
+	const GLenum buffer = gc->getTraits()->doubleBuffer ? GL_BACK : GL_FRONT;
+	camera->setDrawBuffer(buffer);
+	camera->setReadBuffer(buffer);
+	camera->setFinalDrawCallback(new FinishDrawCallback);
+	viewer->realize();
+
+	pScene->SetGraphicsContext(gc.get());
+	pScene->GetWindow(0)->SetSize(opt.width, opt.height);
+
+	vtCamera *pCamera = pScene->GetCamera();
+	pCamera->SetHither(5);
+	pCamera->SetYon(500000);
+
+	// Build the terrain
+	vtTerrainScene *terrscene = new vtTerrainScene;
+	pScene->SetRoot(terrscene->BeginTerrainScene());
+
+	clock_t c1 = clock();
+	vtTerrain *pTerr = CreateTerrain(terrscene, opt);
+	if (!pTerr)
+		return 1;
+	printf("Terrain created in %.2f seconds.\n", (float)(clock() - c1) / CLOCKS_PER_SEC);
+
+	// The flight
+	vtAnimPath *path = new vtAnimPath;
+	if (!path->Read(opt.path) || path->NumPoints() == 0)
+	{
+		printf("Couldn't read the camera path %s\n", (const char *) opt.path);
+		return 1;
+	}
+	vtAnimPathEngine *pFlight = new vtAnimPathEngine(path);
+	pFlight->setName("Flight");
+	pFlight->AddTarget(pCamera);
+	pScene->AddEngine(pFlight);
+
+	int frames = opt.frames;
+	if (frames <= 0)
+		frames = (int) ceil(path->GetPeriod() / opt.step) + 1;
+
+	// Fixed timestep, from here on
+	pScene->SetFixedFrameTime(opt.step);
+
+	// Warm up at the start of the path, so the first frames' one-time costs
+	//  don't dominate the results.
+	pFlight->SetEnabled(false);
+	pFlight->Reset();
+	pFlight->UpdateTargets();
+	for (int i = 0; i < opt.warmup; i++)
+		RenderFrame(pTerr, NULL);
+
+	// Measure
+	vtProfiler *profiler = vtGetProfiler();
+	profiler->SetFrameCount(frames);
+	profiler->SetEnabled(true);
+
+	vtTiledGeom *tg = pTerr->GetTiledGeom();
+	vtPagedStructureLodGrid *pslg = pTerr->GetStructureLodGrid();
+	const int tiles_before = tg ? tg->m_iTileLoads : 0;
+	if (pslg)
+		pslg->ResetLoadCount();
+
+	BenchResults results;
+	pFlight->SetEnabled(true);
+	osg::Timer_t start = osg::Timer::instance()->tick();
+	for (int i = 0; i < frames; i++)
+		RenderFrame(pTerr, &results);
+	results.seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+	profiler->SetEnabled(false);
+	profiler->GetFrameStats(results.frame);
+	results.tiles_loaded = tg ? tg->m_iTileLoads - tiles_before : 0;
+	results.structures_loaded = pslg ? pslg->GetLoadCount() : 0;
+	results.peak_memory = GetPeakMemory();
+
+	// Report
+	WriteResults(stdout, opt, results, false);
+	profiler->LogSummary();
+	if (opt.results != "")
+	{
+		FILE *fp = vtFileOpen(opt.results, "wb");
+		if (fp)
+		{
+			WriteResults(fp, opt, results, true);
+			fclose(fp);
+		}
+		else
+			printf("Couldn't write %s\n", (const char *) opt.results);
+	}
+	if (opt.trace != "" && !profiler->WriteChromeTrace(opt.trace))
+		printf("Couldn't write %s\n", (const char *) opt.trace);
+
+	terrscene->CleanupScene();
+	delete terrscene;
+	pScene->Shutdown();
+
+	return 0;
+}
+
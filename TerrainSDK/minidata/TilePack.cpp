@@ -0,0 +1,588 @@
+//
+// TilePack.cpp: a packed container for libMini tilesets.
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "TilePack.h"
+#include "vtdata/FilePath.h"
+#include "vtdata/vtLog.h"
+
+#include <mini/database.h> // for databuf
+
+#ifdef WIN32
+  #include <windows.h>
+  #include <io.h>		// for _get_osfhandle
+#else
+  #include <unistd.h>	// for pread
+  #include <sys/stat.h>	// for fstat
+#endif
+
+// From minidata.cpp: decode JPEG/PNG/Z data using the registered parameters
+int MiniDecodeExternal(unsigned char *srcdata, unsigned int bytes,
+					   unsigned int extformat, unsigned char **newdata,
+					   unsigned int *newbytes, databuf *obj);
+
+static const char TILEPACK_MAGIC[8] = { 'V','T','P','T','P','A','C','K' };
+static const int TILEPACK_HEADER_SIZE = 8 + 4*4;
+static const int TILEPACK_ENTRY_SIZE = 16;
+
+// Enough to hold the text header of a .db file
+#define TILEPACK_HEADER_READ	2048
+
+// Limits on the header's dimensions, against corrupt files
+#define TILEPACK_MAX_TILES	65536
+#define TILEPACK_MAX_LODS	32
+
+static bool ParseDatabufHeader(const uchar *blob, uint bytes, databuf &buf,
+							   uint &hlen, uint &chunk, uint &extformat);
+static void SwapChunkFromMSB(databuf &buf);
+
+// Little-endian helpers, so that packs are portable between hosts
+static void PutInt32(uchar *p, uint v)
+{
+	p[0] = (uchar) (v);
+	p[1] = (uchar) (v >> 8);
+	p[2] = (uchar) (v >> 16);
+	p[3] = (uchar) (v >> 24);
+}
+static void PutInt64(uchar *p, unsigned long long v)
+{
+	PutInt32(p, (uint) (v & 0xffffffff));
+	PutInt32(p+4, (uint) (v >> 32));
+}
+static uint GetInt32(const uchar *p)
+{
+	return (uint) p[0] | ((uint) p[1] << 8) | ((uint) p[2] << 16) | ((uint) p[3] << 24);
+}
+static unsigned long long GetInt64(const uchar *p)
+{
+	return (unsigned long long) GetInt32(p) | ((unsigned long long) GetInt32(p+4) << 32);
+}
+
+// The size of an open file, which may be more than 4 GB
+static bool GetOpenFileSize(FILE *fp, unsigned long long &size)
+{
+#ifdef WIN32
+	LARGE_INTEGER li;
+	if (!GetFileSizeEx((HANDLE) _get_osfhandle(_fileno(fp)), &li))
+		return false;
+	size = (unsigned long long) li.QuadPart;
+#else
+	struct stat st;
+	if (fstat(fileno(fp), &st) != 0)
+		return false;
+	size = (unsigned long long) st.st_size;
+#endif
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// class vtTilePack implementation
+
+vtTilePack::vtTilePack()
+{
+	m_fp = NULL;
+	m_cols = m_rows = m_lods = 0;
+}
+
+vtTilePack::~vtTilePack()
+{
+	Close();
+}
+
+bool vtTilePack::Open(const char *fname)
+{
+	Close();
+
+	m_fp = vtFileOpen(fname, "rb");
+	if (!m_fp)
+		return false;
+
+	uchar header[TILEPACK_HEADER_SIZE];
+	if (fread(header, TILEPACK_HEADER_SIZE, 1, m_fp) != 1 ||
+		memcmp(header, TILEPACK_MAGIC, 8) != 0 ||
+		GetInt32(header + 8) != TILEPACK_VERSION)
+	{
+		VTLOG("vtTilePack: '%s' is not a tile pack.\n", fname);
+		Close();
+		return false;
+	}
+	const uint cols = GetInt32(header + 12);
+	const uint rows = GetInt32(header + 16);
+	const uint lods = GetInt32(header + 20);
+
+	// Check the dimensions before trusting them to size the index, which
+	//  must fit in the file.
+	const unsigned long long num64 = (unsigned long long) cols * rows * lods;
+	unsigned long long file_size;
+	if (cols < 1 || cols > TILEPACK_MAX_TILES ||
+		rows < 1 || rows > TILEPACK_MAX_TILES ||
+		lods < 1 || lods > TILEPACK_MAX_LODS ||
+		num64 > INT_MAX / TILEPACK_ENTRY_SIZE ||
+		!GetOpenFileSize(m_fp, file_size) ||
+		TILEPACK_HEADER_SIZE + num64 * TILEPACK_ENTRY_SIZE > file_size)
+	{
+		VTLOG("vtTilePack: '%s' has a bad header (%u x %u tiles, %u LODs).\n",
+			fname, cols, rows, lods);
+		Close();
+		return false;
+	}
+	m_cols = (int) cols;
+	m_rows = (int) rows;
+	m_lods = (int) lods;
+
+	// The entire index is read in a single read
+	const uint num = (uint) num64;
+	std::vector<uchar> raw(num * TILEPACK_ENTRY_SIZE);
+	if (fread(&raw[0], raw.size(), 1, m_fp) != 1)
+	{
+		VTLOG("vtTilePack: couldn't read index of '%s'.\n", fname);
+		Close();
+		return false;
+	}
+	m_index.resize(num);
+	for (uint i = 0; i < num; i++)
+	{
+		const uchar *p = &raw[i * TILEPACK_ENTRY_SIZE];
+		m_index[i].offset = GetInt64(p);
+		m_index[i].bytes = GetInt32(p + 8);
+	}
+	VTLOG("vtTilePack: opened '%s', %d x %d tiles, %d LODs.\n", fname,
+		m_cols, m_rows, m_lods);
+	return true;
+}
+
+void vtTilePack::Close()
+{
+	if (m_fp)
+		fclose(m_fp);
+	m_fp = NULL;
+	m_cols = m_rows = m_lods = 0;
+	m_index.clear();
+}
+
+const vtTilePack::Entry *vtTilePack::GetEntry(int col, int row, int lod) const
+{
+	if (col < 0 || col >= m_cols || row < 0 || row >= m_rows ||
+		lod < 0 || lod >= m_lods)
+		return NULL;
+	return &m_index[(row * m_cols + col) * m_lods + lod];
+}
+
+bool vtTilePack::HasTile(int col, int row, int lod) const
+{
+	const Entry *e = GetEntry(col, row, lod);
+	return (e != NULL && e->bytes != 0);
+}
+
+uint vtTilePack::GetTileBytes(int col, int row, int lod) const
+{
+	const Entry *e = GetEntry(col, row, lod);
+	return e ? e->bytes : 0;
+}
+
+/**
+ * Read from the given offset without moving the file position, so that
+ * several threads can read from the pack at the same time.
+ */
+bool vtTilePack::ReadAt(unsigned long long offset, void *buf, uint bytes) const
+{
+#ifdef WIN32
+	HANDLE hFile = (HANDLE) _get_osfhandle(_fileno(m_fp));
+	OVERLAPPED ov;
+	memset(&ov, 0, sizeof(ov));
+	ov.Offset = (DWORD) (offset & 0xffffffff);
+	ov.OffsetHigh = (DWORD) (offset >> 32);
+	DWORD done = 0;
+	if (!ReadFile(hFile, buf, bytes, &done, &ov))
+		return false;
+	return (done == bytes);
+#else
+	const int fd = fileno(m_fp);
+	uchar *ptr = (uchar *) buf;
+	while (bytes > 0)
+	{
+		ssize_t done = pread(fd, ptr, bytes, (off_t) offset);
+		if (done <= 0)
+			return false;
+		ptr += done;
+		offset += done;
+		bytes -= (uint) done;
+	}
+	return true;
+#endif
+}
+
+uchar *vtTilePack::ReadTile(int col, int row, int lod, uint &bytes) const
+{
+	bytes = 0;
+	const Entry *e = GetEntry(col, row, lod);
+	if (!e || e->bytes == 0)
+		return NULL;
+
+	uchar *data = (uchar *) malloc(e->bytes);
+	if (!data)
+		return NULL;
+	if (!ReadAt(e->offset, data, e->bytes))
+	{
+		free(data);
+		return NULL;
+	}
+	bytes = e->bytes;
+	return data;
+}
+
+/**
+ * Load a tile into a databuf.  Uncompressed tiles are read straight into the
+ * buffer which is handed to libMini, so the tile data is never copied on the
+ * way from the file to the texture upload.  Compressed tiles are decoded
+ * once, from the packed bytes into that buffer.
+ */
+bool vtTilePack::LoadTile(int col, int row, int lod, databuf &buf) const
+{
+	const Entry *e = GetEntry(col, row, lod);
+	if (!e || e->bytes == 0)
+		return false;
+
+	// Read the header, and usually the start of the data along with it
+	uchar head[TILEPACK_HEADER_READ];
+	const uint head_bytes = (e->bytes < TILEPACK_HEADER_READ) ? e->bytes : TILEPACK_HEADER_READ;
+	if (!ReadAt(e->offset, head, head_bytes))
+		return false;
+
+	uint hlen, chunk, extformat;
+	bool bHeader = ParseDatabufHeader(head, head_bytes, buf, hlen, chunk, extformat);
+	if (!bHeader || extformat != 0)
+	{
+		// Compressed (or unusual) tile: decode from the whole blob
+		uint bytes;
+		uchar *blob = ReadTile(col, row, lod, bytes);
+		if (!blob)
+			return false;
+		bool success = LoadDatabufFromMemory(buf, blob, bytes);
+		free(blob);
+		return success;
+	}
+	if (hlen + chunk > e->bytes)
+		return false;
+
+	buf.data = malloc(chunk);
+	if (!buf.data)
+		return false;
+	buf.bytes = chunk;
+
+	// Whatever came in with the header, then the rest directly into place
+	uint have = head_bytes - hlen;
+	if (have > chunk)
+		have = chunk;
+	memcpy(buf.data, head + hlen, have);
+	if (have < chunk &&
+		!ReadAt(e->offset + hlen + have, (uchar *) buf.data + have, chunk - have))
+	{
+		buf.release();
+		return false;
+	}
+	SwapChunkFromMSB(buf);
+	return true;
+}
+
+/**
+ * Extract the column, row and relative LOD from a tile filename of the form
+ * written by MakeFilenameDB, e.g. "folder/tile.3-7.db2".  LOD 0 has no
+ * number after the ".db".
+ */
+bool vtTilePack::ParseTileName(const char *fname, int &col, int &row, int &lod)
+{
+	const char *name = StartOfFilename(fname);
+	lod = 0;
+	return (sscanf(name, "tile.%d-%d.db%d", &col, &row, &lod) >= 2);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+
+// Find "key=" in the header and parse the value, if present
+static bool FindParam(const char *header, const char *key, float &value)
+{
+	const size_t len = strlen(key);
+	for (const char *p = header; *p; )
+	{
+		if (!strncmp(p, key, len) && p[len] == '=')
+		{
+			value = (float) atof(p + len + 1);
+			return true;
+		}
+		while (*p && *p != '\n') p++;
+		if (*p) p++;
+	}
+	return false;
+}
+static bool FindParam(const char *header, const char *key, uint &value)
+{
+	const size_t len = strlen(key);
+	for (const char *p = header; *p; )
+	{
+		if (!strncmp(p, key, len) && p[len] == '=')
+		{
+			value = (uint) strtoul(p + len + 1, NULL, 10);
+			return true;
+		}
+		while (*p && *p != '\n') p++;
+		if (*p) p++;
+	}
+	return false;
+}
+
+/**
+ * Parse the text header of a libMini .db file (key=value lines, terminated by
+ * a zero byte) into the metadata of a databuf.  On success, returns the
+ * length of the header including the zero byte, and the size and external
+ * format of the data chunk which follows it.
+ *
+ * Returns false if the header is not in a form we can decode here, in which
+ * case the caller should fall back to databuf::loaddata.
+ */
+static bool ParseDatabufHeader(const uchar *blob, uint bytes, databuf &buf,
+							   uint &hlen, uint &chunk, uint &extformat)
+{
+	hlen = 0;
+	while (hlen < bytes && blob[hlen] != 0)
+		hlen++;
+	if (hlen == bytes || strncmp((const char *) blob, "MAGIC=", 6) != 0)
+		return false;
+	const char *header = (const char *) blob;
+
+	uint xsize = 0, ysize = 0, zsize = 1, tsteps = 1, type = 0;
+	uint implformat = 0;
+	extformat = chunk = 0;
+	if (!FindParam(header, "xsize", xsize) ||
+		!FindParam(header, "ysize", ysize) ||
+		!FindParam(header, "type", type) ||
+		!FindParam(header, "bytes", chunk))
+		return false;
+	FindParam(header, "zsize", zsize);
+	FindParam(header, "tsteps", tsteps);
+	FindParam(header, "extformat", extformat);
+	FindParam(header, "implformat", implformat);
+
+	// Implicitly formatted data (e.g. mipmapped S3TC) is left to libMini
+	if (implformat != 0)
+		return false;
+	hlen++;		// include the zero byte
+
+	buf.release();
+
+	buf.xsize = xsize;
+	buf.ysize = ysize;
+	buf.zsize = zsize;
+	buf.tsteps = tsteps;
+	buf.type = type;
+
+	FindParam(header, "swx", buf.swx);
+	FindParam(header, "swy", buf.swy);
+	FindParam(header, "nwx", buf.nwx);
+	FindParam(header, "nwy", buf.nwy);
+	FindParam(header, "nex", buf.nex);
+	FindParam(header, "ney", buf.ney);
+	FindParam(header, "sex", buf.sex);
+	FindParam(header, "sey", buf.sey);
+	FindParam(header, "h0", buf.h0);
+	FindParam(header, "dh", buf.dh);
+	FindParam(header, "t0", buf.t0);
+	FindParam(header, "dt", buf.dt);
+	FindParam(header, "scaling", buf.scaling);
+	FindParam(header, "bias", buf.bias);
+	FindParam(header, "minvalue", buf.minvalue);
+	FindParam(header, "maxvalue", buf.maxvalue);
+	FindParam(header, "LLWGS84_swx", buf.LLWGS84_swx);
+	FindParam(header, "LLWGS84_swy", buf.LLWGS84_swy);
+	FindParam(header, "LLWGS84_nwx", buf.LLWGS84_nwx);
+	FindParam(header, "LLWGS84_nwy", buf.LLWGS84_nwy);
+	FindParam(header, "LLWGS84_nex", buf.LLWGS84_nex);
+	FindParam(header, "LLWGS84_ney", buf.LLWGS84_ney);
+	FindParam(header, "LLWGS84_sex", buf.LLWGS84_sex);
+	FindParam(header, "LLWGS84_sey", buf.LLWGS84_sey);
+	return true;
+}
+
+// The chunk is stored in MSB order; swap shorts and floats in place on Intel
+static void SwapChunkFromMSB(databuf &buf)
+{
+	static const unsigned short int intel_check = 1;
+	if (*((const uchar *) &intel_check) == 0)
+		return;
+
+	uint b = (buf.type == 1) ? 2 : (buf.type == 2) ? 4 : 1;
+	if (b == 1)
+		return;
+	uchar *ptr = (uchar *) buf.data, tmp;
+	for (uint i = 0; i + b <= buf.bytes; i += b, ptr += b)
+		for (uint k = 0; k < b/2; k++)
+		{
+			tmp = ptr[k];
+			ptr[k] = ptr[b-1-k];
+			ptr[b-1-k] = tmp;
+		}
+}
+
+/**
+ * Decode the contents of a libMini .db file, held in memory, into a databuf.
+ * This mirrors what databuf::loaddata does for a file, including data stored
+ * in an external format (JPEG/PNG/Z).
+ */
+bool LoadDatabufFromMemory(databuf &buf, uchar *blob, uint bytes)
+{
+	uint hlen, chunk, extformat;
+	if (!ParseDatabufHeader(blob, bytes, buf, hlen, chunk, extformat) ||
+		hlen + chunk > bytes)
+		return false;
+
+	uchar *src = blob + hlen;
+	if (extformat != 0)
+	{
+		// Compressed data decodes straight into a new chunk
+		uchar *decoded = NULL;
+		uint decoded_bytes = 0;
+		if (!MiniDecodeExternal(src, chunk, extformat, &decoded, &decoded_bytes, &buf))
+			return false;
+		buf.data = decoded;
+		buf.bytes = decoded_bytes;
+		return true;
+	}
+
+	buf.data = malloc(chunk);
+	if (!buf.data)
+		return false;
+	buf.bytes = chunk;
+	memcpy(buf.data, src, chunk);
+	SwapChunkFromMSB(buf);
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+
+static vtString TileFilename(const char *folder, int col, int row, int lod)
+{
+	// Same naming as MakeFilenameDB
+	vtString fname = folder, str;
+	fname += '/';
+	if (lod == 0)
+		str.Format("tile.%d-%d.db", col, row);
+	else
+		str.Format("tile.%d-%d.db%d", col, row, lod);
+	fname += str;
+	return fname;
+}
+
+/**
+ * Convert an existing tileset folder (as written by WriteElevationTileset or
+ * the image tileset writers) into a single packed file.  The folder is left
+ * untouched.
+ */
+bool WriteTilePack(const char *folder, int cols, int rows, const char *pack_fname,
+				   bool progress_callback(int))
+{
+	VTLOG("WriteTilePack: '%s' (%d x %d) -> '%s'\n", folder, cols, rows, pack_fname);
+
+	// First pass: find which LODs exist, and how many LODs there are
+	const int max_lods = 32;
+	std::vector<int> sizes(cols * rows * max_lods, 0);
+	int lods = 0;
+	for (int row = 0; row < rows; row++)
+	{
+		for (int col = 0; col < cols; col++)
+		{
+			for (int lod = 0; lod < max_lods; lod++)
+			{
+				vtString fname = TileFilename(folder, col, row, lod);
+				if (!vtFileExists(fname))
+					break;
+				sizes[(row * cols + col) * max_lods + lod] = GetFileSize(fname);
+				if (lod + 1 > lods)
+					lods = lod + 1;
+			}
+		}
+		if (progress_callback != NULL)
+			progress_callback(row * 10 / rows);
+	}
+	if (lods == 0)
+	{
+		VTLOG1(" No tiles found.\n");
+		return false;
+	}
+
+	FILE *fp = vtFileOpen(pack_fname, "wb");
+	if (!fp)
+		return false;
+
+	// Write header and index; the data follows directly after the index
+	const int num = cols * rows * lods;
+	std::vector<uchar> index(TILEPACK_HEADER_SIZE + num * TILEPACK_ENTRY_SIZE, 0);
+	memcpy(&index[0], TILEPACK_MAGIC, 8);
+	PutInt32(&index[8], TILEPACK_VERSION);
+	PutInt32(&index[12], cols);
+	PutInt32(&index[16], rows);
+	PutInt32(&index[20], lods);
+
+	unsigned long long offset = index.size();
+	for (int row = 0; row < rows; row++)
+		for (int col = 0; col < cols; col++)
+			for (int lod = 0; lod < lods; lod++)
+			{
+				int bytes = sizes[(row * cols + col) * max_lods + lod];
+				if (bytes <= 0)
+					continue;
+				uchar *p = &index[TILEPACK_HEADER_SIZE +
+					((row * cols + col) * lods + lod) * TILEPACK_ENTRY_SIZE];
+				PutInt64(p, offset);
+				PutInt32(p + 8, bytes);
+				offset += bytes;
+			}
+	bool success = (fwrite(&index[0], index.size(), 1, fp) == 1);
+
+	// Second pass: copy the tiles in, in index order
+	std::vector<uchar> data;
+	for (int row = 0; row < rows && success; row++)
+	{
+		for (int col = 0; col < cols && success; col++)
+		{
+			for (int lod = 0; lod < lods && success; lod++)
+			{
+				int bytes = sizes[(row * cols + col) * max_lods + lod];
+				if (bytes <= 0)
+					continue;
+				vtString fname = TileFilename(folder, col, row, lod);
+				FILE *in = vtFileOpen(fname, "rb");
+				if (!in)
+				{
+					success = false;
+					break;
+				}
+				data.resize(bytes);
+				success = (fread(&data[0], bytes, 1, in) == 1 &&
+						   fwrite(&data[0], bytes, 1, fp) == 1);
+				fclose(in);
+			}
+		}
+		if (progress_callback != NULL)
+			progress_callback(10 + row * 90 / rows);
+	}
+	fclose(fp);
+
+	if (!success)
+	{
+		VTLOG1(" Failed to write tile pack.\n");
+		vtDeleteFile(pack_fname);
+		return false;
+	}
+	VTLOG(" Wrote %d LODs, %.1f MB.\n", lods, (double) offset / (1024*1024));
+	return true;
+}
@@ -0,0 +1,85 @@
+//
+// TilePack.h: a packed container for libMini tilesets.
+//
+// A tileset written as a folder of .db files has one small file per tile per
+// LOD.  The pack stores all of those files in a single file, with an offset
+// index at the front, so that tiles can be found without touching the
+// filesystem and read with a single positioned read.
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#ifndef TILEPACK_H
+#define TILEPACK_H
+
+#include <stdio.h>
+#include <vector>
+#include "vtdata/config_vtdata.h"
+
+class databuf;
+
+// File layout (all values little-endian):
+//
+//  char[8]  magic "VTPTPACK"
+//  int32    version
+//  int32    cols, rows, lods
+//  entry    index[cols * rows * lods]	(offset: uint64, bytes: uint32, reserved: uint32)
+//  ...      tile data
+//
+// An entry with bytes == 0 means that tile LOD does not exist.  Entries are
+// ordered by row, then column, then LOD (where LOD 0 is the most detailed).
+
+#define TILEPACK_VERSION	1
+#define TILEPACK_EXTENSION	".tpk"
+
+/**
+ * Reads tiles from a packed tileset.  The index is read once when the pack
+ * is opened; after that, each tile is a single positioned read (pread) of
+ * the file, which is safe to call from several loader threads at once.
+ */
+class vtTilePack
+{
+public:
+	vtTilePack();
+	~vtTilePack();
+
+	bool Open(const char *fname);
+	void Close();
+	bool IsOpen() const { return m_fp != NULL; }
+
+	int GetCols() const { return m_cols; }
+	int GetRows() const { return m_rows; }
+	int GetLODs() const { return m_lods; }
+
+	bool HasTile(int col, int row, int lod) const;
+	uint GetTileBytes(int col, int row, int lod) const;
+
+	// Returns a buffer allocated with malloc, which the caller must free.
+	uchar *ReadTile(int col, int row, int lod, uint &bytes) const;
+
+	// Read a tile and decode it directly into a libMini databuf.
+	bool LoadTile(int col, int row, int lod, databuf &buf) const;
+
+	static bool ParseTileName(const char *fname, int &col, int &row, int &lod);
+
+protected:
+	struct Entry
+	{
+		unsigned long long offset;
+		uint bytes;
+	};
+	const Entry *GetEntry(int col, int row, int lod) const;
+	bool ReadAt(unsigned long long offset, void *buf, uint bytes) const;
+
+	FILE *m_fp;
+	int m_cols, m_rows, m_lods;
+	std::vector<Entry> m_index;
+};
+
+bool LoadDatabufFromMemory(databuf &buf, uchar *blob, uint bytes);
+
+bool WriteTilePack(const char *folder, int cols, int rows, const char *pack_fname,
+				   bool progress_callback(int) = NULL);
+
+#endif // TILEPACK_H
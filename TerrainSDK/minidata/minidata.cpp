@@ -138,10 +138,12 @@ int conversionhook(int israwdata,unsigned char *srcdata,unsigned int bytes,unsig
 	return(1); // return success
 }
 
+// parameters registered with libMini
+static MINI_CONVERSION_PARAMS conversion_params;
+
 void InitMiniConvHook(int iJpegQuality)
 {
 	// specify conversion parameters
-	static MINI_CONVERSION_PARAMS conversion_params;
 	conversion_params.jpeg_quality = (float) iJpegQuality; // jpeg quality in percent
 	conversion_params.png_gamma=0.0f; // png gamma (0.0=default 1.0=neutral)
 	conversion_params.zlib_level=9; // zlib compression level (0=none 6=standard 9=highest)
@@ -149,3 +151,13 @@ void InitMiniConvHook(int iJpegQuality)
 	// register libMini conversion hook (JPEG/PNG)
 	databuf::setconversion(conversionhook,&conversion_params);
 }
+
+// Decode a chunk in an external format (JPEG/PNG/Z) using the same hook and
+//  parameters that libMini uses, for data which doesn't come from a file.
+int MiniDecodeExternal(unsigned char *srcdata, unsigned int bytes,
+					   unsigned int extformat, unsigned char **newdata,
+					   unsigned int *newbytes, databuf *obj)
+{
+	return conversionhook(0, srcdata, bytes, extformat, newdata, newbytes,
+		obj, &conversion_params);
+}
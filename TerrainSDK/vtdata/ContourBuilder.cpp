@@ -0,0 +1,460 @@
+//
+// ContourBuilder.cpp
+//
+// Make contour lines from elevation grids, a tile at a time, in parallel.
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include <math.h>
+#include <algorithm>
+
+#include "ContourBuilder.h"
+#include "Features.h"
+#include "FilePath.h"
+#include "HeightField.h"
+#include "vtLog.h"
+
+// Default number of cells on a side of each tile
+#define CONTOUR_TILE	256
+
+// A crossing on the far side of a cell, waiting for the next cell's piece
+struct Waiting
+{
+	Waiting(int ix, int ilevel, int iend) : x(ix), level(ilevel), end(iend) {}
+	int x, level, end;
+};
+
+
+///////////////////////////////////////////////////////////////////////
+// vtContourBuilder
+
+bool vtContourBuilder::Crossing::operator<(const Crossing &c) const
+{
+	if (level != c.level) return level < c.level;
+	if (y != c.y) return y < c.y;
+	if (x != c.x) return x < c.x;
+	return dir < c.dir;
+}
+
+bool vtContourBuilder::Crossing::operator==(const Crossing &c) const
+{
+	return (level == c.level && y == c.y && x == c.x && dir == c.dir);
+}
+
+vtContourBuilder::vtContourBuilder()
+{
+	m_iTileSize = CONTOUR_TILE;
+}
+
+/**
+ * Add contour elevations at a regular interval, over the range of a grid's
+ * heights.  For example, if the heights range from 50 to 350 meters, an
+ * interval of 100 gives contours at 100, 200 and 300 meters.
+ */
+void vtContourBuilder::AddLevels(const vtHeightFieldGrid3d &grid, float fInterval)
+{
+	if (fInterval <= 0.0f)
+		return;
+
+	float fMin, fMax;
+	grid.GetHeightExtents(fMin, fMax);
+	int start = (int) floor(fMin / fInterval) + 1;
+	int stop = (int) floor(fMax / fInterval);
+	for (int i = start; i <= stop; i++)
+		m_Levels.push_back(i * fInterval);
+}
+
+/**
+ * Make the contour lines at all the levels which have been added.
+ *
+ * \param grid The elevation grid.  Its true elevations (not exaggerated)
+ *		are contoured.
+ * \param progress_callback If supplied, this is called with progress from
+ *		0 to 100; it returns true to cancel.
+ * \return false if there were no levels, or it was cancelled.
+ */
+bool vtContourBuilder::Build(const vtHeightFieldGrid3d &grid, bool progress_callback(int))
+{
+	m_Lines.clear();
+	m_LineLevels.clear();
+
+	std::sort(m_Levels.begin(), m_Levels.end());
+	m_Levels.erase(std::unique(m_Levels.begin(), m_Levels.end()), m_Levels.end());
+
+	const IPoint2 size = grid.GetDimensions();
+	if (m_Levels.empty() || size.x < 2 || size.y < 2)
+		return false;
+
+	// Contour each tile, joining the pieces of line within it
+	const int cols = (size.x - 2) / m_iTileSize + 1;
+	const int rows = (size.y - 2) / m_iTileSize + 1;
+	const int tiles = cols * rows;
+	std::vector<Chains> tile_chains(tiles);
+
+	vtThreadFlag cancel;
+	int iDone = 0;
+	#pragma omp parallel for schedule(dynamic)
+	for (int t = 0; t < tiles; t++)
+	{
+		if (cancel.IsSet())
+			continue;
+
+		const int x0 = (t % cols) * m_iTileSize;
+		const int y0 = (t / cols) * m_iTileSize;
+		const int x1 = std::min(x0 + m_iTileSize, size.x - 1);
+		const int y1 = std::min(y0 + m_iTileSize, size.y - 1);
+
+		_ContourTile(grid, x0, y0, x1, y1, tile_chains[t]);
+
+		const int iCount = vtAtomicIncrement(iDone);
+
+		if (progress_callback != NULL && vtIsFirstThread())
+		{
+			if (progress_callback(iCount * 90 / tiles))
+				cancel.Set();
+		}
+	}
+	if (cancel.IsSet())
+		return false;
+
+	// Join the lines across the tiles.  Only their ends are needed for
+	//  that; the paths are then read straight from the tiles' lines.
+	std::vector<int> base(tiles + 1, 0);
+	for (int t = 0; t < tiles; t++)
+		base[t+1] = base[t] + tile_chains[t].Size();
+	std::vector<int> partner(base[tiles] * 2, -1);
+	std::vector<End> ends;
+	for (int t = 0; t < tiles; t++)
+	{
+		const Chains &tc = tile_chains[t];
+		for (uint i = 0; i < tc.Size(); i++)
+		{
+			const int c = base[t] + i;
+			const Crossing &first = tc.m_Points[tc.m_Start[i]];
+			const Crossing &last = tc.m_Points[tc.m_Start[i+1] - 1];
+			if (first == last)
+			{
+				partner[c * 2] = c * 2 + 1;
+				partner[c * 2 + 1] = c * 2;
+			}
+			else
+			{
+				ends.push_back(End(first, c * 2));
+				ends.push_back(End(last, c * 2 + 1));
+			}
+		}
+	}
+	_Pair(ends, partner);
+	std::vector<End>().swap(ends);
+
+	std::vector<int> steps, path_start;
+	_Walk(partner, steps, path_start);
+	if (progress_callback != NULL)
+		progress_callback(95);
+
+	// Convert the crossings to earth coordinates
+	const int lines = (int) path_start.size() - 1;
+	m_Lines.resize(lines);
+	m_LineLevels.resize(lines);
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (int i = 0; i < lines; i++)
+	{
+		DLine2 &line = m_Lines[i];
+		for (int s = path_start[i]; s < path_start[i+1]; s++)
+		{
+			const int c = steps[s] / 2;
+			const int t = (int) (std::upper_bound(base.begin(), base.end(), c) - base.begin()) - 1;
+			const Chains &tc = tile_chains[t];
+			const int first = tc.m_Start[c - base[t]], last = tc.m_Start[c - base[t] + 1] - 1;
+			const bool bForward = ((steps[s] & 1) == 0);
+			if (s == path_start[i])
+				m_LineLevels[i] = m_Levels[tc.m_Points[first].level];
+			for (int k = first; k <= last; k++)
+			{
+				DPoint2 p = _CrossingPoint(grid, tc.m_Points[bForward ? k : first + last - k]);
+				if (line.GetSize() == 0 || p != line[line.GetSize() - 1])
+					line.Append(p);
+			}
+		}
+	}
+
+	// A line which touched the grid at a single point has collapsed
+	uint kept = 0;
+	for (uint i = 0; i < m_Lines.size(); i++)
+	{
+		if (m_Lines[i].GetSize() < 2)
+			continue;
+		if (kept != i)
+		{
+			m_Lines[kept] = m_Lines[i];
+			m_LineLevels[kept] = m_LineLevels[i];
+		}
+		kept++;
+	}
+	m_Lines.resize(kept);
+	m_LineLevels.resize(kept);
+
+	VTLOG("vtContourBuilder: %d levels, %d tiles, %d lines\n",
+		(int) m_Levels.size(), tiles, (int) kept);
+	return true;
+}
+
+/**
+ * Add the contour lines to a featureset, with each line's elevation in a
+ * field of the featureset.
+ */
+void vtContourBuilder::AddToFeatures(vtFeatureSetLineString *fset, int iField) const
+{
+	for (uint i = 0; i < m_Lines.size(); i++)
+	{
+		int record = fset->AddPolyLine(m_Lines[i]);
+		fset->SetValue(record, iField, m_LineLevels[i]);
+	}
+}
+
+/**
+ * Contour the cells from (x0,y0) up to (x1,y1), and join the pieces of line
+ * into polylines.
+ *
+ * The cells are visited in rows, and the levels of each cell in order, so
+ * the crossings on each edge come in the same order from both of the cells
+ * which share it.  That lets each piece be linked to its neighbors as it is
+ * found, by walking along the crossings left by the cell to the left and
+ * the row below.
+ */
+void vtContourBuilder::_ContourTile(const vtHeightFieldGrid3d &grid, int x0, int y0,
+									int x1, int y1, Chains &out) const
+{
+	// Copy the tile's heights, with the heixels it shares with its neighbors
+	const int w = x1 - x0 + 1, h = y1 - y0 + 1;
+	std::vector<float> z(w * h);
+	for (int j = 0; j < h; j++)
+		for (int i = 0; i < w; i++)
+			z[j * w + i] = grid.GetElevation(x0 + i, y0 + j, true);
+
+	// The pieces, each two crossings.  End 2s of piece s is its first
+	//  crossing, 2s+1 its second.
+	std::vector<Crossing> pieces;
+	std::vector<int> partner;
+
+	// Crossings waiting for a partner, on the top edges of the previous row
+	//  and on the right edge of the previous cell
+	std::vector<Waiting> below, above, left, right;
+
+	const int levels = (int) m_Levels.size();
+	Crossing edge[4];
+	for (int j = 0; j < h - 1; j++)
+	{
+		below.swap(above);
+		above.clear();
+		left.clear();
+		uint b = 0;
+
+		for (int i = 0; i < w - 1; i++)
+		{
+			right.clear();
+			uint l = 0;
+
+			// Corners, counter-clockwise from the lower left
+			const float c0 = z[j * w + i], c1 = z[j * w + i + 1];
+			const float c2 = z[(j + 1) * w + i + 1], c3 = z[(j + 1) * w + i];
+			if (c0 == INVALID_ELEVATION || c1 == INVALID_ELEVATION ||
+				c2 == INVALID_ELEVATION || c3 == INVALID_ELEVATION)
+			{
+				left.swap(right);
+				continue;
+			}
+
+			// The levels which cross this cell, those with fMin < level <= fMax
+			const float fMin = std::min(std::min(c0, c1), std::min(c2, c3));
+			const float fMax = std::max(std::max(c0, c1), std::max(c2, c3));
+			int lev = (int) (std::upper_bound(m_Levels.begin(), m_Levels.end(), fMin) - m_Levels.begin());
+			for (; lev < levels && m_Levels[lev] <= fMax; lev++)
+			{
+				const float fLevel = m_Levels[lev];
+
+				// Edges: bottom, right, top, left
+				const int x = x0 + i, y = y0 + j;
+				Crossing e0 = { lev, y, x, 0 };
+				Crossing e1 = { lev, y, x + 1, 1 };
+				Crossing e2 = { lev, y + 1, x, 0 };
+				Crossing e3 = { lev, y, x, 1 };
+				edge[0] = e0; edge[1] = e1; edge[2] = e2; edge[3] = e3;
+
+				const int bits = (c0 >= fLevel ? 1 : 0) | (c1 >= fLevel ? 2 : 0) |
+					(c2 >= fLevel ? 4 : 0) | (c3 >= fLevel ? 8 : 0);
+
+				// The ends of the pieces, as pairs of edges
+				int ends[4], n = 0;
+				if (bits == 5 || bits == 10)
+				{
+					// Saddle: the average height decides which corners join
+					const bool bCenterAbove = ((c0 + c1 + c2 + c3) / 4 >= fLevel);
+					if (bCenterAbove == (bits == 5))
+					{
+						// cut off corners 1 and 3
+						ends[0] = 0; ends[1] = 1; ends[2] = 2; ends[3] = 3;
+					}
+					else
+					{
+						// cut off corners 0 and 2
+						ends[0] = 3; ends[1] = 0; ends[2] = 1; ends[3] = 2;
+					}
+					n = 4;
+				}
+				else
+				{
+					// Exactly two edges have corners on different sides
+					const int corner[4] = { bits & 1, (bits >> 1) & 1, (bits >> 2) & 1, (bits >> 3) & 1 };
+					for (int k = 0; k < 4; k++)
+					{
+						if (corner[k] != corner[(k + 1) % 4])
+							ends[n++] = k;
+					}
+				}
+
+				for (int k = 0; k < n; k++)
+				{
+					const int end = (int) pieces.size();
+					pieces.push_back(edge[ends[k]]);
+					partner.push_back(-1);
+
+					// Link to, or leave for, the neighboring cell
+					switch (ends[k])
+					{
+					case 0:
+						while (b < below.size() && (below[b].x < i ||
+							(below[b].x == i && below[b].level < lev)))
+							b++;
+						if (b < below.size() && below[b].x == i && below[b].level == lev)
+						{
+							partner[end] = below[b].end;
+							partner[below[b].end] = end;
+						}
+						break;
+					case 1:
+						right.push_back(Waiting(i, lev, end));
+						break;
+					case 2:
+						above.push_back(Waiting(i, lev, end));
+						break;
+					case 3:
+						while (l < left.size() && left[l].level < lev)
+							l++;
+						if (l < left.size() && left[l].level == lev)
+						{
+							partner[end] = left[l].end;
+							partner[left[l].end] = end;
+						}
+						break;
+					}
+				}
+			}
+			left.swap(right);
+		}
+	}
+
+	// Follow the links
+	std::vector<int> steps, path_start;
+	_Walk(partner, steps, path_start);
+	for (uint p = 0; p + 1 < path_start.size(); p++)
+	{
+		for (int s = path_start[p]; s < path_start[p+1]; s++)
+		{
+			// Each piece after the first shares its first crossing with the
+			//  one before it
+			if (s == path_start[p])
+				out.m_Points.push_back(pieces[steps[s]]);
+			out.m_Points.push_back(pieces[steps[s] ^ 1]);
+		}
+		out.Close();
+	}
+}
+
+/**
+ * Link the ends of lines which are at the same crossing.  Each crossing is
+ * the end of at most two lines, since at most two cells share a grid edge.
+ *
+ * \param ends The ends of the lines.  End 2c is the start of line c, and
+ *		2c+1 is its end.  These get sorted.
+ * \param partner For each end, receives the end linked to it, if any.
+ */
+void vtContourBuilder::_Pair(std::vector<End> &ends, std::vector<int> &partner)
+{
+	std::sort(ends.begin(), ends.end());
+	for (size_t i = 0; i + 1 < ends.size(); i++)
+	{
+		if (ends[i].first == ends[i+1].first)
+		{
+			partner[ends[i].second] = ends[i+1].second;
+			partner[ends[i+1].second] = ends[i].second;
+			i++;
+		}
+	}
+}
+
+/**
+ * Follow linked lines into paths.  A line which closes on itself has its
+ * two ends linked to each other.
+ *
+ * \param partner For each end (2c is the start of line c, 2c+1 its end) the
+ *		end linked to it, or -1.
+ * \param steps Receives the lines to follow for each path, in order: 2c to
+ *		follow line c forwards, 2c+1 to follow it backwards.
+ * \param path_start Receives where each path begins in steps, and the end.
+ */
+void vtContourBuilder::_Walk(const std::vector<int> &partner, std::vector<int> &steps,
+							 std::vector<int> &path_start)
+{
+	const int n = (int) partner.size() / 2;
+
+	// Walk from an end, through each line and on into its partner.  First
+	//  the paths which have loose ends, then the loops.
+	std::vector<char> used(n, 0);
+	path_start.push_back(0);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int e = 0; e < n * 2; e++)
+		{
+			if (used[e / 2])
+				continue;
+			if (pass == 0 && partner[e] != -1)
+				continue;
+			if (pass == 1 && (e & 1))
+				continue;
+
+			int from = e;
+			while (true)
+			{
+				used[from / 2] = 1;
+				steps.push_back(from);
+				const int next = partner[from ^ 1];
+				if (next == -1 || used[next / 2])
+					break;
+				from = next;
+			}
+			path_start.push_back((int) steps.size());
+		}
+	}
+}
+
+DPoint2 vtContourBuilder::_CrossingPoint(const vtHeightFieldGrid3d &grid,
+										 const Crossing &c) const
+{
+	const float fLevel = m_Levels[c.level];
+	const float a = grid.GetElevation(c.x, c.y, true);
+	const float b = (c.dir == 0) ? grid.GetElevation(c.x + 1, c.y, true) :
+		grid.GetElevation(c.x, c.y + 1, true);
+	const double t = (fLevel - a) / (b - a);
+
+	const DRECT &ext = grid.GetEarthExtents();
+	const DPoint2 &spacing = grid.GetSpacing();
+	DPoint2 p(ext.left + c.x * spacing.x, ext.bottom + c.y * spacing.y);
+	if (c.dir == 0)
+		p.x += t * spacing.x;
+	else
+		p.y += t * spacing.y;
+	return p;
+}
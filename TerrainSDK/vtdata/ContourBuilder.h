@@ -0,0 +1,97 @@
+//
+// ContourBuilder.h
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#ifndef CONTOURBUILDERH
+#define CONTOURBUILDERH
+
+#include <vector>
+
+#include "MathTypes.h"
+
+class vtFeatureSetLineString;
+class vtHeightFieldGrid3d;
+
+/**
+ * Makes contour lines from an elevation grid, by marching squares.
+ *
+ * The grid is divided into square tiles, which are contoured on several
+ * threads.  Each tile is scanned once for all the contour elevations
+ * (levels) together.  The pieces of line found in each cell are joined into
+ * polylines by matching their endpoints, first within each tile, then
+ * across the tiles.  The endpoints are identified by the grid edge they lie
+ * on and their level, so pieces from neighboring cells meet exactly.
+ *
+ * Cells with an unknown corner are left out, so contours stop at the edge
+ * of unknown data.
+ *
+ * \par Example:
+	\code
+	vtContourBuilder cb;
+	cb.AddLevels(*grid, 10.0f);
+	if (cb.Build(*grid))
+		cb.AddToFeatures(fset);
+	\endcode
+ */
+class vtContourBuilder
+{
+public:
+	vtContourBuilder();
+
+	/// Add a single contour elevation.
+	void AddLevel(float fLevel) { m_Levels.push_back(fLevel); }
+	void AddLevels(const vtHeightFieldGrid3d &grid, float fInterval);
+	/// How many cells on a side to contour at a time, at least 1.
+	void SetTileSize(int iSize) { m_iTileSize = (iSize < 1) ? 1 : iSize; }
+
+	bool Build(const vtHeightFieldGrid3d &grid, bool progress_callback(int) = NULL);
+
+	/// The number of polylines made by Build.
+	uint NumLines() const { return (uint) m_Lines.size(); }
+	/// A polyline, in earth coordinates.  Closed lines end where they begin.
+	const DLine2 &GetLine(uint i) const { return m_Lines[i]; }
+	/// The elevation of a polyline.
+	float GetLineLevel(uint i) const { return m_LineLevels[i]; }
+
+	void AddToFeatures(vtFeatureSetLineString *fset, int iField = 0) const;
+
+protected:
+	/// Where a contour crosses a grid edge.  dir is 0 for the edge from
+	/// heixel (x,y) to (x+1,y), 1 for the edge from (x,y) to (x,y+1).
+	struct Crossing
+	{
+		int level, y, x, dir;
+		bool operator<(const Crossing &c) const;
+		bool operator==(const Crossing &c) const;
+	};
+	/// A set of polylines of crossings, stored end to end.
+	struct Chains
+	{
+		Chains() { m_Start.push_back(0); }
+		uint Size() const { return (uint) m_Start.size() - 1; }
+		void Close() { m_Start.push_back((int) m_Points.size()); }
+
+		std::vector<Crossing> m_Points;
+		std::vector<int> m_Start;
+	};
+
+	typedef std::pair<Crossing, int> End;
+
+	void _ContourTile(const vtHeightFieldGrid3d &grid, int x0, int y0,
+		int x1, int y1, Chains &out) const;
+	static void _Pair(std::vector<End> &ends, std::vector<int> &partner);
+	static void _Walk(const std::vector<int> &partner, std::vector<int> &steps,
+		std::vector<int> &path_start);
+	DPoint2 _CrossingPoint(const vtHeightFieldGrid3d &grid, const Crossing &c) const;
+
+	std::vector<float> m_Levels;
+	int m_iTileSize;
+
+	std::vector<DLine2> m_Lines;
+	std::vector<float> m_LineLevels;
+};
+
+#endif // CONTOURBUILDERH
@@ -191,6 +191,34 @@ void vtElevationGrid::FreeData()
 	m_pFData = NULL;
 }
 
+/**
+ * Exchange heixel data with another grid of the same size and type, without
+ * copying it.  This is useful to load data into a temporary grid (perhaps
+ * in another thread) and then hand it to the grid which needs it.
+ *
+ * \return false if the grids are not the same size and type.
+ */
+bool vtElevationGrid::SwapData(vtElevationGrid &other)
+{
+	if (m_iSize != other.m_iSize || m_bFloatMode != other.m_bFloatMode)
+		return false;
+
+	short *data = m_pData;
+	m_pData = other.m_pData;
+	other.m_pData = data;
+
+	float *fdata = m_pFData;
+	m_pFData = other.m_pFData;
+	other.m_pFData = fdata;
+
+	float fmin = m_fMinHeight, fmax = m_fMaxHeight;
+	m_fMinHeight = other.m_fMinHeight;
+	m_fMaxHeight = other.m_fMaxHeight;
+	other.m_fMinHeight = fmin;
+	other.m_fMaxHeight = fmax;
+	return true;
+}
+
 /**
  Set all the values in the grid to zero.
  */
@@ -1377,6 +1405,54 @@ float vtElevationGrid::GetFilteredValue(const DPoint2 &p) const
 	return GetInterpolatedElevation(findex_x, findex_y);
 }
 
+/**
+ * Sample the grid at a line of evenly spaced points, p0 + k * step for k from
+ * 0 to count-1.  This is the same as calling GetFilteredValue for each point,
+ * but much of the work is done once for the whole line.
+ *
+ * Points which fall outside the grid, or on unknown heixels, are left
+ * unchanged in the output array.  This allows several grids to be sampled
+ * into the same array, in order of increasing priority.
+ *
+ * \return The number of values which were written.
+ */
+int vtElevationGrid::GetFilteredValues(const DPoint2 &p0, const DPoint2 &step,
+	int count, float *values) const
+{
+	// Work in fractional heixel index space, which is linear along the line
+	const double sx = (m_iSize.x-1) / m_EarthExtents.Width();
+	const double sy = (m_iSize.y-1) / m_EarthExtents.Height();
+	const double fx0 = (p0.x - m_EarthExtents.left) * sx;
+	const double fy0 = (p0.y - m_EarthExtents.bottom) * sy;
+	const double dfx = step.x * sx;
+	const double dfy = step.y * sy;
+
+	int written = 0;
+	for (int k = 0; k < count; k++)
+	{
+		double findex_x = fx0 + k * dfx;
+		double findex_y = fy0 + k * dfy;
+
+		if (findex_x < -0.5 || findex_x > m_iSize.x - 0.5 ||
+			findex_y < -0.5 || findex_y > m_iSize.y -0.5)
+			continue;
+
+		// clamp the edges
+		if (findex_x < 0.0) findex_x = 0.0;
+		if (findex_x > m_iSize.x-1) findex_x = m_iSize.x-1;
+		if (findex_y < 0.0) findex_y = 0.0;
+		if (findex_y > m_iSize.y-1) findex_y = m_iSize.y-1;
+
+		const float value = GetInterpolatedElevation(findex_x, findex_y);
+		if (value != INVALID_ELEVATION)
+		{
+			values[k] = value;
+			written++;
+		}
+	}
+	return written;
+}
+
 /**
  * The standard extents of an elevation grid are the min and max of its data
  * points.  However, because each point in the grid is a spot elevation that
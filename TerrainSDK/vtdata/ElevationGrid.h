@@ -48,6 +48,7 @@ public:
 	bool Create(const DRECT &area, const IPoint2 &size, bool bFloat,
 		const vtProjection &proj, vtElevError *err = NULL);
 	void FreeData();
+	bool SwapData(vtElevationGrid &other);
 
 	void Clear();
 	void Invalidate();
@@ -87,6 +88,11 @@ public:
 	bool LoadFromMicroDEM(const char *szFileName, bool progress_callback(int) = NULL);
 	bool LoadFromXYZ(const char *szFileName, bool progress_callback(int) = NULL);
 	bool LoadFromXYZ(FILE *fp, const char *format, bool progress_callback(int) = NULL);
+
+	/// The text formats (ASC, DSAA and XYZ) are parsed from a memory mapping
+	/// of the file, on several threads.  Set this false to read them with
+	/// stdio, one value at a time, as before.
+	static bool s_bMapTextFiles;
 	bool LoadFromHGT(const char *szFileName, bool progress_callback(int) = NULL);
 	bool LoadFromBT(const char *szFileName, bool progress_callback(int) = NULL,
 		vtElevError *err = NULL);
@@ -125,6 +131,8 @@ public:
 
 	float GetClosestValue(const DPoint2 &p) const;
 	float GetFilteredValue(const DPoint2 &p) const;
+	int GetFilteredValues(const DPoint2 &p0, const DPoint2 &step, int count,
+		float *values) const;
 
 	// Accessors
 	/** Return the embedded name of the DEM is it has one */
@@ -159,9 +167,9 @@ public:
 	float GetScale() const { return m_fVMeters; }
 
 	bool HasData() const { return (m_pData != NULL || m_pFData != NULL); }
-	int MemoryNeededToLoad() const { return m_iSize.x * m_iSize.x * (m_bFloatMode ? 4 : 2); }
-	int MemoryUsed() const { if (m_pData) return m_iSize.x * m_iSize.x * 2;
-						 else if (m_pFData) return m_iSize.x * m_iSize.x * 4;
+	size_t MemoryNeededToLoad() const { return (size_t) m_iSize.x * m_iSize.y * (m_bFloatMode ? 4 : 2); }
+	size_t MemoryUsed() const { if (m_pData) return (size_t) m_iSize.x * m_iSize.y * 2;
+						 else if (m_pFData) return (size_t) m_iSize.x * m_iSize.y * 4;
 						 else return 0; }
 
 	// Implement vtHeightField methods
@@ -13,6 +13,7 @@
 #include <wchar.h>
 #include <fstream>
 #include <memory>	// for auto_ptr
+#include <vector>
 using namespace std;
 
 #include "config_vtdata.h"
@@ -22,6 +23,7 @@ using namespace std;
 #include "ByteOrder.h"
 #include "vtString.h"
 #include "FilePath.h"
+#include "Unarchive.h"
 
 // Headers for PNG support, which uses the library "libpng"
 #include "png.h"
@@ -65,7 +67,8 @@ typedef struct
 
 /**
  * Load from a file whose type is not known a priori.  This will end up
- * calling one of the Load* member functions.
+ * calling one of the Load* member functions.  The file may also be a member
+ * of an archive, given by its GDAL virtual path (see vtArchive).
  *
  * You should call SetupLocalCS() after loading if you will be doing
  * heightfield operations on this grid.
@@ -84,6 +87,11 @@ bool vtElevationGrid::LoadFromFile(const char *szFileName,
 		return false;
 	}
 
+	// A member of an archive can't be opened like a file, but GDAL reads it
+	//  where it is, and reads all the formats below.
+	if (vtIsVirtualPath(szFileName))
+		return LoadWithGDAL(szFileName, progress_callback, err);
+
 	// The first character in the file is useful for telling which format
 	// the file really is.
 	FILE *fp = vtFileOpen(szFileName, "rb");
@@ -236,6 +244,266 @@ bool vtElevationGrid::LoadFrom3TX(const char *szFileName,
 }
 
 
+///////////////////////////////////////////////////////////////////////
+// Fast parsing of the text formats (ASC, DSAA and XYZ)
+//
+// The file is mapped into memory and split at line breaks into chunks,
+//  which are parsed on several threads.  Numbers are parsed by hand, which
+//  is much faster than scanf, and doesn't depend on the locale.
+
+bool vtElevationGrid::s_bMapTextFiles = true;
+
+// Size of the pieces a text file is split into, for parsing in parallel
+#define TEXT_CHUNK_SIZE	(4 * 1024 * 1024)
+
+static size_t CountNumbers(const char *p, const char *end)
+{
+	size_t count = 0;
+	bool bInNumber = false;
+	for (; p < end; p++)
+	{
+		const bool bSeparator = vtIsTextSeparator(*p);
+		if (!bSeparator && !bInNumber)
+			count++;
+		bInNumber = !bSeparator;
+	}
+	return count;
+}
+
+/**
+ * Parse the values of a text grid (ASC or DSAA), which are given a row at a
+ * time, straight into a grid which has already been allocated.  Values which
+ * are 'nodata', or outside the range fMin to fMax, become INVALID_ELEVATION.
+ *
+ * \param bTopFirst True if the first row in the text is the top (north) row.
+ */
+static bool ParseTextGrid(vtElevationGrid *grid, const char *begin, const char *end,
+	bool bTopFirst, bool bHasNoData, double nodata, double fMin, double fMax,
+	bool progress_callback(int))
+{
+	int iColumns, iRows;
+	grid->GetDimensions(iColumns, iRows);
+	const size_t total = (size_t) iColumns * iRows;
+
+	std::vector<const char *> bounds;
+	vtSplitLines(begin, end, TEXT_CHUNK_SIZE, bounds);
+	const int chunks = (int) bounds.size() - 1;
+
+	// Count the values in each chunk, to know the index of each one's first
+	std::vector<size_t> first(chunks + 1, 0);
+	#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < chunks; c++)
+		first[c + 1] = CountNumbers(bounds[c], bounds[c + 1]);
+	for (int c = 0; c < chunks; c++)
+		first[c + 1] += first[c];
+	if (first[chunks] < total)
+	{
+		VTLOG("Grid has %.0f values, expected %.0f.\n", (double) first[chunks], (double) total);
+		return false;
+	}
+	if (progress_callback != NULL && progress_callback(5))
+		return false;
+
+	int iDone = 0;
+	vtThreadFlag failed, cancel;
+	#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < chunks; c++)
+	{
+		if (failed.IsSet() || cancel.IsSet() || first[c] >= total)
+			continue;
+
+		const char *p = bounds[c];
+		const size_t last = (first[c + 1] < total) ? first[c + 1] : total;
+		double value;
+		for (size_t index = first[c]; index < last; index++)
+		{
+			if (!vtParseNumber(p, bounds[c + 1], value))
+			{
+				failed.Set();
+				break;
+			}
+			const int row = (int) (index / iColumns);
+			const int x = (int) (index % iColumns);
+			const int y = bTopFirst ? iRows - 1 - row : row;
+			const float z = (float) value;
+			if ((bHasNoData && z == nodata) || z < fMin || z > fMax)
+				grid->SetFValue(x, y, INVALID_ELEVATION);
+			else
+				grid->SetFValue(x, y, z);
+		}
+		const int iCount = vtAtomicIncrement(iDone);
+
+		if (progress_callback != NULL && vtIsFirstThread())
+		{
+			if (progress_callback(5 + iCount * 95 / chunks))
+				cancel.Set();
+		}
+	}
+	if (failed.IsSet())
+		VTLOG1("Couldn't parse a value in the grid.\n");
+	return !failed.IsSet() && !cancel.IsSet();
+}
+
+// Parse one line of an XYZ file, whose columns are given by a pattern such
+//  as "n x y z", and move to the start of the next line.
+static bool ParseXYZLine(const char *&p, const char *end, const char *pattern,
+	double &x, double &y, double &z)
+{
+	const char *eol = p;
+	while (eol < end && *eol != '\n')
+		eol++;
+
+	bool bOK = true;
+	double n;
+	for (const char *c = pattern; *c && bOK; c++)
+	{
+		switch (*c)
+		{
+		case 'n': bOK = vtParseNumber(p, eol, n); break;
+		case 'x': bOK = vtParseNumber(p, eol, x); break;
+		case 'y': bOK = vtParseNumber(p, eol, y); break;
+		case 'z': bOK = vtParseNumber(p, eol, z); break;
+		}
+	}
+	p = (eol < end) ? eol + 1 : end;
+	return bOK;
+}
+
+/**
+ * Load a grid from the text of an XYZ file, in parallel.  Lines which don't
+ * have all the values of the pattern, such as blank lines, are skipped.
+ */
+static bool ParseXYZText(vtElevationGrid *grid, const char *begin, const char *end,
+	const char *pattern, bool progress_callback(int))
+{
+	// Look at the first two points
+	const char *p = begin;
+	DPoint2 testp[2];
+	bool bInteger = true;
+	int found = 0;
+	while (found < 2 && p < end)
+	{
+		double x, y, z;
+		if (!ParseXYZLine(p, end, pattern, x, y, z))
+			continue;
+		testp[found++].Set(x, y);
+
+		// Try to guess if the data is integer or floating point
+		if ((int)z != z)
+			bInteger = false;
+	}
+	if (found < 2)
+		return false;
+
+	// Compare them and decide whether we are row or column order
+	bool bColumnOrder;
+	DPoint2 diff = testp[1] - testp[0];
+	if (diff.x == 0)
+		bColumnOrder = true;
+	else if (diff.y == 0)
+		bColumnOrder = false;
+	else
+	{
+		VTLOG("Can't determine if file is row-first or column-first.\n");
+		return false;
+	}
+
+	// The first pass collects the extents and number of points
+	std::vector<const char *> bounds;
+	vtSplitLines(begin, end, TEXT_CHUNK_SIZE, bounds);
+	const int chunks = (int) bounds.size() - 1;
+
+	std::vector<DRECT> chunk_extents(chunks);
+	std::vector<int> chunk_points(chunks, 0);
+	#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < chunks; c++)
+	{
+		DRECT ext;
+		ext.SetInsideOut();
+		int num = 0;
+		const char *q = bounds[c];
+		double x, y, z;
+		while (q < bounds[c + 1])
+		{
+			if (!ParseXYZLine(q, bounds[c + 1], pattern, x, y, z))
+				continue;
+			ext.GrowToContainPoint(DPoint2(x, y));
+			num++;
+		}
+		chunk_extents[c] = ext;
+		chunk_points[c] = num;
+	}
+	DRECT extents;
+	extents.SetInsideOut();
+	int iNum = 0;
+	for (int c = 0; c < chunks; c++)
+	{
+		if (chunk_points[c] == 0)
+			continue;
+		extents.GrowToContainPoint(DPoint2(chunk_extents[c].left, chunk_extents[c].bottom));
+		extents.GrowToContainPoint(DPoint2(chunk_extents[c].right, chunk_extents[c].top));
+		iNum += chunk_points[c];
+	}
+	if (progress_callback != NULL && progress_callback(50))
+		return false;
+
+	// Depending on order, convert extents to grid dimensions
+	int iColumns, iRows;
+	if (bColumnOrder)
+	{
+		// column-first ordering
+		double est = extents.Height() / fabs(diff.y);
+		int rounded = (int) (est + 0.5);	// round to nearest
+		iRows = rounded + 1;
+		iColumns = iNum / iRows;
+	}
+	else
+	{
+		// row-first ordering
+		double est = extents.Width() / fabs(diff.x);
+		int rounded = (int) (est + 0.5);	// round to nearest
+		iColumns = rounded + 1;
+		iRows = iNum / iColumns;
+	}
+
+	// Create the grid, then go back and read all the points
+	vtProjection unknown;
+	if (!grid->Create(extents, IPoint2(iColumns, iRows), !bInteger, unknown))
+		return false;
+
+	const DPoint2 base(extents.left, extents.bottom);
+	const DPoint2 spacing = grid->GetSpacing();
+
+	int iDone = 0;
+	vtThreadFlag cancel;
+	#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < chunks; c++)
+	{
+		if (cancel.IsSet())
+			continue;
+		const char *q = bounds[c];
+		double x, y, z;
+		while (q < bounds[c + 1])
+		{
+			if (!ParseXYZLine(q, bounds[c + 1], pattern, x, y, z))
+				continue;
+			const int xpos = (int) ((x - base.x) / spacing.x + 0.5);	// round to nearest
+			const int ypos = (int) ((y - base.y) / spacing.y + 0.5);
+			if (xpos >= 0 && xpos < iColumns && ypos >= 0 && ypos < iRows)
+				grid->SetFValue(xpos, ypos, (float) z);
+		}
+		const int iCount = vtAtomicIncrement(iDone);
+
+		if (progress_callback != NULL && vtIsFirstThread())
+		{
+			if (progress_callback(50 + iCount * 50 / chunks))
+				cancel.Set();
+		}
+	}
+	return !cancel.IsSet();
+}
+
+
 /** Loads from a Arc/Info compatible ASCII grid file.
  * Projection is read from a corresponding .prj file.
  *
@@ -341,6 +609,18 @@ bool vtElevationGrid::LoadFromASC(const char *szFileName,
 	if (!AllocateGrid())
 		return false;
 
+	// Parse the values straight from memory, if we can
+	vtMappedFile mapped;
+	const long data_start = ftell(fp);
+	if (s_bMapTextFiles && data_start > 0 && mapped.Open(szFileName) &&
+		(size_t) data_start < mapped.GetSize())
+	{
+		fclose(fp);
+		const char *data = mapped.GetData();
+		return ParseTextGrid(this, data + data_start, data + mapped.GetSize(),
+			true, true, nodata, -1E6, 1E6, progress_callback);
+	}
+
 	int i, j;
 	float z;
 	for (i = 0; i < nrows; i++)
@@ -998,7 +1278,7 @@ bool vtElevationGrid::LoadFromDSAA(const char* szFileName, bool progress_callbac
 	// Free buffers to prepare to receive new data
 	FreeData();
 
-	FILE *fp = vtFileOpen(szFileName, "rt");
+	FILE *fp = vtFileOpen(szFileName, "rb");
 	if (!fp)
 		return false;
 
@@ -1029,6 +1309,18 @@ bool vtElevationGrid::LoadFromDSAA(const char* szFileName, bool progress_callbac
 	if (!AllocateGrid())
 		return false;
 
+	// Parse the values straight from memory, if we can
+	vtMappedFile mapped;
+	const long data_start = ftell(fp);
+	if (s_bMapTextFiles && data_start > 0 && mapped.Open(szFileName) &&
+		(size_t) data_start < mapped.GetSize())
+	{
+		fclose(fp);
+		const char *data = mapped.GetData();
+		return ParseTextGrid(this, data + data_start, data + mapped.GetSize(),
+			false, false, 0, zlo, zhi, progress_callback);
+	}
+
 	float z;
 	for (int y = 0; y < ny; y++)
 	{
@@ -2370,6 +2662,16 @@ bool vtElevationGrid::LoadFromXYZ(const char *szFileName, bool progress_callback
 		fclose(fp);
 		return false;
 	}
+
+	// Parse the points straight from memory, if we can
+	vtMappedFile mapped;
+	if (s_bMapTextFiles && mapped.Open(szFileName))
+	{
+		fclose(fp);
+		const char *data = mapped.GetData();
+		return ParseXYZText(this, data, data + mapped.GetSize(), pattern,
+			progress_callback);
+	}
 	bool success = LoadFromXYZ(fp, pattern, progress_callback);
 	fclose(fp);
 	return success;
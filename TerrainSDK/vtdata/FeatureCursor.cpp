@@ -0,0 +1,391 @@
+//
+// FeatureCursor.cpp
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include <string.h>
+#include <algorithm>
+
+#include "FeatureCursor.h"
+#include "FilePath.h"
+#include "vtLog.h"
+
+
+vtFeatureCursor::vtFeatureCursor()
+{
+	m_hSHP = NULL;
+	m_hDBF = NULL;
+	m_iShapeType = SHPT_NULL;
+	m_iRecords = 0;
+	m_bFilter = false;
+	m_bIndexed = false;
+	m_iNext = 0;
+}
+
+vtFeatureCursor::~vtFeatureCursor()
+{
+	Close();
+}
+
+/**
+ * Open a Shapefile for reading.  Its attributes (.dbf) are read too, if
+ * there are any; by default, all the columns are read.
+ *
+ * \param filename The .shp file, in UTF-8 encoding.
+ * \return true if successful.
+ */
+bool vtFeatureCursor::Open(const char *filename)
+{
+	Close();
+
+	// SHPOpen doesn't yet support utf-8 or wide filenames, so convert
+	vtString fname_local = UTF8ToLocal(filename);
+
+	m_hSHP = SHPOpen(fname_local, "rb");
+	if (m_hSHP == NULL)
+	{
+		VTLOG("vtFeatureCursor: couldn't open '%s'\n", filename);
+		return false;
+	}
+	SHPGetInfo(m_hSHP, &m_iRecords, &m_iShapeType, NULL, NULL);
+	m_strFilename = filename;
+
+	m_hDBF = DBFOpen(UTF8ToLocal(MakeDBFName(filename)), "rb");
+	if (m_hDBF != NULL)
+	{
+		for (int i = 0; i < DBFGetFieldCount(m_hDBF); i++)
+			m_Fields.push_back(i);
+	}
+	VTLOG("vtFeatureCursor: '%s', %d records of type %s\n", filename, m_iRecords,
+		(const char *) GetShapeTypeName(m_iShapeType));
+	return true;
+}
+
+void vtFeatureCursor::Close()
+{
+	if (m_hDBF != NULL)
+		DBFClose(m_hDBF);
+	if (m_hSHP != NULL)
+		SHPClose(m_hSHP);
+	m_hSHP = NULL;
+	m_hDBF = NULL;
+	m_iRecords = 0;
+	m_Fields.clear();
+	m_bFilter = false;
+	m_bIndexed = false;
+	m_Candidates.clear();
+	m_iNext = 0;
+	m_BatchRecords.clear();
+}
+
+/**
+ * Read only these attribute columns.  Names are not case-sensitive, and
+ * names which the file doesn't have are ignored.  Call before
+ * CreateFeatureSet.
+ */
+void vtFeatureCursor::SelectFields(const vtStringArray &names)
+{
+	m_Fields.clear();
+	if (m_hDBF == NULL)
+		return;
+
+	int iWidth, iDecimals;
+	char szFieldName[80];
+	for (int i = 0; i < DBFGetFieldCount(m_hDBF); i++)
+	{
+		DBFGetFieldInfo(m_hDBF, i, szFieldName, &iWidth, &iDecimals);
+		for (uint j = 0; j < names.size(); j++)
+		{
+			if (!names[j].CompareNoCase(szFieldName))
+			{
+				m_Fields.push_back(i);
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * Read only the shapes whose extents overlap this rectangle.  If the file
+ * has a spatial index, only the shapes it suggests are read from the file.
+ * This rewinds the cursor.
+ */
+void vtFeatureCursor::SetFilter(const DRECT &rect)
+{
+	m_bFilter = true;
+	m_Filter = rect;
+	m_iNext = 0;
+	_ReadIndex();
+}
+
+/**
+ * Make an empty featureset to receive batches from this file, of the right
+ * geometry type and with the selected fields.  Returns NULL if the shape
+ * type is not supported.
+ */
+vtFeatureSet *vtFeatureCursor::CreateFeatureSet() const
+{
+	vtFeatureSet *pSet = NULL;
+	switch (m_iShapeType)
+	{
+	case SHPT_POINT:
+		pSet = new vtFeatureSetPoint2D;
+		break;
+	case SHPT_POINTZ:
+		pSet = new vtFeatureSetPoint3D;
+		break;
+	case SHPT_ARC:
+		pSet = new vtFeatureSetLineString;
+		break;
+	case SHPT_ARCZ:
+		pSet = new vtFeatureSetLineString3D;
+		break;
+	case SHPT_POLYGON:
+	case SHPT_POLYGONZ:
+		pSet = new vtFeatureSetPolygon;
+		break;
+	default:
+		return NULL;
+	}
+	pSet->SetFilename(m_strFilename);
+	pSet->GetAtProjection().ReadProjFile(m_strFilename);
+
+	int iWidth, iDecimals;
+	char szFieldName[80];
+	for (uint i = 0; i < m_Fields.size(); i++)
+	{
+		DBFFieldType fieldtype = DBFGetFieldInfo(m_hDBF, m_Fields[i],
+			szFieldName, &iWidth, &iDecimals);
+		pSet->AddField(szFieldName, ConvertFieldType(fieldtype), iWidth);
+	}
+	return pSet;
+}
+
+/**
+ * Read the next batch of features.  The featureset's previous features are
+ * replaced.  Shapes with no vertices are skipped; a line with several parts
+ * becomes a feature for each part.
+ *
+ * \param pSet A featureset made with CreateFeatureSet.
+ * \param iMaxFeatures The most features to read.
+ * \return The number of features read; 0 when there are no more.
+ */
+uint vtFeatureCursor::ReadBatch(vtFeatureSet *pSet, uint iMaxFeatures)
+{
+	// Must use "C" locale in case we read any floating-point fields
+	ScopedLocale normal_numbers(LC_NUMERIC, "C");
+
+	pSet->SetNumEntities(0);
+	m_BatchRecords.clear();
+	if (m_hSHP == NULL)
+		return 0;
+
+	int iRecord;
+	while (pSet->NumEntities() < iMaxFeatures && (iRecord = _NextRecord()) != -1)
+	{
+		SHPObject *pObj = SHPReadObject(m_hSHP, iRecord);
+		if (!pObj)
+			continue;
+
+		if (m_bFilter && (pObj->dfXMax < m_Filter.left ||
+			pObj->dfXMin > m_Filter.right ||
+			pObj->dfYMax < m_Filter.bottom ||
+			pObj->dfYMin > m_Filter.top))
+		{
+			SHPDestroyObject(pObj);
+			continue;
+		}
+
+		const uint first = pSet->NumEntities();
+		_AddGeometry(pSet, pObj);
+		SHPDestroyObject(pObj);
+
+		for (uint i = first; i < pSet->NumEntities(); i++)
+		{
+			m_BatchRecords.push_back(iRecord);
+			_ReadAttributes(pSet, i, iRecord);
+		}
+	}
+	return pSet->NumEntities();
+}
+
+/** How far the cursor is through the file, from 0 to 100. */
+int vtFeatureCursor::GetProgress() const
+{
+	if (m_bIndexed)
+		return m_Candidates.empty() ? 100 : m_iNext * 100 / m_Candidates.size();
+	return m_iRecords == 0 ? 100 : m_iNext * 100 / m_iRecords;
+}
+
+int vtFeatureCursor::_NextRecord()
+{
+	if (m_bIndexed)
+		return (m_iNext < m_Candidates.size()) ? m_Candidates[m_iNext++] : -1;
+	return ((int) m_iNext < m_iRecords) ? (int) m_iNext++ : -1;
+}
+
+void vtFeatureCursor::_AddGeometry(vtFeatureSet *pSet, SHPObject *pObj) const
+{
+	if (pObj->nVertices == 0)
+		return;
+
+	vtFeatureSetPoint2D *pSetP2 = dynamic_cast<vtFeatureSetPoint2D *>(pSet);
+	vtFeatureSetPoint3D *pSetP3 = dynamic_cast<vtFeatureSetPoint3D *>(pSet);
+	vtFeatureSetLineString *pSetLine = dynamic_cast<vtFeatureSetLineString *>(pSet);
+	vtFeatureSetLineString3D *pSetLine3 = dynamic_cast<vtFeatureSetLineString3D *>(pSet);
+	vtFeatureSetPolygon *pSetPoly = dynamic_cast<vtFeatureSetPolygon *>(pSet);
+
+	if (pSetP2)
+		pSetP2->AddPoint(DPoint2(pObj->padfX[0], pObj->padfY[0]));
+	else if (pSetP3)
+		pSetP3->AddPoint(DPoint3(pObj->padfX[0], pObj->padfY[0], pObj->padfZ[0]));
+	else if (pSetLine)
+	{
+		DLine2 dline;
+		for (int part = 0; part < pObj->nParts; part++)
+		{
+			int start = pObj->panPartStart[part], end;
+			if (part+1 < pObj->nParts)
+				end = pObj->panPartStart[part+1]-1;
+			else
+				end = pObj->nVertices-1;
+
+			dline.SetSize(end - start + 1);
+			for (int j = start; j <= end; j++)
+				dline.SetAt(j-start, DPoint2(pObj->padfX[j], pObj->padfY[j]));
+			pSetLine->AddPolyLine(dline);
+		}
+	}
+	else if (pSetLine3)
+	{
+		DLine3 dline;
+		dline.SetSize(pObj->nVertices);
+		for (int j = 0; j < pObj->nVertices; j++)
+			dline.SetAt(j, DPoint3(pObj->padfX[j], pObj->padfY[j], pObj->padfZ[j]));
+		pSetLine3->AddPolyLine(dline);
+	}
+	else if (pSetPoly)
+	{
+		DPolygon2 dpoly;
+		if (SHPToDPolygon2(pObj, dpoly))
+			pSetPoly->AddPolygon(dpoly);
+	}
+}
+
+void vtFeatureCursor::_ReadAttributes(vtFeatureSet *pSet, uint iFeature,
+									  int iRecord) const
+{
+	if (m_hDBF == NULL || iRecord >= DBFGetRecordCount(m_hDBF))
+		return;
+
+	for (uint iField = 0; iField < m_Fields.size(); iField++)
+	{
+		const int iColumn = m_Fields[iField];
+		switch (pSet->GetField(iField)->m_type)
+		{
+		case FT_String:
+			pSet->SetValue(iFeature, iField, DBFReadStringAttribute(m_hDBF, iRecord, iColumn));
+			break;
+		case FT_Integer:
+			pSet->SetValue(iFeature, iField, DBFReadIntegerAttribute(m_hDBF, iRecord, iColumn));
+			break;
+		case FT_Double:
+			pSet->SetValue(iFeature, iField, DBFReadDoubleAttribute(m_hDBF, iRecord, iColumn));
+			break;
+		case FT_Boolean:
+			pSet->SetValue(iFeature, iField, DBFReadLogicalAttribute(m_hDBF, iRecord, iColumn));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/**
+ * Look for a quadtree spatial index (.qix, as written by shptree or
+ * ogr2ogr -lco SPATIAL_INDEX=YES) and find the shapes it says might
+ * overlap the filter.
+ */
+bool vtFeatureCursor::_ReadIndex()
+{
+	m_bIndexed = false;
+	m_Candidates.clear();
+
+	vtString qixname = m_strFilename.Left(m_strFilename.GetLength() - 4) + ".qix";
+	FILE *fp = vtFileOpen(qixname, "rb");
+	if (!fp)
+		return false;
+
+	// The header is "SQT", the byte order (1 = LSB, 2 = MSB), a version,
+	//  3 reserved bytes, then the number of shapes and the tree depth.
+	uchar header[16];
+	if (fread(header, 16, 1, fp) != 1 || strncmp((const char *) header, "SQT", 3) != 0)
+	{
+		fclose(fp);
+		return false;
+	}
+	ByteOrder order = BO_MACHINE;
+	if (header[3] == 1)
+		order = BO_LITTLE_ENDIAN;
+	else if (header[3] == 2)
+		order = BO_BIG_ENDIAN;
+
+	bool success = _SearchIndexNode(fp, order);
+	fclose(fp);
+	if (!success)
+	{
+		VTLOG("vtFeatureCursor: couldn't read index '%s'\n", (const char *) qixname);
+		m_Candidates.clear();
+		return false;
+	}
+	std::sort(m_Candidates.begin(), m_Candidates.end());
+	m_Candidates.erase(std::unique(m_Candidates.begin(), m_Candidates.end()),
+		m_Candidates.end());
+
+	// Beware of an index which is out of date with the file
+	while (!m_Candidates.empty() && m_Candidates.back() >= m_iRecords)
+		m_Candidates.pop_back();
+
+	m_bIndexed = true;
+	VTLOG("vtFeatureCursor: index gives %d of %d records\n",
+		(int) m_Candidates.size(), m_iRecords);
+	return true;
+}
+
+bool vtFeatureCursor::_SearchIndexNode(FILE *fp, ByteOrder order)
+{
+	// Each node is: the size of its subnodes in bytes, its extents (xmin,
+	//  ymin, xmax, ymax), its shapes (count, ids), then its subnodes (count,
+	//  nodes).
+	int offset, count, subnodes;
+	double bounds[4];
+	if (FRead(&offset, DT_INT, 1, fp, order) != 1 ||
+		FRead(bounds, DT_DOUBLE, 4, fp, order) != 4 ||
+		FRead(&count, DT_INT, 1, fp, order) != 1 ||
+		count < 0)
+		return false;
+
+	if (bounds[2] < m_Filter.left || bounds[0] > m_Filter.right ||
+		bounds[3] < m_Filter.bottom || bounds[1] > m_Filter.top)
+	{
+		// Skip the whole node
+		return fseek(fp, offset + count * 4 + 4, SEEK_CUR) == 0;
+	}
+	if (count > 0)
+	{
+		const size_t first = m_Candidates.size();
+		m_Candidates.resize(first + count);
+		if (FRead(&m_Candidates[first], DT_INT, count, fp, order) != (size_t) count)
+			return false;
+	}
+	if (FRead(&subnodes, DT_INT, 1, fp, order) != 1)
+		return false;
+	for (int i = 0; i < subnodes; i++)
+	{
+		if (!_SearchIndexNode(fp, order))
+			return false;
+	}
+	return true;
+}
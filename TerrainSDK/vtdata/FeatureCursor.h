@@ -0,0 +1,96 @@
+//
+// FeatureCursor.h
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#ifndef FEATURECURSORH
+#define FEATURECURSORH
+
+#include <vector>
+
+#include "ByteOrder.h"
+#include "Features.h"
+
+/**
+ * Reads a Shapefile a batch of features at a time, so that files much
+ * larger than memory can be processed.  Only one batch is held in memory.
+ *
+ * Each batch is a vtFeatureSet of the file's geometry type, with the
+ * attribute columns you select.  Optionally, only the shapes which overlap
+ * a rectangle are read; if there is a spatial index (.qix) beside the file,
+ * it is used to read only the shapes which might overlap.
+ *
+ * \par Example:
+	\code
+	vtFeatureCursor cursor;
+	if (cursor.Open("parcels.shp"))
+	{
+		vtStringArray names;
+		names.push_back("owner");
+		cursor.SelectFields(names);
+		cursor.SetFilter(area);
+		vtFeatureSet *batch = cursor.CreateFeatureSet();
+		while (cursor.ReadBatch(batch) > 0)
+		{
+			[...]
+		}
+		delete batch;
+	}
+	\endcode
+ */
+class vtFeatureCursor
+{
+public:
+	vtFeatureCursor();
+	~vtFeatureCursor();
+
+	bool Open(const char *filename);
+	void Close();
+
+	void SelectFields(const vtStringArray &names);
+	void SetFilter(const DRECT &rect);
+	/// True if the filter is using a spatial index.
+	bool UsingIndex() const { return m_bIndexed; }
+
+	/// The Shapelib shape type of the file, such as SHPT_POLYGON.
+	int GetShapeType() const { return m_iShapeType; }
+	/// The number of records in the file, before filtering.
+	int NumRecords() const { return m_iRecords; }
+
+	vtFeatureSet *CreateFeatureSet() const;
+	uint ReadBatch(vtFeatureSet *pSet, uint iMaxFeatures = 4096);
+	/// The record in the file which a feature of the last batch came from.
+	int GetRecord(uint iFeature) const { return m_BatchRecords[iFeature]; }
+	/// Rewind to the first record.
+	void Reset() { m_iNext = 0; }
+	int GetProgress() const;
+
+protected:
+	int _NextRecord();
+	void _AddGeometry(vtFeatureSet *pSet, SHPObject *pObj) const;
+	void _ReadAttributes(vtFeatureSet *pSet, uint iFeature, int iRecord) const;
+	bool _ReadIndex();
+	bool _SearchIndexNode(FILE *fp, ByteOrder order);
+
+	vtString m_strFilename;
+	SHPHandle m_hSHP;
+	DBFHandle m_hDBF;
+	int m_iShapeType;
+	int m_iRecords;
+
+	// The DBF columns to read
+	std::vector<int> m_Fields;
+
+	bool m_bFilter;
+	DRECT m_Filter;
+	bool m_bIndexed;
+	std::vector<int> m_Candidates;	// records from the index, ascending
+
+	// The next record, or the next candidate if using the index
+	uint m_iNext;
+	std::vector<int> m_BatchRecords;
+};
+
+#endif // FEATURECURSORH
@@ -12,6 +12,51 @@
 #include "DLG.h"
 
 
+/**
+ * Coordinates gathered into contiguous buffers, so they can be transformed
+ * in bulk, then scattered back in the same order.
+ */
+class CoordBuffer
+{
+public:
+	CoordBuffer(uint iSize) : m_iNext(0)
+	{
+		m_x.reserve(iSize);
+		m_y.reserve(iSize);
+	}
+	template <class P> void Put(const P &p)
+	{
+		m_x.push_back(p.x);
+		m_y.push_back(p.y);
+	}
+	template <class P> void Get(P &p)
+	{
+		p.x = m_x[m_iNext];
+		p.y = m_y[m_iNext];
+		m_iNext++;
+	}
+	uint Size() const { return (uint) m_x.size(); }
+	int Transform(OCTransform *pTransform, bool progress_callback(int))
+	{
+		if (m_x.empty())
+			return 0;
+		return TransformPoints(pTransform, Size(), &m_x.front(), &m_y.front(),
+			progress_callback);
+	}
+
+protected:
+	std::vector<double> m_x, m_y;
+	uint m_iNext;
+};
+
+static bool ReportTransform(int bad, uint size)
+{
+	if (bad)
+		VTLOG("Warning: %d of %d coordinates did not transform correctly.\n", bad, size);
+	return (bad == 0);
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 // vtFeatureSetPoint2D
 //
@@ -62,19 +107,14 @@ void vtFeatureSetPoint2D::Offset(const DPoint2 &p, bool bSelectedOnly)
 
 bool vtFeatureSetPoint2D::TransformCoords(OCTransform *pTransform, bool progress_callback(int))
 {
-	uint i, bad = 0, size = m_Point2.GetSize();
+	uint i, size = m_Point2.GetSize();
+	CoordBuffer buf(size);
 	for (i = 0; i < size; i++)
-	{
-		if (progress_callback != NULL && (i%200)==0)
-			progress_callback(i * 99 / size);
-
-		int success = pTransform->Transform(1, &m_Point2[i].x, &m_Point2[i].y);
-		if (success != 1)
-			bad++;
-	}
-	if (bad)
-		VTLOG("Warning: %d of %d coordinates did not transform correctly.\n", bad, size);
-	return (bad == 0);
+		buf.Put(m_Point2[i]);
+	int bad = buf.Transform(pTransform, progress_callback);
+	for (i = 0; i < size; i++)
+		buf.Get(m_Point2[i]);
+	return ReportTransform(bad, buf.Size());
 }
 
 bool vtFeatureSetPoint2D::AppendGeometryFrom(vtFeatureSet *pFromSet)
@@ -267,19 +307,14 @@ void vtFeatureSetPoint3D::Offset(const DPoint2 &p, bool bSelectedOnly)
 
 bool vtFeatureSetPoint3D::TransformCoords(OCTransform *pTransform, bool progress_callback(int))
 {
-	uint i, bad = 0, size = m_Point3.GetSize();
+	uint i, size = m_Point3.GetSize();
+	CoordBuffer buf(size);
 	for (i = 0; i < size; i++)
-	{
-		if (progress_callback != NULL && (i%200)==0)
-			progress_callback(i * 99 / size);
-
-		int success = pTransform->Transform(1, &m_Point3[i].x, &m_Point3[i].y);
-		if (success != 1)
-			bad++;
-	}
-	if (bad)
-		VTLOG("Warning: %d of %d coordinates did not transform correctly.\n", bad, size);
-	return (bad == 0);
+		buf.Put(m_Point3[i]);
+	int bad = buf.Transform(pTransform, progress_callback);
+	for (i = 0; i < size; i++)
+		buf.Get(m_Point3[i]);
+	return ReportTransform(bad, buf.Size());
 }
 
 bool vtFeatureSetPoint3D::AppendGeometryFrom(vtFeatureSet *pFromSet)
@@ -443,25 +478,16 @@ void vtFeatureSetLineString::Offset(const DPoint2 &p, bool bSelectedOnly)
 
 bool vtFeatureSetLineString::TransformCoords(OCTransform *pTransform, bool progress_callback(int))
 {
-	uint i, j, pts, bad = 0, size = m_Line.size();
+	uint i, j, size = m_Line.size();
+	CoordBuffer buf(NumTotalVertices());
 	for (i = 0; i < size; i++)
-	{
-		if (progress_callback != NULL && (i%200)==0)
-			progress_callback(i * 99 / size);
-
-		DLine2 &dline = m_Line[i];
-		pts = dline.GetSize();
-		for (j = 0; j < pts; j++)
-		{
-			DPoint2 &p = dline[j];
-			int success = pTransform->Transform(1, &p.x, &p.y);
-			if (success != 1)
-				bad++;
-		}
-	}
-	if (bad)
-		VTLOG("Warning: %d of %d coordinates did not transform correctly.\n", bad, size);
-	return (bad == 0);
+		for (j = 0; j < m_Line[i].GetSize(); j++)
+			buf.Put(m_Line[i][j]);
+	int bad = buf.Transform(pTransform, progress_callback);
+	for (i = 0; i < size; i++)
+		for (j = 0; j < m_Line[i].GetSize(); j++)
+			buf.Get(m_Line[i][j]);
+	return ReportTransform(bad, buf.Size());
 }
 
 bool vtFeatureSetLineString::AppendGeometryFrom(vtFeatureSet *pFromSet)
@@ -697,25 +723,16 @@ void vtFeatureSetLineString3D::Offset(const DPoint2 &p, bool bSelectedOnly)
 
 bool vtFeatureSetLineString3D::TransformCoords(OCTransform *pTransform, bool progress_callback(int))
 {
-	uint i, j, pts, bad = 0, size = m_Line.size();
+	uint i, j, size = m_Line.size();
+	CoordBuffer buf(NumTotalVertices());
 	for (i = 0; i < size; i++)
-	{
-		if (progress_callback != NULL && (i%200)==0)
-			progress_callback(i * 99 / size);
-
-		DLine3 &dline = m_Line[i];
-		pts = dline.GetSize();
-		for (j = 0; j < pts; j++)
-		{
-			DPoint3 &p = dline[j];
-			int success = pTransform->Transform(1, &p.x, &p.y);
-			if (success != 1)
-				bad++;
-		}
-	}
-	if (bad)
-		VTLOG("Warning: %d of %d coordinates did not transform correctly.\n", bad, size);
-	return (bad == 0);
+		for (j = 0; j < m_Line[i].GetSize(); j++)
+			buf.Put(m_Line[i][j]);
+	int bad = buf.Transform(pTransform, progress_callback);
+	for (i = 0; i < size; i++)
+		for (j = 0; j < m_Line[i].GetSize(); j++)
+			buf.Get(m_Line[i][j]);
+	return ReportTransform(bad, buf.Size());
 }
 
 bool vtFeatureSetLineString3D::AppendGeometryFrom(vtFeatureSet *pFromSet)
@@ -948,29 +965,26 @@ void vtFeatureSetPolygon::Offset(const DPoint2 &p, bool bSelectedOnly)
 
 bool vtFeatureSetPolygon::TransformCoords(OCTransform *pTransform, bool progress_callback(int))
 {
-	uint i, j, k, pts, bad = 0, size = m_Poly.size();
+	uint i, j, k, size = m_Poly.size();
+	CoordBuffer buf(NumTotalVertices());
 	for (i = 0; i < size; i++)
-	{
-		if (progress_callback != NULL && (i%200)==0)
-			progress_callback(i * 99 / size);
+		for (j = 0; j < m_Poly[i].size(); j++)
+			for (k = 0; k < m_Poly[i][j].GetSize(); k++)
+				buf.Put(m_Poly[i][j][k]);
+	int bad = buf.Transform(pTransform, progress_callback);
+	for (i = 0; i < size; i++)
+		for (j = 0; j < m_Poly[i].size(); j++)
+			for (k = 0; k < m_Poly[i][j].GetSize(); k++)
+				buf.Get(m_Poly[i][j][k]);
+	return ReportTransform(bad, buf.Size());
+}
 
-		DPolygon2 &dpoly = m_Poly[i];
-		for (j = 0; j < dpoly.size(); j++)
-		{
-			DLine2 &dline = dpoly[j];
-			pts = dline.GetSize();
-			for (k = 0; k < pts; k++)
-			{
-				DPoint2 &p = dline[k];
-				int success = pTransform->Transform(1, &p.x, &p.y);
-				if (success != 1)
-					bad++;
-			}
-		}
-	}
-	if (bad)
-		VTLOG("Warning: %d of %d coordinates did not transform correctly.\n", bad, size);
-	return (bad == 0);
+int vtFeatureSetPolygon::NumTotalVertices() const
+{
+	int total = 0;
+	for (uint i = 0; i < m_Poly.size(); i++)
+		total += m_Poly[i].NumTotalVertices();
+	return total;
 }
 
 bool vtFeatureSetPolygon::AppendGeometryFrom(vtFeatureSet *pFromSet)
@@ -9,6 +9,7 @@
 #include "vtLog.h"
 #include "DxfParser.h"
 #include "FilePath.h"
+#include "Unarchive.h"
 
 //
 // Construct / Destruct
@@ -277,6 +278,11 @@ vtFeatureSet *vtFeatureLoader::LoadFromSHP(const char *filename, bool progress_c
 {
 	VTLOG(" FeatureLoader LoadFromSHP\n");
 
+	// Shapelib can only open real files, but OGR can read a shapefile (and
+	//  its .shx, .dbf and .prj) from inside an archive.
+	if (vtIsVirtualPath(filename))
+		return LoadWithOGR(filename, progress_callback);
+
 	// SHPOpen doesn't yet support utf-8 or wide filenames, so convert
 	vtString fname_local = UTF8ToLocal(filename);
 
@@ -1248,8 +1254,10 @@ void vtFeatureSet::SetNumEntities(int iNum)
 		m_fields[iField]->SetNumRecords(iNum);
 
 	// Also keep size of flag array in synch
+	for (int i = iNum; i < previous; i++)
+		delete m_Features[i];
 	m_Features.resize(iNum);
-	for (int i = 0; i < (iNum - previous); i++)
+	for (int i = previous; i < iNum; i++)
 	{
 		vtFeature *f = new vtFeature;
 		f->flags = 0;
@@ -1960,6 +1968,8 @@ void Field::GetValue(uint record, double &value)
 		value = (double) m_int[record];
 	else if (m_type == FT_Short)
 		value = (double) m_short[record];
+	else if (m_type == FT_String)
+		value = atof(m_string[record]);
 }
 
 void Field::GetValue(uint record, bool &value)
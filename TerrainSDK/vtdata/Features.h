@@ -417,6 +417,7 @@ public:
 	void Offset(const DPoint2 &p, bool bSelectedOnly = false);
 	bool TransformCoords(OCTransform *pTransform, bool progress_callback(int)=0);
 	bool AppendGeometryFrom(vtFeatureSet *pFromSet);
+	int NumTotalVertices() const;
 
 	int AddPolygon(const DPolygon2 &poly);
 	void SetPolygon(uint num, const DPolygon2 &poly) { m_Poly[num] = poly; }
@@ -38,6 +38,7 @@
 #define FSTRING_INI		_T("INI Files (*.ini)|*.ini")
 #define FSTRING_IVE		_T("IVE Files (*.ive)|*.ive")
 #define FSTRING_JPEG	_T("JPEG Files (*.jpg, *.jpeg)|*.jpg;*.jpeg")
+#define FSTRING_JSON	_T("JSON Files (*.json)|*.json")
 #define FSTRING_KML		_T("KML Files (*.kml)|*.kml")
 #define FSTRING_LOC		_T("Location Files (*.loc)|*.loc")
 #define FSTRING_LWO		_T("LightWave Files (*.lwo)|*.lwo")
@@ -9,6 +9,8 @@
 
 #include <stdio.h>
 #include <errno.h>
+#include <math.h>
+#include <stdlib.h>
 
 #include "FilePath.h"
 #include "vtLog.h"
@@ -28,6 +30,7 @@
 #endif
 
 #if WIN32
+#  include <windows.h>	// for vtMappedFile
 #  ifdef _MSC_VER
 #	undef mkdir		// replace the one in direct.h that takes 1 param
 #	define mkdir(dirname,mode)	_mkdir(dirname)
@@ -42,12 +45,18 @@
 #  endif
 #else
 #  include <utime.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
 #endif
 
 #if SUPPORT_BZIP2
   #include "bzlib.h"
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 /**
  * The dir_iter class provides a cross-platform way to read directories.
  * It is addapted from the 'boost' library, without encurring the huge overhead
@@ -550,6 +559,17 @@ int GetFileSize(const char *fname)
 	return buf.st_size;
 }
 
+/**
+ * Return the time a file was last modified, or 0 if it doesn't exist.
+ */
+time_t GetFileModTime(const char *fname)
+{
+	struct stat buf;
+	if (stat(fname, &buf) != 0)
+		return 0;
+	return buf.st_mtime;
+}
+
 void SetEnvironmentVar(const vtString &var, const vtString &value)
 {
 #if VTUNIX
@@ -878,3 +898,287 @@ FILE *vtFileOpen(const wstring &fname_ws, const char *mode)
 }
 
 #endif // SUPPORT_WSTRING
+
+
+///////////////////////////////////////////////////////////////////////
+// vtMappedFile
+
+vtMappedFile::vtMappedFile()
+{
+	m_pData = NULL;
+	m_iSize = 0;
+#if WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+vtMappedFile::~vtMappedFile()
+{
+	Close();
+}
+
+/**
+ * Map a whole file into memory.
+ *
+ * \return false if the file couldn't be opened or mapped, or is empty.
+ */
+bool vtMappedFile::Open(const char *fname_utf8)
+{
+	Close();
+#if WIN32
+  #if SUPPORT_WSTRING
+	wstring2 fn;
+	fn.from_utf8(fname_utf8);
+	m_hFile = CreateFileW(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  #else
+	m_hFile = CreateFileA(fname_utf8, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  #endif
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0 ||
+		(ULONGLONG) size.QuadPart > (ULONGLONG) ((size_t) -1))
+	{
+		Close();
+		return false;
+	}
+	m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping != NULL)
+		m_pData = (const char *) MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+	m_iSize = (size_t) size.QuadPart;
+#else
+  #if SUPPORT_WSTRING && !__DARWIN_OSX__
+	wstring2 fn;
+	fn.from_utf8(fname_utf8);
+	int fd = open(fn.mb_str(), O_RDONLY);
+  #else
+	int fd = open(fname_utf8, O_RDONLY);
+  #endif
+	if (fd < 0)
+		return false;
+	struct stat buf;
+	if (fstat(fd, &buf) != 0 || buf.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	void *data = mmap(NULL, (size_t) buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);	// the mapping keeps the file open
+	if (data == MAP_FAILED)
+		return false;
+	madvise(data, (size_t) buf.st_size, MADV_SEQUENTIAL);
+	m_pData = (const char *) data;
+	m_iSize = (size_t) buf.st_size;
+#endif
+	return true;
+}
+
+void vtMappedFile::Close()
+{
+#if WIN32
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping != NULL)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_hMapping = NULL;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (m_pData)
+		munmap((void *) m_pData, m_iSize);
+#endif
+	m_pData = NULL;
+	m_iSize = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Fast number parsing
+
+static const double s_Pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Parse a number from text, after skipping any separators, and move past
+ * it.  The number must end at a separator or at 'end'.  This is much faster
+ * than scanf or strtod, and doesn't depend on the locale.
+ *
+ * \param p The text to parse; moved past the number.
+ * \param end The end of the text, which need not be null-terminated.
+ * \param value Receives the number.
+ * \return false if there is no number, or it is not well formed.
+ */
+bool vtParseNumber(const char *&p, const char *end, double &value)
+{
+	while (p < end && vtIsTextSeparator(*p))
+		p++;
+	if (p == end)
+		return false;
+
+	const char *start = p;
+	bool bNegative = false;
+	if (*p == '-' || *p == '+')
+	{
+		bNegative = (*p == '-');
+		p++;
+	}
+
+	// Up to 15 significant digits are kept exactly in the mantissa; any
+	//  more only change the exponent.
+	double mantissa = 0;
+	int iDigits = 0, iSignificant = 0, iExponent = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		if (iSignificant < 15)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0)
+				iSignificant++;
+		}
+		else
+			iExponent++;
+		iDigits++;
+		p++;
+	}
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			if (iSignificant < 15)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0)
+					iSignificant++;
+				iExponent--;
+			}
+			iDigits++;
+			p++;
+		}
+	}
+	if (iDigits > 0 && p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char *e = p + 1;
+		bool bNegExp = false;
+		if (e < end && (*e == '-' || *e == '+'))
+		{
+			bNegExp = (*e == '-');
+			e++;
+		}
+		if (e < end && *e >= '0' && *e <= '9')
+		{
+			int exp = 0;
+			while (e < end && *e >= '0' && *e <= '9')
+			{
+				if (exp < 10000)
+					exp = exp * 10 + (*e - '0');
+				e++;
+			}
+			iExponent += bNegExp ? -exp : exp;
+			p = e;
+		}
+	}
+	if (iDigits > 0 && (p == end || vtIsTextSeparator(*p)))
+	{
+		if (iExponent < 0)
+			mantissa = (iExponent >= -22) ? mantissa / s_Pow10[-iExponent] : mantissa * pow(10.0, iExponent);
+		else if (iExponent > 0)
+			mantissa = (iExponent <= 22) ? mantissa * s_Pow10[iExponent] : mantissa * pow(10.0, iExponent);
+		value = bNegative ? -mantissa : mantissa;
+		return true;
+	}
+
+	// Something unusual, such as "nan"; let the C library try.
+	p = start;
+	char buf[64];
+	int len = 0;
+	while (p < end && !vtIsTextSeparator(*p) && len < 63)
+		buf[len++] = *p++;
+	buf[len] = 0;
+	if (p < end && !vtIsTextSeparator(*p))
+		return false;
+	char *stop;
+	value = strtod(buf, &stop);
+	return (stop != buf && *stop == 0);
+}
+
+/**
+ * Split text into pieces of about piece_size, each ending at a line break,
+ * so that the pieces can be parsed on several threads.  The pieces are from
+ * bounds[i] to bounds[i+1].
+ */
+void vtSplitLines(const char *begin, const char *end, size_t piece_size,
+				  std::vector<const char *> &bounds)
+{
+	bounds.clear();
+	bounds.push_back(begin);
+	const char *p = begin;
+	while ((size_t) (end - p) > piece_size)
+	{
+		p += piece_size;
+		while (p < end && *p != '\n')
+			p++;
+		if (p < end)
+			p++;
+		bounds.push_back(p);
+	}
+	if (bounds.back() != end)
+		bounds.push_back(end);
+}
+
+/**
+ * True on the first thread of an OpenMP loop, which is the thread that
+ * started it.  A progress callback may only be called on that thread.
+ */
+bool vtIsFirstThread()
+{
+#ifdef _OPENMP
+	return (omp_get_thread_num() == 0);
+#else
+	return true;
+#endif
+}
+
+/**
+ * Add one to a counter shared by the threads of an OpenMP loop, such as for
+ * progress, and return the new count.
+ */
+int vtAtomicIncrement(int &value)
+{
+	int result;
+#if _OPENMP >= 201107
+	#pragma omp atomic capture
+	result = ++value;
+#else
+	// Before OpenMP 3.1, as in MSVC, there is no atomic capture
+	#pragma omp critical(vtAtomicIncrement)
+	result = ++value;
+#endif
+	return result;
+}
+
+void vtThreadFlag::Set()
+{
+	#pragma omp critical(vtThreadFlag)
+	m_bSet = true;
+}
+
+bool vtThreadFlag::IsSet() const
+{
+	bool bSet;
+	#pragma omp critical(vtThreadFlag)
+	bSet = m_bSet;
+	return bSet;
+}
+
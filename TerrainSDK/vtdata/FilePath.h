@@ -20,6 +20,7 @@
 #endif
 
 #include <fstream>
+#include <time.h>
 
 #ifdef WIN32
   #include <io.h>
@@ -101,10 +102,66 @@ vtString GetExtension(const vtString &fname, bool bFull = true);
 vtString ChangeFileExtension(const char *input, const char *extension);
 bool vtFileExists(const char *fname);
 int GetFileSize(const char *fname);
+time_t GetFileModTime(const char *fname);
 
 void SetEnvironmentVar(const vtString &var, const vtString &value);
 
 
+/**
+ * A file mapped into memory, read-only.  Large files, such as text
+ * elevation grids, can be parsed straight from the mapping without being
+ * copied through stdio.
+ */
+class vtMappedFile
+{
+public:
+	vtMappedFile();
+	~vtMappedFile();
+
+	bool Open(const char *fname_utf8);
+	void Close();
+
+	const char *GetData() const { return m_pData; }
+	size_t GetSize() const { return m_iSize; }
+
+protected:
+	const char *m_pData;
+	size_t m_iSize;
+#if WIN32
+	void *m_hFile;
+	void *m_hMapping;
+#endif
+};
+
+/** True for the characters which separate the numbers in text files. */
+inline bool vtIsTextSeparator(char c)
+{
+	return (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',');
+}
+bool vtParseNumber(const char *&p, const char *end, double &value);
+void vtSplitLines(const char *begin, const char *end, size_t piece_size,
+				  std::vector<const char *> &bounds);
+
+// Helpers for the OpenMP loops which parse and process data.
+bool vtIsFirstThread();
+int vtAtomicIncrement(int &value);
+
+/**
+ * A flag which the threads of an OpenMP loop can set and test, to stop the
+ * loop early, such as on an error or when the user cancels.
+ */
+class vtThreadFlag
+{
+public:
+	vtThreadFlag() : m_bSet(false) {}
+	void Set();
+	bool IsSet() const;
+
+protected:
+	bool m_bSet;
+};
+
+
 // Encapsulation for Zlib's gzip output functions.
 class GZOutput
 {
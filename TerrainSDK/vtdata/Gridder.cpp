@@ -0,0 +1,797 @@
+//
+// Gridder.cpp
+//
+// Produce elevation grids from scattered points, by binning, inverse
+// distance weighting, or linear interpolation on a triangulation.
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "Gridder.h"
+#include "ElevationGrid.h"
+#include "Features.h"
+#include "FilePath.h"
+#include "vtLog.h"
+
+#define ANSI_DECLARATORS
+#define REAL double
+extern "C" {
+#include "triangle/triangle.h"
+}
+
+// Number of points given at a time by the point sources
+#define POINT_CHUNK_SIZE	(1024 * 1024)
+
+// Size of the blocks read from an XYZ file, and of the pieces each block
+//  is split into for parsing in parallel
+#define XYZ_BLOCK_SIZE	(16 * 1024 * 1024)
+#define XYZ_PIECE_SIZE	(1024 * 1024)
+
+// Points sorted into band files are written this many at a time
+#define BAND_BUFFER_POINTS	65536
+
+// Rows of a band which are rasterized together, for TIN_LINEAR
+#define TIN_BLOCK_ROWS	16
+
+#define MAX_NEIGHBORS	64
+
+
+///////////////////////////////////////////////////////////////////////
+// vtPointSource
+
+/**
+ * Read through all the points, to count them, and optionally find their
+ * extents.
+ */
+bool vtPointSource::CountPoints(int &iCount, DRECT *extents)
+{
+	iCount = 0;
+	if (!Rewind())
+		return false;
+	if (extents)
+		extents->SetInsideOut();
+
+	std::vector<DPoint3> points;
+	while (ReadChunk(points))
+	{
+		iCount += (int) points.size();
+		if (extents)
+		{
+			for (size_t i = 0; i < points.size(); i++)
+				extents->GrowToContainPoint(DPoint2(points[i].x, points[i].y));
+		}
+	}
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// vtPointSourceFeatures
+
+vtPointSourceFeatures::vtPointSourceFeatures(const vtFeatureSetPoint3D *pSet)
+{
+	m_pSet = pSet;
+	m_iNext = 0;
+}
+
+bool vtPointSourceFeatures::Rewind()
+{
+	m_iNext = 0;
+	return true;
+}
+
+bool vtPointSourceFeatures::ReadChunk(std::vector<DPoint3> &points)
+{
+	const uint total = m_pSet->NumEntities();
+	if (m_iNext >= total)
+		return false;
+
+	uint count = total - m_iNext;
+	if (count > POINT_CHUNK_SIZE)
+		count = POINT_CHUNK_SIZE;
+	const DLine3 &all = m_pSet->GetAllPoints();
+	points.assign(&all[m_iNext], &all[m_iNext] + count);
+	m_iNext += count;
+	return true;
+}
+
+int vtPointSourceFeatures::NumPoints()
+{
+	return (int) m_pSet->NumEntities();
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// vtPointSourceXYZ
+
+// Parse one line of an XYZ file, and move to the start of the next line.
+static bool ParseXYZPoint(const char *&p, const char *end, int iSkip, DPoint3 &point)
+{
+	const char *eol = p;
+	while (eol < end && *eol != '\n')
+		eol++;
+
+	double value;
+	bool bOK = true;
+	for (int i = 0; i < iSkip && bOK; i++)
+		bOK = vtParseNumber(p, eol, value);
+	bOK = bOK && vtParseNumber(p, eol, point.x) && vtParseNumber(p, eol,
+		point.y) && vtParseNumber(p, eol, point.z);
+
+	p = (eol < end) ? eol + 1 : end;
+	return bOK;
+}
+
+// Parse all the lines from begin to end, which must be whole lines, in
+//  pieces on several threads.
+static void ParseXYZBlock(const char *begin, const char *end, int iSkip,
+	std::vector<DPoint3> &points)
+{
+	std::vector<const char *> bounds;
+	vtSplitLines(begin, end, XYZ_PIECE_SIZE, bounds);
+	const int pieces = (int) bounds.size() - 1;
+
+	std::vector< std::vector<DPoint3> > results(pieces);
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < pieces; i++)
+	{
+		const char *q = bounds[i];
+		std::vector<DPoint3> &result = results[i];
+		result.reserve((bounds[i + 1] - q) / 24);
+		DPoint3 point;
+		while (q < bounds[i + 1])
+		{
+			if (ParseXYZPoint(q, bounds[i + 1], iSkip, point))
+				result.push_back(point);
+		}
+	}
+	for (int i = 0; i < pieces; i++)
+		points.insert(points.end(), results[i].begin(), results[i].end());
+}
+
+vtPointSourceXYZ::vtPointSourceXYZ()
+{
+	m_fp = NULL;
+	m_iLeftover = 0;
+	m_bEOF = true;
+	m_iSkip = 0;
+}
+
+vtPointSourceXYZ::~vtPointSourceXYZ()
+{
+	Close();
+}
+
+bool vtPointSourceXYZ::Open(const char *fname_utf8)
+{
+	Close();
+	m_fp = vtFileOpen(fname_utf8, "rb");
+	if (!m_fp)
+		return false;
+
+	// Look at the first few lines, to see if they have 3 or 4 values
+	char line[1024];
+	m_iSkip = -1;
+	for (int i = 0; i < 10 && m_iSkip < 0 && fgets(line, 1024, m_fp) != NULL; i++)
+	{
+		const char *p = line, *end = line + strlen(line);
+		double value;
+		int count = 0;
+		while (vtParseNumber(p, end, value))
+			count++;
+		if (count == 3)
+			m_iSkip = 0;
+		else if (count == 4)
+			m_iSkip = 1;
+	}
+	if (m_iSkip < 0)
+	{
+		VTLOG("Couldn't find any points in %s\n", fname_utf8);
+		Close();
+		return false;
+	}
+	m_Buffer.resize(XYZ_BLOCK_SIZE);
+	return Rewind();
+}
+
+void vtPointSourceXYZ::Close()
+{
+	if (m_fp)
+		fclose(m_fp);
+	m_fp = NULL;
+	m_Buffer.clear();
+	m_iLeftover = 0;
+	m_bEOF = true;
+}
+
+bool vtPointSourceXYZ::Rewind()
+{
+	if (!m_fp)
+		return false;
+	rewind(m_fp);
+	m_iLeftover = 0;
+	m_bEOF = false;
+	return true;
+}
+
+bool vtPointSourceXYZ::ReadChunk(std::vector<DPoint3> &points)
+{
+	points.clear();
+	while (points.empty())
+	{
+		if (!m_fp || (m_bEOF && m_iLeftover == 0))
+			return false;
+
+		size_t size = m_iLeftover;
+		if (!m_bEOF)
+		{
+			size += fread(&m_Buffer[size], 1, m_Buffer.size() - size, m_fp);
+			if (size < m_Buffer.size())
+				m_bEOF = true;
+		}
+		const char *begin = &m_Buffer[0], *end = begin + size;
+
+		// Keep the last, partial, line for next time
+		const char *cut = end;
+		if (!m_bEOF)
+		{
+			while (cut > begin && cut[-1] != '\n')
+				cut--;
+			if (cut == begin)
+				cut = end;	// a line longer than the buffer
+		}
+		ParseXYZBlock(begin, cut, m_iSkip, points);
+
+		m_iLeftover = end - cut;
+		if (m_iLeftover > 0)
+			memmove(&m_Buffer[0], cut, m_iLeftover);
+	}
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// A 2D k-d tree over the points, for finding the nearest neighbors.
+//
+// The tree is implicit: the points are reordered so that the median of
+//  each range is its node, splitting on x and y at alternate levels.
+
+struct Neighbors
+{
+	Neighbors(int k, double radius2) : m_iNum(0), m_iMax(k), m_dRadius2(radius2) {}
+
+	double Bound() const
+	{
+		return (m_iNum < m_iMax) ? m_dRadius2 : m_dDist2[m_iNum - 1];
+	}
+	void Insert(double dist2, int index)
+	{
+		if (dist2 >= Bound())
+			return;
+		int j = (m_iNum < m_iMax) ? m_iNum++ : m_iNum - 1;
+		while (j > 0 && m_dDist2[j - 1] > dist2)
+		{
+			m_dDist2[j] = m_dDist2[j - 1];
+			m_iIndex[j] = m_iIndex[j - 1];
+			j--;
+		}
+		m_dDist2[j] = dist2;
+		m_iIndex[j] = index;
+	}
+
+	int m_iNum, m_iMax;
+	double m_dRadius2;
+	double m_dDist2[MAX_NEIGHBORS];	// nearest first
+	int m_iIndex[MAX_NEIGHBORS];
+};
+
+static bool LessX(const DPoint3 &a, const DPoint3 &b) { return a.x < b.x; }
+static bool LessY(const DPoint3 &a, const DPoint3 &b) { return a.y < b.y; }
+
+class PointTree
+{
+public:
+	PointTree(std::vector<DPoint3> &points) : m_Points(points)
+	{
+		_Build(0, (int) points.size(), 0);
+	}
+	void FindNearest(const DPoint2 &p, Neighbors &nb) const
+	{
+		_Search(0, (int) m_Points.size(), 0, p, nb);
+	}
+
+protected:
+	void _Build(int lo, int hi, int axis)
+	{
+		if (hi - lo < 2)
+			return;
+		const int mid = (lo + hi) / 2;
+		std::nth_element(m_Points.begin() + lo, m_Points.begin() + mid,
+			m_Points.begin() + hi, axis ? LessY : LessX);
+		_Build(lo, mid, 1 - axis);
+		_Build(mid + 1, hi, 1 - axis);
+	}
+	void _Search(int lo, int hi, int axis, const DPoint2 &p, Neighbors &nb) const
+	{
+		if (lo >= hi)
+			return;
+		const int mid = (lo + hi) / 2;
+		const DPoint3 &q = m_Points[mid];
+		const double dx = p.x - q.x, dy = p.y - q.y;
+		nb.Insert(dx*dx + dy*dy, mid);
+
+		// Search the side the point is on first, then the other side only
+		//  if it could be close enough.
+		const double diff = axis ? dy : dx;
+		if (diff < 0)
+		{
+			_Search(lo, mid, 1 - axis, p, nb);
+			if (diff * diff < nb.Bound())
+				_Search(mid + 1, hi, 1 - axis, p, nb);
+		}
+		else
+		{
+			_Search(mid + 1, hi, 1 - axis, p, nb);
+			if (diff * diff < nb.Bound())
+				_Search(lo, mid, 1 - axis, p, nb);
+		}
+	}
+
+	std::vector<DPoint3> &m_Points;
+};
+
+
+///////////////////////////////////////////////////////////////////////
+// vtPointGridder
+
+vtPointGridder::vtPointGridder()
+{
+	m_Method = IDW;
+	m_iNeighbors = 12;
+	m_dPower = 2.0;
+	m_dDistanceCutoff = 2.0;
+	m_iMaxPoints = 4000000;
+}
+
+/**
+ * Fill a grid from a set of points.  The grid must already be created, with
+ * the extents, size and projection you want.
+ *
+ * \return false if there was a problem, such as no points, or if the user
+ *		cancelled.
+ */
+bool vtPointGridder::Grid(vtPointSource &source, vtElevationGrid &grid,
+	bool progress_callback(int))
+{
+	int iColumns, iRows;
+	grid.GetDimensions(iColumns, iRows);
+	if (iColumns < 2 || iRows < 2)
+		return false;
+
+	// Start with every node empty
+	#pragma omp parallel for
+	for (int j = 0; j < iRows; j++)
+		for (int i = 0; i < iColumns; i++)
+			grid.SetFValue(i, j, INVALID_ELEVATION);
+
+	bool bOK;
+	if (m_Method == IDW || m_Method == TIN_LINEAR)
+		bOK = _Banded(source, grid, progress_callback);
+	else
+		bOK = _Bin(source, grid, progress_callback);
+	return bOK;
+}
+
+bool vtPointGridder::_Bin(vtPointSource &source, vtElevationGrid &grid,
+	bool progress_callback(int))
+{
+	int iColumns, iRows;
+	grid.GetDimensions(iColumns, iRows);
+	const DRECT &ext = grid.GetEarthExtents();
+	const DPoint2 &step = grid.GetSpacing();
+
+	// For the mean, the grid holds the running mean, and we count the
+	//  points in each cell.  For min and max, the grid is all we need.
+	std::vector<int> counts;
+	if (m_Method == BIN_MEAN)
+		counts.resize((size_t) iColumns * iRows, 0);
+
+	const int total = source.NumPoints();
+	int done = 0, used = 0;
+	if (!source.Rewind())
+		return false;
+	std::vector<DPoint3> points;
+	while (source.ReadChunk(points))
+	{
+		for (size_t n = 0; n < points.size(); n++)
+		{
+			const DPoint3 &p = points[n];
+			const int i = (int) floor((p.x - ext.left) / step.x + 0.5);
+			const int j = (int) floor((p.y - ext.bottom) / step.y + 0.5);
+			if (i < 0 || i >= iColumns || j < 0 || j >= iRows)
+				continue;
+			const float z = (float) p.z;
+			const float current = grid.GetFValue(i, j);
+			if (m_Method == BIN_MEAN)
+			{
+				int &count = counts[(size_t) j * iColumns + i];
+				count++;
+				grid.SetFValue(i, j, (count == 1) ? z : current + (z - current) / count);
+			}
+			else if (current == INVALID_ELEVATION ||
+				(m_Method == BIN_MIN && z < current) ||
+				(m_Method == BIN_MAX && z > current))
+				grid.SetFValue(i, j, z);
+			used++;
+		}
+		done += (int) points.size();
+		if (progress_callback != NULL && total > 0 &&
+			progress_callback((int) ((double) done * 99 / total)))
+			return false;
+	}
+	VTLOG("Binned %d of %d points into the grid.\n", used, done);
+	return (used > 0);
+}
+
+bool vtPointGridder::_Banded(vtPointSource &source, vtElevationGrid &grid,
+	bool progress_callback(int))
+{
+	int iColumns, iRows;
+	grid.GetDimensions(iColumns, iRows);
+	const DRECT &ext = grid.GetEarthExtents();
+	const DPoint2 &step = grid.GetSpacing();
+
+	int total = source.NumPoints();
+	if (total < 0 && !source.CountPoints(total))
+		return false;
+	if (total == 0)
+		return false;
+
+	// The search radius, and the overlap between bands, are based on the
+	//  mean spacing of the points.
+	double area = ext.Width() * ext.Height();
+	if (area <= 0)
+		area = step.x * step.y;
+	const double spacing = sqrt(area / total);
+	const double radius = m_dDistanceCutoff * spacing;
+	double margin = radius;
+	if (m_Method == TIN_LINEAR && margin < 4 * spacing)
+		margin = 4 * spacing;
+
+	// Divide the rows into bands, each with no more than the maximum number
+	//  of points, assuming they are spread fairly evenly.
+	int bands = (total + m_iMaxPoints - 1) / m_iMaxPoints;
+	int iBandRows = iRows;
+	while (bands < iRows)
+	{
+		iBandRows = (iRows + bands - 1) / bands;
+		const double fraction = (iBandRows * step.y + 2 * margin) / (iRows * step.y);
+		if (total * fraction <= m_iMaxPoints)
+			break;
+		bands++;
+	}
+	bands = (iRows + iBandRows - 1) / iBandRows;
+	VTLOG("Gridding %d points in %d bands of %d rows, radius %.2lf\n",
+		total, bands, iBandRows, radius);
+
+	// Which bands a point belongs to, including the overlap
+	const double fMargin = margin / step.y;
+	const double left = ext.left - margin, right = ext.right + margin;
+
+	std::vector<DPoint3> chunk, points;
+	std::vector<FILE *> files;
+	std::vector<size_t> counts;
+	if (bands == 1)
+	{
+		// Everything fits in memory
+		if (!source.Rewind())
+			return false;
+		points.reserve(total);
+		while (source.ReadChunk(chunk))
+		{
+			for (size_t n = 0; n < chunk.size(); n++)
+			{
+				const DPoint3 &p = chunk[n];
+				const double fy = (p.y - ext.bottom) / step.y;
+				if (p.x >= left && p.x <= right && fy >= -fMargin && fy <= iRows - 1 + fMargin)
+					points.push_back(p);
+			}
+			if (progress_callback != NULL &&
+				progress_callback((int) ((double) points.size() * 20 / total)))
+				return false;
+		}
+	}
+	else
+	{
+		// Sort the points into a temporary file for each band
+		files.resize(bands, NULL);
+		counts.resize(bands, 0);
+		for (int b = 0; b < bands; b++)
+		{
+			files[b] = tmpfile();
+			if (!files[b])
+			{
+				VTLOG1("Couldn't create a temporary file for gridding.\n");
+				for (int f = 0; f < b; f++)
+					fclose(files[f]);
+				return false;
+			}
+		}
+		std::vector< std::vector<DPoint3> > pending(bands);
+		bool bOK = source.Rewind();
+		int done = 0;
+		while (bOK && source.ReadChunk(chunk))
+		{
+			for (size_t n = 0; n < chunk.size() && bOK; n++)
+			{
+				const DPoint3 &p = chunk[n];
+				if (p.x < left || p.x > right)
+					continue;
+				const double fy = (p.y - ext.bottom) / step.y;
+				int b0 = (int) floor((fy - fMargin) / iBandRows);
+				int b1 = (int) floor((fy + fMargin) / iBandRows);
+				if (b0 < 0) b0 = 0;
+				if (b1 > bands - 1) b1 = bands - 1;
+				for (int b = b0; b <= b1; b++)
+				{
+					pending[b].push_back(p);
+					if (pending[b].size() == BAND_BUFFER_POINTS)
+					{
+						bOK = (fwrite(&pending[b][0], sizeof(DPoint3), BAND_BUFFER_POINTS,
+							files[b]) == BAND_BUFFER_POINTS);
+						counts[b] += BAND_BUFFER_POINTS;
+						pending[b].clear();
+					}
+				}
+			}
+			done += (int) chunk.size();
+			if (progress_callback != NULL &&
+				progress_callback((int) ((double) done * 20 / total)))
+				bOK = false;
+		}
+		for (int b = 0; b < bands && bOK; b++)
+		{
+			if (pending[b].empty())
+				continue;
+			bOK = (fwrite(&pending[b][0], sizeof(DPoint3), pending[b].size(),
+				files[b]) == pending[b].size());
+			counts[b] += pending[b].size();
+		}
+		if (!bOK)
+		{
+			VTLOG1("Couldn't sort the points into bands.\n");
+			for (int b = 0; b < bands; b++)
+				fclose(files[b]);
+			return false;
+		}
+	}
+
+	// Fill each band in turn
+	bool bOK = true;
+	for (int b = 0; b < bands && bOK; b++)
+	{
+		if (bands > 1)
+		{
+			points.resize(counts[b]);
+			rewind(files[b]);
+			if (counts[b] > 0 &&
+				fread(&points[0], sizeof(DPoint3), counts[b], files[b]) != counts[b])
+			{
+				VTLOG("Couldn't read back the points of band %d.\n", b);
+				bOK = false;
+			}
+			fclose(files[b]);
+			files[b] = NULL;
+		}
+		const int iRow0 = b * iBandRows;
+		const int iRow1 = std::min(iRows, iRow0 + iBandRows);
+		const int iBase = 20 + 80 * b / bands, iRange = 80 / bands;
+		if (!bOK)
+			break;
+		if (m_Method == IDW)
+			bOK = _FillIDW(points, grid, iRow0, iRow1, radius, progress_callback, iBase, iRange);
+		else
+			bOK = _FillTIN(points, grid, iRow0, iRow1, progress_callback, iBase, iRange);
+	}
+	for (int b = 0; b < bands; b++)
+		if (!files.empty() && files[b])
+			fclose(files[b]);
+	return bOK;
+}
+
+/**
+ * Fill the rows iRow0 to iRow1 (exclusive) with the inverse-distance-weighted
+ * average of the nearest points.  The points are reordered.
+ */
+bool vtPointGridder::_FillIDW(std::vector<DPoint3> &points, vtElevationGrid &grid,
+	int iRow0, int iRow1, double dRadius, bool progress_callback(int),
+	int iBase, int iRange)
+{
+	if (points.empty())
+		return true;
+
+	int iColumns, iRows;
+	grid.GetDimensions(iColumns, iRows);
+	const DRECT &ext = grid.GetEarthExtents();
+	const DPoint2 &step = grid.GetSpacing();
+
+	PointTree tree(points);
+
+	int k = m_iNeighbors;
+	if (k < 1) k = 1;
+	if (k > MAX_NEIGHBORS) k = MAX_NEIGHBORS;
+	const double radius2 = dRadius * dRadius;
+	const bool bSquare = (m_dPower == 2.0);
+	const double fHalfPower = m_dPower / 2;
+
+	int iDone = 0;
+	vtThreadFlag cancel;
+	#pragma omp parallel for schedule(dynamic)
+	for (int j = iRow0; j < iRow1; j++)
+	{
+		if (cancel.IsSet())
+			continue;
+
+		DPoint2 p(ext.left, ext.bottom + j * step.y);
+		for (int i = 0; i < iColumns; i++)
+		{
+			p.x = ext.left + i * step.x;
+			Neighbors nb(k, radius2);
+			tree.FindNearest(p, nb);
+			if (nb.m_iNum == 0)
+				continue;
+
+			// A point right on the node gives its value exactly
+			if (nb.m_dDist2[0] == 0)
+			{
+				grid.SetFValue(i, j, (float) points[nb.m_iIndex[0]].z);
+				continue;
+			}
+			double sum = 0, weights = 0;
+			for (int n = 0; n < nb.m_iNum; n++)
+			{
+				const double w = bSquare ? 1.0 / nb.m_dDist2[n] :
+					1.0 / pow(nb.m_dDist2[n], fHalfPower);
+				sum += w * points[nb.m_iIndex[n]].z;
+				weights += w;
+			}
+			grid.SetFValue(i, j, (float) (sum / weights));
+		}
+		const int iCount = vtAtomicIncrement(iDone);
+
+		if (progress_callback != NULL && vtIsFirstThread())
+		{
+			if (progress_callback(iBase + iCount * iRange / (iRow1 - iRow0)))
+				cancel.Set();
+		}
+	}
+	return !cancel.IsSet();
+}
+
+/**
+ * Triangulate the points, and fill the rows iRow0 to iRow1 (exclusive) by
+ * linear interpolation on the triangles.
+ */
+bool vtPointGridder::_FillTIN(const std::vector<DPoint3> &points, vtElevationGrid &grid,
+	int iRow0, int iRow1, bool progress_callback(int), int iBase, int iRange)
+{
+	if (points.size() < 3)
+		return true;
+
+	int iColumns, iRows;
+	grid.GetDimensions(iColumns, iRows);
+	const DRECT &ext = grid.GetEarthExtents();
+	const DPoint2 &step = grid.GetSpacing();
+
+	struct triangulateio in, out;
+	memset(&in, 0, sizeof(in));
+	memset(&out, 0, sizeof(out));
+	in.numberofpoints = (int) points.size();
+	in.pointlist = (REAL *) malloc(in.numberofpoints * 2 * sizeof(REAL));
+	if (!in.pointlist)
+		return false;
+	for (int i = 0; i < in.numberofpoints; i++)
+	{
+		in.pointlist[2*i] = points[i].x;
+		in.pointlist[2*i + 1] = points[i].y;
+	}
+
+	// Triangulate the points.  Switches are chosen:
+	// number everything from zero (z), quietly (Q), with no output points
+	// (N) or boundary markers (B), so the triangles index our points.
+	triangulate("zQNB", &in, &out, NULL);
+	free(in.pointlist);
+	const int iTriangles = out.numberoftriangles;
+	const int *tris = out.trianglelist;
+
+	// Find which blocks of rows each triangle covers
+	const int iBlocks = (iRow1 - iRow0 + TIN_BLOCK_ROWS - 1) / TIN_BLOCK_ROWS;
+	std::vector< std::vector<int> > blocks(iBlocks);
+	for (int t = 0; t < iTriangles; t++)
+	{
+		const double y0 = points[tris[t*3]].y;
+		const double y1 = points[tris[t*3+1]].y;
+		const double y2 = points[tris[t*3+2]].y;
+		int r0 = (int) ceil((std::min(y0, std::min(y1, y2)) - ext.bottom) / step.y);
+		int r1 = (int) floor((std::max(y0, std::max(y1, y2)) - ext.bottom) / step.y);
+		if (r0 < iRow0) r0 = iRow0;
+		if (r1 > iRow1 - 1) r1 = iRow1 - 1;
+		if (r0 > r1)
+			continue;
+		for (int b = (r0 - iRow0) / TIN_BLOCK_ROWS; b <= (r1 - iRow0) / TIN_BLOCK_ROWS; b++)
+			blocks[b].push_back(t);
+	}
+
+	// Each block of rows is filled by one thread, so the nodes on the edges
+	//  between triangles are never written by two threads at once.
+	int iDone = 0;
+	vtThreadFlag cancel;
+	#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < iBlocks; b++)
+	{
+		if (cancel.IsSet())
+			continue;
+
+		const int iBlock0 = iRow0 + b * TIN_BLOCK_ROWS;
+		const int iBlock1 = std::min(iRow1, iBlock0 + TIN_BLOCK_ROWS);
+		const std::vector<int> &list = blocks[b];
+		for (size_t n = 0; n < list.size(); n++)
+		{
+			const int t = list[n];
+			const DPoint3 &a = points[tris[t*3]];
+			const DPoint3 &c1 = points[tris[t*3+1]];
+			const DPoint3 &c2 = points[tris[t*3+2]];
+			const double det = (c1.y - c2.y) * (a.x - c2.x) + (c2.x - c1.x) * (a.y - c2.y);
+			if (det == 0)
+				continue;
+
+			int r0 = (int) ceil((std::min(a.y, std::min(c1.y, c2.y)) - ext.bottom) / step.y);
+			int r1 = (int) floor((std::max(a.y, std::max(c1.y, c2.y)) - ext.bottom) / step.y);
+			int i0 = (int) ceil((std::min(a.x, std::min(c1.x, c2.x)) - ext.left) / step.x);
+			int i1 = (int) floor((std::max(a.x, std::max(c1.x, c2.x)) - ext.left) / step.x);
+			if (r0 < iBlock0) r0 = iBlock0;
+			if (r1 > iBlock1 - 1) r1 = iBlock1 - 1;
+			if (i0 < 0) i0 = 0;
+			if (i1 > iColumns - 1) i1 = iColumns - 1;
+
+			for (int j = r0; j <= r1; j++)
+			{
+				const double y = ext.bottom + j * step.y;
+				for (int i = i0; i <= i1; i++)
+				{
+					// Barycentric coordinates of the node
+					const double x = ext.left + i * step.x;
+					const double l1 = ((c1.y - c2.y) * (x - c2.x) + (c2.x - c1.x) * (y - c2.y)) / det;
+					const double l2 = ((c2.y - a.y) * (x - c2.x) + (a.x - c2.x) * (y - c2.y)) / det;
+					const double l3 = 1.0 - l1 - l2;
+					if (l1 < -1E-9 || l2 < -1E-9 || l3 < -1E-9)
+						continue;
+					grid.SetFValue(i, j, (float) (l1 * a.z + l2 * c1.z + l3 * c2.z));
+				}
+			}
+		}
+		const int iCount = vtAtomicIncrement(iDone);
+
+		if (progress_callback != NULL && vtIsFirstThread())
+		{
+			if (progress_callback(iBase + iCount * iRange / iBlocks))
+				cancel.Set();
+		}
+	}
+	free(out.trianglelist);
+	free(out.pointlist);
+	free(out.pointattributelist);
+	free(out.pointmarkerlist);
+	free(out.triangleattributelist);
+	free(out.neighborlist);
+	free(out.segmentlist);
+	free(out.segmentmarkerlist);
+	free(out.edgelist);
+	free(out.edgemarkerlist);
+	return !cancel.IsSet();
+}
@@ -0,0 +1,147 @@
+//
+// Gridder.h
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#ifndef GRIDDERH
+#define GRIDDERH
+
+#include <stdio.h>
+#include <vector>
+
+#include "MathTypes.h"
+
+class vtElevationGrid;
+class vtFeatureSetPoint3D;
+
+/**
+ * A source of scattered 3D points, which are read a chunk at a time so that
+ * the whole set never has to be in memory at once.
+ */
+class vtPointSource
+{
+public:
+	virtual ~vtPointSource() {}
+
+	/// Go back to the first point.
+	virtual bool Rewind() = 0;
+
+	/// Read the next chunk of points, replacing the contents of 'points'.
+	///  Returns false when there are no more.
+	virtual bool ReadChunk(std::vector<DPoint3> &points) = 0;
+
+	/// The number of points, or -1 if it isn't known without reading them.
+	virtual int NumPoints() { return -1; }
+
+	bool CountPoints(int &iCount, DRECT *extents = NULL);
+};
+
+/**
+ * Points from a 3D point feature set which is already in memory.
+ */
+class vtPointSourceFeatures : public vtPointSource
+{
+public:
+	vtPointSourceFeatures(const vtFeatureSetPoint3D *pSet);
+
+	bool Rewind();
+	bool ReadChunk(std::vector<DPoint3> &points);
+	int NumPoints();
+
+protected:
+	const vtFeatureSetPoint3D *m_pSet;
+	uint m_iNext;
+};
+
+/**
+ * Points from an XYZ text file, with "x y z" or "n x y z" on each line,
+ * separated by spaces or commas.  The file is read a block at a time, and
+ * each block is parsed on several threads.  Lines which aren't points, such
+ * as a header, are skipped.
+ */
+class vtPointSourceXYZ : public vtPointSource
+{
+public:
+	vtPointSourceXYZ();
+	~vtPointSourceXYZ();
+
+	bool Open(const char *fname_utf8);
+	void Close();
+
+	bool Rewind();
+	bool ReadChunk(std::vector<DPoint3> &points);
+
+protected:
+	FILE *m_fp;
+	std::vector<char> m_Buffer;
+	size_t m_iLeftover;		// bytes of a partial line kept from the last block
+	bool m_bEOF;
+	int m_iSkip;			// leading values on each line which aren't x,y,z
+};
+
+/**
+ * Produces an elevation grid from scattered 3D points, such as a LIDAR
+ * survey, with one of several methods:
+ *
+ * - BIN_MEAN, BIN_MIN, BIN_MAX: each grid node gets the mean, lowest or
+ *   highest of the points which fall in its cell.  This is fast and suits
+ *   dense data, such as LIDAR gridded at a coarser spacing.
+ * - IDW: each node gets the inverse-distance-weighted average of its
+ *   nearest points, within a search radius.
+ * - TIN_LINEAR: the points are triangulated, and each node gets the height
+ *   of the triangle it falls on.
+ *
+ * Nodes which get no value are INVALID_ELEVATION.
+ *
+ * The points are read from a vtPointSource in chunks.  For binning, only
+ * the grid and an accumulator for each node are held in memory.  For IDW
+ * and TIN, the grid is divided into bands of rows such that no band has
+ * more than SetMaxPoints points (plus an overlap, so the bands join
+ * seamlessly); if there is more than one band, the points are sorted into
+ * temporary files, one for each band, and the bands are done one at a time.
+ * The rows of each band are filled on several threads.
+ */
+class vtPointGridder
+{
+public:
+	enum Method { BIN_MEAN, BIN_MIN, BIN_MAX, IDW, TIN_LINEAR };
+
+	vtPointGridder();
+
+	void SetMethod(Method m) { m_Method = m; }
+	Method GetMethod() const { return m_Method; }
+
+	/// For IDW, the number of nearest points to use for each node.
+	void SetNeighbors(int iNum) { m_iNeighbors = iNum; }
+	/// For IDW, the power of the distance by which points are weighted.
+	void SetPower(double dPower) { m_dPower = dPower; }
+	/// For IDW, the search radius, in multiples of the mean point spacing.
+	///  Nodes with no points this close get no value.
+	void SetDistanceCutoff(double dFactor) { m_dDistanceCutoff = dFactor; }
+	/// For IDW and TIN, the most points to hold in memory at once.
+	void SetMaxPoints(int iMax) { m_iMaxPoints = iMax; }
+
+	bool Grid(vtPointSource &source, vtElevationGrid &grid,
+		bool progress_callback(int) = NULL);
+
+protected:
+	bool _Bin(vtPointSource &source, vtElevationGrid &grid,
+		bool progress_callback(int));
+	bool _Banded(vtPointSource &source, vtElevationGrid &grid,
+		bool progress_callback(int));
+	bool _FillIDW(std::vector<DPoint3> &points, vtElevationGrid &grid,
+		int iRow0, int iRow1, double dRadius, bool progress_callback(int),
+		int iBase, int iRange);
+	bool _FillTIN(const std::vector<DPoint3> &points, vtElevationGrid &grid,
+		int iRow0, int iRow1, bool progress_callback(int), int iBase, int iRange);
+
+	Method m_Method;
+	int m_iNeighbors;
+	double m_dPower;
+	double m_dDistanceCutoff;
+	int m_iMaxPoints;
+};
+
+#endif // GRIDDERH
@@ -5,6 +5,8 @@
 // Free for all uses, see license.txt for details.
 //
 
+#include <vector>
+
 #include "HeightField.h"
 #include "vtDIB.h"
 #include "vtLog.h"
@@ -74,6 +76,26 @@ bool vtHeightField3d::ConvertEarthToSurfacePoint(const DPoint2 &epos,
 	return FindAltitudeAtPoint(p3, p3.y, bTrue, iCultureFlags);
 }
 
+/**
+ * Find the altitude at a whole set of points at once.  This is the same as
+ * calling FindAltitudeAtPoint for each point, with the y value of each
+ * point receiving the result.  Points where nothing is found are left
+ * unchanged.
+ *
+ * \return The number of points for which an altitude was found.
+ */
+int vtHeightField3d::FindAltitudesAtPoints(FPoint3 *points, int count,
+	bool bTrue, int iCultureFlags) const
+{
+	int found = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (FindAltitudeAtPoint(points[i], points[i].y, bTrue, iCultureFlags))
+			found++;
+	}
+	return found;
+}
+
 /**
  * Tests whether a given point is within the current terrain
  */
@@ -172,15 +194,18 @@ float vtHeightField3d::LineOnSurface(const DLine2 &line, float fSpacing, float f
 	else
 	{
 		// not curved: straight line in earth coordinates
-		FPoint3 last_v;
-		for (i = 0; i < points; i++)
+		FLine3 verts;
+		verts.SetSize(points);
+		if (points > 0)
+			m_LocalCS.EarthToLocal(line.GetData(), verts.GetData(), points);
+
+		const uint first = output.GetSize();
+		if (bInterp)
 		{
-			if (bInterp)
+			for (i = 1; i < points; i++)
 			{
-				v1 = v2;
-				m_LocalCS.EarthToLocal(line[i].x, line[i].y, v2.x, v2.z);
-				if (i == 0)
-					continue;
+				v1 = verts[i-1];
+				v2 = verts[i];
 
 				// estimate how many steps to subdivide this segment into
 				FPoint3 diff = v2 - v1;
@@ -192,25 +217,32 @@ float vtHeightField3d::LineOnSurface(const DLine2 &line, float fSpacing, float f
 				{
 					// simple linear interpolation of the ground coordinate
 					v.Set(v1.x + diff.x / iSteps * j, 0.0f, v1.z + diff.z / iSteps * j);
-					FindAltitudeAtPoint(v, v.y, bTrue);
-					v.y += fOffset;
 					output.Append(v);
-					iVerts++;
-
-					// keep a running total of approximate ground length
-					if (j > 0)
-						fTotalLength += (v - last_v).Length();
-					last_v = v;
 				}
 			}
-			else
+		}
+		else
+		{
+			for (i = 0; i < points; i++)
 			{
-				m_LocalCS.EarthToLocal(line[i], v.x, v.z);
-				FindAltitudeAtPoint(v, v.y, bTrue);
-				v.y += fOffset;
-				output.Append(v);
+				verts[i].y = 0.0f;
+				output.Append(verts[i]);
 			}
 		}
+
+		// look up the ground under all the new points together
+		const uint last = output.GetSize();
+		if (last > first)
+			FindAltitudesAtPoints(output.GetData() + first, last - first, bTrue);
+		for (i = first; i < last; i++)
+		{
+			output[i].y += fOffset;
+
+			// keep a running total of approximate ground length
+			if (bInterp && i > first)
+				fTotalLength += (output[i] - output[i-1]).Length();
+		}
+		iVerts += (last - first);
 	}
 	return fTotalLength;
 }
@@ -279,6 +311,27 @@ void vtHeightFieldGrid3d::Initialize(const LinearUnits units,
 	m_dStep.y = m_EarthExtents.Height() / (m_iSize.y - 1);
 }
 
+/**
+ * Grids answer point queries from their own data, so the points can be
+ * found in parallel.  Tests on culture are made one point at a time, since
+ * culture may not be safe to query from several threads.
+ */
+int vtHeightFieldGrid3d::FindAltitudesAtPoints(FPoint3 *points, int count,
+	bool bTrue, int iCultureFlags) const
+{
+	if (iCultureFlags != 0)
+		return vtHeightField3d::FindAltitudesAtPoints(points, count, bTrue, iCultureFlags);
+
+	int found = 0;
+	#pragma omp parallel for reduction(+:found)
+	for (int i = 0; i < count; i++)
+	{
+		if (FindAltitudeAtPoint(points[i], points[i].y, bTrue, 0))
+			found++;
+	}
+	return found;
+}
+
 void vtHeightFieldGrid3d::SetEarthExtents(const DRECT &ext)
 {
 	vtHeightField3d::SetEarthExtents(ext);
@@ -634,7 +687,6 @@ bool vtHeightFieldGrid3d::ColorDibFromTable(vtBitmapBase *pBM, const ColorMap *c
 {
 	VTLOG1(" ColorDibFromTable:");
 	const IPoint2 bitmap_size = pBM->GetSize();
-	int depth = pBM->GetDepth();
 
 	VTLOG(" dib size %d x %d, grid %d x %d.. ", bitmap_size.x, bitmap_size.y,
 		m_iSize.x, m_iSize.y);
@@ -644,41 +696,41 @@ bool vtHeightFieldGrid3d::ColorDibFromTable(vtBitmapBase *pBM, const ColorMap *c
 		   ratioy = (double)(m_iSize.y - 1)/(bitmap_size.y - 1);
 
 	bool has_invalid = false;
-	const RGBi nodata_24bit(nodata.r, nodata.g, nodata.b);
 	float elev;
 
-	// now iterate over the texels
-	for (int i = 0; i < bitmap_size.x; i++)
+	// now iterate over the texels, filling a row at a time
+	std::vector<uchar> row(bitmap_size.x * 4);
+	for (int j = 0; j < bitmap_size.y; j++)
 	{
-		if (progress_callback != NULL && (i&40) == 0)
-			progress_callback(i * 100 / bitmap_size.x);
+		if (progress_callback != NULL && (j%40) == 0)
+			progress_callback(j * 100 / bitmap_size.y);
 
 		// find the corresponding location in the height grid
-		const double x = i * ratiox;
+		const double y = j * ratioy;
 
-		for (int j = 0; j < bitmap_size.y; j++)
+		uchar *texel = &row[0];
+		for (int i = 0; i < bitmap_size.x; i++, texel += 4)
 		{
-			const double y = j * ratioy;
-
 			if (bExact)
 				elev = GetElevation(i, j, true);	// Always use true elevation
 			else
-				elev = GetInterpolatedElevation(x, y, true);	// Always use true elevation
+				elev = GetInterpolatedElevation(i * ratiox, y, true);	// Always use true elevation
 			if (elev == INVALID_ELEVATION)
 			{
-				if (depth == 32)
-					pBM->SetPixel32(i, bitmap_size.y - 1 - j, nodata);
-				else
-					pBM->SetPixel24(i, bitmap_size.y - 1 - j, nodata_24bit);
+				texel[0] = (uchar) nodata.r;
+				texel[1] = (uchar) nodata.g;
+				texel[2] = (uchar) nodata.b;
+				texel[3] = (uchar) nodata.a;
 				has_invalid = true;
 				continue;
 			}
 			const RGBi &rgb = color_map->ColorFromTable(elev);
-			if (depth == 32)
-				pBM->SetPixel32(i, bitmap_size.y - 1 - j, rgb);
-			else
-				pBM->SetPixel24(i, bitmap_size.y - 1 - j, rgb);
+			texel[0] = (uchar) rgb.r;
+			texel[1] = (uchar) rgb.g;
+			texel[2] = (uchar) rgb.b;
+			texel[3] = 255;
 		}
+		pBM->WriteRow(bitmap_size.y - 1 - j, &row[0]);
 	}
 	VTLOG("Done.\n");
 	return has_invalid;
@@ -715,12 +767,11 @@ void vtHeightFieldGrid3d::ShadeDibFromElevation(vtBitmapBase *pBM, const FPoint3
 	if (xOffset < 1) xOffset = 1;
 	if (yOffset < 1) yOffset = 1;
 
-	const int depth = pBM->GetDepth();
-
 	// Center, Left, Right, Top, Bottom
 	FPoint3 c, l, r, t, b, v3;
 
-	// iterate over the texels
+	// iterate over the texels, shading a row at a time
+	std::vector<float> shades(bitmap_size.x);
 	for (int j = 0; j < bitmap_size.y; j++)
 	{
 		if (progress_callback != NULL && (j%40) == 0)
@@ -732,6 +783,8 @@ void vtHeightFieldGrid3d::ShadeDibFromElevation(vtBitmapBase *pBM, const FPoint3
 		{
 			const int x = (int) (i * ratiox);
 
+			// Leave texels in nodata areas as they are
+			shades[i] = 1.0f;
 			GetWorldLocation(x, y, c, bTrue);
 			if (c.y == INVALID_ELEVATION)
 				continue;
@@ -799,15 +852,10 @@ void vtHeightFieldGrid3d::ShadeDibFromElevation(vtBitmapBase *pBM, const FPoint3
 				shade = 0;
 			if (shade > 1.1f)
 				shade = 1.1f;
-
-			// combine color and shading
-			if (depth == 8)
-				pBM->ScalePixel8(i, bitmap_size.y-1-j, shade);
-			else if (depth == 24)
-				pBM->ScalePixel24(i, bitmap_size.y-1-j, shade);
-			else if (depth == 32)
-				pBM->ScalePixel32(i, bitmap_size.y-1-j, shade);
+			shades[i] = shade;
 		}
+		// combine color and shading
+		pBM->ScaleRow(bitmap_size.y-1-j, &shades[0]);
 	}
 }
 
@@ -820,14 +868,11 @@ void vtHeightFieldGrid3d::ShadeQuick(vtBitmapBase *pBM, float fLightFactor,
 									 bool bTrue, bool progress_callback(int))
 {
 	const IPoint2 bitmap_size = pBM->GetSize();
-	const int depth = pBM->GetDepth();
 
 	const int stepx = m_iSize.x / bitmap_size.x;
 	const int stepy = m_iSize.y / bitmap_size.y;
 
-	RGBi rgb;
-	RGBAi rgba;
-
+	std::vector<uchar> row(bitmap_size.x * 4);
 	for (int j = 0; j < bitmap_size.y; j++)
 	{
 		if (progress_callback != NULL && (j%40) == 0)
@@ -835,13 +880,9 @@ void vtHeightFieldGrid3d::ShadeQuick(vtBitmapBase *pBM, float fLightFactor,
 
 		// find corresponding location in heightfield
 		const int y = m_iSize.y-1 - (j * stepy);
+		pBM->ReadRow(j, &row[0]);
 		for (int i = 0; i < bitmap_size.x; i++)
 		{
-			if (depth == 32)
-				pBM->GetPixel32(i, j, rgba);
-			else
-				pBM->GetPixel24(i, j, rgb);
-
 			int x_offset = 0;
 			if (i == bitmap_size.x-1)
 				x_offset = -1;
@@ -865,33 +906,14 @@ void vtHeightFieldGrid3d::ShadeQuick(vtBitmapBase *pBM, float fLightFactor,
 				diff = 128;
 			else if (diff < -128)
 				diff = -128;
-			if (depth == 32)
+			uchar *texel = &row[i * 4];
+			for (int c = 0; c < 3; c++)
 			{
-				rgba.r += diff;
-				rgba.g += diff;
-				rgba.b += diff;
-				if (rgba.r < 0) rgba.r = 0;
-				else if (rgba.r > 255) rgba.r = 255;
-				if (rgba.g < 0) rgba.g = 0;
-				else if (rgba.g > 255) rgba.g = 255;
-				if (rgba.b < 0) rgba.b = 0;
-				else if (rgba.b > 255) rgba.b = 255;
-				pBM->SetPixel32(i, j, rgba);
-			}
-			else
-			{
-				rgb.r = rgb.r + diff;
-				rgb.g = rgb.g + diff;
-				rgb.b = rgb.b + diff;
-				if (rgb.r < 0) rgb.r = 0;
-				else if (rgb.r > 255) rgb.r = 255;
-				if (rgb.g < 0) rgb.g = 0;
-				else if (rgb.g > 255) rgb.g = 255;
-				if (rgb.b < 0) rgb.b = 0;
-				else if (rgb.b > 255) rgb.b = 255;
-				pBM->SetPixel24(i, j, rgb);
+				const int value = texel[c] + diff;
+				texel[c] = (uchar) (value < 0 ? 0 : value > 255 ? 255 : value);
 			}
 		}
+		pBM->WriteRow(j, &row[0]);
 	}
 }
 
@@ -980,16 +1002,9 @@ void vtHeightFieldGrid3d::ShadowCastDib(vtBitmapBase *pBM, const FPoint3 &light_
 	//  completely dark terrain.  We can catch this case up front.
 	if (light_dir.y > 0)
 	{
-		for (int i = 0; i < bitmap_size.x; i++)
-		{
-			for (int j = 0; j < bitmap_size.y; j++)
-			{
-				if (b8bit)
-					pBM->ScalePixel8(i, j, fAmbient);
-				else
-					pBM->ScalePixel24(i, j, fAmbient);
-			}
-		}
+		const std::vector<float> ambient(bitmap_size.x, fAmbient);
+		for (int j = 0; j < bitmap_size.y; j++)
+			pBM->ScaleRow(j, &ambient[0]);
 		return;
 	}
 
@@ -1150,6 +1165,7 @@ void vtHeightFieldGrid3d::ShadowCastDib(vtBitmapBase *pBM, const FPoint3 &light_
 
 	// Second pass.  Now we are going to loop through the LightMap and apply
 	//  the full lighting formula to each texel that has not been shaded yet.
+	std::vector<float> shades(bitmap_size.x);
 	for (int j = 0; j < bitmap_size.y; j++)
 	{
 		if (progress_callback != NULL && (j%20) == 0)
@@ -1157,6 +1173,7 @@ void vtHeightFieldGrid3d::ShadowCastDib(vtBitmapBase *pBM, const FPoint3 &light_
 
 		for (int i = 0; i < bitmap_size.x; i++)
 		{
+			shades[i] = 1.0f;
 			if (lightmap.Get(i, j) > 0)
 				continue;
 
@@ -1210,11 +1227,9 @@ void vtHeightFieldGrid3d::ShadowCastDib(vtBitmapBase *pBM, const FPoint3 &light_
 			// some anti-aliasing or edge softening algorithm to the LightMap.
 			// Once that's done, apply the whole LightMap to the DIB.
 			// LightMap[I][J]= shade; // set to value of the shading - see comment above)
-			if (b8bit)
-				pBM->ScalePixel8(i, bitmap_size.y-1-j, shade);
-			else
-				pBM->ScalePixel24(i, bitmap_size.y-1-j, shade);
+			shades[i] = shade;
 		}
+		pBM->ScaleRow(bitmap_size.y-1-j, &shades[0]);
 	}
 
 	// Possible TODO: Apply edge softening algorithm (?)
@@ -108,6 +108,9 @@ public:
 		bool bTrue = false, int iCultureFlags = 0,
 		FPoint3 *vNormal = NULL) const = 0;
 
+	virtual int FindAltitudesAtPoints(FPoint3 *points, int count,
+		bool bTrue = false, int iCultureFlags = 0) const;
+
 	/// Find the intersection point of a ray with the heightfield
 	virtual bool CastRayToSurface(const FPoint3 &point, const FPoint3 &dir,
 		FPoint3 &result) const = 0;
@@ -154,6 +157,8 @@ public:
 
 	bool CastRayToSurface(const FPoint3 &point, const FPoint3 &dir,
 		FPoint3 &result) const;
+	int FindAltitudesAtPoints(FPoint3 *points, int count,
+		bool bTrue = false, int iCultureFlags = 0) const;
 	bool LineOfSight(const FPoint3 &point1, const FPoint3 &point2) const;
 
 	/** Get the grid spacing, the width of each column and row. */
@@ -16,6 +16,10 @@
 #include "Projections.h"
 #include "LocalCS.h"
 
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
 ////////////////////////////////////////////////////////////////////////////
 
 LocalCS::LocalCS()
@@ -121,6 +125,90 @@ void LocalCS::EarthToLocal(const DRECT &earth, FRECT &world) const
 	EarthToLocal(earth.right, earth.top, world.right, world.top);
 }
 
+/**
+ * Convert many points from the coordinate system of the virtual world
+ * (x,y,z) to actual earth coodinates (map coordinates, altitude in meters).
+ * The results are exactly the same as converting each point by itself.
+ */
+void LocalCS::LocalToEarth(const FPoint3 *world, DPoint3 *earth, uint count) const
+{
+	uint i = 0;
+#if USE_SSE2
+	// Both horizontal axes at once
+	const __m128d origin = _mm_loadu_pd(&m_EarthOrigin.x);
+	const __m128d scale = _mm_loadu_pd(&m_Scale.x);
+	for (; i < count; i++)
+	{
+		const __m128d w = _mm_set_pd(-world[i].z, world[i].x);
+		_mm_storeu_pd(&earth[i].x, _mm_add_pd(origin, _mm_div_pd(w, scale)));
+		earth[i].z = world[i].y;
+	}
+#endif
+	for (; i < count; i++)
+		LocalToEarth(world[i], earth[i]);
+}
+
+/**
+ * Convert many points from earth coodinates (map coordinates) to the
+ * coordinate system of the virtual world.  Only the x and z of each world
+ * point are set; y is left alone, for example to receive the ground height.
+ * The results are exactly the same as converting each point by itself.
+ */
+void LocalCS::EarthToLocal(const DPoint2 *earth, FPoint3 *world, uint count) const
+{
+	uint i = 0;
+#if USE_SSE2
+	// Both horizontal axes at once: (earth - origin) * (sx, -sy)
+	const __m128d origin = _mm_loadu_pd(&m_EarthOrigin.x);
+	const __m128d scale = _mm_set_pd(-m_Scale.y, m_Scale.x);
+	for (; i < count; i++)
+	{
+		const __m128d e = _mm_loadu_pd(&earth[i].x);
+		const __m128 f = _mm_cvtpd_ps(_mm_mul_pd(_mm_sub_pd(e, origin), scale));
+		world[i].x = _mm_cvtss_f32(f);
+		world[i].z = _mm_cvtss_f32(_mm_shuffle_ps(f, f, 1));
+	}
+#endif
+	for (; i < count; i++)
+		EarthToLocal(earth[i].x, earth[i].y, world[i].x, world[i].z);
+}
+
+/**
+ * Convert many points from earth coodinates (map coordinates, altitude in
+ * meters) to the coordinate system of the virtual world (x,y,z).
+ * The results are exactly the same as converting each point by itself.
+ */
+void LocalCS::EarthToLocal(const DPoint3 *earth, FPoint3 *world, uint count) const
+{
+	uint i = 0;
+#if USE_SSE2
+	const __m128d origin = _mm_loadu_pd(&m_EarthOrigin.x);
+	const __m128d scale = _mm_set_pd(-m_Scale.y, m_Scale.x);
+	for (; i < count; i++)
+	{
+		const __m128d e = _mm_loadu_pd(&earth[i].x);
+		const __m128 f = _mm_cvtpd_ps(_mm_mul_pd(_mm_sub_pd(e, origin), scale));
+		world[i].x = _mm_cvtss_f32(f);
+		world[i].y = (float) earth[i].z;
+		world[i].z = _mm_cvtss_f32(_mm_shuffle_ps(f, f, 1));
+	}
+#endif
+	for (; i < count; i++)
+		EarthToLocal(earth[i], world[i]);
+}
+
+/**
+ * Convert a 3D polyline from earth coodinates (map coordinates, altitude in
+ * meters) to the coordinate system of the virtual world (x,y,z).
+ */
+void LocalCS::EarthToLocal(const DLine3 &earth, FLine3 &world) const
+{
+	const uint size = earth.GetSize();
+	world.SetSize(size);
+	if (size > 0)
+		EarthToLocal(earth.GetData(), world.GetData(), size);
+}
+
 /**
  * Convert a vector from the coordinate system of the virtual world (x,y,z)
  * to actual earth coodinates (map coordinates, altitude in meters)
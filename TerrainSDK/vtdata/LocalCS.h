@@ -36,6 +36,12 @@ public:
 	void EarthToLocal(const DPoint3 &earth, FPoint3 &world) const;
 	void EarthToLocal(const DRECT &earth, FRECT &world) const;
 
+	// Many points at once
+	void LocalToEarth(const FPoint3 *world, DPoint3 *earth, uint count) const;
+	void EarthToLocal(const DPoint2 *earth, FPoint3 *world, uint count) const;
+	void EarthToLocal(const DPoint3 *earth, FPoint3 *world, uint count) const;
+	void EarthToLocal(const DLine3 &earth, FLine3 &world) const;
+
 	void VectorLocalToEarth(float x, float z, DPoint2 &earth) const;
 	void VectorEarthToLocal(const DPoint2 &earth, float &x, float &z) const;
 
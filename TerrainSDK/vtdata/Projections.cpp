@@ -7,6 +7,8 @@
 // Parts of the code are derived from public-domain USGS software.
 //
 
+#include <algorithm>
+
 #include "Projections.h"
 #include "StatePlane.h"
 #include "MathTypes.h"
@@ -18,6 +20,10 @@
 // GDAL
 #include "cpl_csv.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 /**
  * Enumeration of the Datum types
  *
@@ -1054,6 +1060,250 @@ int DymaxOCT::TransformEx(int nCount, double *x, double *y, double *z, int *pabS
 	return iConverted != 0;
 }
 
+// atanh and asinh, which older compilers such as MSVC 2012 lack
+static inline double ArcTanh(double x)
+{
+	return 0.5 * log((1 + x) / (1 - x));
+}
+
+static inline double ArcSinh(double x)
+{
+	const double y = log(fabs(x) + sqrt(x*x + 1));
+	return (x < 0) ? -y : y;
+}
+
+// True unless the value is infinite or NaN
+static inline bool IsFinite(double x)
+{
+	return (x - x == 0.0);
+}
+
+/**
+ * A coordinate reference system which NativeOCT can convert to and from
+ * itself: Geographic, or Transverse Mercator (which includes UTM).
+ */
+class NativeCRS
+{
+public:
+	bool Setup(const vtProjection *proj);
+	bool SameAs(const NativeCRS &c) const;
+	void ToGeo(double x, double y, double &lon, double &lat) const;
+	void FromGeo(double lon, double lat, double &x, double &y) const;
+
+	bool m_bGeo;
+	double m_fToRadians;	// for geographic
+	double m_fToMeters;		// for Transverse Mercator
+	double m_k0, m_lon0, m_lat0, m_fe, m_fn;
+
+protected:
+	double ConformalTau(double tau) const;
+
+	// Ellipsoid constants for Kruger's series
+	double m_e, m_A, m_y0;
+	double m_alpha[7], m_beta[7];
+};
+
+bool NativeCRS::Setup(const vtProjection *proj)
+{
+	// Anything unusual, such as a proj.4 extension string, goes to PROJ
+	if (proj->IsDymaxion() || proj->GetAttrNode("EXTENSION") != NULL ||
+		proj->GetPrimeMeridian() != 0.0)
+		return false;
+
+	const double a = proj->GetSemiMajor();
+	const double invf = proj->GetInvFlattening();
+	const double f = (invf == 0.0) ? 0.0 : 1.0 / invf;
+
+	m_bGeo = (proj->IsGeographic() != 0);
+	if (m_bGeo)
+	{
+		m_fToRadians = proj->GetAngularUnits();
+		return true;
+	}
+	const char *proj_string = proj->GetAttrValue("PROJECTION");
+	if (!proj_string || !EQUAL(proj_string, SRS_PT_TRANSVERSE_MERCATOR))
+		return false;
+
+	m_fToMeters = proj->GetLinearUnits();
+	m_k0 = proj->GetNormProjParm(SRS_PP_SCALE_FACTOR, 1.0);
+	m_lon0 = proj->GetNormProjParm(SRS_PP_CENTRAL_MERIDIAN, 0.0) / 180.0 * PId;
+	m_lat0 = proj->GetNormProjParm(SRS_PP_LATITUDE_OF_ORIGIN, 0.0) / 180.0 * PId;
+	m_fe = proj->GetNormProjParm(SRS_PP_FALSE_EASTING, 0.0);
+	m_fn = proj->GetNormProjParm(SRS_PP_FALSE_NORTHING, 0.0);
+
+	// Kruger's series to 6th order in n, after Karney (2011), "Transverse
+	//  Mercator with an accuracy of a few nanometers".
+	const double n = f / (2 - f), n2 = n*n, n3 = n2*n, n4 = n3*n, n5 = n4*n, n6 = n5*n;
+	m_e = sqrt(f * (2 - f));
+	m_A = a / (1 + n) * (1 + n2/4 + n4/64 + n6/256);
+	m_alpha[1] = n/2 - 2*n2/3 + 5*n3/16 + 41*n4/180 - 127*n5/288 + 7891*n6/37800;
+	m_alpha[2] = 13*n2/48 - 3*n3/5 + 557*n4/1440 + 281*n5/630 - 1983433*n6/1935360;
+	m_alpha[3] = 61*n3/240 - 103*n4/140 + 15061*n5/26880 + 167603*n6/181440;
+	m_alpha[4] = 49561*n4/161280 - 179*n5/168 + 6601661*n6/7257600;
+	m_alpha[5] = 34729*n5/80640 - 3418889*n6/1995840;
+	m_alpha[6] = 212378941*n6/319334400;
+	m_beta[1] = n/2 - 2*n2/3 + 37*n3/96 - n4/360 - 81*n5/512 + 96199*n6/604800;
+	m_beta[2] = n2/48 + n3/15 - 437*n4/1440 + 46*n5/105 - 1118711*n6/3870720;
+	m_beta[3] = 17*n3/480 - 37*n4/840 - 209*n5/4480 + 5569*n6/90720;
+	m_beta[4] = 4397*n4/161280 - 11*n5/504 - 830251*n6/7257600;
+	m_beta[5] = 4583*n5/161280 - 108847*n6/3991680;
+	m_beta[6] = 20648693*n6/638668800;
+
+	// Northing of the latitude of origin
+	const double fn = m_fn;
+	double x, y;
+	m_fn = m_y0 = 0.0;
+	FromGeo(m_lon0, m_lat0, x, y);
+	m_y0 = y * m_fToMeters;
+	m_fn = fn;
+	return true;
+}
+
+bool NativeCRS::SameAs(const NativeCRS &c) const
+{
+	if (m_bGeo || c.m_bGeo)
+		return (m_bGeo && c.m_bGeo);
+	return (m_k0 == c.m_k0 && m_lon0 == c.m_lon0 && m_lat0 == c.m_lat0 &&
+		m_fe == c.m_fe && m_fn == c.m_fn);
+}
+
+double NativeCRS::ConformalTau(double tau) const
+{
+	const double sigma = sinh(m_e * ArcTanh(m_e * tau / sqrt(1 + tau*tau)));
+	return tau * sqrt(1 + sigma*sigma) - sigma * sqrt(1 + tau*tau);
+}
+
+/** From this CRS to longitude and latitude in radians. */
+void NativeCRS::ToGeo(double x, double y, double &lon, double &lat) const
+{
+	if (m_bGeo)
+	{
+		lon = x * m_fToRadians;
+		lat = y * m_fToRadians;
+		return;
+	}
+	const double xi = (y * m_fToMeters - m_fn + m_y0) / (m_k0 * m_A);
+	const double eta = (x * m_fToMeters - m_fe) / (m_k0 * m_A);
+	double xip = xi, etap = eta;
+	for (int j = 1; j <= 6; j++)
+	{
+		xip -= m_beta[j] * sin(2*j*xi) * cosh(2*j*eta);
+		etap -= m_beta[j] * cos(2*j*xi) * sinh(2*j*eta);
+	}
+	lon = m_lon0 + atan2(sinh(etap), cos(xip));
+
+	// Solve for the latitude from the conformal latitude, by Newton's method
+	const double taup = sin(xip) / sqrt(sinh(etap)*sinh(etap) + cos(xip)*cos(xip));
+	const double e2m = 1 - m_e * m_e;
+	double tau = taup;
+	for (int i = 0; i < 5; i++)
+	{
+		const double taupi = ConformalTau(tau);
+		const double dtau = (taup - taupi) / sqrt(1 + taupi*taupi) *
+			(1 + e2m * tau*tau) / (e2m * sqrt(1 + tau*tau));
+		tau += dtau;
+		if (fabs(dtau) < 1e-14)
+			break;
+	}
+	lat = atan(tau);
+}
+
+/** From longitude and latitude in radians to this CRS. */
+void NativeCRS::FromGeo(double lon, double lat, double &x, double &y) const
+{
+	if (m_bGeo)
+	{
+		x = lon / m_fToRadians;
+		y = lat / m_fToRadians;
+		return;
+	}
+	const double lam = lon - m_lon0;
+	const double taup = ConformalTau(tan(lat));
+	const double xip = atan2(taup, cos(lam));
+	const double etap = ArcSinh(sin(lam) / sqrt(taup*taup + cos(lam)*cos(lam)));
+	double xi = xip, eta = etap;
+	for (int j = 1; j <= 6; j++)
+	{
+		xi += m_alpha[j] * sin(2*j*xip) * cosh(2*j*etap);
+		eta += m_alpha[j] * cos(2*j*xip) * sinh(2*j*etap);
+	}
+	x = (m_fe + m_k0 * m_A * eta) / m_fToMeters;
+	y = (m_fn + m_k0 * m_A * xi - m_y0) / m_fToMeters;
+}
+
+/**
+ * A fast transform for conversions which need no datum shift, between
+ * Geographic and Transverse Mercator (including UTM) coordinates on the
+ * same datum.  It does the math itself, without PROJ, and is safe to share
+ * between threads.  Like DymaxOCT, it contains the standard OCT, which
+ * describes the source and target.
+ */
+class NativeOCT : public OCTransform
+{
+public:
+	NativeOCT(OCTransform *pStandard, const NativeCRS &source,
+		const NativeCRS &target)
+	{
+		m_pStandardTransform = pStandard;
+		m_source = source;
+		m_target = target;
+		m_bSame = source.SameAs(target);
+	}
+	~NativeOCT()
+	{
+		delete m_pStandardTransform;
+	}
+
+	OGRSpatialReference *GetSourceCS() { return m_pStandardTransform->GetSourceCS(); }
+	OGRSpatialReference *GetTargetCS() { return m_pStandardTransform->GetTargetCS(); }
+
+	int Transform(int nCount, double *x, double *y, double *z = NULL);
+	int TransformEx(int nCount, double *x, double *y, double *z = NULL, int *pabSuccess = NULL );
+
+	OCTransform *m_pStandardTransform;
+	NativeCRS m_source, m_target;
+	bool m_bSame;	// Same projection, perhaps different units
+};
+
+int NativeOCT::Transform(int nCount, double *x, double *y, double *z)
+{
+	return TransformEx(nCount, x, y, z, NULL);
+}
+
+int NativeOCT::TransformEx(int nCount, double *x, double *y, double *z, int *pabSuccess)
+{
+	int iFailed = 0;
+	double lon, lat;
+	for (int i = 0; i < nCount; i++)
+	{
+		bool bSuccess = true;
+		if (m_bSame && !m_source.m_bGeo)
+		{
+			// Only the linear units differ
+			x[i] = x[i] * m_source.m_fToMeters / m_target.m_fToMeters;
+			y[i] = y[i] * m_source.m_fToMeters / m_target.m_fToMeters;
+		}
+		else
+		{
+			m_source.ToGeo(x[i], y[i], lon, lat);
+
+			// There is nothing beyond the poles
+			if (fabs(lat) <= PId / 2)
+				m_target.FromGeo(lon, lat, x[i], y[i]);
+			else
+				bSuccess = false;
+		}
+		if (!IsFinite(x[i]) || !IsFinite(y[i]))
+			bSuccess = false;
+		if (!bSuccess)
+			iFailed++;
+		if (pabSuccess != NULL)
+			pabSuccess[i] = bSuccess ? TRUE : FALSE;
+	}
+	// Like OGR, FALSE if any point failed
+	return (iFailed == 0) ? TRUE : FALSE;
+}
+
 // display debugging information to the log
 void LogConvertingProjections(const vtProjection *pSource,
 							  const vtProjection *pTarget)
@@ -1106,6 +1356,9 @@ OCTransform *CreateCoordTransform(const vtProjection *pSource,
 		LogConvertingProjections(pSource, pTarget);
 	}
 
+	if (!result)
+		return NULL;
+
 	if (!pSource->IsDymaxion() && pTarget->IsDymaxion())
 	{
 		return new DymaxOCT(result, true);
@@ -1114,8 +1367,107 @@ OCTransform *CreateCoordTransform(const vtProjection *pSource,
 	{
 		return new DymaxOCT(result, false);
 	}
+
+	// Datum-free conversions can avoid PROJ
+	NativeCRS source, target;
+	if (source.Setup(pSource) && target.Setup(pTarget) &&
+		pSource->IsSameGeogCS(pTarget))
+	{
+		if (bLog)
+			VTLOG1(" Transform: using native math.\n");
+		return new NativeOCT(result, source, target);
+	}
+	return result;
+}
+
+/**
+ * Transform a large number of points, in batches on several threads.
+ * Each thread uses its own copy of the transform, unless the transform
+ * is safe to share.
+ *
+ * \param transform The transform to use.
+ * \param iCount The number of points.
+ * \param x, y Arrays of the coordinates, which are transformed in place.
+ * \param progress_callback If supplied, this is called with progress from
+ *		0 to 100.
+ * \return The number of points which failed to transform.
+ */
+int TransformPoints(OCTransform *transform, uint iCount, double *x, double *y,
+					bool progress_callback(int))
+{
+	if (iCount == 0)
+		return 0;
+
+	const int batch = 4096;
+	const int batches = (int) ((iCount + batch - 1) / batch);
+
+	// A Dymaxion transform can't be copied, but PROJ transforms can
+	int threads = 1;
+#ifdef _OPENMP
+	if (dynamic_cast<DymaxOCT*>(transform) == NULL)
+		threads = std::min(omp_get_max_threads(), batches);
+#endif
+	std::vector<OCTransform*> transforms(1, transform);
+	if (threads > 1 && dynamic_cast<NativeOCT*>(transform) == NULL)
+	{
+		ScopedLocale normal_numbers(LC_NUMERIC, "C");
+		for (int t = 1; t < threads; t++)
+		{
+			OCTransform *copy = OGRCreateCoordinateTransformation(
+				transform->GetSourceCS(), transform->GetTargetCS());
+			if (!copy)
+				break;
+			transforms.push_back(copy);
+		}
+		threads = (int) transforms.size();
+	}
 	else
-		return result;
+		transforms.resize(threads, transform);
+
+	int bad = 0;
+	int iDone = 0;
+	#pragma omp parallel for schedule(dynamic) num_threads(threads) reduction(+:bad)
+	for (int b = 0; b < batches; b++)
+	{
+#ifdef _OPENMP
+		OCTransform *local = transforms[omp_get_thread_num()];
+#else
+		OCTransform *local = transforms[0];
+#endif
+		const int first = b * batch;
+		const int count = std::min(batch, (int) iCount - first);
+		double x0[batch], y0[batch];
+		memcpy(x0, x + first, count * sizeof(double));
+		memcpy(y0, y + first, count * sizeof(double));
+		int success[batch];
+		if (!local->TransformEx(count, x + first, y + first, NULL, success))
+		{
+			// PROJ may fail a whole batch for one bad point, so start again
+			//  and transform each point on its own.
+			for (int i = 0; i < count; i++)
+			{
+				x[first + i] = x0[i];
+				y[first + i] = y0[i];
+				local->TransformEx(1, x + first + i, y + first + i, NULL, success + i);
+			}
+		}
+		for (int i = 0; i < count; i++)
+		{
+			if (!success[i])
+				bad++;
+		}
+
+		const int iFinished = vtAtomicIncrement(iDone);
+		if (progress_callback != NULL && vtIsFirstThread())
+			progress_callback(iFinished * 99 / batches);
+	}
+
+	for (uint t = 1; t < transforms.size(); t++)
+	{
+		if (transforms[t] != transform)
+			delete transforms[t];
+	}
+	return bad;
 }
 
 void TransformInPlace(OCTransform *transform, DPolygon2 &poly)
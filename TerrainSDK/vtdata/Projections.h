@@ -136,6 +136,8 @@ void CreateSimilarGeographicProjection(const vtProjection &source, vtProjection
 OCTransform *CreateTransformIgnoringDatum(const vtProjection *pSource, vtProjection *pTarget);
 OCTransform *CreateCoordTransform(const vtProjection *pSource,
 						  const vtProjection *pTarget, bool bLog = false);
+int TransformPoints(OCTransform *transform, uint iCount, double *x, double *y,
+					bool progress_callback(int) = NULL);
 void TransformInPlace(OCTransform *transform, DPolygon2 &poly);
 void TransformInPlace(OCTransform *transform, DLine2 &line);
 
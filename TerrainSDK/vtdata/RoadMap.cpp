@@ -1,13 +1,15 @@
 //
 // RoadMap.cpp
 //
-// Copyright (c) 2001-2012 Virtual Terrain Project
+// Copyright (c) 2001-2013 Virtual Terrain Project
 // Free for all uses, see license.txt for details.
 //
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <math.h>
+#include <algorithm>
 #include "RoadMap.h"
 #include "vtLog.h"
 #include "FilePath.h"
@@ -39,6 +41,7 @@ float diffAngle(float a, float b)
 TNode::TNode()
 {
 	m_pNext = NULL;
+	m_iIndex = -1;
 	m_id = -1;
 }
 
@@ -287,6 +290,7 @@ TLink::TLink()
 	m_Surface = SURFT_PAVED;
 	m_iHwy = -1;
 	m_pNext = NULL;
+	m_iIndex = -1;
 	m_id = 0;
 	m_iFlags = (RF_FORWARD|RF_REVERSE);	// by default, links are bidirectional
 	m_fHeight[0] = 0;
@@ -307,6 +311,10 @@ TLink::TLink(TLink &ref)
 {
 	*this = ref;
 //	DLine2::DLine2(ref);	// need to do this?
+
+	// the copy doesn't belong to any road map yet
+	m_pNext = NULL;
+	m_iIndex = -1;
 }
 
 TLink::~TLink()
@@ -505,8 +513,8 @@ vtRoadMap::vtRoadMap()
 	// provide inital values for extent
 	m_bValidExtents = false;
 
-	m_pFirstLink = NULL;
-	m_pFirstNode = NULL;
+	m_iNodesIndexed = 0;
+	m_fGridCell = 0.0;
 }
 
 
@@ -517,74 +525,289 @@ vtRoadMap::~vtRoadMap()
 
 void vtRoadMap::DeleteElements()
 {
-	TLink *nextR;
-	while (m_pFirstLink)
+	for (uint i = 0; i < m_Links.size(); i++)
+		delete m_Links[i];
+	m_Links.clear();
+
+	for (uint i = 0; i < m_Nodes.size(); i++)
+		delete m_Nodes[i];
+	m_Nodes.clear();
+
+	m_NodeIDs.clear();
+	m_iNodesIndexed = 0;
+	ClearNodeGrid();
+}
+
+//
+// Make the GetNext() chain agree with the arrays, around position i.
+//
+void vtRoadMap::RechainNodes(uint i)
+{
+	const uint size = m_Nodes.size();
+	if (i > 0 && i <= size)
+		m_Nodes[i-1]->SetNext(i < size ? m_Nodes[i] : NULL);
+	if (i < size)
+		m_Nodes[i]->SetNext(i+1 < size ? m_Nodes[i+1] : NULL);
+}
+
+void vtRoadMap::RechainLinks(uint i)
+{
+	const uint size = m_Links.size();
+	if (i > 0 && i <= size)
+		m_Links[i-1]->SetNext(i < size ? m_Links[i] : NULL);
+	if (i < size)
+		m_Links[i]->SetNext(i+1 < size ? m_Links[i+1] : NULL);
+}
+
+/**
+ * Add a node to the road map.  The road map takes ownership of the node,
+ * and will delete it.
+ */
+void vtRoadMap::AddNode(TNode *pNode)
+{
+	pNode->m_iIndex = m_Nodes.size();
+	m_Nodes.push_back(pNode);
+	RechainNodes(pNode->m_iIndex);
+}
+
+/**
+ * Add a link to the road map.  The road map takes ownership of the link,
+ * and will delete it.
+ */
+void vtRoadMap::AddLink(TLink *pLink)
+{
+	pLink->m_iIndex = m_Links.size();
+	m_Links.push_back(pLink);
+	RechainLinks(pLink->m_iIndex);
+}
+
+/**
+ * Move all the nodes and links of another road map into this one, leaving
+ * the other road map empty.
+ */
+void vtRoadMap::TakeElements(vtRoadMap &from)
+{
+	for (uint i = 0; i < from.m_Nodes.size(); i++)
+		AddNode(from.m_Nodes[i]);
+	for (uint i = 0; i < from.m_Links.size(); i++)
+		AddLink(from.m_Links[i]);
+
+	from.m_Nodes.clear();
+	from.m_Links.clear();
+	from.m_NodeIDs.clear();
+	from.m_iNodesIndexed = 0;
+	from.ClearNodeGrid();
+	from.m_bValidExtents = false;
+
+	m_bValidExtents = false;
+}
+
+//
+// Add the nodes which were added since the last lookup to the ID index,
+// and to the grid if there is one.
+//
+void vtRoadMap::IndexNewNodes()
+{
+	for (uint i = m_iNodesIndexed; i < m_Nodes.size(); i++)
 	{
-		nextR = m_pFirstLink->GetNext();
-		delete m_pFirstLink;
-		m_pFirstLink = nextR;
+		TNode *pN = m_Nodes[i];
+		m_NodeIDs[pN->m_id] = pN;
+		if (!m_NodeGrid.empty())
+			m_NodeGrid[GridBucket(pN->Pos())].push_back(pN);
 	}
+	m_iNodesIndexed = m_Nodes.size();
+}
 
-	TNode *nextN;
-	while (m_pFirstNode)
+void vtRoadMap::UngridNode(TNode *pNode)
+{
+	// Normally the node is in the bucket for its position, but look in
+	// all of them if it was moved without telling us.
+	std::vector<TNode*> &bucket = m_NodeGrid[GridBucket(pNode->Pos())];
+	std::vector<TNode*>::iterator it = std::find(bucket.begin(), bucket.end(), pNode);
+	if (it != bucket.end())
 	{
-		nextN = m_pFirstNode->GetNext();
-		delete m_pFirstNode;
-		m_pFirstNode = nextN;
+		bucket.erase(it);
+		return;
 	}
+	for (uint b = 0; b < m_NodeGrid.size(); b++)
+	{
+		it = std::find(m_NodeGrid[b].begin(), m_NodeGrid[b].end(), pNode);
+		if (it != m_NodeGrid[b].end())
+		{
+			m_NodeGrid[b].erase(it);
+			return;
+		}
+	}
+}
+
+//
+// Remove a node from the ID index and the grid, before it is deleted.
+//
+void vtRoadMap::ForgetNode(TNode *pNode)
+{
+	if (pNode->m_iIndex < 0 || (uint) pNode->m_iIndex >= m_iNodesIndexed)
+		return;		// never indexed
+
+	std::map<int, TNode*>::iterator it = m_NodeIDs.find(pNode->m_id);
+	if (it != m_NodeIDs.end() && it->second == pNode)
+		m_NodeIDs.erase(it);
+
+	if (!m_NodeGrid.empty())
+		UngridNode(pNode);
 }
 
+/**
+ * Find a node by its ID.  The index is kept up to date as nodes are added;
+ * to change the ID of a node which is already in the road map, use
+ * SetNodeID.
+ */
 TNode *vtRoadMap::FindNodeByID(int id)
 {
-	for (TNode *pN = m_pFirstNode; pN; pN = pN->GetNext())
+	IndexNewNodes();
+
+	std::map<int, TNode*>::iterator it = m_NodeIDs.find(id);
+	if (it != m_NodeIDs.end() && it->second->m_id != id)
+	{
+		// Someone changed an ID directly; start over.
+		m_NodeIDs.clear();
+		for (uint i = 0; i < m_Nodes.size(); i++)
+			m_NodeIDs[m_Nodes[i]->m_id] = m_Nodes[i];
+		it = m_NodeIDs.find(id);
+	}
+	if (it == m_NodeIDs.end())
+		return NULL;
+	return it->second;
+}
+
+/**
+ * Set the ID of a node, keeping the lookup for FindNodeByID up to date.
+ */
+void vtRoadMap::SetNodeID(TNode *pNode, int id)
+{
+	if (pNode->m_iIndex >= 0 && (uint) pNode->m_iIndex < m_iNodesIndexed)
 	{
-		if (pN->m_id == id)
-			return pN;
+		std::map<int, TNode*>::iterator it = m_NodeIDs.find(pNode->m_id);
+		if (it != m_NodeIDs.end() && it->second == pNode)
+			m_NodeIDs.erase(it);
+		m_NodeIDs[id] = pNode;
+	}
+	pNode->m_id = id;
+}
+
+int vtRoadMap::GridBucket(int cx, int cy) const
+{
+	const uint hash = ((uint) cx * 73856093u) ^ ((uint) cy * 19349663u);
+	return (int) (hash % m_NodeGrid.size());
+}
+
+int vtRoadMap::GridBucket(const DPoint2 &p) const
+{
+	return GridBucket((int) floor(p.x / m_fGridCell), (int) floor(p.y / m_fGridCell));
+}
+
+/**
+ * Build a spatial hash grid of the nodes, which makes FindNodeAtPoint fast
+ * when its epsilon is not much larger than the cell size.  This is meant for
+ * operations which look up many points, such as merging nodes.
+ *
+ * While the grid exists, a node already in the road map must be moved with
+ * MoveNode (rather than SetPos) for it to be found at its new position.
+ */
+void vtRoadMap::BuildNodeGrid(double fCellSize)
+{
+	ClearNodeGrid();
+	if (fCellSize <= 0)
+		return;
+
+	uint buckets = 64;
+	while (buckets < m_Nodes.size())
+		buckets <<= 1;
+
+	m_fGridCell = fCellSize;
+	m_NodeGrid.resize(buckets);
+	for (uint i = 0; i < m_iNodesIndexed; i++)
+		m_NodeGrid[GridBucket(m_Nodes[i]->Pos())].push_back(m_Nodes[i]);
+	IndexNewNodes();
+}
+
+void vtRoadMap::ClearNodeGrid()
+{
+	m_NodeGrid.clear();
+	m_fGridCell = 0.0;
+}
+
+/**
+ * Move a node, keeping the grid (if any) up to date.  Note that the links
+ * which meet at the node are not changed.
+ */
+void vtRoadMap::MoveNode(TNode *pNode, const DPoint2 &pos)
+{
+	const bool bGridded = !m_NodeGrid.empty() && pNode->m_iIndex >= 0 &&
+		(uint) pNode->m_iIndex < m_iNodesIndexed;
+	if (bGridded)
+		UngridNode(pNode);
+	pNode->SetPos(pos);
+	if (bGridded)
+		m_NodeGrid[GridBucket(pos)].push_back(pNode);
+}
+
+// Helper for FindNodeAtPoint
+static void ConsiderNode(TNode *node, const DPoint2 &point, const DRECT &target,
+						 const TNode *pIgnore, TNode *&closest, double &dist)
+{
+	if (node == pIgnore || !target.ContainsPoint(node->Pos()))
+		return;
+	const double result = (node->Pos() - point).Length();
+	if (result < dist)
+	{
+		closest = node;
+		dist = result;
 	}
-	return NULL;
 }
 
 /**
  * Find the node closest to the indicated point.  Ignore nodes more than
  * epsilon units away from the point.
+ *
+ * \param point The point to look near.
+ * \param epsilon The distance to look within.
+ * \param pIgnore Optionally, a node to ignore, such as a node at the point.
  */
-TNode *vtRoadMap::FindNodeAtPoint(const DPoint2 &point, double epsilon)
+TNode *vtRoadMap::FindNodeAtPoint(const DPoint2 &point, double epsilon,
+								  const TNode *pIgnore)
 {
 	TNode *closest = NULL;
-	double result, dist = 1E9;
+	double dist = 1E9;
 
 	// a target rectangle, to quickly cull points too far away
 	DRECT target(point.x-epsilon, point.y+epsilon, point.x+epsilon, point.y-epsilon);
-	for (TNode *curNode = GetFirstNode(); curNode; curNode = curNode->GetNext())
+
+	if (!m_NodeGrid.empty())
 	{
-		if (!target.ContainsPoint(curNode->Pos()))
-			continue;
-		result = (curNode->Pos() - point).Length();
-		if (result < dist)
+		const int cx0 = (int) floor(target.left / m_fGridCell);
+		const int cx1 = (int) floor(target.right / m_fGridCell);
+		const int cy0 = (int) floor(target.bottom / m_fGridCell);
+		const int cy1 = (int) floor(target.top / m_fGridCell);
+
+		// The grid only helps if the target covers a few of its cells
+		if ((double) (cx1 - cx0 + 1) * (cy1 - cy0 + 1) <= (double) m_NodeGrid.size())
 		{
-			closest = curNode;
-			dist = result;
+			IndexNewNodes();
+			for (int cy = cy0; cy <= cy1; cy++)
+				for (int cx = cx0; cx <= cx1; cx++)
+				{
+					const std::vector<TNode*> &bucket = m_NodeGrid[GridBucket(cx, cy)];
+					for (uint i = 0; i < bucket.size(); i++)
+						ConsiderNode(bucket[i], point, target, pIgnore, closest, dist);
+				}
+			return closest;
 		}
 	}
+	for (uint i = 0; i < m_Nodes.size(); i++)
+		ConsiderNode(m_Nodes[i], point, target, pIgnore, closest, dist);
 	return closest;
 }
 
-int	vtRoadMap::NumLinks() const
-{
-	int count = 0;
-	for (TLink *pL = m_pFirstLink; pL; pL = pL->GetNext())
-		count++;
-	return count;
-}
-
-int	vtRoadMap::NumNodes() const
-{
-	int count = 0;
-	for (TNode *pN = m_pFirstNode; pN; pN = pN->GetNext())
-		count++;
-	return count;
-}
-
 DRECT vtRoadMap::GetMapExtent()
 {
 	if (!m_bValidExtents)
@@ -606,10 +829,10 @@ void vtRoadMap::ComputeExtents()
 
 	// iterate through all elements accumulating extents
 	m_extents.SetInsideOut();
-	for (TLink *pL = m_pFirstLink; pL; pL = pL->GetNext())
+	for (uint i = 0; i < m_Links.size(); i++)
 	{
 		// links are a subclass of line, so we can treat them as lines
-		const DLine2 *dl = pL;
+		const DLine2 *dl = m_Links[i];
 		m_extents.GrowToContainLine(*dl);
 	}
 	m_bValidExtents = true;
@@ -622,84 +845,88 @@ int vtRoadMap::RemoveUnusedNodes()
 {
 	VTLOG("   vtRoadMap::RemoveUnusedNodes: ");
 
-	TNode *prev = NULL, *next;
-	TNode *pN = m_pFirstNode;
-	int total = 0, unused = 0;
-
-	while (pN)
+	// Compact the array in one pass, keeping the order of the remaining nodes
+	IndexNewNodes();
+	const uint total = m_Nodes.size();
+	uint kept = 0;
+	for (uint i = 0; i < total; i++)
 	{
-		total++;
-		next = pN->GetNext();
+		TNode *pN = m_Nodes[i];
 		if (pN->NumLinks() == 0)
 		{
-			// delete it
-			if (prev)
-				prev->SetNext(next);
-			else
-				m_pFirstNode = next;
+			ForgetNode(pN);
 			delete pN;
-			unused++;
 		}
 		else
-			prev = pN;
-		pN = next;
+		{
+			pN->m_iIndex = kept;
+			m_Nodes[kept++] = pN;
+		}
 	}
+	m_Nodes.resize(kept);
+	m_iNodesIndexed = kept;
+	for (uint i = 0; i < kept; i++)
+		RechainNodes(i);
+
+	const uint unused = total - kept;
 	VTLOG("   %d of %d removed\n", unused, total);
 	return unused;
 }
 
 /**
- * Remove a node, which also deletes it.
+ * Remove a node, which also deletes it.  The last node in the road map
+ * takes its place.
  */
 void vtRoadMap::RemoveNode(TNode *pNode)
 {
-	TNode *prev = NULL, *next;
-	TNode *pN = m_pFirstNode;
-
-	while (pN)
-	{
-		next = pN->GetNext();
-		if (pNode == pN)
-		{
-			// delete it
-			if (prev)
-				prev->SetNext(next);
-			else
-				m_pFirstNode = next;
-			delete pN;
-			break;
-		}
-		else
-			prev = pN;
-		pN = next;
-	}
+	const int i = pNode->m_iIndex;
+	if (i < 0 || i >= (int) m_Nodes.size() || m_Nodes[i] != pNode)
+		return;		// not ours
+
+	// The last node is about to move into this slot; index it first.
+	const uint last = m_Nodes.size() - 1;
+	if ((uint) i < m_iNodesIndexed && last >= m_iNodesIndexed)
+		IndexNewNodes();
+	ForgetNode(pNode);
+
+	m_Nodes[i] = m_Nodes[last];
+	m_Nodes[i]->m_iIndex = i;
+	m_Nodes.pop_back();
+	if (m_iNodesIndexed > m_Nodes.size())
+		m_iNodesIndexed = m_Nodes.size();
+
+	// Chain the moved node between its new neighbors, and end the chain at
+	//  the new last node, which still points to where the moved node was.
+	RechainNodes(i);
+	RechainNodes(m_Nodes.size());
+	assert(m_Nodes.empty() || m_Nodes.back()->GetNext() == NULL);
+	assert(i == 0 || i >= (int) m_Nodes.size() || m_Nodes[i-1]->GetNext() == m_Nodes[i]);
+
+	delete pNode;
 }
 
 /**
- * Remove a link, which also deletes it.
+ * Remove a link, which also deletes it.  The last link in the road map
+ * takes its place.
  */
 void vtRoadMap::RemoveLink(TLink *pLink)
 {
-	TLink *prev = NULL, *next;
-	TLink *pL = m_pFirstLink;
-
-	while (pL)
-	{
-		next = pL->GetNext();
-		if (pLink == pL)
-		{
-			// delete it
-			if (prev)
-				prev->SetNext(next);
-			else
-				m_pFirstLink = next;
-			delete pL;
-			break;
-		}
-		else
-			prev = pL;
-		pL = next;
-	}
+	const int i = pLink->m_iIndex;
+	if (i < 0 || i >= (int) m_Links.size() || m_Links[i] != pLink)
+		return;		// not ours
+
+	const uint last = m_Links.size() - 1;
+	m_Links[i] = m_Links[last];
+	m_Links[i]->m_iIndex = i;
+	m_Links.pop_back();
+
+	// As for nodes: the moved link, and the end of the chain
+	RechainLinks(i);
+	RechainLinks(m_Links.size());
+	assert(m_Links.empty() || m_Links.back()->GetNext() == NULL);
+	assert(i == 0 || i >= (int) m_Links.size() || m_Links[i-1]->GetNext() == m_Links[i]);
+
+	delete pLink;
 }
 
 /**
@@ -1001,7 +1228,7 @@ bool vtRoadMap::WriteRMF(const char *filename)
 	// go through and set id numbers (1-based) for the nodes and links
 	i= 1;
 	while (curNode) {
-		curNode->m_id = i++;
+		SetNodeID(curNode, i++);
 		curNode = curNode->GetNext();
 	}
 	i=1;
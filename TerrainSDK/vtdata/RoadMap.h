@@ -1,13 +1,14 @@
 //
 // RoadMap.h
 //
-// Copyright (c) 2001-2009 Virtual Terrain Project
+// Copyright (c) 2001-2013 Virtual Terrain Project
 // Free for all uses, see license.txt for details.
 //
 
 #ifndef ROADMAPH
 #define ROADMAPH
 
+#include <map>
 #include "DLG.h"
 
 #define RMFVERSION_STRING "RMFFile2.0"
@@ -96,9 +97,9 @@ public:
 	int FindLink(int linkID);	// returns internal number of link with given ID.  -1 if not found.
 	int m_id;
 
-	// Linked list
-	void SetNext(TNode *next) { m_pNext = next; }
+	// Iteration, in the order the road map stores the nodes
 	TNode *GetNext() const { return m_pNext; }
+	int GetIndex() const { return m_iIndex; }	// see vtRoadMap::GetNode
 
 	// Position
 	void SetPos(const DPoint2 &pos) { m_p = pos; }
@@ -110,8 +111,12 @@ public:
 	std::vector<float> m_fLinkAngle;
 
 protected:
+	friend class vtRoadMap;
+	void SetNext(TNode *next) { m_pNext = next; }
+
 	DPoint2 m_p;	// utm coordinates of center
 	TNode *m_pNext;
+	int m_iIndex;	// position in the road map's node array, -1 if none
 
 	// Information about the links that connect to or from this node.
 	std::vector<TLink*> m_connect;
@@ -184,8 +189,9 @@ public:
 	float	m_fLaneWidth;
 	float	m_fParkingWidth;
 
+	// Iteration, in the order the road map stores the links
 	TLink *GetNext() const { return m_pNext; }
-	void SetNext(TLink *next) { m_pNext = next; }
+	int GetIndex() const { return m_iIndex; }	// see vtRoadMap::GetLink
 
 	void SetIntersectionType(int n, IntersectionType t)
 	{
@@ -208,7 +214,11 @@ public:
 	}
 
 protected:
-	TLink	*m_pNext;		// Next in linked list
+	friend class vtRoadMap;
+	void SetNext(TLink *next) { m_pNext = next; }
+
+	TLink	*m_pNext;		// Next in the road map's order
+	int		m_iIndex;		// position in the road map's link array, -1 if none
 	TNode	*m_pNode[2];	// "from" and "to" nodes
 	float	m_fHeight[2];	// Height above the terrain heightfield
 
@@ -227,6 +237,11 @@ typedef TNode *TNodePtr;
  * is overdue to be replaced by some clean, extensible standard for
  * transportation networks.  Unforunately, such a standard does not yet
  * exist.
+ *
+ * Nodes and links are kept in arrays, so they can be counted, indexed and
+ * removed in constant time.  GetFirstNode/GetNext iterate in array order.
+ * Removing an element moves the last element into its place, so to remove
+ * elements while iterating, iterate by index from the end.
  */
 class vtRoadMap
 {
@@ -238,25 +253,20 @@ public:
 	DRECT GetMapExtent();		// get the geographical extent of the road map
 	void ComputeExtents();
 
-	int		NumLinks() const;	// returns number of links in the road map
-	int		NumNodes() const;	// returns number of nodes in the road map
+	int		NumLinks() const { return (int) m_Links.size(); }
+	int		NumNodes() const { return (int) m_Nodes.size(); }
 
-	TLink	*GetFirstLink() { return m_pFirstLink; }
-	TNode	*GetFirstNode() { return m_pFirstNode; }
+	TLink	*GetFirstLink() { return m_Links.empty() ? NULL : m_Links[0]; }
+	TNode	*GetFirstNode() { return m_Nodes.empty() ? NULL : m_Nodes[0]; }
+	TLink	*GetLink(int i) { return m_Links[i]; }
+	TNode	*GetNode(int i) { return m_Nodes[i]; }
 
 	virtual TNode *NewNode() { return new TNode; }
 	virtual TLink *NewLink() { return new TLink; }
 
-	void AddNode(TNode *pNode)
-	{
-		pNode->SetNext(m_pFirstNode);
-		m_pFirstNode = pNode;
-	}
-	void AddLink(TLink *pLink)
-	{
-		pLink->SetNext(m_pFirstLink);
-		m_pFirstLink = pLink;
-	}
+	void AddNode(TNode *pNode);
+	void AddLink(TLink *pLink);
+	void TakeElements(vtRoadMap &from);
 
 	virtual TNode *AddNewNode()
 	{
@@ -280,7 +290,13 @@ public:
 	}
 
 	TNode *FindNodeByID(int id);
-	TNode *FindNodeAtPoint(const DPoint2 &point, double epsilon);
+	void SetNodeID(TNode *pNode, int id);
+
+	TNode *FindNodeAtPoint(const DPoint2 &point, double epsilon,
+		const TNode *pIgnore = NULL);
+	void BuildNodeGrid(double fCellSize);
+	void ClearNodeGrid();
+	void MoveNode(TNode *pNode, const DPoint2 &pos);
 
 	// cleaning function: remove unused nodes, return the number removed
 	int RemoveUnusedNodes();
@@ -294,8 +310,26 @@ protected:
 	DRECT	m_extents;			// the extent of the roads in the RoadMap
 	bool	m_bValidExtents;	// true when extents are computed
 
-	TLink	*m_pFirstLink;
-	TNode	*m_pFirstNode;
+	std::vector<TLink*> m_Links;
+	std::vector<TNode*> m_Nodes;
+
+	void RechainNodes(uint i);
+	void RechainLinks(uint i);
+
+	// Lookup of nodes by ID, and in the grid.  Nodes at or past
+	// m_iNodesIndexed in the array have not been indexed yet, since their
+	// ID and position are usually assigned just after they are added.
+	void IndexNewNodes();
+	void ForgetNode(TNode *pNode);
+	std::map<int, TNode*> m_NodeIDs;
+	uint m_iNodesIndexed;
+
+	// Optional spatial hash grid of the nodes, see BuildNodeGrid
+	void UngridNode(TNode *pNode);
+	int GridBucket(int cx, int cy) const;
+	int GridBucket(const DPoint2 &p) const;
+	double m_fGridCell;
+	std::vector< std::vector<TNode*> > m_NodeGrid;
 
 	vtProjection	m_proj;
 };
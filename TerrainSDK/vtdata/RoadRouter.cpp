@@ -0,0 +1,660 @@
+//
+// RoadRouter.cpp
+//
+// Shortest routes through a road map: A*, bidirectional Dijkstra, and
+// contraction hierarchies.
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include <float.h>
+#include <time.h>
+#include <algorithm>
+#include "RoadRouter.h"
+#include "vtLog.h"
+
+// The straight-line distance is scaled down very slightly, so that rounding
+// of the (float) link lengths can't make the A* heuristic overestimate.
+#define HEURISTIC_SCALE		0.9999
+
+// How far a witness search may look before giving up, while contracting,
+// and while only estimating the effect of contracting a node.  Giving up
+// early only costs extra shortcuts, never correctness.
+#define WITNESS_SETTLE_LIMIT	500
+#define ESTIMATE_SETTLE_LIMIT	50
+
+static const char *s_MethodNames[] = { "A*", "bidirectional", "hierarchy" };
+
+
+//
+// Search state
+//
+void vtRoadRouter::Search::Resize(int nodes)
+{
+	stamp = 0;
+	reached.assign(nodes, 0);
+	settled.assign(nodes, 0);
+	dist.resize(nodes);
+	parent.resize(nodes);
+	queue = Queue();
+}
+
+void vtRoadRouter::Search::Start(int node)
+{
+	if (++stamp == 0)
+	{
+		// The stamp wrapped around, so clear the marks for real
+		reached.assign(reached.size(), 0);
+		settled.assign(settled.size(), 0);
+		stamp = 1;
+	}
+	queue = Queue();
+	Relax(node, 0.0, -1);
+	queue.push(Candidate(0.0, node));
+}
+
+double vtRoadRouter::Search::TopKey() const
+{
+	return queue.empty() ? DBL_MAX : queue.top().key;
+}
+
+// Returns true if this is the shortest distance to the node found so far.
+bool vtRoadRouter::Search::Relax(int n, double d, int edge)
+{
+	if (Reached(n) && dist[n] <= d)
+		return false;
+	reached[n] = stamp;
+	dist[n] = d;
+	parent[n] = edge;
+	return true;
+}
+
+
+//
+// vtRoadRouter
+//
+vtRoadRouter::vtRoadRouter()
+{
+	m_pMap = NULL;
+	m_iNodes = 0;
+	m_iOriginalEdges = 0;
+	m_Method = RM_ASTAR;
+	m_iMeet = -1;
+	m_iSettled = 0;
+	m_iCacheSize = 256;
+}
+
+/**
+ * Set the road map to route through.  The router copies what it needs of
+ * the road map's topology, so this must be called again if the road map
+ * changes.  Any hierarchy is discarded.
+ */
+bool vtRoadRouter::SetRoadMap(vtRoadMap *pMap)
+{
+	m_pMap = pMap;
+	m_Edges.clear();
+	m_Rank.clear();
+	m_UpOutStart.clear();
+	m_UpOutEdges.clear();
+	m_UpInStart.clear();
+	m_UpInEdges.clear();
+	ClearCache();
+
+	m_iNodes = pMap ? pMap->NumNodes() : 0;
+	m_Pos.resize(m_iNodes);
+	for (int i = 0; i < m_iNodes; i++)
+		m_Pos[i] = pMap->GetNode(i)->Pos();
+
+	if (pMap)
+	{
+		for (int i = 0; i < pMap->NumLinks(); i++)
+		{
+			TLink *link = pMap->GetLink(i);
+			const TNode *n0 = link->GetNode(0);
+			const TNode *n1 = link->GetNode(1);
+			if (!n0 || !n1 || n0 == n1)
+				continue;
+
+			Edge e;
+			e.cost = link->Length();
+			e.link = i;
+			e.child[0] = e.child[1] = -1;
+			if (link->GetFlag(RF_FORWARD))
+			{
+				e.from = n0->GetIndex();
+				e.to = n1->GetIndex();
+				m_Edges.push_back(e);
+			}
+			if (link->GetFlag(RF_REVERSE))
+			{
+				e.from = n1->GetIndex();
+				e.to = n0->GetIndex();
+				m_Edges.push_back(e);
+			}
+		}
+	}
+	m_iOriginalEdges = (int) m_Edges.size();
+
+	std::vector<int> ids(m_iOriginalEdges);
+	for (int i = 0; i < m_iOriginalEdges; i++)
+		ids[i] = i;
+	BuildAdjacency(m_OutStart, m_OutEdges, ids, false);
+	BuildAdjacency(m_InStart, m_InEdges, ids, true);
+
+	m_Forward.Resize(m_iNodes);
+	m_Backward.Resize(m_iNodes);
+
+	VTLOG("vtRoadRouter: %d nodes, %d directed edges\n", m_iNodes, m_iOriginalEdges);
+	return (pMap != NULL);
+}
+
+//
+// Lay out the given edges in compressed rows, grouped by the node they
+// leave from (or arrive at, if bByTarget).
+//
+void vtRoadRouter::BuildAdjacency(std::vector<int> &start, std::vector<int> &edges,
+								  const std::vector<int> &ids, bool bByTarget)
+{
+	start.assign(m_iNodes + 1, 0);
+	for (uint i = 0; i < ids.size(); i++)
+	{
+		const Edge &e = m_Edges[ids[i]];
+		start[(bByTarget ? e.to : e.from) + 1]++;
+	}
+	for (int i = 0; i < m_iNodes; i++)
+		start[i+1] += start[i];
+
+	std::vector<int> fill(start.begin(), start.end() - 1);
+	edges.resize(ids.size());
+	for (uint i = 0; i < ids.size(); i++)
+	{
+		const Edge &e = m_Edges[ids[i]];
+		edges[fill[bByTarget ? e.to : e.from]++] = ids[i];
+	}
+}
+
+void vtRoadRouter::SetCacheSize(uint iRoutes)
+{
+	m_iCacheSize = iRoutes;
+	while (m_Cache.size() > m_iCacheSize)
+	{
+		m_CacheIndex.erase(m_Cache.back().first);
+		m_Cache.pop_back();
+	}
+}
+
+void vtRoadRouter::ClearCache()
+{
+	m_Cache.clear();
+	m_CacheIndex.clear();
+}
+
+/**
+ * Find the shortest route from one node to another.
+ *
+ * \param pFrom, pTo Nodes of the road map given to SetRoadMap.
+ * \param route Receives the route, if there is one.
+ * \return true if there is a route.
+ */
+bool vtRoadRouter::FindRoute(const TNode *pFrom, const TNode *pTo, vtRoute &route)
+{
+	route.Clear();
+	m_iSettled = 0;
+	if (!m_pMap || !pFrom || !pTo)
+		return false;
+
+	const int s = pFrom->GetIndex();
+	const int t = pTo->GetIndex();
+	if (s < 0 || s >= m_iNodes || m_pMap->GetNode(s) != pFrom ||
+		t < 0 || t >= m_iNodes || m_pMap->GetNode(t) != pTo)
+		return false;	// not in our road map
+
+	const RouteKey key(s, t);
+	if (m_iCacheSize > 0)
+	{
+		std::map<RouteKey, CacheList::iterator>::iterator it = m_CacheIndex.find(key);
+		if (it != m_CacheIndex.end())
+		{
+			// Move it to the front
+			m_Cache.splice(m_Cache.begin(), m_Cache, it->second);
+			route = m_Cache.front().second;
+			return !route.IsEmpty();
+		}
+	}
+
+	bool bFound;
+	if (s == t)
+	{
+		m_iMeet = s;
+		bFound = true;
+	}
+	else if (m_Method == RM_ASTAR)
+		bFound = SearchAStar(s, t);
+	else
+		bFound = SearchBidirectional(s, t, m_Method == RM_HIERARCHY && HasHierarchy());
+
+	if (bFound)
+		MakeRoute(s, t, route);
+
+	if (m_iCacheSize > 0)
+	{
+		m_Cache.push_front(std::make_pair(key, route));
+		m_CacheIndex[key] = m_Cache.begin();
+		SetCacheSize(m_iCacheSize);
+	}
+	return bFound;
+}
+
+bool vtRoadRouter::SearchAStar(int s, int t)
+{
+	Search &fw = m_Forward;
+	const DPoint2 &target = m_Pos[t];
+
+	fw.Start(s);
+	while (!fw.queue.empty())
+	{
+		const int u = fw.queue.top().node;
+		fw.queue.pop();
+		if (fw.Settled(u))
+			continue;
+		fw.settled[u] = fw.stamp;
+		m_iSettled++;
+
+		if (u == t)
+		{
+			m_iMeet = t;
+			return true;
+		}
+		for (int i = m_OutStart[u]; i < m_OutStart[u+1]; i++)
+		{
+			const int id = m_OutEdges[i];
+			const int v = m_Edges[id].to;
+			if (fw.Settled(v))
+				continue;
+			const double d = fw.dist[u] + m_Edges[id].cost;
+			if (fw.Relax(v, d, id))
+				fw.queue.push(Candidate(d + (m_Pos[v] - target).Length() * HEURISTIC_SCALE, v));
+		}
+	}
+	return false;
+}
+
+//
+// Search from both ends, until the searches meet on the shortest route.
+// With the hierarchy, each search only goes up (to higher ranked nodes).
+//
+bool vtRoadRouter::SearchBidirectional(int s, int t, bool bHierarchy)
+{
+	m_Forward.Start(s);
+	m_Backward.Start(t);
+
+	const std::vector<int> &fstart = bHierarchy ? m_UpOutStart : m_OutStart;
+	const std::vector<int> &fedges = bHierarchy ? m_UpOutEdges : m_OutEdges;
+	const std::vector<int> &bstart = bHierarchy ? m_UpInStart : m_InStart;
+	const std::vector<int> &bedges = bHierarchy ? m_UpInEdges : m_InEdges;
+
+	double best = DBL_MAX;
+	m_iMeet = -1;
+
+	while (true)
+	{
+		const double kf = m_Forward.TopKey();
+		const double kb = m_Backward.TopKey();
+
+		// In the hierarchy, the route's top node may be far from the middle,
+		// so each side searches until it can't improve on the best.
+		if (bHierarchy ? (kf >= best && kb >= best) : (kf + kb >= best))
+			break;
+
+		const bool bForward = (kf <= kb);
+		Search &cur = bForward ? m_Forward : m_Backward;
+		Search &other = bForward ? m_Backward : m_Forward;
+
+		const Candidate c = cur.queue.top();
+		cur.queue.pop();
+		const int u = c.node;
+		if (cur.Settled(u) || c.key > cur.dist[u])
+			continue;
+		cur.settled[u] = cur.stamp;
+		m_iSettled++;
+
+		if (other.Reached(u) && cur.dist[u] + other.dist[u] < best)
+		{
+			best = cur.dist[u] + other.dist[u];
+			m_iMeet = u;
+		}
+
+		const std::vector<int> &start = bForward ? fstart : bstart;
+		const std::vector<int> &edges = bForward ? fedges : bedges;
+		for (int i = start[u]; i < start[u+1]; i++)
+		{
+			const int id = edges[i];
+			const Edge &e = m_Edges[id];
+			const int v = bForward ? e.to : e.from;
+			const double d = cur.dist[u] + e.cost;
+			if (!cur.Relax(v, d, id))
+				continue;
+			cur.queue.push(Candidate(d, v));
+			if (other.Reached(v) && d + other.dist[v] < best)
+			{
+				best = d + other.dist[v];
+				m_iMeet = v;
+			}
+		}
+	}
+	return (m_iMeet != -1);
+}
+
+//
+// Expand a (possibly shortcut) edge into the original edges it stands for.
+//
+void vtRoadRouter::UnpackEdge(int e, std::vector<int> &links)
+{
+	std::vector<int> stack(1, e);
+	while (!stack.empty())
+	{
+		const Edge &edge = m_Edges[stack.back()];
+		if (edge.link >= 0)
+			links.push_back(stack.back());
+		stack.pop_back();
+		if (edge.link < 0)
+		{
+			stack.push_back(edge.child[1]);
+			stack.push_back(edge.child[0]);
+		}
+	}
+}
+
+void vtRoadRouter::MakeRoute(int s, int t, vtRoute &route)
+{
+	// The edges from the start to the meeting point, then on to the end
+	std::vector<int> path;
+	for (int n = m_iMeet; n != s; n = m_Edges[path.back()].from)
+		path.push_back(m_Forward.parent[n]);
+	std::reverse(path.begin(), path.end());
+	for (int n = m_iMeet; n != t; n = m_Edges[path.back()].to)
+		path.push_back(m_Backward.parent[n]);
+
+	std::vector<int> edges;
+	for (uint i = 0; i < path.size(); i++)
+		UnpackEdge(path[i], edges);
+
+	route.Clear();
+	route.m_Nodes.reserve(edges.size() + 1);
+	route.m_Links.reserve(edges.size());
+	route.m_Nodes.push_back(m_pMap->GetNode(s));
+	for (uint i = 0; i < edges.size(); i++)
+	{
+		const Edge &e = m_Edges[edges[i]];
+		route.m_Links.push_back(m_pMap->GetLink(e.link));
+		route.m_Nodes.push_back(m_pMap->GetNode(e.to));
+		route.m_fLength += e.cost;
+	}
+}
+
+//
+// Look for paths from u which avoid v, up to the given length.  The
+// results are left in m_Forward.
+//
+void vtRoadRouter::WitnessSearch(int u, int v, double limit, int iMaxSettled,
+								 const std::vector< std::vector<int> > &out,
+								 const std::vector<bool> &contracted)
+{
+	Search &ws = m_Forward;
+	ws.Start(u);
+
+	int settled = 0;
+	while (!ws.queue.empty())
+	{
+		const Candidate c = ws.queue.top();
+		ws.queue.pop();
+		const int x = c.node;
+		if (ws.Settled(x) || c.key > ws.dist[x])
+			continue;
+		if (c.key > limit || ++settled > iMaxSettled)
+			break;
+		ws.settled[x] = ws.stamp;
+
+		for (uint i = 0; i < out[x].size(); i++)
+		{
+			const Edge &e = m_Edges[out[x][i]];
+			if (e.to == v || contracted[e.to])
+				continue;
+			const double d = ws.dist[x] + e.cost;
+			if (ws.Relax(e.to, d, out[x][i]))
+				ws.queue.push(Candidate(d, e.to));
+		}
+	}
+}
+
+//
+// Remove the edges which go to (or come from, if bFrom) node v.
+//
+void vtRoadRouter::DropEdges(std::vector<int> &edges, int v, bool bFrom)
+{
+	uint kept = 0;
+	for (uint i = 0; i < edges.size(); i++)
+	{
+		const Edge &e = m_Edges[edges[i]];
+		if ((bFrom ? e.from : e.to) != v)
+			edges[kept++] = edges[i];
+	}
+	edges.resize(kept);
+}
+
+//
+// Contract a node: add a shortcut for each shortest path which passes
+// through it.  Returns the edge difference (shortcuts added, less edges
+// removed), which is used to decide the order of contraction.  If
+// bSimulate, nothing is changed.
+//
+int vtRoadRouter::ContractNode(int v, bool bSimulate,
+							   std::vector< std::vector<int> > &out,
+							   std::vector< std::vector<int> > &in,
+							   const std::vector<bool> &contracted)
+{
+	int removed = 0, shortcuts = 0;
+	for (uint i = 0; i < in[v].size(); i++)
+		if (!contracted[m_Edges[in[v][i]].from])
+			removed++;
+	for (uint j = 0; j < out[v].size(); j++)
+		if (!contracted[m_Edges[out[v][j]].to])
+			removed++;
+
+	for (uint i = 0; i < in[v].size(); i++)
+	{
+		const int e1 = in[v][i];
+		const int u = m_Edges[e1].from;
+		if (contracted[u])
+			continue;
+
+		// The longest path through v which we need a witness for
+		double limit = 0;
+		for (uint j = 0; j < out[v].size(); j++)
+		{
+			const Edge &e2 = m_Edges[out[v][j]];
+			if (!contracted[e2.to] && e2.to != u)
+				limit = std::max(limit, (double) m_Edges[e1].cost + e2.cost);
+		}
+		if (limit == 0)
+			continue;
+		WitnessSearch(u, v, limit, bSimulate ? ESTIMATE_SETTLE_LIMIT : WITNESS_SETTLE_LIMIT,
+			out, contracted);
+
+		for (uint j = 0; j < out[v].size(); j++)
+		{
+			const int e2 = out[v][j];
+			const int w = m_Edges[e2].to;
+			if (contracted[w] || w == u)
+				continue;
+
+			const float via = m_Edges[e1].cost + m_Edges[e2].cost;
+			if (m_Forward.Reached(w) && m_Forward.dist[w] <= via)
+				continue;	// there is another way which is as short
+
+			shortcuts++;
+			if (bSimulate)
+				continue;
+
+			// Don't add it if there is already an edge which is as short
+			bool bHave = false;
+			for (uint k = 0; k < out[u].size() && !bHave; k++)
+			{
+				const Edge &e = m_Edges[out[u][k]];
+				bHave = (e.to == w && e.cost <= via);
+			}
+			if (bHave)
+				continue;
+
+			Edge sc;
+			sc.from = u;
+			sc.to = w;
+			sc.cost = via;
+			sc.link = -1;
+			sc.child[0] = e1;
+			sc.child[1] = e2;
+			out[u].push_back((int) m_Edges.size());
+			in[w].push_back((int) m_Edges.size());
+			m_Edges.push_back(sc);
+		}
+	}
+	return shortcuts - removed;
+}
+
+/**
+ * Preprocess the road map into a contraction hierarchy, which makes
+ * queries with RM_HIERARCHY much faster.  The nodes are contracted one at
+ * a time, least important first, adding shortcut edges to preserve the
+ * shortest routes between the remaining nodes.
+ */
+bool vtRoadRouter::BuildHierarchy(bool progress_callback(int))
+{
+	if (!m_pMap || m_iNodes == 0)
+		return false;
+
+	VTLOG1("vtRoadRouter: building contraction hierarchy\n");
+	clock_t tm1 = clock();
+
+	const int n = m_iNodes;
+	m_Edges.resize(m_iOriginalEdges);
+	ClearCache();
+
+	std::vector< std::vector<int> > out(n), in(n);
+	for (int i = 0; i < m_iOriginalEdges; i++)
+	{
+		out[m_Edges[i].from].push_back(i);
+		in[m_Edges[i].to].push_back(i);
+	}
+	std::vector<bool> contracted(n, false);
+	std::vector<int> deleted(n, 0);		// contracted neighbors of each node
+
+	Queue order;
+	for (int v = 0; v < n; v++)
+		order.push(Candidate(ContractNode(v, true, out, in, contracted), v));
+
+	m_Rank.assign(n, 0);
+	int rank = 0;
+	while (!order.empty())
+	{
+		const int v = order.top().node;
+		order.pop();
+		if (contracted[v])
+			continue;
+
+		// The priority may have gone up since it was queued; if so, requeue
+		const double priority = ContractNode(v, true, out, in, contracted) + deleted[v];
+		if (!order.empty() && priority > order.top().key)
+		{
+			order.push(Candidate(priority, v));
+			continue;
+		}
+		ContractNode(v, false, out, in, contracted);
+		contracted[v] = true;
+		m_Rank[v] = rank++;
+
+		// Drop the neighbors' edges to and from v, so that later searches
+		// don't have to step over them.
+		for (uint i = 0; i < in[v].size(); i++)
+		{
+			const int u = m_Edges[in[v][i]].from;
+			deleted[u]++;
+			DropEdges(out[u], v, false);
+		}
+		for (uint j = 0; j < out[v].size(); j++)
+		{
+			const int w = m_Edges[out[v][j]].to;
+			deleted[w]++;
+			DropEdges(in[w], v, true);
+		}
+
+		if (progress_callback != NULL && (rank % 1000) == 0)
+			progress_callback(rank * 99 / n);
+	}
+
+	// Split the edges into those going up from each node, and those coming
+	// down to each node (which the backward search follows up).
+	std::vector<int> up, down;
+	for (int i = 0; i < (int) m_Edges.size(); i++)
+	{
+		if (m_Rank[m_Edges[i].from] < m_Rank[m_Edges[i].to])
+			up.push_back(i);
+		else
+			down.push_back(i);
+	}
+	BuildAdjacency(m_UpOutStart, m_UpOutEdges, up, false);
+	BuildAdjacency(m_UpInStart, m_UpInEdges, down, true);
+
+	clock_t tm2 = clock();
+	VTLOG("  %d shortcuts added, %.2f seconds\n", (int) m_Edges.size() - m_iOriginalEdges,
+		(float) (tm2 - tm1) / CLOCKS_PER_SEC);
+	return true;
+}
+
+/**
+ * Time a number of queries between random pairs of nodes, with the current
+ * method and without the cache, and log the results.
+ *
+ * \return The number of queries per second.
+ */
+double vtRoadRouter::Benchmark(int iQueries, uint iSeed)
+{
+	if (!m_pMap || m_iNodes < 2 || iQueries < 1)
+		return 0;
+
+	// Pick the pairs first, so that only the queries are timed
+	std::vector<int> pairs(iQueries * 2);
+	uint r = iSeed;
+	for (int i = 0; i < iQueries * 2; i++)
+	{
+		r = r * 1103515245u + 12345u;
+		pairs[i] = (int) ((r >> 8) % (uint) m_iNodes);
+	}
+
+	const uint cache = m_iCacheSize;
+	SetCacheSize(0);
+
+	vtRoute route;
+	int found = 0;
+	double settled = 0;
+	clock_t tm1 = clock();
+	for (int i = 0; i < iQueries; i++)
+	{
+		if (FindRoute(m_pMap->GetNode(pairs[i*2]), m_pMap->GetNode(pairs[i*2+1]), route))
+			found++;
+		settled += m_iSettled;
+	}
+	clock_t tm2 = clock();
+
+	SetCacheSize(cache);
+
+	const double seconds = (double) (tm2 - tm1) / CLOCKS_PER_SEC;
+	const double rate = (seconds > 0) ? iQueries / seconds : 0;
+	RouteMethod method = m_Method;
+	if (method == RM_HIERARCHY && !HasHierarchy())
+		method = RM_BIDIRECTIONAL;
+	VTLOG("vtRoadRouter (%s): %d queries in %.3f s, %.0f queries/sec, %d routes found, %.0f nodes settled per query\n",
+		s_MethodNames[method], iQueries, seconds, rate, found, settled / iQueries);
+	return rate;
+}
+
@@ -0,0 +1,159 @@
+//
+// RoadRouter.h
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#ifndef ROADROUTERH
+#define ROADROUTERH
+
+#include <list>
+#include <map>
+#include <queue>
+#include "RoadMap.h"
+
+/**
+ * A path through a road map, as found by vtRoadRouter.
+ */
+struct vtRoute
+{
+	vtRoute() { m_fLength = 0; }
+	void Clear() { m_Nodes.clear(); m_Links.clear(); m_fLength = 0; }
+	bool IsEmpty() const { return m_Nodes.empty(); }
+
+	std::vector<TNode*> m_Nodes;	// from the start to the destination
+	std::vector<TLink*> m_Links;	// m_Links[i] goes from m_Nodes[i] to m_Nodes[i+1]
+	double m_fLength;				// in the horizontal units of the road map
+};
+
+enum RouteMethod
+{
+	RM_ASTAR,			// A* search, guided by straight-line distance
+	RM_BIDIRECTIONAL,	// Dijkstra's algorithm from both ends at once
+	RM_HIERARCHY		// contraction hierarchy, see vtRoadRouter::BuildHierarchy
+};
+
+/**
+ * Finds shortest routes through a vtRoadMap, following the direction of
+ * travel of each link (RF_FORWARD and RF_REVERSE).  The cost of a link is
+ * its length.
+ *
+ * The router takes a compact copy of the road map's topology when it is
+ * given the road map, so the road map should not be changed while the
+ * router is in use.  For many repeated queries, call BuildHierarchy once,
+ * which makes each query explore only a small part of the network.
+ *
+ * Recent routes are cached.  A router is not safe to use from several
+ * threads at once; use one per thread.
+ */
+class vtRoadRouter
+{
+public:
+	vtRoadRouter();
+
+	bool SetRoadMap(vtRoadMap *pMap);
+	vtRoadMap *GetRoadMap() const { return m_pMap; }
+
+	bool BuildHierarchy(bool progress_callback(int) = NULL);
+	bool HasHierarchy() const { return !m_Rank.empty(); }
+
+	void SetMethod(RouteMethod method) { m_Method = method; }
+	RouteMethod GetMethod() const { return m_Method; }
+
+	void SetCacheSize(uint iRoutes);
+	uint GetCacheSize() const { return m_iCacheSize; }
+	void ClearCache();
+
+	bool FindRoute(const TNode *pFrom, const TNode *pTo, vtRoute &route);
+
+	/// The number of nodes the last query explored (not counting cache hits)
+	int GetSettledCount() const { return m_iSettled; }
+
+	double Benchmark(int iQueries, uint iSeed = 1);
+
+protected:
+	struct Edge
+	{
+		int from, to;
+		float cost;
+		int link;		// index of the road map link, or -1 for a shortcut
+		int child[2];	// for a shortcut, the two edges it stands for
+	};
+
+	// An entry in a priority queue of nodes, smallest key first
+	struct Candidate
+	{
+		Candidate(double k, int n) : key(k), node(n) {}
+		bool operator<(const Candidate &c) const { return key > c.key; }
+		double key;
+		int node;
+	};
+	typedef std::priority_queue<Candidate> Queue;
+
+	// The state of one search direction.  Stamps avoid having to clear the
+	// arrays for each query.
+	struct Search
+	{
+		void Resize(int nodes);
+		void Start(int node);
+		bool Reached(int n) const { return reached[n] == stamp; }
+		bool Settled(int n) const { return settled[n] == stamp; }
+		double TopKey() const;
+		bool Relax(int n, double d, int edge);
+
+		uint stamp;
+		std::vector<uint> reached, settled;
+		std::vector<double> dist;
+		std::vector<int> parent;	// edge by which each node was reached
+		Queue queue;
+	};
+
+	void BuildAdjacency(std::vector<int> &start, std::vector<int> &edges,
+		const std::vector<int> &ids, bool bByTarget);
+
+	bool SearchAStar(int s, int t);
+	bool SearchBidirectional(int s, int t, bool bHierarchy);
+	void MakeRoute(int s, int t, vtRoute &route);
+	void UnpackEdge(int e, std::vector<int> &links);
+
+	// Contraction
+	int ContractNode(int v, bool bSimulate, std::vector< std::vector<int> > &out,
+		std::vector< std::vector<int> > &in, const std::vector<bool> &contracted);
+	void DropEdges(std::vector<int> &edges, int v, bool bFrom);
+	void WitnessSearch(int u, int v, double limit, int iMaxSettled,
+		const std::vector< std::vector<int> > &out, const std::vector<bool> &contracted);
+
+	vtRoadMap *m_pMap;
+	int m_iNodes;
+	int m_iOriginalEdges;
+	std::vector<Edge> m_Edges;
+	std::vector<DPoint2> m_Pos;
+
+	// Adjacency (compressed rows): the edges out of node i are
+	// m_OutEdges[m_OutStart[i] .. m_OutStart[i+1]-1], and likewise for the
+	// edges into each node.
+	std::vector<int> m_OutStart, m_OutEdges;
+	std::vector<int> m_InStart, m_InEdges;
+
+	// The hierarchy: each node's rank, the edges up from each node, and the
+	// edges which arrive at each node from above.
+	std::vector<int> m_Rank;
+	std::vector<int> m_UpOutStart, m_UpOutEdges;
+	std::vector<int> m_UpInStart, m_UpInEdges;
+
+	RouteMethod m_Method;
+	Search m_Forward, m_Backward;
+	int m_iMeet;
+	int m_iSettled;
+
+	// Cache of recent routes, most recent first
+	typedef std::pair<int, int> RouteKey;
+	typedef std::list<std::pair<RouteKey, vtRoute> > CacheList;
+	CacheList m_Cache;
+	std::map<RouteKey, CacheList::iterator> m_CacheIndex;
+	uint m_iCacheSize;
+};
+
+#endif	// ROADROUTERH
+
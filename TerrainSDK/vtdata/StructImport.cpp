@@ -6,7 +6,7 @@
 //
 
 #include "Building.h"
-#include "Features.h"
+#include "FeatureCursor.h"
 #include "Fence.h"
 #include "MaterialDescriptor.h"
 #include "PolyChecker.h"
@@ -209,29 +209,13 @@ bool vtStructureArray::ReadSHP(const char *pathname, StructImportOptions &opt,
 {
 	VTLOG("vtStructureArray::ReadSHP(%s)\n", pathname);
 
-	// SHPOpen doesn't yet support utf-8 or wide filenames, so convert
-	vtString fname_local = UTF8ToLocal(pathname);
-
-	SHPHandle hSHP = SHPOpen(fname_local, "rb");
-	if (hSHP == NULL)
+	// Read the file a batch at a time, so that it needn't fit in memory
+	vtFeatureCursor cursor;
+	if (!cursor.Open(pathname))
 		return false;
 
-	int		nEntities, nShapeType;
-	DPoint2 point;
-	DLine2	line;
-	int		i, j;
-	int		field_height = -1;
-	int		field_roof = -1;
-	int		field_filename = -1;
-	int		field_itemname = -1;
-	int		field_scale = -1;
-	int		field_rotation = -1;
-	PolyChecker PolyChecker;
-
-	SHPGetInfo(hSHP, &nEntities, &nShapeType, NULL, NULL);
-
-	// Open DBF File & Get DBF Info:
-	DBFHandle db = DBFOpen(fname_local, "rb");
+	int nShapeType = cursor.GetShapeType();
+	vtStringArray fieldnames;
 
 	// Make sure that entities are of the expected type
 	if (opt.type == ST_BUILDING)
@@ -242,208 +226,251 @@ bool vtStructureArray::ReadSHP(const char *pathname, StructImportOptions &opt,
 			nShapeType != SHPT_ARC &&
 			nShapeType != SHPT_POLYGONZ)
 			return false;
-		if (db != NULL)
-		{
-			// Check for field with number of stories
-			field_height = FindDBField(db, opt.m_strFieldNameHeight);
-			// Check for field with number of stories
-			field_roof = FindDBField(db, opt.m_strFieldNameRoof);
-		}
+		// Fields with number of stories, and roof type
+		fieldnames.push_back(opt.m_strFieldNameHeight);
+		fieldnames.push_back(opt.m_strFieldNameRoof);
 	}
 	if (opt.type == ST_INSTANCE)
 	{
 		if (nShapeType != SHPT_POINT &&
 			nShapeType != SHPT_POINTZ)
 			return false;
-		if (db == NULL)
-			return false;
-
-		field_filename = FindDBField(db, (const char *)opt.m_strFieldNameFile);
-		field_itemname = FindDBField(db, "itemname");
-		if (field_filename == -1 && field_itemname == -1)
-			return false;
-
-		field_scale = FindDBField(db, "scale");
-		field_rotation = FindDBField(db, "rotation");
+		fieldnames.push_back(opt.m_strFieldNameFile);
+		fieldnames.push_back("itemname");
+		fieldnames.push_back("scale");
+		fieldnames.push_back("rotation");
 	}
 	if (opt.type == ST_LINEAR)
 	{
 		if (nShapeType != SHPT_ARC && nShapeType != SHPT_POLYGON)
 			return false;
 	}
+	cursor.SelectFields(fieldnames);
 
-	int iEmptyEntities = 0;
-	for (i = 0; i < nEntities; i++)
-	{
-		if (progress_callback != NULL && (i & 0xff) == 0)
-			progress_callback(i * 100 / nEntities);
+	// do exclusion of shapes outside the indicated extents
+	if (opt.bInsideOnly)
+		cursor.SetFilter(opt.rect);
 
-		SHPObject *psShape = SHPReadObject(hSHP, i);
-		if (!psShape)
-		{
-			iEmptyEntities++;
-			continue;
-		}
+	vtFeatureSet *pSet = cursor.CreateFeatureSet();
+	if (!pSet)
+		return false;
 
-		if (opt.bInsideOnly)
+	vtFeatureSetPoint2D *pSetP2 = dynamic_cast<vtFeatureSetPoint2D *>(pSet);
+	vtFeatureSetPoint3D *pSetP3 = dynamic_cast<vtFeatureSetPoint3D *>(pSet);
+	vtFeatureSetLineString *pSetLine = dynamic_cast<vtFeatureSetLineString *>(pSet);
+	vtFeatureSetPolygon *pSetPoly = dynamic_cast<vtFeatureSetPolygon *>(pSet);
+
+	int field_height = -1;
+	int field_roof = -1;
+	int field_filename = -1;
+	int field_itemname = -1;
+	int field_scale = -1;
+	int field_rotation = -1;
+	if (opt.type == ST_BUILDING)
+	{
+		field_height = pSet->GetFieldIndex(opt.m_strFieldNameHeight);
+		field_roof = pSet->GetFieldIndex(opt.m_strFieldNameRoof);
+	}
+	if (opt.type == ST_INSTANCE)
+	{
+		field_filename = pSet->GetFieldIndex(opt.m_strFieldNameFile);
+		field_itemname = pSet->GetFieldIndex("itemname");
+		if (field_filename == -1 && field_itemname == -1)
 		{
-			// do exclusion of shapes outside the indicated extents
-			if (psShape->dfXMax < opt.rect.left ||
-				psShape->dfXMin > opt.rect.right ||
-				psShape->dfYMax < opt.rect.bottom ||
-				psShape->dfYMin > opt.rect.top)
-			{
-				SHPDestroyObject(psShape);
-				continue;
-			}
+			delete pSet;
+			return false;
 		}
+		field_scale = pSet->GetFieldIndex("scale");
+		field_rotation = pSet->GetFieldIndex("rotation");
+	}
 
-		int num_points = psShape->nVertices;
-		if (opt.type == ST_BUILDING)
-		{
-			vtBuilding *bld = AddNewBuilding();
-			if (nShapeType == SHPT_POINT || nShapeType == SHPT_POINTZ)
-			{
-				point.x = psShape->padfX[0];
-				point.y = psShape->padfY[0];
-				bld->SetRectangle(point, 10, 10);	// default size
-			}
-			if (nShapeType == SHPT_POLYGON || nShapeType == SHPT_POLYGONZ ||
-				nShapeType == SHPT_ARC)
-			{
-				DPolygon2 foot;
-				SHPToDPolygon2(psShape, foot);
+	DPoint2 point;
+	PolyChecker PolyChecker;
+	uint i, j, next, num;
+	while ((num = cursor.ReadBatch(pSet)) > 0)
+	{
+		if (progress_callback != NULL)
+			progress_callback(cursor.GetProgress());
 
-				// test clockwisdom and reverse if necessary
-				if (PolyChecker.IsClockwisePolygon(foot[0]))
-					foot.ReverseOrder();
+		// A line shape with several parts is read as one feature per part,
+		//  so gather the features of each record into one structure.
+		for (i = 0; i < num; i = next)
+		{
+			next = i + 1;
+			while (next < num && cursor.GetRecord(next) == cursor.GetRecord(i))
+				next++;
 
-				bld->SetFootprint(0, foot);
-				// Give it a flat roof with the same footprint
-				bld->SetFootprint(1, foot);
-				bld->SetRoofType(ROOF_FLAT);
+			if (pSetP2)
+				point = pSetP2->GetPoint(i);
+			if (pSetP3)
+			{
+				const DPoint3 &p3 = pSetP3->GetPoint(i);
+				point.Set(p3.x, p3.y);
 			}
 
-			// attempt to get height from the DBF
-			int stories;
-			if (field_height != -1)
+			if (opt.type == ST_BUILDING)
 			{
-				double height = DBFReadDoubleAttribute(db, i, field_height);
-				switch (opt.m_HeightType)
+				vtBuilding *bld = AddNewBuilding();
+				if (pSetP2 || pSetP3)
+					bld->SetRectangle(point, 10, 10);	// default size
+				if (pSetPoly || pSetLine)
 				{
-				case StructImportOptions::STORIES:
-					stories = (int) height;
-					if (stories >= 1)
-						bld->SetNumStories(stories);
-					break;
-				case StructImportOptions::FEET:
-					height = height * 0.3048;
-				case StructImportOptions::METERS:
-					stories = (int) (height / 3.2);
-					if (stories < 1)
-						stories = 1;
-					bld->SetNumStories((int) stories);
-					bld->GetLevel(0)->m_fStoryHeight = (float) (height / stories);
-					break;
-				case StructImportOptions::FEETNOSTORIES:
-					height = height * 0.3048;
-				case StructImportOptions::METERSNOSTORIES:
-					stories = (int) (height / 3.2);
-					if (stories < 1)
-						stories = 1;
-					bld->SetNumStories(1);
-					bld->GetLevel(0)->m_fStoryHeight = (float) (height);
-					break;
+					DPolygon2 foot;
+					if (pSetPoly)
+						foot = pSetPoly->GetPolygon(i);
+					else
+					{
+						// Each part is a closed line; ignore the duplicated
+						//  first point
+						for (j = i; j < next; j++)
+						{
+							DLine2 line = pSetLine->GetPolyLine(j);
+							if (line.GetSize() > 1 && line[0] == line[line.GetSize()-1])
+								line.RemoveAt(line.GetSize()-1);
+							foot.push_back(line);
+						}
+					}
+
+					// test clockwisdom and reverse if necessary
+					if (PolyChecker.IsClockwisePolygon(foot[0]))
+						foot.ReverseOrder();
+
+					bld->SetFootprint(0, foot);
+					// Give it a flat roof with the same footprint
+					bld->SetFootprint(1, foot);
+					bld->SetRoofType(ROOF_FLAT);
 				}
-			}
-			// if DBF didn't have height info, get it from default building
-			bool bDoHeight = (field_height == -1);
 
-			// Apply materials, edge slopes and other things from the default
-			//  building, if there is one.
-			vtBuilding *pDefBld = GetClosestDefault(bld);
-			if (pDefBld)
-				bld->CopyStyleFrom(pDefBld, bDoHeight);
+				// attempt to get height from the DBF
+				int stories;
+				if (field_height != -1)
+				{
+					double height = pSet->GetDoubleValue(i, field_height);
+					switch (opt.m_HeightType)
+					{
+					case StructImportOptions::STORIES:
+						stories = (int) height;
+						if (stories >= 1)
+							bld->SetNumStories(stories);
+						break;
+					case StructImportOptions::FEET:
+						height = height * 0.3048;
+					case StructImportOptions::METERS:
+						stories = (int) (height / 3.2);
+						if (stories < 1)
+							stories = 1;
+						bld->SetNumStories((int) stories);
+						bld->GetLevel(0)->m_fStoryHeight = (float) (height / stories);
+						break;
+					case StructImportOptions::FEETNOSTORIES:
+						height = height * 0.3048;
+					case StructImportOptions::METERSNOSTORIES:
+						stories = (int) (height / 3.2);
+						if (stories < 1)
+							stories = 1;
+						bld->SetNumStories(1);
+						bld->GetLevel(0)->m_fStoryHeight = (float) (height);
+						break;
+					}
+				}
+				// if DBF didn't have height info, get it from default building
+				bool bDoHeight = (field_height == -1);
 
-			// Apply explicit colors, if they were specified.
-			if (opt.m_bFixedColor)
-			{
-				bld->SetColor(BLD_BASIC, opt.m_BuildingColor);
-				bld->SetColor(BLD_ROOF, opt.m_RoofColor);
-			}
+				// Apply materials, edge slopes and other things from the default
+				//  building, if there is one.
+				vtBuilding *pDefBld = GetClosestDefault(bld);
+				if (pDefBld)
+					bld->CopyStyleFrom(pDefBld, bDoHeight);
 
-			// Now deal with roof type, which the user might have specified.
-			if (field_roof != -1)
-			{
-				vtString type = DBFReadStringAttribute(db, i, field_roof);
-				if (!type.CompareNoCase("flat") || !type.CompareNoCase("plat"))
-					bld->SetRoofType(ROOF_FLAT);
-				if (!type.CompareNoCase("shed") || !type.CompareNoCase("hangar"))
-					bld->SetRoofType(ROOF_SHED, opt.m_iSlope);
-				if (!type.CompareNoCase("gable") || !type.CompareNoCase("pignon"))
-					bld->SetRoofType(ROOF_GABLE, opt.m_iSlope);
-				if (!type.CompareNoCase("hip") || !type.CompareNoCase("arete"))
-					bld->SetRoofType(ROOF_HIP, opt.m_iSlope);
-			}
-			// Apply explicit roof type, if specified.
-			else if (opt.m_eRoofType != ROOF_UNKNOWN)
-				bld->SetRoofType(opt.m_eRoofType, opt.m_iSlope);
-		}
-		if (opt.type == ST_INSTANCE)
-		{
-			vtStructInstance *inst = AddNewInstance();
-			inst->SetPoint(DPoint2(psShape->padfX[0], psShape->padfY[0]));
-			// attempt to get properties from the DBF
-			const char *string;
-			vtTag tag;
-			if (field_filename != -1)
-			{
-				string = DBFReadStringAttribute(db, i, field_filename);
-				tag.name = "filename";
-				tag.value = string;
-				inst->AddTag(tag);
-			}
-			if (field_itemname != -1)
-			{
-				string = DBFReadStringAttribute(db, i, field_itemname);
-				tag.name = "itemname";
-				tag.value = string;
-				inst->AddTag(tag);
+				// Apply explicit colors, if they were specified.
+				if (opt.m_bFixedColor)
+				{
+					bld->SetColor(BLD_BASIC, opt.m_BuildingColor);
+					bld->SetColor(BLD_ROOF, opt.m_RoofColor);
+				}
+
+				// Now deal with roof type, which the user might have specified.
+				if (field_roof != -1)
+				{
+					vtString type;
+					pSet->GetValueAsString(i, field_roof, type);
+					if (!type.CompareNoCase("flat") || !type.CompareNoCase("plat"))
+						bld->SetRoofType(ROOF_FLAT);
+					if (!type.CompareNoCase("shed") || !type.CompareNoCase("hangar"))
+						bld->SetRoofType(ROOF_SHED, opt.m_iSlope);
+					if (!type.CompareNoCase("gable") || !type.CompareNoCase("pignon"))
+						bld->SetRoofType(ROOF_GABLE, opt.m_iSlope);
+					if (!type.CompareNoCase("hip") || !type.CompareNoCase("arete"))
+						bld->SetRoofType(ROOF_HIP, opt.m_iSlope);
+				}
+				// Apply explicit roof type, if specified.
+				else if (opt.m_eRoofType != ROOF_UNKNOWN)
+					bld->SetRoofType(opt.m_eRoofType, opt.m_iSlope);
 			}
-			if (field_scale != -1)
+			if (opt.type == ST_INSTANCE)
 			{
-				double scale = DBFReadDoubleAttribute(db, i, field_scale);
-				if (scale != 1.0)
+				vtStructInstance *inst = AddNewInstance();
+				inst->SetPoint(point);
+				// attempt to get properties from the DBF
+				vtTag tag;
+				if (field_filename != -1)
 				{
-					tag.name = "scale";
-					tag.value.Format("%lf", scale);
+					tag.name = "filename";
+					pSet->GetValueAsString(i, field_filename, tag.value);
 					inst->AddTag(tag);
 				}
+				if (field_itemname != -1)
+				{
+					tag.name = "itemname";
+					pSet->GetValueAsString(i, field_itemname, tag.value);
+					inst->AddTag(tag);
+				}
+				if (field_scale != -1)
+				{
+					double scale = pSet->GetDoubleValue(i, field_scale);
+					if (scale != 1.0)
+					{
+						tag.name = "scale";
+						tag.value.Format("%lf", scale);
+						inst->AddTag(tag);
+					}
+				}
+				if (field_rotation != -1)
+				{
+					double rotation = pSet->GetDoubleValue(i, field_rotation);
+					inst->SetRotation((float)rotation / 180.0f * PIf);
+				}
 			}
-			if (field_rotation != -1)
-			{
-				double rotation = DBFReadDoubleAttribute(db, i, field_rotation);
-				inst->SetRotation((float)rotation / 180.0f * PIf);
-			}
-		}
-		if (opt.type == ST_LINEAR)
-		{
-			vtFence *fen = AddNewFence();
-			for (j = 0; j < num_points; j++)
+			if (opt.type == ST_LINEAR)
 			{
-				point.x = psShape->padfX[j];
-				point.y = psShape->padfY[j];
-				fen->AddPoint(point);
+				// One fence through all the parts or rings, one after another
+				vtFence *fen = AddNewFence();
+				if (pSetPoly)
+				{
+					const DPolygon2 &poly = pSetPoly->GetPolygon(i);
+					for (uint ring = 0; ring < poly.size(); ring++)
+					{
+						const DLine2 &line = poly[ring];
+						for (j = 0; j < line.GetSize(); j++)
+							fen->AddPoint(line[j]);
+						// Polygon rings are closed
+						if (line.GetSize() > 0)
+							fen->AddPoint(line[0]);
+					}
+				}
+				else
+				{
+					for (uint part = i; part < next; part++)
+					{
+						const DLine2 &line = pSetLine->GetPolyLine(part);
+						for (j = 0; j < line.GetSize(); j++)
+							fen->AddPoint(line[j]);
+					}
+				}
 			}
 		}
-		SHPDestroyObject(psShape);
 	}
-	if (db != NULL)
-		DBFClose(db);
-	SHPClose(hSHP);
-
-	if (iEmptyEntities)
-		VTLOG("\t Warning: %d of %d entities were empty.\n", iEmptyEntities, nEntities);
+	delete pSet;
 
 	VTLOG1("\tReadSHP done.\n");
 	return true;
@@ -0,0 +1,1073 @@
+//
+// TinBuilder.cpp
+//
+// Build large Delaunay TINs a tile at a time, in parallel.
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "TinBuilder.h"
+#include "ElevationGrid.h"
+#include "FilePath.h"
+#include "Gridder.h"
+#include "vtTin.h"
+#include "vtLog.h"
+
+#define ANSI_DECLARATORS
+#define REAL double
+extern "C" {
+#include "triangle/triangle.h"
+}
+
+// Average number of points in each cell of a PointCells
+#define CELL_POINTS		8
+
+// Point states, while building
+#define PS_UNUSED		0
+#define PS_USED			1
+#define PS_DUPLICATE	2
+
+// Rounds of decimation, at most
+#define MAX_ROUNDS		100
+
+// Heixels on each side of the blocks a grid is divided into
+#define GRID_BLOCK		128
+
+
+///////////////////////////////////////////////////////////////////////
+// Helpers
+
+/**
+ * Triangulate a set of points with the Triangle library.  The triangles,
+ * counterclockwise, are three indices each into the points.  Optionally,
+ * the neighbors of each triangle are also given: the first is the triangle
+ * opposite the first corner, and so on, or -1 for none.
+ *
+ * Triangle is not reentrant: it keeps process-wide globals, such as the
+ * error bounds set by exactinit() and the seed for its random sampling.
+ * So the call to triangulate() is in a critical section, which any other
+ * code that calls Triangle on a thread of an OpenMP loop should share.
+ */
+static void TrianglePoints(const std::vector<DPoint2> &points, std::vector<int> &tris,
+	std::vector<int> *neighbors)
+{
+	tris.clear();
+	if (neighbors)
+		neighbors->clear();
+	if (points.size() < 3)
+		return;
+
+	struct triangulateio in, out;
+	memset(&in, 0, sizeof(in));
+	memset(&out, 0, sizeof(out));
+	in.numberofpoints = (int) points.size();
+	in.pointlist = (REAL *) malloc(in.numberofpoints * 2 * sizeof(REAL));
+	for (int i = 0; i < in.numberofpoints; i++)
+	{
+		in.pointlist[2*i] = points[i].x;
+		in.pointlist[2*i + 1] = points[i].y;
+	}
+
+	// Triangulate the points.  Switches are chosen:
+	// number everything from zero (z), quietly (Q), with no output points
+	// (N) or boundary markers (B), and optionally the neighbors (n).
+	#pragma omp critical(vtTriangle)
+	triangulate((char *) (neighbors ? "zQNBn" : "zQNB"), &in, &out, NULL);
+
+	tris.assign(out.trianglelist, out.trianglelist + out.numberoftriangles * 3);
+	if (neighbors && out.neighborlist)
+		neighbors->assign(out.neighborlist, out.neighborlist + out.numberoftriangles * 3);
+
+	free(in.pointlist);
+	free(out.pointlist);
+	free(out.pointattributelist);
+	free(out.pointmarkerlist);
+	free(out.trianglelist);
+	free(out.triangleattributelist);
+	free(out.neighborlist);
+	free(out.segmentlist);
+	free(out.segmentmarkerlist);
+	free(out.edgelist);
+	free(out.edgemarkerlist);
+}
+
+// The center and squared radius of the circle through three points.
+//  Returns false if they are in a line.
+static bool Circumcircle(const DPoint2 &a, const DPoint2 &b, const DPoint2 &c,
+	DPoint2 &center, double &radius2)
+{
+	// Relative to a, for precision
+	const double bx = b.x - a.x, by = b.y - a.y;
+	const double cx = c.x - a.x, cy = c.y - a.y;
+	const double d = 2 * (bx * cy - by * cx);
+	if (d == 0)
+		return false;
+	const double b2 = bx*bx + by*by, c2 = cx*cx + cy*cy;
+	const double ux = (cy * b2 - by * c2) / d;
+	const double uy = (bx * c2 - cx * b2) / d;
+	center.Set(a.x + ux, a.y + uy);
+	radius2 = ux*ux + uy*uy;
+	return true;
+}
+
+// A small, fixed, pseudo-random offset for each point, from -0.5 to 0.5
+static double JitterOf(uint i, uint salt)
+{
+	uint h = i * 2654435761u + salt * 0x9E3779B9u;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	h *= 0x297A2D39u;
+	h ^= h >> 15;
+	return (h & 0xFFFFFF) / (double) 0x1000000 - 0.5;
+}
+
+struct Triple
+{
+	Triple(int a, int b, int c)
+	{
+		// Sorted, so that the same triangle always gives the same triple
+		if (a > b) std::swap(a, b);
+		if (b > c) std::swap(b, c);
+		if (a > b) std::swap(a, b);
+		v0 = a; v1 = b; v2 = c;
+	}
+	bool operator<(const Triple &t) const
+	{
+		if (v0 != t.v0) return v0 < t.v0;
+		if (v1 != t.v1) return v1 < t.v1;
+		return v2 < t.v2;
+	}
+	int v0, v1, v2;
+};
+
+/**
+ * A uniform grid of cells over a set of points, each cell listing the
+ * points in it.  There are about CELL_POINTS points in each cell.
+ */
+class PointCells
+{
+public:
+	template <class P>
+	void Build(const std::vector<P> &points, const DRECT &ext)
+	{
+		const int n = (int) points.size();
+		m_Ext = ext;
+		double w = ext.Width(), h = ext.Height();
+		if (w <= 0) w = (h > 0) ? h : 1;
+		if (h <= 0) h = w;
+		const double cells = (double) n / CELL_POINTS + 1;
+		m_iCols = std::max(1, (int) sqrt(cells * w / h));
+		m_iRows = std::max(1, (int) (cells / m_iCols));
+		m_Size.Set(w / m_iCols, h / m_iRows);
+
+		// Counting sort of the points by cell
+		m_Start.assign((size_t) m_iCols * m_iRows + 1, 0);
+		std::vector<int> cell(n);
+		for (int i = 0; i < n; i++)
+		{
+			cell[i] = Row(points[i].y) * m_iCols + Col(points[i].x);
+			m_Start[cell[i] + 1]++;
+		}
+		for (size_t c = 1; c < m_Start.size(); c++)
+			m_Start[c] += m_Start[c - 1];
+		std::vector<int> next(m_Start.begin(), m_Start.end() - 1);
+		m_Order.resize(n);
+		for (int i = 0; i < n; i++)
+			m_Order[next[cell[i]]++] = i;
+	}
+	int Col(double x) const
+	{
+		const int c = (int) ((x - m_Ext.left) / m_Size.x);
+		return (c < 0) ? 0 : (c >= m_iCols) ? m_iCols - 1 : c;
+	}
+	int Row(double y) const
+	{
+		const int r = (int) ((y - m_Ext.bottom) / m_Size.y);
+		return (r < 0) ? 0 : (r >= m_iRows) ? m_iRows - 1 : r;
+	}
+	// The points of a cell are m_Order[Begin(c,r)] up to m_Order[End(c,r)]
+	int Begin(int col, int row) const { return m_Start[(size_t) row * m_iCols + col]; }
+	int End(int col, int row) const { return m_Start[(size_t) row * m_iCols + col + 1]; }
+
+	DRECT m_Ext;
+	DPoint2 m_Size;
+	int m_iCols, m_iRows;
+	std::vector<int> m_Start;
+	std::vector<int> m_Order;
+};
+
+
+///////////////////////////////////////////////////////////////////////
+// vtTinBuilder
+
+vtTinBuilder::vtTinBuilder()
+{
+	m_fMaxError = 0.0f;
+	m_iTilePoints = 500000;
+	m_dJitter = 0;
+}
+
+DPoint2 vtTinBuilder::_Jittered(int i) const
+{
+	return DPoint2(m_Points[i].x + m_dJitter * JitterOf(i, 0),
+		m_Points[i].y + m_dJitter * JitterOf(i, 1));
+}
+
+/**
+ * Build a TIN from a set of points.  The TIN is emptied first.
+ *
+ * \return false if there are fewer than three points, or the user cancelled.
+ */
+bool vtTinBuilder::Build(vtPointSource &source, vtTin &tin, bool progress_callback(int))
+{
+	tin.FreeData();
+
+	// Read all the points
+	m_Points.clear();
+	const int expected = source.NumPoints();
+	if (expected > 0)
+		m_Points.reserve(expected);
+	if (!source.Rewind())
+		return false;
+	std::vector<DPoint3> chunk;
+	while (source.ReadChunk(chunk))
+	{
+		m_Points.insert(m_Points.end(), chunk.begin(), chunk.end());
+		if (progress_callback != NULL && expected > 0 &&
+			progress_callback((int) ((double) m_Points.size() * 10 / expected)))
+			return false;
+	}
+	const int n = (int) m_Points.size();
+	if (n < 3)
+		return false;
+
+	DRECT ext;
+	ext.SetInsideOut();
+	for (int i = 0; i < n; i++)
+		ext.GrowToContainPoint(DPoint2(m_Points[i].x, m_Points[i].y));
+	m_dJitter = 1E-7 * std::max(ext.Width(), ext.Height());
+	if (m_dJitter == 0)
+		m_dJitter = 1E-7;
+
+	// Find the duplicate points
+	m_State.assign(n, PS_UNUSED);
+	PointCells cells;
+	cells.Build(m_Points, ext);
+	int duplicates = 0;
+	#pragma omp parallel for schedule(dynamic, 64) reduction(+:duplicates)
+	for (int r = 0; r < cells.m_iRows; r++)
+	{
+		for (int c = 0; c < cells.m_iCols; c++)
+		{
+			const int begin = cells.Begin(c, r), end = cells.End(c, r);
+			for (int i = begin; i < end; i++)
+			{
+				const DPoint3 &p = m_Points[cells.m_Order[i]];
+				for (int j = begin; j < i; j++)
+				{
+					const DPoint3 &q = m_Points[cells.m_Order[j]];
+					if (p.x == q.x && p.y == q.y)
+					{
+						m_State[cells.m_Order[i]] = PS_DUPLICATE;
+						duplicates++;
+						break;
+					}
+				}
+			}
+		}
+	}
+	if (duplicates > 0)
+		VTLOG("TIN builder: ignoring %d duplicate points.\n", duplicates);
+
+	std::vector<int> tris;
+	if (m_fMaxError > 0)
+	{
+		if (!_Refine(tris, progress_callback))
+			return false;
+	}
+	else
+	{
+		std::vector<int> subset;
+		subset.reserve(n - duplicates);
+		for (int i = 0; i < n; i++)
+		{
+			if (m_State[i] != PS_DUPLICATE)
+			{
+				m_State[i] = PS_USED;
+				subset.push_back(i);
+			}
+		}
+		if (!_Triangulate(subset, tris))
+			return false;
+	}
+	if (progress_callback != NULL && progress_callback(90))
+		return false;
+
+	// Along the edges of gridded data, the jitter makes slivers from points
+	//  which are really in a line; drop those.
+	size_t kept = 0;
+	for (size_t i = 0; i < tris.size(); i += 3)
+	{
+		const DPoint3 &a = m_Points[tris[i]];
+		const DPoint3 &b = m_Points[tris[i+1]];
+		const DPoint3 &c = m_Points[tris[i+2]];
+		if ((b.x - a.x) * (c.y - a.y) == (b.y - a.y) * (c.x - a.x))
+			continue;
+		tris[kept++] = tris[i];
+		tris[kept++] = tris[i+1];
+		tris[kept++] = tris[i+2];
+	}
+	tris.resize(kept);
+
+	// Copy the used points and the triangles to the TIN
+	std::vector<int> remap(n, -1);
+	for (size_t i = 0; i < tris.size(); i++)
+	{
+		int &v = remap[tris[i]];
+		if (v == -1)
+		{
+			v = tin.NumVerts();
+			const DPoint3 &p = m_Points[tris[i]];
+			tin.AddVert(DPoint2(p.x, p.y), (float) p.z);
+		}
+	}
+	for (size_t i = 0; i < tris.size(); i += 3)
+		tin.AddTri(remap[tris[i]], remap[tris[i+1]], remap[tris[i+2]]);
+	tin.ComputeExtents();
+
+	VTLOG("TIN builder: %d points, %d vertices, %d triangles.\n", n,
+		tin.NumVerts(), tin.NumTris());
+
+	m_Points.clear();
+	m_State.clear();
+	return true;
+}
+
+/**
+ * Decimate: choose which points to use, adding the worst point of each
+ * triangle a round at a time, until every point is within the tolerance.
+ * The triangles of the final choice are returned.
+ */
+bool vtTinBuilder::_Refine(std::vector<int> &tris, bool progress_callback(int))
+{
+	const int n = (int) m_Points.size();
+	DRECT ext;
+	ext.SetInsideOut();
+	for (int i = 0; i < n; i++)
+		ext.GrowToContainPoint(DPoint2(m_Points[i].x, m_Points[i].y));
+	PointCells cells;
+	cells.Build(m_Points, ext);
+
+	// Start with the outermost point of each row and column of cells, and a
+	//  sparse sample of the rest.
+	const int stepx = std::max(1, cells.m_iCols / 16);
+	const int stepy = std::max(1, cells.m_iRows / 16);
+	std::vector<int> extreme(2 * (cells.m_iCols + cells.m_iRows), -1);
+	for (int r = 0; r < cells.m_iRows; r++)
+	{
+		for (int c = 0; c < cells.m_iCols; c++)
+		{
+			bool bSample = (c % stepx == 0 && r % stepy == 0);
+			for (int k = cells.Begin(c, r); k < cells.End(c, r); k++)
+			{
+				const int i = cells.m_Order[k];
+				if (m_State[i] == PS_DUPLICATE)
+					continue;
+				if (bSample)
+				{
+					m_State[i] = PS_USED;
+					bSample = false;
+				}
+				const DPoint3 &p = m_Points[i];
+				int *e = &extreme[0];
+				if (e[r*2] == -1 || p.x < m_Points[e[r*2]].x) e[r*2] = i;
+				if (e[r*2+1] == -1 || p.x > m_Points[e[r*2+1]].x) e[r*2+1] = i;
+				e += 2 * cells.m_iRows;
+				if (e[c*2] == -1 || p.y < m_Points[e[c*2]].y) e[c*2] = i;
+				if (e[c*2+1] == -1 || p.y > m_Points[e[c*2+1]].y) e[c*2+1] = i;
+			}
+		}
+	}
+	for (size_t e = 0; e < extreme.size(); e++)
+		if (extreme[e] != -1)
+			m_State[extreme[e]] = PS_USED;
+
+	std::vector<char> found(n);
+	std::vector<int> subset;
+	for (int round = 0; round < MAX_ROUNDS; round++)
+	{
+		subset.clear();
+		for (int i = 0; i < n; i++)
+			if (m_State[i] == PS_USED)
+				subset.push_back(i);
+		if (!_Triangulate(subset, tris))
+			return false;
+
+		// Find the unused point furthest from the surface in each triangle
+		const int ntris = (int) tris.size() / 3;
+		std::vector<int> worst(ntris, -1);
+		std::vector<float> error(ntris, 0.0f);
+		std::fill(found.begin(), found.end(), 0);
+		#pragma omp parallel for schedule(dynamic, 16)
+		for (int t = 0; t < ntris; t++)
+		{
+			const DPoint3 &a = m_Points[tris[t*3]];
+			const DPoint3 &b = m_Points[tris[t*3+1]];
+			const DPoint3 &c = m_Points[tris[t*3+2]];
+			const double det = (b.y - c.y) * (a.x - c.x) + (c.x - b.x) * (a.y - c.y);
+			if (det == 0)
+				continue;
+			const int c0 = cells.Col(std::min(a.x, std::min(b.x, c.x)));
+			const int c1 = cells.Col(std::max(a.x, std::max(b.x, c.x)));
+			const int r0 = cells.Row(std::min(a.y, std::min(b.y, c.y)));
+			const int r1 = cells.Row(std::max(a.y, std::max(b.y, c.y)));
+			for (int r = r0; r <= r1; r++)
+			{
+				for (int col = c0; col <= c1; col++)
+				{
+					for (int k = cells.Begin(col, r); k < cells.End(col, r); k++)
+					{
+						const int i = cells.m_Order[k];
+						if (m_State[i] != PS_UNUSED)
+							continue;
+						const DPoint3 &p = m_Points[i];
+						const double l1 = ((b.y - c.y) * (p.x - c.x) + (c.x - b.x) * (p.y - c.y)) / det;
+						const double l2 = ((c.y - a.y) * (p.x - c.x) + (a.x - c.x) * (p.y - c.y)) / det;
+						const double l3 = 1.0 - l1 - l2;
+						if (l1 < -1E-12 || l2 < -1E-12 || l3 < -1E-12)
+							continue;
+						found[i] = 1;
+						const float e = (float) fabs(p.z - (l1 * a.z + l2 * b.z + l3 * c.z));
+						if (e > error[t])
+						{
+							error[t] = e;
+							worst[t] = i;
+						}
+					}
+				}
+			}
+		}
+
+		// Add those worse than the tolerance, and any which weren't inside
+		//  a triangle at all
+		int added = 0;
+		for (int t = 0; t < ntris; t++)
+		{
+			if (worst[t] != -1 && error[t] > m_fMaxError && m_State[worst[t]] == PS_UNUSED)
+			{
+				m_State[worst[t]] = PS_USED;
+				added++;
+			}
+		}
+		for (int i = 0; i < n; i++)
+		{
+			if (m_State[i] == PS_UNUSED && !found[i])
+			{
+				m_State[i] = PS_USED;
+				added++;
+			}
+		}
+		VTLOG("TIN decimation round %d: %d points, adding %d\n", round,
+			(int) subset.size(), added);
+		if (added == 0)
+			return true;
+
+		if (progress_callback != NULL &&
+			progress_callback(10 + std::min(75, round * 8)))
+			return false;
+	}
+	// Use the points chosen so far
+	subset.clear();
+	for (int i = 0; i < n; i++)
+		if (m_State[i] == PS_USED)
+			subset.push_back(i);
+	return _Triangulate(subset, tris);
+}
+
+/**
+ * Find the Delaunay triangulation of a subset of the points, a tile at a
+ * time.  The triangles are given as indices of the points.
+ */
+bool vtTinBuilder::_Triangulate(const std::vector<int> &subset, std::vector<int> &tris) const
+{
+	tris.clear();
+	const int n = (int) subset.size();
+	if (n < 3)
+		return false;
+
+	// Work with the jittered positions
+	std::vector<DPoint2> points(n);
+	DRECT ext;
+	ext.SetInsideOut();
+	for (int i = 0; i < n; i++)
+	{
+		points[i] = _Jittered(subset[i]);
+		ext.GrowToContainPoint(points[i]);
+	}
+
+	if (n <= m_iTilePoints)
+	{
+		TrianglePoints(points, tris, NULL);
+		for (size_t i = 0; i < tris.size(); i++)
+			tris[i] = subset[tris[i]];
+		return true;
+	}
+
+	// Divide the points into tiles
+	const int tiles = (n + m_iTilePoints - 1) / m_iTilePoints;
+	const double w = std::max(ext.Width(), m_dJitter), h = std::max(ext.Height(), m_dJitter);
+	const int tcols = std::max(1, (int) floor(sqrt(tiles * w / h) + 0.5));
+	const int trows = std::max(1, (tiles + tcols - 1) / tcols);
+	const int ntiles = tcols * trows;
+	const DPoint2 tsize(w / tcols, h / trows);
+
+	std::vector<int> tstart(ntiles + 1, 0), tile(n);
+	for (int i = 0; i < n; i++)
+	{
+		const int tx = std::min(tcols - 1, (int) ((points[i].x - ext.left) / tsize.x));
+		const int ty = std::min(trows - 1, (int) ((points[i].y - ext.bottom) / tsize.y));
+		tile[i] = ty * tcols + tx;
+		tstart[tile[i] + 1]++;
+	}
+	for (int t = 1; t <= ntiles; t++)
+		tstart[t] += tstart[t - 1];
+	std::vector<int> torder(n);
+	{
+		std::vector<int> next(tstart.begin(), tstart.end() - 1);
+		for (int i = 0; i < n; i++)
+			torder[next[tile[i]]++] = i;
+	}
+
+	// Triangulate each tile on its own.  A triangle whose circumcircle is
+	//  inside the tile (or off the edge of the whole set) can't have any
+	//  point of another tile in its circle, so it is final.  The vertices of
+	//  the rest, and of the tile's outer edges, are on the seams.
+	std::vector< std::vector<int> > final(ntiles);
+	std::vector< std::vector<int> > seams(ntiles);
+	#pragma omp parallel for schedule(dynamic)
+	for (int t = 0; t < ntiles; t++)
+	{
+		const int count = tstart[t + 1] - tstart[t];
+		const int *members = &torder[0] + tstart[t];
+		std::vector<int> &seam = seams[t];
+		if (count < 3)
+		{
+			seam.assign(members, members + count);
+			continue;
+		}
+		std::vector<DPoint2> local(count);
+		for (int k = 0; k < count; k++)
+			local[k] = points[members[k]];
+		std::vector<int> ltris, neighbors;
+		TrianglePoints(local, ltris, &neighbors);
+
+		const int tx = t % tcols, ty = t / tcols;
+		const double left = ext.left + tx * tsize.x, right = left + tsize.x;
+		const double bottom = ext.bottom + ty * tsize.y, top = bottom + tsize.y;
+		const double slack = tsize.x * 1E-9 + tsize.y * 1E-9;
+		for (size_t k = 0; k < ltris.size(); k += 3)
+		{
+			const int v0 = ltris[k], v1 = ltris[k+1], v2 = ltris[k+2];
+			DPoint2 center;
+			double radius2;
+			bool bFinal = Circumcircle(local[v0], local[v1], local[v2], center, radius2);
+			if (bFinal)
+			{
+				const double r = sqrt(radius2) * (1 + 1E-9) + slack;
+				bFinal = (tx == 0 || center.x - r >= left) &&
+					(tx == tcols - 1 || center.x + r <= right) &&
+					(ty == 0 || center.y - r >= bottom) &&
+					(ty == trows - 1 || center.y + r <= top);
+			}
+			if (bFinal)
+			{
+				final[t].push_back(members[v0]);
+				final[t].push_back(members[v1]);
+				final[t].push_back(members[v2]);
+			}
+			else
+			{
+				seam.push_back(members[v0]);
+				seam.push_back(members[v1]);
+				seam.push_back(members[v2]);
+			}
+			// The ends of each outer edge
+			for (int e = 0; e < 3; e++)
+			{
+				if (neighbors[k + e] == -1)
+				{
+					seam.push_back(members[ltris[k + (e+1)%3]]);
+					seam.push_back(members[ltris[k + (e+2)%3]]);
+				}
+			}
+		}
+	}
+
+	// Gather the seam points
+	std::vector<char> bSeam(n, 0);
+	std::vector<int> seam_points;
+	for (int t = 0; t < ntiles; t++)
+	{
+		for (size_t k = 0; k < seams[t].size(); k++)
+		{
+			const int i = seams[t][k];
+			if (!bSeam[i])
+			{
+				bSeam[i] = 1;
+				seam_points.push_back(i);
+			}
+		}
+		std::vector<int>().swap(seams[t]);
+	}
+
+	// Final triangles whose points are all on the seams could also come
+	//  from triangulating the seams; note them, so they aren't used twice.
+	std::vector<Triple> final_seam;
+	for (int t = 0; t < ntiles; t++)
+	{
+		const std::vector<int> &f = final[t];
+		for (size_t k = 0; k < f.size(); k += 3)
+			if (bSeam[f[k]] && bSeam[f[k+1]] && bSeam[f[k+2]])
+				final_seam.push_back(Triple(f[k], f[k+1], f[k+2]));
+	}
+	std::sort(final_seam.begin(), final_seam.end());
+
+	// Triangulate the seam points together.  Of those triangles, we want
+	//  the ones which are Delaunay for the whole set: those which have no
+	//  other point in their circumcircle.
+	std::vector<DPoint2> spoints(seam_points.size());
+	for (size_t k = 0; k < seam_points.size(); k++)
+		spoints[k] = points[seam_points[k]];
+	std::vector<int> stris;
+	TrianglePoints(spoints, stris, NULL);
+	std::vector<DPoint2>().swap(spoints);
+
+	PointCells cells;
+	cells.Build(points, ext);
+
+	const int nstris = (int) stris.size() / 3;
+	std::vector<char> keep(nstris, 0);
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (int s = 0; s < nstris; s++)
+	{
+		const int v0 = seam_points[stris[s*3]];
+		const int v1 = seam_points[stris[s*3+1]];
+		const int v2 = seam_points[stris[s*3+2]];
+		if (std::binary_search(final_seam.begin(), final_seam.end(), Triple(v0, v1, v2)))
+			continue;
+
+		DPoint2 center;
+		double radius2;
+		if (!Circumcircle(points[v0], points[v1], points[v2], center, radius2))
+		{
+			keep[s] = 1;
+			continue;
+		}
+
+		// Look first near the middle of the triangle, where any point inside
+		//  the circle is most likely, then everywhere in the circle.
+		const DPoint2 middle = (points[v0] + points[v1] + points[v2]) / 3;
+		const int mc = cells.Col(middle.x), mr = cells.Row(middle.y);
+		bool bEmpty = true;
+		for (int k = cells.Begin(mc, mr); k < cells.End(mc, mr) && bEmpty; k++)
+		{
+			const int i = cells.m_Order[k];
+			if (!bSeam[i] && (points[i] - center).LengthSquared() < radius2)
+				bEmpty = false;
+		}
+		const double r = sqrt(radius2);
+		const int c0 = cells.Col(center.x - r), c1 = cells.Col(center.x + r);
+		const int r0 = cells.Row(center.y - r), r1 = cells.Row(center.y + r);
+		for (int row = r0; row <= r1 && bEmpty; row++)
+		{
+			for (int col = c0; col <= c1 && bEmpty; col++)
+			{
+				for (int k = cells.Begin(col, row); k < cells.End(col, row); k++)
+				{
+					const int i = cells.m_Order[k];
+					if (!bSeam[i] && (points[i] - center).LengthSquared() < radius2)
+					{
+						bEmpty = false;
+						break;
+					}
+				}
+			}
+		}
+		keep[s] = bEmpty;
+	}
+
+	// Put together the final triangles and the seams
+	size_t total = 0;
+	for (int t = 0; t < ntiles; t++)
+		total += final[t].size();
+	tris.reserve(total + stris.size());
+	for (int t = 0; t < ntiles; t++)
+	{
+		for (size_t k = 0; k < final[t].size(); k++)
+			tris.push_back(subset[final[t][k]]);
+		std::vector<int>().swap(final[t]);
+	}
+	int seam_tris = 0;
+	for (int s = 0; s < nstris; s++)
+	{
+		if (!keep[s])
+			continue;
+		tris.push_back(subset[seam_points[stris[s*3]]]);
+		tris.push_back(subset[seam_points[stris[s*3+1]]]);
+		tris.push_back(subset[seam_points[stris[s*3+2]]]);
+		seam_tris++;
+	}
+	VTLOG("Triangulated %d points in %d tiles, with %d seam points and %d seam triangles.\n",
+		n, ntiles, (int) seam_points.size(), seam_tris);
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// From an elevation grid
+
+/**
+ * Build a TIN from an elevation grid, using only as many of the heixels as
+ * are needed to keep every heixel within the tolerance (SetMaxError) of the
+ * surface.  With no tolerance, every valid heixel is used.  Areas with no
+ * data are left out of the TIN.  The TIN is emptied first; its CRS is not
+ * set.
+ *
+ * \return false if the grid has no data, or the user cancelled.
+ */
+bool vtTinBuilder::Build(const vtElevationGrid &grid, vtTin &tin, bool progress_callback(int))
+{
+	tin.FreeData();
+
+	const IPoint2 size = grid.GetDimensions();
+	const int cols = size.x, rows = size.y;
+	if (cols < 2 || rows < 2 || !grid.HasData())
+		return false;
+
+	std::vector<char> used((size_t) cols * rows, PS_UNUSED);
+
+	// Keep every heixel at the edge of an area with no data
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (int j = 0; j < rows; j++)
+	{
+		for (int i = 0; i < cols; i++)
+		{
+			if (grid.GetFValue(i, j) == INVALID_ELEVATION)
+				continue;
+			if ((i > 0 && grid.GetFValue(i-1, j) == INVALID_ELEVATION) ||
+				(i < cols-1 && grid.GetFValue(i+1, j) == INVALID_ELEVATION) ||
+				(j > 0 && grid.GetFValue(i, j-1) == INVALID_ELEVATION) ||
+				(j < rows-1 && grid.GetFValue(i, j+1) == INVALID_ELEVATION))
+				used[(size_t) j * cols + i] = PS_USED;
+		}
+	}
+
+	// Simplify the edges of the blocks, which neighboring blocks share
+	const int bcols = (cols - 2) / GRID_BLOCK + 1;
+	const int brows = (rows - 2) / GRID_BLOCK + 1;
+	for (int b = 0; b <= brows; b++)
+	{
+		const int y = std::min(b * GRID_BLOCK, rows - 1);
+		for (int a = 0; a < bcols; a++)
+		{
+			const int x0 = a * GRID_BLOCK, x1 = std::min(x0 + GRID_BLOCK, cols - 1);
+			_SimplifyLine(grid, x0, y, 1, 0, x1 - x0, used);
+		}
+	}
+	for (int a = 0; a <= bcols; a++)
+	{
+		const int x = std::min(a * GRID_BLOCK, cols - 1);
+		for (int b = 0; b < brows; b++)
+		{
+			const int y0 = b * GRID_BLOCK, y1 = std::min(y0 + GRID_BLOCK, rows - 1);
+			_SimplifyLine(grid, x, y0, 0, 1, y1 - y0, used);
+		}
+	}
+
+	// Then the inside of each block
+	const int blocks = bcols * brows;
+	std::vector< std::vector<int> > block_tris(blocks);
+	std::vector<float> block_error(blocks, 0.0f);
+	int iDone = 0;
+	vtThreadFlag cancel;
+	#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < blocks; b++)
+	{
+		if (cancel.IsSet())
+			continue;
+
+		const int x0 = (b % bcols) * GRID_BLOCK, y0 = (b / bcols) * GRID_BLOCK;
+		_SimplifyBlock(grid, x0, y0, std::min(x0 + GRID_BLOCK, cols - 1),
+			std::min(y0 + GRID_BLOCK, rows - 1), used, block_tris[b], block_error[b]);
+
+		const int iCount = vtAtomicIncrement(iDone);
+
+		if (progress_callback != NULL && vtIsFirstThread())
+		{
+			if (progress_callback(iCount * 95 / blocks))
+				cancel.Set();
+		}
+	}
+	if (cancel.IsSet())
+		return false;
+
+	// Copy the vertices and triangles to the TIN
+	std::vector<int> remap((size_t) cols * rows, -1);
+	DPoint2 p;
+	for (int b = 0; b < blocks; b++)
+	{
+		const std::vector<int> &bt = block_tris[b];
+		for (size_t k = 0; k < bt.size(); k++)
+		{
+			int &v = remap[bt[k]];
+			if (v == -1)
+			{
+				const int i = bt[k] % cols, j = bt[k] / cols;
+				grid.GetEarthPoint(i, j, p);
+				v = tin.NumVerts();
+				tin.AddVert(p, grid.GetFValue(i, j));
+			}
+		}
+		for (size_t k = 0; k < bt.size(); k += 3)
+			tin.AddTri(remap[bt[k]], remap[bt[k+1]], remap[bt[k+2]]);
+		std::vector<int>().swap(block_tris[b]);
+	}
+	tin.ComputeExtents();
+
+	const float fError = *std::max_element(block_error.begin(), block_error.end());
+	VTLOG("TIN from grid: %d of %d heixels, %d triangles, max error %.3f.\n",
+		tin.NumVerts(), cols * rows, tin.NumTris(), fError);
+	if (m_fMaxError > 0 && fError > m_fMaxError)
+		VTLOG(" Warning: error is more than the tolerance, %.3f.\n", m_fMaxError);
+	return (tin.NumTris() > 0);
+}
+
+/**
+ * Simplify a line of heixels, from (x,y) in steps of (dx,dy), marking those
+ * which are needed to keep the line within the tolerance.  The ends of each
+ * run of valid heixels are always kept.
+ */
+void vtTinBuilder::_SimplifyLine(const vtElevationGrid &grid, int x, int y,
+	int dx, int dy, int len, std::vector<char> &used) const
+{
+	const int cols = grid.GetDimensions().x;
+	std::vector<float> z(len + 1);
+	for (int k = 0; k <= len; k++)
+		z[k] = grid.GetFValue(x + k * dx, y + k * dy);
+
+	std::vector< std::pair<int,int> > spans;
+	for (int k = 0; k <= len; k++)
+	{
+		if (z[k] == INVALID_ELEVATION)
+			continue;
+		const int start = k;
+		while (k < len && z[k+1] != INVALID_ELEVATION)
+			k++;
+		spans.push_back(std::make_pair(start, k));
+	}
+
+	// Keep the ends of each span, then the worst point between, if it's
+	//  worse than the tolerance, and so on.
+	while (!spans.empty())
+	{
+		const int a = spans.back().first, b = spans.back().second;
+		spans.pop_back();
+		used[(size_t) (y + a * dy) * cols + x + a * dx] = PS_USED;
+		used[(size_t) (y + b * dy) * cols + x + b * dx] = PS_USED;
+		if (m_fMaxError <= 0)
+		{
+			for (int k = a + 1; k < b; k++)
+				used[(size_t) (y + k * dy) * cols + x + k * dx] = PS_USED;
+			continue;
+		}
+		int worst = -1;
+		float error = m_fMaxError;
+		for (int k = a + 1; k < b; k++)
+		{
+			const float e = fabsf(z[k] - (z[a] + (z[b] - z[a]) * (k - a) / (b - a)));
+			if (e > error)
+			{
+				error = e;
+				worst = k;
+			}
+		}
+		if (worst != -1)
+		{
+			spans.push_back(std::make_pair(a, worst));
+			spans.push_back(std::make_pair(worst, b));
+		}
+	}
+}
+
+/**
+ * Choose the heixels inside one block of the grid, from (x0,y0) to (x1,y1)
+ * inclusive, by greedy insertion, and triangulate them.  The heixels on the
+ * edges of the block must already be chosen.  The triangles are given as
+ * indices of heixels in the whole grid.
+ *
+ * \param fError Receives the largest vertical distance of any heixel from
+ *		the triangles, measured again on the result, which should not be
+ *		more than the tolerance.
+ */
+void vtTinBuilder::_SimplifyBlock(const vtElevationGrid &grid, int x0, int y0,
+	int x1, int y1, const std::vector<char> &used, std::vector<int> &tris,
+	float &fError) const
+{
+	const int cols = grid.GetDimensions().x;
+	const int w = x1 - x0 + 1, h = y1 - y0 + 1;
+
+	// Work with the block's own heixels
+	std::vector<float> z(w * h);
+	std::vector<char> state(w * h);
+	for (int j = 0; j < h; j++)
+	{
+		for (int i = 0; i < w; i++)
+		{
+			const int k = j * w + i;
+			z[k] = grid.GetFValue(x0 + i, y0 + j);
+			state[k] = used[(size_t) (y0 + j) * cols + x0 + i];
+			if (m_fMaxError <= 0 && z[k] != INVALID_ELEVATION)
+				state[k] = PS_USED;
+		}
+	}
+
+	std::vector<DPoint2> points;
+	std::vector<int> ids, ltris;
+	std::vector<char> found(w * h, 0);
+	std::vector<Triple> previous, current;
+	for (int round = 0; round < MAX_ROUNDS; round++)
+	{
+		points.clear();
+		ids.clear();
+		for (int k = 0; k < w * h; k++)
+		{
+			if (state[k] == PS_USED)
+			{
+				points.push_back(DPoint2(k % w, k / w));
+				ids.push_back(k);
+			}
+		}
+		TrianglePoints(points, ltris, NULL);
+		if (m_fMaxError <= 0)
+			break;
+
+		// Add the heixel furthest from the surface in each triangle, if it's
+		//  further than the tolerance.  Heixels are at whole coordinates, so
+		//  this arithmetic is exact.  A triangle which was there last round
+		//  didn't need a heixel then, and still doesn't, so skip it.
+		current.clear();
+		int added = 0;
+		for (size_t t = 0; t < ltris.size(); t += 3)
+		{
+			const int a = ids[ltris[t]], b = ids[ltris[t+1]], c = ids[ltris[t+2]];
+			current.push_back(Triple(a, b, c));
+			if (std::binary_search(previous.begin(), previous.end(), current.back()))
+				continue;
+			const double ax = a % w, ay = a / w, bx = b % w, by = b / w, cx = c % w, cy = c / w;
+			double det = (by - cy) * (ax - cx) + (cx - bx) * (ay - cy);
+			if (det == 0)
+				continue;
+			const double sign = (det < 0) ? -1 : 1;
+			det *= sign;
+
+			int worst = -1;
+			float error = m_fMaxError;
+			const int i0 = (int) std::min(ax, std::min(bx, cx)), i1 = (int) std::max(ax, std::max(bx, cx));
+			const int j0 = (int) std::min(ay, std::min(by, cy)), j1 = (int) std::max(ay, std::max(by, cy));
+			for (int j = j0; j <= j1; j++)
+			{
+				for (int i = i0; i <= i1; i++)
+				{
+					const int k = j * w + i;
+					if (state[k] != PS_UNUSED || z[k] == INVALID_ELEVATION)
+						continue;
+					const double l1 = sign * ((by - cy) * (i - cx) + (cx - bx) * (j - cy));
+					const double l2 = sign * ((cy - ay) * (i - cx) + (ax - cx) * (j - cy));
+					const double l3 = det - l1 - l2;
+					if (l1 < 0 || l2 < 0 || l3 < 0)
+						continue;
+					found[k] = 1;
+					const float e = (float) fabs(z[k] - (l1 * z[a] + l2 * z[b] + l3 * z[c]) / det);
+					if (e > error)
+					{
+						error = e;
+						worst = k;
+					}
+				}
+			}
+			if (worst != -1)
+			{
+				state[worst] = PS_USED;
+				added++;
+			}
+		}
+		std::sort(current.begin(), current.end());
+		previous.swap(current);
+
+		// Also add any which haven't been inside a triangle at all, except on
+		//  the edges of the block, which must stay as they are.
+		for (int j = 1; j < h - 1; j++)
+		{
+			for (int i = 1; i < w - 1; i++)
+			{
+				const int k = j * w + i;
+				if (state[k] == PS_UNUSED && !found[k] && z[k] != INVALID_ELEVATION)
+				{
+					state[k] = PS_USED;
+					added++;
+				}
+			}
+		}
+		if (added == 0)
+			break;
+	}
+
+	// Give the triangles in the whole grid, leaving out those over no data,
+	//  and check the error of every heixel under the ones we keep.
+	tris.clear();
+	tris.reserve(ltris.size());
+	fError = 0.0f;
+	for (size_t t = 0; t < ltris.size(); t += 3)
+	{
+		const int a = ids[ltris[t]], b = ids[ltris[t+1]], c = ids[ltris[t+2]];
+		const int mi = ((a % w) + (b % w) + (c % w) + 1) / 3;
+		const int mj = ((a / w) + (b / w) + (c / w) + 1) / 3;
+		if (z[mj * w + mi] == INVALID_ELEVATION)
+			continue;
+		tris.push_back((y0 + a / w) * cols + x0 + a % w);
+		tris.push_back((y0 + b / w) * cols + x0 + b % w);
+		tris.push_back((y0 + c / w) * cols + x0 + c % w);
+
+		const double ax = a % w, ay = a / w, bx = b % w, by = b / w, cx = c % w, cy = c / w;
+		double det = (by - cy) * (ax - cx) + (cx - bx) * (ay - cy);
+		if (det == 0)
+			continue;
+		const double sign = (det < 0) ? -1 : 1;
+		det *= sign;
+		const int i0 = (int) std::min(ax, std::min(bx, cx)), i1 = (int) std::max(ax, std::max(bx, cx));
+		const int j0 = (int) std::min(ay, std::min(by, cy)), j1 = (int) std::max(ay, std::max(by, cy));
+		for (int j = j0; j <= j1; j++)
+		{
+			for (int i = i0; i <= i1; i++)
+			{
+				const int k = j * w + i;
+				if (z[k] == INVALID_ELEVATION)
+					continue;
+				const double l1 = sign * ((by - cy) * (i - cx) + (cx - bx) * (j - cy));
+				const double l2 = sign * ((cy - ay) * (i - cx) + (ax - cx) * (j - cy));
+				const double l3 = det - l1 - l2;
+				if (l1 < 0 || l2 < 0 || l3 < 0)
+					continue;
+				const float e = (float) fabs(z[k] - (l1 * z[a] + l2 * z[b] + l3 * z[c]) / det);
+				if (e > fError)
+					fError = e;
+			}
+		}
+	}
+}
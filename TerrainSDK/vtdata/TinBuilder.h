@@ -0,0 +1,81 @@
+//
+// TinBuilder.h
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#ifndef TINBUILDERH
+#define TINBUILDERH
+
+#include <vector>
+
+#include "MathTypes.h"
+
+class vtElevationGrid;
+class vtPointSource;
+class vtTin;
+
+/**
+ * Builds the Delaunay triangulation of a large set of points, as a vtTin.
+ *
+ * The points are divided into tiles, which are triangulated independently,
+ * on several threads.  The triangles whose circumcircle lies inside their
+ * tile must be in the triangulation of the whole set; those are kept.  The
+ * points of the other triangles, along the seams between the tiles, are then
+ * triangulated together, and the triangles which fill the seams are taken
+ * from that.  The result is the same as triangulating all the points at
+ * once, but much faster, and with much less memory needed at any one time.
+ *
+ * The points are moved by a tiny, fixed amount (one ten-millionth of the
+ * size of the set) for the triangulation only, so that the tiles agree on
+ * how to triangulate points which lie on a circle, such as gridded data.
+ * The TIN has the points' original positions.
+ *
+ * Optionally, the TIN can be decimated: only as many points are used as are
+ * needed to keep every point within a given vertical distance of the
+ * surface.  Points are added, starting with a sparse set, a round at a time:
+ * in each round, each triangle gets the point inside it furthest from its
+ * surface, if that is further than the tolerance.
+ *
+ * Points with the same x and y as an earlier point are ignored.
+ *
+ * An elevation grid can also be made into a TIN with only the heixels
+ * needed to stay within the error tolerance; this is usually a small
+ * fraction of them.  The grid is divided into square blocks, which are
+ * refined in the same way, on several threads.  The edges between blocks
+ * are simplified first, as lines, so that neighboring blocks share the
+ * same vertices along them and join without cracks.
+ */
+class vtTinBuilder
+{
+public:
+	vtTinBuilder();
+
+	/// The most vertical error to allow, if decimating.  0 uses every point.
+	void SetMaxError(float fMaxError) { m_fMaxError = fMaxError; }
+	/// Roughly how many points to triangulate at a time.
+	void SetTilePoints(int iNum) { m_iTilePoints = iNum; }
+
+	bool Build(vtPointSource &source, vtTin &tin, bool progress_callback(int) = NULL);
+	bool Build(const vtElevationGrid &grid, vtTin &tin, bool progress_callback(int) = NULL);
+
+protected:
+	void _SimplifyLine(const vtElevationGrid &grid, int x, int y, int dx, int dy,
+		int len, std::vector<char> &used) const;
+	void _SimplifyBlock(const vtElevationGrid &grid, int x0, int y0, int x1, int y1,
+		const std::vector<char> &used, std::vector<int> &tris, float &fError) const;
+	bool _Triangulate(const std::vector<int> &subset, std::vector<int> &tris) const;
+	bool _Refine(std::vector<int> &tris, bool progress_callback(int));
+	DPoint2 _Jittered(int i) const;
+
+	float m_fMaxError;
+	int m_iTilePoints;
+
+	// While building
+	std::vector<DPoint3> m_Points;
+	std::vector<char> m_State;
+	double m_dJitter;
+};
+
+#endif // TINBUILDERH
@@ -253,3 +253,139 @@ int ExpandZip(const char *archive_fname, const char *prepend_path,
 	return uz.Extract(true, true, prepend_path, progress_callback);
 }
 
+
+
+/**
+ * Returns true if the path is one of GDAL's virtual file paths, such as a
+ * member of an archive, which can't be opened with the C runtime.
+ */
+bool vtIsVirtualPath(const char *path)
+{
+	return (strncmp(path, "/vsi", 4) == 0);
+}
+
+
+/**
+ * Reads the table of contents of an archive.  Zip files are recognized by
+ * their extension; anything else is taken as a tar file, which may be
+ * gzipped (.tar, .tgz, .tar.gz).
+ *
+ * \param archive_fname The archive's filename, in UTF-8.
+ *
+ * \return true if the archive could be read.
+ */
+bool vtArchive::Open(const char *archive_fname)
+{
+	m_fname = archive_fname;
+	m_Entries.clear();
+	m_bZip = (GetExtension(m_fname, false).CompareNoCase(".zip") == 0);
+
+	if (m_bZip)
+		return _ListZip();
+	else
+		return _ListTar();
+}
+
+/**
+ * Finds a member by its path within the archive, ignoring case.
+ *
+ * \return The index of the member, or -1 if there is none.
+ */
+int vtArchive::FindEntry(const char *name) const
+{
+	for (uint i = 0; i < m_Entries.size(); i++)
+	{
+		if (m_Entries[i].m_name.CompareNoCase(name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * The path by which GDAL and OGR can read a member of the archive, in UTF-8
+ * like other filenames.
+ */
+vtString vtArchive::GetVirtualPath(uint i) const
+{
+	vtString path = m_bZip ? "/vsizip/" : "/vsitar/";
+	path += m_fname;
+	path += "/";
+	path += m_Entries[i].m_name;
+	return path;
+}
+
+bool vtArchive::_ListZip()
+{
+	// vtUnzip doesn't handle utf8 paths, so convert to local
+	vtString local_fname = UTF8ToLocal(m_fname);
+	vtUnzip uz;
+	if (!uz.Open(local_fname))
+		return false;
+
+	char name[1024];
+	unz_file_info info;
+	bool more = uz.GoToFirstFile();
+	while (more)
+	{
+		if (!uz.GetCurrentFileInfo(&info, name, sizeof(name)))
+			return false;
+
+		vtArchiveEntry entry;
+		entry.m_name = name;
+		entry.m_size = info.uncompressed_size;
+		entry.m_bDirectory = (entry.m_name.Right(1) == "/");
+		if (entry.m_bDirectory)
+			entry.m_name = entry.m_name.Left(entry.m_name.GetLength() - 1);
+		m_Entries.push_back(entry);
+
+		more = uz.GoToNextFile();
+	}
+	return true;
+}
+
+bool vtArchive::_ListTar()
+{
+	vtString local_fname = UTF8ToLocal(m_fname);
+	gzFile in = gzopen(local_fname, "rb");
+	if (in == NULL)
+		return false;
+
+	// Read only the headers, seeking past the contents of each member.
+	union tar_buffer buffer;
+	bool success = false;
+	while (gzread(in, &buffer, BLOCKSIZE) == BLOCKSIZE)
+	{
+		if (buffer.header.name[0] == 0)
+		{
+			// end-of-tar block
+			success = true;
+			break;
+		}
+		char name[101];
+		strncpy(name, buffer.header.name, 100);
+		name[100] = 0;
+
+		int size = getoct(buffer.header.size, 12);
+		if (buffer.header.typeflag == DIRTYPE ||
+			buffer.header.typeflag == REGTYPE ||
+			buffer.header.typeflag == AREGTYPE)
+		{
+			vtArchiveEntry entry;
+			entry.m_name = name;
+			entry.m_size = size;
+			entry.m_bDirectory = (buffer.header.typeflag == DIRTYPE);
+			if (entry.m_name.Right(1) == "/")
+				entry.m_name = entry.m_name.Left(entry.m_name.GetLength() - 1);
+			m_Entries.push_back(entry);
+		}
+		int blocks = (size + BLOCKSIZE - 1) / BLOCKSIZE;
+		if (blocks > 0 && gzseek(in, blocks * BLOCKSIZE, SEEK_CUR) < 0)
+			break;
+	}
+	// Some tar writers leave off the end-of-tar blocks
+	if (!success && gzeof(in) && !m_Entries.empty())
+		success = true;
+	gzclose(in);
+
+	return success;
+}
@@ -5,9 +5,53 @@
 #ifndef UNARCHIVE_H
 #define UNARCHIVE_H
 
+#include <vector>
+
+#include "vtString.h"
+
 int ExpandTGZ(const char *archive_fname, const char *prepend_path);
 int ExpandZip(const char *archive_fname, const char *prepend_path,
 			  bool progress_callback(int) = NULL);
 
+bool vtIsVirtualPath(const char *path);
+
+/** One file or directory in an archive. */
+struct vtArchiveEntry
+{
+	vtString m_name;	// path within the archive, with '/' separators
+	size_t m_size;		// uncompressed size in bytes
+	bool m_bDirectory;
+};
+
+/**
+ * The table of contents of a zip, tar, or gzipped tar file, which lets its
+ * members be read where they are, without expanding the archive.
+ *
+ * Each member has a GDAL virtual path (/vsizip/ or /vsitar/), which readers
+ * based on GDAL and OGR accept in place of a filename.  GDAL opens members
+ * next to each other as well, so formats with sidecar files (.hdr, .prj,
+ * .shx, .dbf) work.  Virtual paths may be read from several threads at once.
+ */
+class vtArchive
+{
+public:
+	vtArchive() : m_bZip(false) {}
+
+	bool Open(const char *archive_fname);
+
+	uint NumEntries() const { return (uint) m_Entries.size(); }
+	const vtArchiveEntry &GetEntry(uint i) const { return m_Entries[i]; }
+	int FindEntry(const char *name) const;
+	vtString GetVirtualPath(uint i) const;
+
+protected:
+	bool _ListZip();
+	bool _ListTar();
+
+	vtString m_fname;
+	bool m_bZip;
+	std::vector<vtArchiveEntry> m_Entries;
+};
+
 #endif
 
@@ -56,6 +56,18 @@
 #define SUPPORT_WSTRING	1
 #endif
 
+// Use SSE2 instructions in a few inner loops (image and coordinate
+// conversion).  By default this is set when the compiler targets SSE2, which
+// is always there on x86-64, and optional on 32-bit x86.
+//
+#ifndef USE_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2	1
+#else
+#define USE_SSE2	0
+#endif
+#endif
+
 // Put these useful typedefs here so that they can be used throughout the
 // VTP codebase.
 typedef unsigned int uint;
@@ -7,6 +7,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "config_vtdata.h"
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
 
 // Headers for PNG support, which uses the library "libpng"
 #include "png.h"
@@ -30,6 +37,187 @@ extern "C" {
 #include "gdal_priv.h"
 #include "Projections.h"
 
+///////////////////////////////////////////////////////////////////////
+// Rows of pixels
+//
+
+static void SwapRB32(const uchar *src, uchar *dst, int count)
+{
+	int i = 0;
+#if USE_SSE2
+	const __m128i ga = _mm_set1_epi32(0xFF00FF00);
+	const __m128i rb = _mm_set1_epi32(0x00FF00FF);
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *) (src + i * 4));
+		const __m128i c = _mm_and_si128(v, rb);
+		const __m128i swapped = _mm_or_si128(_mm_slli_epi32(c, 16), _mm_srli_epi32(c, 16));
+		_mm_storeu_si128((__m128i *) (dst + i * 4), _mm_or_si128(_mm_and_si128(v, ga), swapped));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const uchar c0 = src[i*4], c2 = src[i*4+2];
+		dst[i*4] = c2;
+		dst[i*4+1] = src[i*4+1];
+		dst[i*4+2] = c0;
+		dst[i*4+3] = src[i*4+3];
+	}
+}
+
+static void GrayTo32(const uchar *src, uchar *dst, int count)
+{
+	int i = 0;
+#if USE_SSE2
+	const __m128i alpha = _mm_set1_epi32(0xFF000000);
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i g = _mm_loadu_si128((const __m128i *) (src + i));
+		const __m128i lo = _mm_unpacklo_epi8(g, g);
+		const __m128i hi = _mm_unpackhi_epi8(g, g);
+		__m128i *out = (__m128i *) (dst + i * 4);
+		_mm_storeu_si128(out, _mm_or_si128(_mm_unpacklo_epi16(lo, lo), alpha));
+		_mm_storeu_si128(out + 1, _mm_or_si128(_mm_unpackhi_epi16(lo, lo), alpha));
+		_mm_storeu_si128(out + 2, _mm_or_si128(_mm_unpacklo_epi16(hi, hi), alpha));
+		_mm_storeu_si128(out + 3, _mm_or_si128(_mm_unpackhi_epi16(hi, hi), alpha));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[i*4] = dst[i*4+1] = dst[i*4+2] = src[i];
+		dst[i*4+3] = 255;
+	}
+}
+
+// The byte offsets of red and blue in a color pixel
+static inline int RedOffset(vtPixelFormat f) { return (f == PF_RGB24 || f == PF_RGBA32) ? 0 : 2; }
+
+/**
+ * Convert a row of pixels from one format to another.  Gray (or palette)
+ * pixels become color, and color becomes gray by its luminance.  Pixels
+ * which gain an alpha get 255.  The source and destination may be the
+ * same memory only if the two formats have the same size.
+ *
+ * \param palette For a source which is PF_GRAY8, a palette of BGRX quads
+ *		for its values, as in an 8-bit DIB, or NULL if they are gray levels.
+ */
+void vtConvertRow(const uchar *src, vtPixelFormat src_format, const uchar *palette,
+				  uchar *dst, vtPixelFormat dst_format, int count)
+{
+	if (count <= 0)
+		return;
+	if (src_format == dst_format)
+	{
+		const int bytes = (src_format == PF_GRAY8) ? 1 : (src_format <= PF_BGR24) ? 3 : 4;
+		memmove(dst, src, (size_t) count * bytes);
+		return;
+	}
+	if (src_format == PF_GRAY8 && dst_format >= PF_RGBA32 && palette == NULL)
+	{
+		GrayTo32(src, dst, count);
+		return;
+	}
+	if (src_format >= PF_RGBA32 && dst_format >= PF_RGBA32)
+	{
+		SwapRB32(src, dst, count);
+		return;
+	}
+
+	// The rest are done a pixel at a time, which the compiler can at least
+	//  unroll, since the formats are fixed for the whole row.
+	const int sbytes = (src_format == PF_GRAY8) ? 1 : (src_format <= PF_BGR24) ? 3 : 4;
+	const int dbytes = (dst_format == PF_GRAY8) ? 1 : (dst_format <= PF_BGR24) ? 3 : 4;
+	if (dst_format == PF_GRAY8)
+	{
+		const int sr = RedOffset(src_format), sb = 2 - sr;
+		for (int i = 0; i < count; i++, src += sbytes)
+			dst[i] = (uchar) ((src[sr] * 77 + src[1] * 150 + src[sb] * 29) >> 8);
+		return;
+	}
+	const int dr = RedOffset(dst_format), db = 2 - dr;
+	if (src_format == PF_GRAY8)
+	{
+		for (int i = 0; i < count; i++, dst += dbytes)
+		{
+			if (palette)
+			{
+				const uchar *q = palette + src[i] * 4;
+				dst[dr] = q[2];
+				dst[1] = q[1];
+				dst[db] = q[0];
+			}
+			else
+				dst[0] = dst[1] = dst[2] = src[i];
+			if (dbytes == 4)
+				dst[3] = 255;
+		}
+		return;
+	}
+	const int sr = RedOffset(src_format), sb = 2 - sr;
+	for (int i = 0; i < count; i++, src += sbytes, dst += dbytes)
+	{
+		const uchar r = src[sr], g = src[1], b = src[sb];
+		const uchar alpha = (sbytes == 4) ? src[3] : 255;
+		dst[dr] = r;
+		dst[1] = g;
+		dst[db] = b;
+		if (dbytes == 4)
+			dst[3] = alpha;
+	}
+}
+
+/**
+ * Multiply the colors of a row of pixels by a factor for each pixel, as
+ * ScalePixel8/24/32 do.  Alpha is not changed.
+ */
+void vtScaleRow(uchar *row, vtPixelFormat format, const float *scale, int count)
+{
+	if (format == PF_GRAY8 || format == PF_RGB24 || format == PF_BGR24)
+	{
+		const int bytes = (format == PF_GRAY8) ? 1 : 3;
+		for (int i = 0; i < count; i++)
+		{
+			for (int c = 0; c < bytes; c++, row++)
+			{
+				const uint value = (int) (*row * scale[i]);
+				*row = (uchar) (value > 255 ? 255 : value);
+			}
+		}
+		return;
+	}
+	int i = 0;
+#if USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *) (row + i * 4));
+		const __m128i lo = _mm_unpacklo_epi8(v, zero);
+		const __m128i hi = _mm_unpackhi_epi8(v, zero);
+		__m128 p0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+		__m128 p1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+		__m128 p2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+		__m128 p3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+		p0 = _mm_mul_ps(p0, _mm_set_ps(1.0f, scale[i], scale[i], scale[i]));
+		p1 = _mm_mul_ps(p1, _mm_set_ps(1.0f, scale[i+1], scale[i+1], scale[i+1]));
+		p2 = _mm_mul_ps(p2, _mm_set_ps(1.0f, scale[i+2], scale[i+2], scale[i+2]));
+		p3 = _mm_mul_ps(p3, _mm_set_ps(1.0f, scale[i+3], scale[i+3], scale[i+3]));
+		const __m128i w0 = _mm_packs_epi32(_mm_cvttps_epi32(p0), _mm_cvttps_epi32(p1));
+		const __m128i w1 = _mm_packs_epi32(_mm_cvttps_epi32(p2), _mm_cvttps_epi32(p3));
+		_mm_storeu_si128((__m128i *) (row + i * 4), _mm_packus_epi16(w0, w1));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		uchar *p = row + i * 4;
+		for (int c = 0; c < 3; c++)
+		{
+			const uint value = (int) (p[c] * scale[i]);
+			p[c] = (uchar) (value > 255 ? 255 : value);
+		}
+	}
+}
+
+
 ///////////////////////////////////////////////////////////////////////
 // Base class vtBitmapBase
 //
@@ -64,24 +252,126 @@ void vtBitmapBase::ScalePixel32(int x, int y, float fScale)
 	SetPixel32(x, y, rgba);
 }
 
-void vtBitmapBase::BlitTo(vtBitmapBase &target, int x, int y)
+/**
+ * Read a whole row of the bitmap, as RGBA bytes (4 for each pixel).
+ */
+void vtBitmapBase::ReadRow(int y, uchar *rgba) const
 {
-	const int depth = GetDepth();
-	const int tdepth = target.GetDepth();
+	vtPixelSpan span;
+	if (GetPixelSpan(span))
+	{
+		vtConvertRow(span.Row(y), span.m_Format, span.m_pPalette, rgba, PF_RGBA32,
+			span.m_Size.x);
+		return;
+	}
+	const IPoint2 size = GetSize();
+	const uint depth = GetDepth();
+	RGBi rgb;
+	RGBAi c;
+	for (int x = 0; x < size.x; x++, rgba += 4)
+	{
+		if (depth == 8)
+			c.Set(GetPixel8(x, y), GetPixel8(x, y), GetPixel8(x, y), 255);
+		else if (depth == 24)
+		{
+			GetPixel24(x, y, rgb);
+			c.Set(rgb.r, rgb.g, rgb.b, 255);
+		}
+		else
+			GetPixel32(x, y, c);
+		rgba[0] = (uchar) c.r;
+		rgba[1] = (uchar) c.g;
+		rgba[2] = (uchar) c.b;
+		rgba[3] = (uchar) c.a;
+	}
+}
 
+/**
+ * Write a whole row of the bitmap, from RGBA bytes (4 for each pixel).
+ * An 8-bit bitmap gets the luminance of each color.
+ */
+void vtBitmapBase::WriteRow(int y, const uchar *rgba)
+{
+	vtPixelSpan span;
+	if (GetPixelSpan(span))
+	{
+		vtConvertRow(rgba, PF_RGBA32, NULL, span.Row(y), span.m_Format,
+			span.m_Size.x);
+		return;
+	}
+	const IPoint2 size = GetSize();
+	const uint depth = GetDepth();
+	for (int x = 0; x < size.x; x++, rgba += 4)
+	{
+		if (depth == 8)
+			SetPixel8(x, y, (uchar) ((rgba[0] * 77 + rgba[1] * 150 + rgba[2] * 29) >> 8));
+		else if (depth == 24)
+			SetPixel24(x, y, RGBi(rgba[0], rgba[1], rgba[2]));
+		else
+			SetPixel32(x, y, RGBAi(rgba[0], rgba[1], rgba[2], rgba[3]));
+	}
+}
+
+/**
+ * Multiply the colors of a whole row of the bitmap, by a factor for each
+ * pixel.  This is the same as calling ScalePixel8/24/32 for each, but faster.
+ */
+void vtBitmapBase::ScaleRow(int y, const float *scale)
+{
+	vtPixelSpan span;
+	if (GetPixelSpan(span))
+	{
+		vtScaleRow(span.Row(y), span.m_Format, scale, span.m_Size.x);
+		return;
+	}
+	const IPoint2 size = GetSize();
+	const uint depth = GetDepth();
+	for (int x = 0; x < size.x; x++)
+	{
+		if (depth == 8)
+			ScalePixel8(x, y, scale[x]);
+		else if (depth == 24)
+			ScalePixel24(x, y, scale[x]);
+		else if (depth == 32)
+			ScalePixel32(x, y, scale[x]);
+	}
+}
+
+/**
+ * Copy this bitmap into another, with its corner at (x, y) in the target,
+ * converting the pixels to the target's format.
+ */
+void vtBitmapBase::BlitTo(vtBitmapBase &target, int x, int y)
+{
 	const IPoint2 source_size = GetSize();
 	const IPoint2 target_size = target.GetSize();
 
+	// Clip to the target
+	const int i0 = std::max(0, -x), i1 = std::min(source_size.x, target_size.x - x);
+	const int j0 = std::max(0, -y), j1 = std::min(source_size.y, target_size.y - y);
+	if (i0 >= i1 || j0 >= j1)
+		return;
+
+	vtPixelSpan from, to;
+	if (GetPixelSpan(from) && target.GetPixelSpan(to))
+	{
+		const int sbytes = from.BytesPerPixel(), tbytes = to.BytesPerPixel();
+		for (int j = j0; j < j1; j++)
+			vtConvertRow(from.Row(j) + i0 * sbytes, from.m_Format, from.m_pPalette,
+				to.Row(j + y) + (i0 + x) * tbytes, to.m_Format, i1 - i0);
+		return;
+	}
+
+	// Otherwise, a pixel at a time
+	const int depth = GetDepth();
+	const int tdepth = target.GetDepth();
 	RGBi rgb;
 	RGBAi rgba;
-	for (int i = 0; i < source_size.x; i++)
+	for (int j = j0; j < j1; j++)
 	{
-		for (int j = 0; j < source_size.y; j++)
+		for (int i = i0; i < i1; i++)
 		{
 			const int tx = i+x, ty = j+y;
-			if (tx < 0 || tx > target_size.x-1 || ty < 0 || ty > target_size.y-1)
-				continue;
-
 			if (depth == 8 && tdepth == 8)
 			{
 				const uchar value = GetPixel8(i, j);
@@ -179,6 +469,7 @@ vtDIB::vtDIB(void *pDIB)
 	m_pDIB = pDIB;
 
 	m_Hdr = (BITMAPINFOHEADER *) m_pDIB;
+	m_iPaletteSize = m_Hdr->biClrUsed * sizeof(RGBQUAD);
 	m_Data = ((byte *)m_Hdr) + sizeof(BITMAPINFOHEADER) + m_iPaletteSize;
 
 	m_iWidth = m_Hdr->biWidth;
@@ -256,16 +547,11 @@ bool vtDIB::Create24From8bit(const vtDIB &from)
 	if (!Create(from.GetSize(), 24))
 		return false;
 
-	RGBi rgb;
-	uint i, j;
-	for (i = 0; i < m_iWidth; i++)
-	{
-		for (j = 0; j < m_iHeight; j++)
-		{
-			from.GetPixel24From8bit(i, j, rgb);
-			SetPixel24(i, j, rgb);
-		}
-	}
+	vtPixelSpan src, dst;
+	if (!from.GetPixelSpan(src) || !GetPixelSpan(dst))
+		return false;
+	for (uint j = 0; j < m_iHeight; j++)
+		vtConvertRow(src.Row(j), src.m_Format, src.m_pPalette, dst.Row(j), PF_BGR24, m_iWidth);
 	return true;
 }
 
@@ -1107,6 +1393,33 @@ void vtDIB::LeaveInternalDIB(bool bLeaveIt)
 	m_bLeaveIt = bLeaveIt;
 }
 
+/**
+ * Get direct access to the pixels, for 8, 24 and 32-bit bitmaps.
+ */
+bool vtDIB::GetPixelSpan(vtPixelSpan &span) const
+{
+	if (m_Data == NULL)
+		return false;
+	if (m_iBitCount == 8)
+		span.m_Format = PF_GRAY8;
+	else if (m_iBitCount == 24)
+		span.m_Format = PF_BGR24;
+	else if (m_iBitCount == 32)
+		span.m_Format = PF_BGRA32;
+	else
+		return false;
+
+	// Rows are stored bottom-up
+	span.m_pOrigin = ((byte *)m_Data) + (m_iHeight-1)*m_iByteWidth;
+	span.m_iStride = -(int)m_iByteWidth;
+	span.m_Size.Set(m_iWidth, m_iHeight);
+	if (m_iBitCount == 8 && m_iPaletteSize > 0)
+		span.m_pPalette = ((uchar *)m_Hdr) + sizeof(BITMAPINFOHEADER);
+	else
+		span.m_pPalette = NULL;
+	return true;
+}
+
 /**
  * Get a 24-bit RGB value from a 24-bit bitmap.
  *
@@ -1272,12 +1585,16 @@ void vtDIB::SetPixel1(int x, int y, bool value)
  */
 void vtDIB::SetColor(const RGBi &rgb)
 {
-	uint i, j;
-	for (i = 0; i < m_iWidth; i++)
-		for (j = 0; j < m_iHeight; j++)
-		{
-			SetPixel24(i, j, rgb);
-		}
+	vtPixelSpan span;
+	if (!GetPixelSpan(span) || m_iHeight == 0)
+		return;
+
+	// Fill one row, then copy it to the others
+	for (uint i = 0; i < m_iWidth; i++)
+		SetPixel24(i, 0, rgb);
+	const int bytes = m_iWidth * span.BytesPerPixel();
+	for (uint j = 1; j < m_iHeight; j++)
+		memcpy(span.Row(j), span.Row(0), bytes);
 }
 
 /**
@@ -1285,62 +1602,30 @@ void vtDIB::SetColor(const RGBi &rgb)
  */
 void vtDIB::Invert()
 {
-	uint i, j;
-	if (m_iBitCount == 8)
-	{
-		for (i = 0; i < m_iWidth; i++)
-			for (j = 0; j < m_iHeight; j++)
-			{
-				SetPixel8(i, j, 8-GetPixel8(i, j));
-			}
-	}
-	if (m_iBitCount == 24)
+	if (m_iBitCount != 8 && m_iBitCount != 24)
+		return;
+	for (uint j = 0; j < m_iHeight; j++)
 	{
-		RGBi rgb;
-		for (i = 0; i < m_iWidth; i++)
-			for (j = 0; j < m_iHeight; j++)
-			{
-				GetPixel24(i, j, rgb);
-				rgb.r = 255 - rgb.r;
-				rgb.g = 255 - rgb.g;
-				rgb.b = 255 - rgb.b;
-				SetPixel24(i, j, rgb);
-			}
+		byte *row = ((byte *)m_Data) + j*m_iByteWidth;
+		if (m_iBitCount == 8)
+		{
+			for (uint i = 0; i < m_iWidth; i++)
+				row[i] = 8 - row[i];
+		}
+		else
+		{
+			for (uint i = 0; i < m_iWidth * 3; i++)
+				row[i] = 255 - row[i];
+		}
 	}
 }
 
 /**
- * Copy from this bitmap to another.  Currently, this is implemented with
- * a slow, completely unoptimized approach of one pixel at a time.
+ * Copy from this bitmap to another of the same depth.
  */
 void vtDIB::Blit(vtDIB &target, int x, int y)
 {
-	uint depth = GetDepth();
-	if (depth != target.GetDepth())
+	if (GetDepth() != target.GetDepth())
 		return;
-	int tw = target.GetWidth();
-	int th = target.GetHeight();
-
-	uint i, j;
-	for (i = 0; i < m_iWidth; i++)
-	{
-		for (j = 0; j < m_iHeight; j++)
-		{
-			int tx = i+x, ty = j+y;
-			if (tx < 0 || tx > tw-1 || ty < 0 || ty > th-1)
-				continue;
-
-			if (depth == 8)
-			{
-				uchar value = GetPixel8(i, j);
-				target.SetPixel8(tx, ty, value);
-			}
-			else if (depth == 24)
-			{
-				uint value2 = GetPixel24(i, j);
-				target.SetPixel24(tx, ty, value2);
-			}
-		}
-	}
+	BlitTo(target, x, y);
 }
-
@@ -8,12 +8,55 @@
 #ifndef VTDATA_DIBH
 #define VTDATA_DIBH
 
+#include <stddef.h>
+
 #include "MathTypes.h"
 
 class vtProjection;
 
+/// The layout of the bytes of each pixel, for direct access to a bitmap.
+enum vtPixelFormat
+{
+	PF_GRAY8,	// one byte: a gray level, or an index into a palette
+	PF_RGB24,
+	PF_BGR24,
+	PF_RGBA32,
+	PF_BGRA32
+};
+
+/**
+ * Direct access to the pixels of a bitmap, a row at a time.  Row y starts
+ * at m_pOrigin + y * m_iStride, with y counting the same way as for
+ * GetPixel; the stride is negative for bitmaps which are stored the other
+ * way up.
+ */
+struct vtPixelSpan
+{
+	uchar *m_pOrigin;		// the first pixel of row 0
+	int m_iStride;			// bytes from one row to the next
+	vtPixelFormat m_Format;
+	IPoint2 m_Size;
+	const uchar *m_pPalette;	// for PF_GRAY8, a palette of BGRX quads, or NULL for gray
+
+	uchar *Row(int y) const { return m_pOrigin + (ptrdiff_t) y * m_iStride; }
+	int BytesPerPixel() const
+	{
+		return (m_Format == PF_GRAY8) ? 1 : (m_Format <= PF_BGR24) ? 3 : 4;
+	}
+};
+
+void vtConvertRow(const uchar *src, vtPixelFormat src_format, const uchar *palette,
+				  uchar *dst, vtPixelFormat dst_format, int count);
+void vtScaleRow(uchar *row, vtPixelFormat format, const float *scale, int count);
+
 /**
  * An abstract class which defines the basic functionality that any bitmap must expose.
+ *
+ * Access to single pixels is through virtual methods, which is convenient but
+ * slow for whole images.  Bitmaps which are simply arrays of bytes also
+ * provide a vtPixelSpan, and the bulk operations here (ReadRow, WriteRow,
+ * ScaleRow, BlitTo) work a row at a time on that, using SSE2 where
+ * available.  Any other bitmap falls back to the virtual methods.
  */
 class vtBitmapBase
 {
@@ -31,9 +74,16 @@ public:
 	virtual IPoint2 GetSize() const = 0;
 	virtual uint GetDepth() const = 0;
 
+	/// Get direct access to the pixels, if this bitmap allows it.
+	virtual bool GetPixelSpan(vtPixelSpan &span) const { return false; }
+
 	void ScalePixel8(int x, int y, float fScale);
 	void ScalePixel24(int x, int y, float fScale);
 	void ScalePixel32(int x, int y, float fScale);
+
+	void ReadRow(int y, uchar *rgba) const;
+	void WriteRow(int y, const uchar *rgba);
+	void ScaleRow(int y, const float *scale);
 	void BlitTo(vtBitmapBase &target, int x, int y);
 };
 
@@ -103,6 +153,7 @@ public:
 	uint GetWidth() const { return m_iWidth; }
 	uint GetHeight() const { return m_iHeight; }
 	uint GetDepth() const { return m_iBitCount; }
+	bool GetPixelSpan(vtPixelSpan &span) const;
 
 	void *GetHandle() const { return m_pDIB; }
 	BITMAPINFOHEADER *GetDIBHeader() const { return m_Hdr; }
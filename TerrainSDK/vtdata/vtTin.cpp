@@ -1306,9 +1306,9 @@ void vtTin::SetupTriangleBins(int bins, bool progress_callback(int))
 	}
 }
 
-int vtTin::MemoryNeededToLoad() const
+size_t vtTin::MemoryNeededToLoad() const
 {
-	int bytes = m_file_verts * sizeof(DPoint2);	// xy
+	size_t bytes = m_file_verts * sizeof(DPoint2);	// xy
 	bytes += m_file_verts * sizeof(float);		// z
 	bytes += sizeof(int) * 3 * m_file_tris;		// triangles
 	return bytes;
@@ -1394,6 +1394,43 @@ bool vtTin::FindTriangleOnEarth(const DPoint2 &p, float &fAltitude, int &iTriang
 	return false;
 }
 
+/**
+ * Find the altitude at a line of evenly spaced points, p0 + k * step for k
+ * from 0 to count-1.  Neighbouring points usually fall on the same triangle,
+ * so the last triangle hit is tested first before searching.
+ *
+ * Points which do not hit the TIN are left unchanged in the output array.
+ * This allows several TINs or grids to be sampled into the same array, in
+ * order of increasing priority.
+ *
+ * \return The number of values which were written.
+ */
+int vtTin::FindAltitudesOnEarth(const DPoint2 &p0, const DPoint2 &step,
+	int count, float *values, bool bTrue) const
+{
+	int written = 0;
+	int iLast = -1;
+	float fAltitude;
+	for (int k = 0; k < count; k++)
+	{
+		const DPoint2 p(p0.x + k * step.x, p0.y + k * step.y);
+		if (!m_EarthExtents.ContainsPoint(p, true))
+			continue;
+
+		bool bHit = (iLast != -1 && TestTriangle(iLast, p, fAltitude));
+		if (!bHit)
+			bHit = FindTriangleOnEarth(p, fAltitude, iLast, bTrue);
+		if (!bHit)
+		{
+			iLast = -1;
+			continue;
+		}
+		values[k] = fAltitude;
+		written++;
+	}
+	return written;
+}
+
 bool vtTin::FindAltitudeAtPoint(const FPoint3 &p3, float &fAltitude,
 		bool bTrue, int iCultureFlags, FPoint3 *vNormal) const
 {
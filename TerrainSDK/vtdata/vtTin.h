@@ -112,6 +112,8 @@ public:
 	// This method tells you the height, and also which triangle intersected.
 	bool FindTriangleOnEarth(const DPoint2 &p, float &fAltitude,
 		int &iTriangle, bool bTrue = false) const;
+	int FindAltitudesOnEarth(const DPoint2 &p0, const DPoint2 &step, int count,
+		float *values, bool bTrue = false) const;
 	FPoint3 GetTriangleNormal(int iTriangle) const;
 
 	// Avoid implementing HeightField3d virtual methods
@@ -126,7 +128,7 @@ public:
 	bool HasVertexNormals() const { return m_vert_normal.GetSize() != 0; }
 	int RemoveTrianglesBySegment(const DPoint2 &ep1, const DPoint2 &ep2);
 	void SetupTriangleBins(int bins, bool progress_callback(int) = NULL);
-	int MemoryNeededToLoad() const;
+	size_t MemoryNeededToLoad() const;
 	double GetArea2D();
 	double GetArea3D();
 
@@ -16,6 +16,24 @@
 #include "vtdata/Features.h"	// for vtFeatureSet
 #include "vtdata/vtLog.h"
 
+#include <osg/Timer>
+
+// Layers with more features than this are batched, unless their style says
+//  otherwise.
+#define FEATURE_BATCH_THRESHOLD	10000
+
+// Batched layers are divided into a grid of cells, with about this many
+//  features in each cell.
+#define FEATURES_PER_CELL		512
+#define MAX_CELLS_ACROSS		64
+
+// The most vertices put in one batched mesh, so that 16-bit indices will do
+#define FEATURE_MESH_MAX_VERTS	65535
+
+// Long lines are split into pieces of this many vertices, so they can be
+//  spread over several meshes.
+#define FEATURE_LINE_PIECE		4096
+
 vtAbstractLayer::vtAbstractLayer() : vtLayer(LT_RAW)
 {
 	m_pSet = NULL;
@@ -24,10 +42,16 @@ vtAbstractLayer::vtAbstractLayer() : vtLayer(LT_RAW)
 	pLabelGroup = NULL;
 	pMultiTexture = NULL;
 	m_pHeightField = NULL;
+	pGeodeObject = NULL;
+	pGeodeLine = NULL;
 
 	m_Props.SetValueString("Type", TERR_LTYPE_ABSTRACT);
 
+	m_bBatched = false;
+	m_iCellsAcross = 0;
+	m_bReindexCells = false;
 	m_bNeedRebuild = false;
+	m_bEditing = false;
 }
 
 vtAbstractLayer::~vtAbstractLayer()
@@ -206,11 +230,23 @@ void vtAbstractLayer::RecreateFeatureVisuals(bool progress_callback(int))
 	uint entities = m_pSet->NumEntities();
 	VTLOG("  Creating %d entities.. ", entities);
 
-	for (uint i = 0; i < entities; i++)
+	// Large layers are batched, unless the style says otherwise
+	if (!m_Props.GetValueBool("Batched", m_bBatched))
+		m_bBatched = (entities > FEATURE_BATCH_THRESHOLD);
+
+	if (m_bBatched)
+	{
+		SetupCells();
+		RebuildCells(progress_callback);
+	}
+	else
 	{
-		CreateFeatureVisual(i);
-		if (progress_callback != NULL)
-			progress_callback(i * 100 / entities);
+		for (uint i = 0; i < entities; i++)
+		{
+			CreateFeatureVisual(i);
+			if (progress_callback != NULL)
+				progress_callback(i * 100 / entities);
+		}
 	}
 
 	// A few types of visuals are not strictly per-feature; they must be
@@ -227,6 +263,18 @@ void vtAbstractLayer::RecreateFeatureVisuals(bool progress_callback(int))
 
 void vtAbstractLayer::CreateFeatureVisual(int iIndex)
 {
+	if (m_bBatched)
+	{
+		// Put the feature in its cell, and rebuild that cell
+		vtVisual *viz = GetViz(m_pSet->GetFeature(iIndex));
+		viz->m_iCell = FindCell(iIndex);
+		MarkCellDirty(viz->m_iCell);
+		m_bReindexCells = true;
+		if (!m_bEditing)
+			RebuildCells();
+		return;
+	}
+
 	if (m_Props.GetValueBool("ObjectGeometry"))
 		CreateObjectGeometry(iIndex);
 
@@ -323,6 +371,30 @@ int vtAbstractLayer::GetObjectMaterialIndex(vtTagArray &style, uint iIndex)
 	return result;
 }
 
+int vtAbstractLayer::GetLineMaterialIndex(vtTagArray &style, uint iIndex)
+{
+	int result;
+	int color_field_index;
+	if (style.GetValueInt("LineColorFieldIndex", color_field_index))
+	{
+		RGBAf rgba;
+		if (GetColorField(*m_pSet, iIndex, color_field_index, rgba))
+		{
+			result = pGeomMats->FindByDiffuse(rgba);
+			if (result == -1)
+			{
+				RGBf rgb = (RGBf) rgba;
+				result = pGeomMats->AddRGBMaterial(rgb, false, false, true);
+			}
+		}
+		else
+			result = material_index_line;
+	}
+	else
+		result = material_index_line;
+	return result;
+}
+
 
 /**
 	Given a featureset and style description, create a geometry object (such as
@@ -459,25 +531,7 @@ void vtAbstractLayer::CreateLineGeometry(uint iIndex)
 		CreateGeomGroup();
 
 	// Determine color and material index
-	int color_field_index;
-	int material_index;
-	if (m_Props.GetValueInt("LineColorFieldIndex", color_field_index))
-	{
-		RGBAf rgba;
-		if (GetColorField(*m_pSet, iIndex, color_field_index, rgba))
-		{
-			material_index = pGeomMats->FindByDiffuse(rgba);
-			if (material_index == -1)
-			{
-				RGBf rgb = (RGBf) rgba;
-				material_index = pGeomMats->AddRGBMaterial(rgb, false, false, true);
-			}
-		}
-		else
-			material_index = material_index_line;
-	}
-	else
-		material_index = material_index_line;
+	int material_index = GetLineMaterialIndex(m_Props, iIndex);
 
 	// Estimate number of mesh vertices we'll have
 	int iEstimatedVerts = 0;
@@ -612,14 +666,13 @@ void vtAbstractLayer::CreateLineGeometryForPoints()
 	vtGeomFactory mf(pGeodeLine, osg::PrimitiveSet::LINE_STRIP, 0, 30000, material_index,
 		iEstimatedVerts);
 
-	FPoint3 f3;
+	// preserve 3D point's elevation: don't drape
+	FLine3 fline;
+	m_pHeightField->m_LocalCS.EarthToLocal(dline, fline);
+
 	mf.PrimStart();
 	for (uint j = 0; j < size; j++)
-	{
-		// preserve 3D point's elevation: don't drape
-		m_pHeightField->m_LocalCS.EarthToLocal(dline[j], f3);
-		mf.AddVertex(f3);
-	}
+		mf.AddVertex(fline[j]);
 	mf.PrimEnd();
 
 	// If the user specified a line width, apply it now
@@ -653,9 +706,27 @@ void vtAbstractLayer::CreateFeatureLabel(uint iIndex)
 	if (!pLabelGroup)
 		CreateLabelGroup();
 
+	vtTransform *bb = CreateLabel(iIndex);
+	if (!bb)
+		return;
+	pLabelGroup->addChild(bb);
+
+	// Track what was created
+	vtVisual *viz = GetViz(m_pSet->GetFeature(iIndex));
+	if (viz) viz->m_xform = bb;
+}
+
+/**
+ * Make the label for a feature, in a transform which places it.  The caller
+ * must add it to the scene.
+ *
+ * \return The transform, or NULL if there is no label for the feature.
+ */
+vtTransform *vtAbstractLayer::CreateLabel(uint iIndex)
+{
 	// Must have a font to make a label
 	if (!m_pFont.valid())
-		return;
+		return NULL;
 
 	// for GetValueFloat below
 	ScopedLocale normal_numbers(LC_NUMERIC, "C");
@@ -679,7 +750,7 @@ void vtAbstractLayer::CreateFeatureLabel(uint iIndex)
 	// Don't drape on culture, but do use true elevation
 	FPoint3 fp3;
 	if (!m_pHeightField->ConvertEarthToSurfacePoint(p2, fp3, 0, true))
-		return;
+		return NULL;
 
 	float label_elevation;
 	if (!m_Props.GetValueFloat("LabelHeight", label_elevation))
@@ -745,15 +816,11 @@ void vtAbstractLayer::CreateFeatureLabel(uint iIndex)
 	// default behavior now.
 	geode->AddTextMesh(text, -1, bOutline);
 
-	// Transform to position it, add to the label group.
+	// Transform to position it.
 	vtTransform *bb = new vtTransform;
 	bb->addChild(geode);
 	bb->SetTrans(fp3);
-	pLabelGroup->addChild(bb);
-
-	// Track what was created
-	vtVisual *viz = GetViz(m_pSet->GetFeature(iIndex));
-	if (viz) viz->m_xform = bb;
+	return bb;
 }
 
 /**
@@ -770,6 +837,10 @@ void vtAbstractLayer::ReleaseGeometry()
 		vtFeature *f = m_pSet->GetFeature(i);
 		ReleaseFeatureGeometry(f);
 	}
+	for (uint c = 0; c < m_Cells.size(); c++)
+		ReleaseCell(m_Cells[c], true, true);
+	m_Cells.clear();
+
 	if (pGeomGroup)
 	{
 		pContainer->removeChild(pGeomGroup);
@@ -789,6 +860,13 @@ void vtAbstractLayer::ReleaseFeatureGeometry(vtFeature *f)
 {
 	vtVisual *v = GetViz(f);
 
+	// When batched, the geometry is shared with the other features of the
+	//  cell, which must be rebuilt without it.
+	if (v->m_iCell != -1)
+	{
+		MarkCellDirty(v->m_iCell);
+		m_bReindexCells = true;
+	}
 	for (uint m = 0; m < v->m_meshes.size(); m++)
 	{
 		vtMesh *mesh = v->m_meshes[m];
@@ -796,7 +874,7 @@ void vtAbstractLayer::ReleaseFeatureGeometry(vtFeature *f)
 		pGeodeObject->RemoveMesh(mesh);
 		pGeodeLine->RemoveMesh(mesh);
 	}
-	if (v->m_xform)
+	if (v->m_xform && v->m_iCell == -1)
 		pLabelGroup->removeChild(v->m_xform);
 	delete v;
 	m_Map.erase(f);
@@ -820,17 +898,52 @@ void vtAbstractLayer::RefreshFeatureVisuals(bool progress_callback(int))
 // When the underlying feature changes, we need to rebuild the visual
 void vtAbstractLayer::RefreshFeature(uint iIndex)
 {
-	// If we're not doing a full rebuild, we can create individual items
-	if (!m_bNeedRebuild)
+	// If we're doing a full rebuild, there's nothing to do yet
+	if (m_bNeedRebuild)
+		return;
+
+	if (m_bBatched)
 	{
-		vtFeature *f = m_pSet->GetFeature(iIndex);
-		ReleaseFeatureGeometry(f);
-		CreateFeatureVisual(iIndex);
+		// Only the cell it was in, and the cell it is in now, are rebuilt
+		vtVisual *viz = GetViz(m_pSet->GetFeature(iIndex));
+		const int iCell = FindCell(iIndex);
+		if (viz->m_iCell != iCell)
+		{
+			if (viz->m_iCell != -1)
+				MarkCellDirty(viz->m_iCell);
+			viz->m_iCell = iCell;
+			m_bReindexCells = true;
+		}
+		MarkCellDirty(iCell);
+		if (!m_bEditing)
+			RebuildCells();
+		return;
 	}
+
+	// Otherwise, we can create individual items
+	vtFeature *f = m_pSet->GetFeature(iIndex);
+	ReleaseFeatureGeometry(f);
+	CreateFeatureVisual(iIndex);
 }
 
 void vtAbstractLayer::UpdateVisualSelection()
 {
+	if (m_bBatched)
+	{
+		// Selected features are batched with the yellow material, so the
+		//  geometry of the cells where the selection changed is rebuilt.
+		if (!m_Props.GetValueBool("ObjectGeometry"))
+			return;
+		for (uint j = 0; j < m_pSet->NumEntities(); j++)
+		{
+			vtVisual *viz = GetViz(m_pSet->GetFeature(j));
+			if (viz->m_iCell != -1 && viz->m_bSelected != m_pSet->IsSelected(j))
+				MarkCellDirty(viz->m_iCell, false);
+		}
+		RebuildCells();
+		return;
+	}
+
 	// use SetMeshMatIndex to make the meshes of selected features yellow
 	for (uint j = 0; j < m_pSet->NumEntities(); j++)
 	{
@@ -881,15 +994,19 @@ void vtAbstractLayer::Reload()
 //  methods around any editing of style or geometry.
 void vtAbstractLayer::EditBegin()
 {
+	m_bEditing = true;
 }
 
 void vtAbstractLayer::EditEnd()
 {
+	m_bEditing = false;
 	if (m_bNeedRebuild)
 	{
 		m_bNeedRebuild = false;
 		RefreshFeatureVisuals();
 	}
+	else if (m_bBatched)
+		RebuildCells();
 }
 
 vtVisual *vtAbstractLayer::GetViz(vtFeature *feat)
@@ -916,3 +1033,623 @@ bool vtAbstractLayer::CreateAtOnce()
 	return false;
 }
 
+
+/**
+ * Get the bounding box, in world coordinates, of the geometry which was made
+ * for a feature.  This works for batched layers too, where the feature's
+ * geometry is part of larger meshes.
+ *
+ * \return false if the feature has no geometry.
+ */
+bool vtAbstractLayer::GetFeatureBounds(uint iIndex, FBox3 &box)
+{
+	vtVisual *viz = GetViz(m_pSet->GetFeature(iIndex));
+	box.InsideOut();
+	bool bFound = false;
+
+	FBox3 mbox;
+	for (uint k = 0; k < viz->m_meshes.size(); k++)
+	{
+		viz->m_meshes[k]->GetBoundBox(mbox);
+		box.GrowToContainBox(mbox);
+		bFound = true;
+	}
+	for (uint k = 0; k < viz->m_ranges.size(); k++)
+	{
+		const vtVisual::VertexRange &range = viz->m_ranges[k];
+		for (uint v = range.first; v < range.first + range.count; v++)
+		{
+			box.GrowToContainPoint(range.mesh->GetVtxPos(v));
+			bFound = true;
+		}
+	}
+	return bFound;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Batched visuals
+//
+// The features are divided among a grid of cells over the extents of the
+// layer.  The geometry of each cell is merged into one mesh per material
+// (more, if it has too many vertices for one), which are made in parallel.
+// Each feature's vtVisual records which cell it is in, and which ranges of
+// vertices of the meshes are its own.  When features change, only their
+// cells are rebuilt.
+
+// The style of the geometry, read once for all the features.
+struct vtAbstractLayer::BatchStyle
+{
+	bool bObjects, bLines;
+	float fObjectHeight, fRadius;
+	bool bTetrahedra;
+	float fLineHeight;
+	bool bTessellate;
+};
+
+// The geometry of one feature, made before it is merged into meshes.
+struct vtAbstractLayer::FeatureGeometry
+{
+	FeatureGeometry() : m_iObjectMat(-1), m_iLineMat(-1) {}
+
+	void AddLine(const FLine3 &line)
+	{
+		// Long lines are split into pieces, which share their end vertices
+		const uint size = line.GetSize();
+		for (uint start = 0; start + 1 < size; start += FEATURE_LINE_PIECE - 1)
+		{
+			uint end = start + FEATURE_LINE_PIECE;
+			if (end > size)
+				end = size;
+			for (uint i = start; i < end; i++)
+				m_LinePos.push_back(line[i]);
+			m_LineEnds.push_back((uint) m_LinePos.size());
+		}
+	}
+
+	int m_iObjectMat, m_iLineMat;
+	std::vector<FPoint3> m_Objects;		// the center of each solid
+	std::vector<FPoint3> m_LinePos;
+	std::vector<uint> m_LineEnds;		// where each line ends in m_LinePos
+};
+
+// A set of solids or line pieces from one feature, in a batch.
+struct FeatureBatchMember
+{
+	int iFeature;		// index in the array of features being built
+	uint iFirst, iLast;	// range of solids or line pieces
+	uint iFirstVert, iVerts;	// where they went in the mesh
+};
+
+// The contents of one mesh: the features of one cell, with one material.
+struct FeatureBatch
+{
+	int iCell;
+	bool bLines;
+	int iMatIdx;
+	uint iVerts;
+	std::vector<FeatureBatchMember> members;
+	vtMesh *pMesh;
+};
+
+// Vertices in each solid
+#define OCTAHEDRON_VERTS	6
+#define TETRAHEDRON_VERTS	12
+
+static void AddOctahedron(vtMesh *mesh, const FPoint3 &center, float fRadius)
+{
+	static const FPoint3 axes[6] = { FPoint3(1,0,0), FPoint3(-1,0,0),
+		FPoint3(0,1,0), FPoint3(0,-1,0), FPoint3(0,0,1), FPoint3(0,0,-1) };
+	static const int tris[8][3] = { {0,2,4}, {4,2,1}, {1,2,5}, {5,2,0},
+		{4,3,0}, {1,3,4}, {5,3,1}, {0,3,5} };
+
+	const int base = mesh->NumVertices();
+	for (int i = 0; i < 6; i++)
+		mesh->AddVertexN(center + axes[i] * fRadius, axes[i]);
+	for (int i = 0; i < 8; i++)
+		mesh->AddTri(base + tris[i][0], base + tris[i][1], base + tris[i][2]);
+}
+
+static void AddTetrahedron(vtMesh *mesh, const FPoint3 &center, float fRadius)
+{
+	const float f = fRadius / sqrtf(3.0f);
+	const FPoint3 corner[4] = { FPoint3(f,f,f), FPoint3(f,-f,-f),
+		FPoint3(-f,f,-f), FPoint3(-f,-f,f) };
+	static const int faces[4][3] = { {0,1,2}, {0,3,1}, {0,2,3}, {1,3,2} };
+
+	// Flat shaded, so each face has its own vertices
+	for (int i = 0; i < 4; i++)
+	{
+		const FPoint3 &p0 = corner[faces[i][0]];
+		const FPoint3 &p1 = corner[faces[i][1]];
+		const FPoint3 &p2 = corner[faces[i][2]];
+		FPoint3 norm = (p1 - p0).Cross(p2 - p0);
+		norm.Normalize();
+
+		const int base = mesh->NumVertices();
+		mesh->AddVertexN(center + p0, norm);
+		mesh->AddVertexN(center + p1, norm);
+		mesh->AddVertexN(center + p2, norm);
+		mesh->AddTri(base, base + 1, base + 2);
+	}
+}
+
+// Divide the extents of the layer into a grid of cells, and put each feature
+//  in a cell.
+void vtAbstractLayer::SetupCells()
+{
+	const uint entities = m_pSet->NumEntities();
+	m_pSet->EarthExtents(m_CellExtents);
+
+	m_iCellsAcross = (int) sqrt((double) entities / FEATURES_PER_CELL);
+	if (m_iCellsAcross < 1)
+		m_iCellsAcross = 1;
+	if (m_iCellsAcross > MAX_CELLS_ACROSS)
+		m_iCellsAcross = MAX_CELLS_ACROSS;
+
+	m_Cells.clear();
+	m_Cells.resize(m_iCellsAcross * m_iCellsAcross);
+	for (uint i = 0; i < entities; i++)
+	{
+		vtVisual *viz = GetViz(m_pSet->GetFeature(i));
+		viz->m_iCell = FindCell(i);
+		m_Cells[viz->m_iCell].m_Features.push_back(i);
+	}
+	for (uint c = 0; c < m_Cells.size(); c++)
+		MarkCellDirty(c);
+	m_bReindexCells = false;
+}
+
+// The point which decides which cell a feature is in.
+bool vtAbstractLayer::GetFeatureAnchor(uint iIndex, DPoint2 &p) const
+{
+	if (m_pSetP2)
+		p = m_pSetP2->GetPoint(iIndex);
+	else if (m_pSetP3)
+	{
+		const DPoint3 &p3 = m_pSetP3->GetPoint(iIndex);
+		p.Set(p3.x, p3.y);
+	}
+	else if (m_pSetLS2)
+	{
+		const DLine2 &dline = m_pSetLS2->GetPolyLine(iIndex);
+		if (dline.GetSize() == 0)
+			return false;
+		p = dline[dline.GetSize() / 2];
+	}
+	else if (m_pSetLS3)
+	{
+		const DLine3 &dline = m_pSetLS3->GetPolyLine(iIndex);
+		if (dline.GetSize() == 0)
+			return false;
+		const DPoint3 &p3 = dline[dline.GetSize() / 2];
+		p.Set(p3.x, p3.y);
+	}
+	else if (m_pSetPoly)
+	{
+		const DPolygon2 &dpoly = m_pSetPoly->GetPolygon(iIndex);
+		if (dpoly.size() == 0 || dpoly[0].GetSize() == 0)
+			return false;
+		p = dpoly[0].Centroid();
+	}
+	else
+		return false;
+	return true;
+}
+
+int vtAbstractLayer::FindCell(uint iIndex) const
+{
+	DPoint2 p;
+	if (!GetFeatureAnchor(iIndex, p))
+		return 0;
+
+	int x = 0, y = 0;
+	const double width = m_CellExtents.Width();
+	const double height = m_CellExtents.Height();
+	if (width > 0)
+		x = (int) ((p.x - m_CellExtents.left) / width * m_iCellsAcross);
+	if (height > 0)
+		y = (int) ((p.y - m_CellExtents.bottom) / height * m_iCellsAcross);
+
+	// Features which have moved outside the extents go in the edge cells
+	if (x < 0) x = 0;
+	if (x > m_iCellsAcross-1) x = m_iCellsAcross-1;
+	if (y < 0) y = 0;
+	if (y > m_iCellsAcross-1) y = m_iCellsAcross-1;
+	return y * m_iCellsAcross + x;
+}
+
+void vtAbstractLayer::MarkCellDirty(int iCell, bool bLabels)
+{
+	if (iCell < 0 || iCell >= (int) m_Cells.size())
+		return;
+	m_Cells[iCell].m_bDirtyGeom = true;
+	if (bLabels)
+		m_Cells[iCell].m_bDirtyLabels = true;
+}
+
+void vtAbstractLayer::ReleaseCell(Cell &cell, bool bGeom, bool bLabels)
+{
+	if (bGeom)
+	{
+		for (uint m = 0; m < cell.m_Meshes.size(); m++)
+		{
+			vtMesh *mesh = cell.m_Meshes[m];
+			pGeodeObject->RemoveMesh(mesh);
+			pGeodeLine->RemoveMesh(mesh);
+		}
+		cell.m_Meshes.clear();
+	}
+	if (bLabels && cell.m_pLabels)
+	{
+		pLabelGroup->removeChild(cell.m_pLabels);
+		cell.m_pLabels = NULL;
+	}
+}
+
+// Make the geometry of one feature.  This is called from several threads at
+//  once, so it must not change the layer.
+void vtAbstractLayer::MakeFeatureGeometry(uint iIndex, const BatchStyle &style,
+	FeatureGeometry &geom)
+{
+	FPoint3 p3;
+	if (style.bObjects)
+	{
+		if (m_pSetP2)
+		{
+			m_pHeightField->ConvertEarthToSurfacePoint(m_pSetP2->GetPoint(iIndex),
+				p3, 0, true);	// use true elev
+			p3.y += style.fObjectHeight;
+			geom.m_Objects.push_back(p3);
+		}
+		else if (m_pSetP3)
+		{
+			m_pHeightField->m_LocalCS.EarthToLocal(m_pSetP3->GetPoint(iIndex), p3);
+			geom.m_Objects.push_back(p3);
+		}
+		else if (m_pSetLS2)
+		{
+			const DLine2 &dline = m_pSetLS2->GetPolyLine(iIndex);
+			for (uint j = 0; j < dline.GetSize(); j++)
+			{
+				m_pHeightField->ConvertEarthToSurfacePoint(dline[j], p3);
+				p3.y += style.fObjectHeight;
+				geom.m_Objects.push_back(p3);
+			}
+		}
+		else if (m_pSetLS3)
+		{
+			// preserve 3D point's elevation: don't drape
+			FLine3 fline;
+			m_pHeightField->m_LocalCS.EarthToLocal(m_pSetLS3->GetPolyLine(iIndex), fline);
+			geom.m_Objects.insert(geom.m_Objects.end(), fline.GetData(),
+				fline.GetData() + fline.GetSize());
+		}
+	}
+	if (style.bLines)
+	{
+		FLine3 line;
+		if (m_pSetLS2)
+		{
+			const DLine2 &dline = m_pSetLS2->GetPolyLine(iIndex);
+			if (m_pOCTransform.get())
+			{
+				DLine2 copy = dline;
+				TransformInPlace(m_pOCTransform.get(), copy);
+				m_pHeightField->LineOnSurface(copy, m_fSpacing, style.fLineHeight,
+					style.bTessellate, false, true, line);
+			}
+			else
+				m_pHeightField->LineOnSurface(dline, m_fSpacing, style.fLineHeight,
+					style.bTessellate, false, true, line);
+			geom.AddLine(line);
+		}
+		else if (m_pSetLS3)
+		{
+			// preserve 3D point's elevation: don't drape
+			const DLine3 &dline = m_pSetLS3->GetPolyLine(iIndex);
+			if (m_pOCTransform.get())
+			{
+				DLine3 copy = dline;
+				for (uint j = 0; j < copy.GetSize(); j++)
+					m_pOCTransform->Transform(1, &copy[j].x, &copy[j].y);
+				m_pHeightField->m_LocalCS.EarthToLocal(copy, line);
+			}
+			else
+				m_pHeightField->m_LocalCS.EarthToLocal(dline, line);
+			geom.AddLine(line);
+		}
+		else if (m_pSetPoly)
+		{
+			const DPolygon2 &dpoly = m_pSetPoly->GetPolygon(iIndex);
+			for (uint k = 0; k < dpoly.size(); k++)
+			{
+				// copy each ring in order to close it
+				DLine2 dline = dpoly[k];
+				if (dline.GetSize() == 0)
+					continue;
+				dline.Append(dline[0]);
+				if (m_pOCTransform.get())
+					TransformInPlace(m_pOCTransform.get(), dline);
+
+				line.Clear();
+				m_pHeightField->LineOnSurface(dline, m_fSpacing, style.fLineHeight,
+					style.bTessellate, false, true, line);
+				geom.AddLine(line);
+			}
+		}
+	}
+}
+
+/**
+ * Rebuild the cells which have been marked as needing it.
+ */
+void vtAbstractLayer::RebuildCells(bool progress_callback(int))
+{
+	if (m_Cells.empty())
+		return;
+
+	osg::Timer *timer = osg::Timer::instance();
+	osg::Timer_t start = timer->tick();
+
+	// for GetValueFloat below
+	ScopedLocale normal_numbers(LC_NUMERIC, "C");
+
+	if (m_bReindexCells)
+	{
+		// Features have been added or removed, so the indices may have
+		//  changed.  Put each feature back in its cell.
+		for (uint c = 0; c < m_Cells.size(); c++)
+			m_Cells[c].m_Features.clear();
+		for (uint i = 0; i < m_pSet->NumEntities(); i++)
+		{
+			vtVisual *viz = GetViz(m_pSet->GetFeature(i));
+			if (viz->m_iCell == -1)
+			{
+				viz->m_iCell = FindCell(i);
+				MarkCellDirty(viz->m_iCell);
+			}
+			m_Cells[viz->m_iCell].m_Features.push_back(i);
+		}
+		m_bReindexCells = false;
+	}
+
+	BatchStyle style;
+	style.bObjects = m_Props.GetValueBool("ObjectGeometry") &&
+		(m_pSetP2 || m_pSetP3 || m_pSetLS2 || m_pSetLS3);
+	style.bLines = m_Props.GetValueBool("LineGeometry") &&
+		(m_pSetLS2 || m_pSetLS3 || m_pSetPoly);
+	const bool bLabels = m_Props.GetValueBool("Labels") &&
+		(m_pSetP2 || m_pSetP3 || m_pSetPoly);
+
+	style.fObjectHeight = 0.0f;
+	if (m_pSetP2 || m_pSetLS2)
+		m_Props.GetValueFloat("ObjectGeomHeight", style.fObjectHeight);
+	if (!m_Props.GetValueFloat("ObjectGeomSize", style.fRadius))
+		style.fRadius = 1;
+	// If a large number of 3D points, make as simple geometry as possible
+	style.bTetrahedra = (m_pSetP3 != NULL && m_pSet->NumEntities() > 10000);
+	const uint iSolidVerts = style.bTetrahedra ? TETRAHEDRON_VERTS : OCTAHEDRON_VERTS;
+
+	style.fLineHeight = 0.0f;
+	if (m_pSetLS2 || m_pSetPoly)
+	{
+		if (!m_Props.GetValueFloat("LineGeomHeight", style.fLineHeight))
+			style.fLineHeight = 1.0f;
+	}
+	style.bTessellate = m_Props.GetValueBool("Tessellate");
+
+	float fWidth;
+	bool bWidth = (m_Props.GetValueFloat("LineWidth", fWidth) && fWidth != 1.0f);
+
+	if ((style.bObjects || style.bLines) && !pGeomGroup)
+		CreateGeomGroup();
+
+	// Release the old geometry of the dirty cells, and gather their features
+	std::vector<int> cells;
+	std::vector<uint> features;
+	for (uint c = 0; c < m_Cells.size(); c++)
+	{
+		Cell &cell = m_Cells[c];
+		if (!cell.m_bDirtyGeom)
+			continue;
+		ReleaseCell(cell, true, false);
+		for (uint j = 0; j < cell.m_Features.size(); j++)
+			GetViz(m_pSet->GetFeature(cell.m_Features[j]))->m_ranges.clear();
+		if (style.bObjects || style.bLines)
+		{
+			cells.push_back(c);
+			features.insert(features.end(), cell.m_Features.begin(), cell.m_Features.end());
+		}
+	}
+	const int count = (int) features.size();
+	std::vector<FeatureGeometry> geom(count);
+
+	// Finding the materials may add to the material array, so do it first,
+	//  on this thread.
+	for (int k = 0; k < count; k++)
+	{
+		const uint i = features[k];
+		vtVisual *viz = GetViz(m_pSet->GetFeature(i));
+		viz->m_bSelected = m_pSet->IsSelected(i);
+		if (style.bObjects)
+		{
+			geom[k].m_iObjectMat = viz->m_bSelected ? material_index_yellow :
+				GetObjectMaterialIndex(m_Props, i);
+		}
+		if (style.bLines)
+			geom[k].m_iLineMat = GetLineMaterialIndex(m_Props, i);
+	}
+
+	// Make the geometry of the features.  A coordinate transform can't be
+	//  shared between threads, so if there is one, use a single thread.
+	const bool bParallel = (m_pOCTransform.get() == NULL);
+	#pragma omp parallel for schedule(dynamic, 64) if (bParallel)
+	for (int k = 0; k < count; k++)
+		MakeFeatureGeometry(features[k], style, geom[k]);
+
+	if (progress_callback != NULL)
+		progress_callback(40);
+
+	// Lay the features out in batches, one per cell and material, each no
+	//  larger than a mesh can index.
+	std::vector<FeatureBatch> batches;
+	std::map<std::pair<int,int>, int> current;	// (material, lines) -> batch
+	int k = 0;
+	for (uint n = 0; n < cells.size(); n++)
+	{
+		current.clear();
+		const Cell &cell = m_Cells[cells[n]];
+		for (uint j = 0; j < cell.m_Features.size(); j++, k++)
+		{
+			const FeatureGeometry &fg = geom[k];
+			for (int lines = 0; lines < 2; lines++)
+			{
+				const uint items = lines ? (uint) fg.m_LineEnds.size() : (uint) fg.m_Objects.size();
+				const std::pair<int,int> key(lines ? fg.m_iLineMat : fg.m_iObjectMat, lines);
+				for (uint item = 0; item < items; item++)
+				{
+					uint verts = iSolidVerts;
+					if (lines)
+						verts = fg.m_LineEnds[item] - (item == 0 ? 0 : fg.m_LineEnds[item-1]);
+
+					std::map<std::pair<int,int>, int>::iterator it = current.find(key);
+					if (it == current.end() ||
+						batches[it->second].iVerts + verts > FEATURE_MESH_MAX_VERTS)
+					{
+						FeatureBatch batch;
+						batch.iCell = cells[n];
+						batch.bLines = (lines != 0);
+						batch.iMatIdx = key.first;
+						batch.iVerts = 0;
+						batch.pMesh = NULL;
+						batches.push_back(batch);
+						current[key] = (int) batches.size() - 1;
+						it = current.find(key);
+					}
+					FeatureBatch &batch = batches[it->second];
+
+					// Extend this feature's run in the batch, or start one
+					if (!batch.members.empty() && batch.members.back().iFeature == k)
+						batch.members.back().iLast = item;
+					else
+					{
+						FeatureBatchMember member;
+						member.iFeature = k;
+						member.iFirst = member.iLast = item;
+						member.iFirstVert = member.iVerts = 0;
+						batch.members.push_back(member);
+					}
+					batch.iVerts += verts;
+				}
+			}
+		}
+	}
+
+	// Fill the meshes
+	const int iBatches = (int) batches.size();
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int b = 0; b < iBatches; b++)
+	{
+		FeatureBatch &batch = batches[b];
+		vtMesh *mesh;
+		if (batch.bLines)
+			mesh = new vtMesh(osg::PrimitiveSet::LINES, 0, batch.iVerts);
+		else
+			mesh = new vtMesh(osg::PrimitiveSet::TRIANGLES, VT_Normals, batch.iVerts);
+
+		for (uint m = 0; m < batch.members.size(); m++)
+		{
+			FeatureBatchMember &member = batch.members[m];
+			const FeatureGeometry &fg = geom[member.iFeature];
+			member.iFirstVert = mesh->NumVertices();
+			for (uint item = member.iFirst; item <= member.iLast; item++)
+			{
+				if (!batch.bLines)
+				{
+					if (style.bTetrahedra)
+						AddTetrahedron(mesh, fg.m_Objects[item], style.fRadius);
+					else
+						AddOctahedron(mesh, fg.m_Objects[item], style.fRadius);
+					continue;
+				}
+				const uint first = (item == 0 ? 0 : fg.m_LineEnds[item-1]);
+				const int base = mesh->NumVertices();
+				for (uint v = first; v < fg.m_LineEnds[item]; v++)
+				{
+					mesh->AddVertex(fg.m_LinePos[v]);
+					if (v > first)
+						mesh->AddLine(base + v - first - 1, base + v - first);
+				}
+			}
+			member.iVerts = mesh->NumVertices() - member.iFirstVert;
+		}
+		batch.pMesh = mesh;
+	}
+
+	if (progress_callback != NULL)
+		progress_callback(70);
+
+	// Add them to the scene, and tell each feature where its vertices are
+	for (int b = 0; b < iBatches; b++)
+	{
+		FeatureBatch &batch = batches[b];
+		if (batch.bLines)
+		{
+			pGeodeLine->AddMesh(batch.pMesh, batch.iMatIdx);
+			if (bWidth)
+				batch.pMesh->SetLineWidth(fWidth);
+		}
+		else
+			pGeodeObject->AddMesh(batch.pMesh, batch.iMatIdx);
+		m_Cells[batch.iCell].m_Meshes.push_back(batch.pMesh);
+
+		for (uint m = 0; m < batch.members.size(); m++)
+		{
+			const FeatureBatchMember &member = batch.members[m];
+			vtVisual::VertexRange range;
+			range.mesh = batch.pMesh;
+			range.first = member.iFirstVert;
+			range.count = member.iVerts;
+			vtFeature *feat = m_pSet->GetFeature(features[member.iFeature]);
+			GetViz(feat)->m_ranges.push_back(range);
+		}
+	}
+
+	// Labels can't be merged, but they are grouped by cell
+	if (bLabels && !pLabelGroup)
+		CreateLabelGroup();
+	for (uint c = 0; c < m_Cells.size(); c++)
+	{
+		Cell &cell = m_Cells[c];
+		if (cell.m_bDirtyLabels)
+		{
+			ReleaseCell(cell, false, true);
+			for (uint j = 0; j < cell.m_Features.size(); j++)
+				GetViz(m_pSet->GetFeature(cell.m_Features[j]))->m_xform = NULL;
+		}
+		if (cell.m_bDirtyLabels && bLabels && !cell.m_Features.empty())
+		{
+			cell.m_pLabels = new vtGroup;
+			cell.m_pLabels->setName("Label Cell");
+			pLabelGroup->addChild(cell.m_pLabels);
+
+			for (uint j = 0; j < cell.m_Features.size(); j++)
+			{
+				const uint i = cell.m_Features[j];
+				vtTransform *bb = CreateLabel(i);
+				if (bb)
+				{
+					cell.m_pLabels->addChild(bb);
+					GetViz(m_pSet->GetFeature(i))->m_xform = bb;
+				}
+			}
+			if (progress_callback != NULL)
+				progress_callback(70 + c * 30 / m_Cells.size());
+		}
+		cell.m_bDirtyGeom = cell.m_bDirtyLabels = false;
+	}
+
+	VTLOG("  Built %d features in %d cells, %d meshes, %.1f ms\n", count,
+		(int) cells.size(), iBatches, timer->delta_m(start, timer->tick()));
+}
@@ -18,9 +18,20 @@ class vtTerrain;
 class vtVisual
 {
 public:
-	vtVisual() : m_xform(NULL) {}
+	vtVisual() : m_xform(NULL), m_iCell(-1), m_bSelected(false) {}
 	std::vector<vtMesh*> m_meshes;
 	vtTransform *m_xform;
+
+	// When the layer is batched, the feature's geometry is part of the
+	//  merged meshes of its cell, as these ranges of vertices.
+	struct VertexRange
+	{
+		vtMesh *mesh;
+		uint first, count;
+	};
+	std::vector<VertexRange> m_ranges;
+	int m_iCell;
+	bool m_bSelected;	// whether it was selected when its cell was built
 };
 
 typedef std::map<vtFeature*,vtVisual*> VizMap;
@@ -70,6 +81,13 @@ typedef std::map<vtFeature*,vtVisual*> VizMap;
 	 - "LabelOutline": true to put a dark outline around the font to improve its
 		readability against most backgrounds.
 
+	- "Batched": true to merge the geometry of the features, one mesh per
+		material for each cell of a grid over the layer, instead of making
+		meshes for each feature.  This is much faster to create and to draw
+		for large layers.  Labels are still made for each feature, but
+		grouped by cell.  The default is true for layers of more than
+		10000 features.
+
  When a terrain description (TParams) contains an abstract layer, these same
  style properties are encoded.  On disk, they are stored as XML elements.
  */
@@ -100,6 +118,7 @@ public:
 		float fSpacing, bool progress_callback(int) = NULL);
 	void RecreateFeatureVisuals(bool progress_callback(int) = NULL);
 	void CreateLineGeometryForPoints();
+	bool IsBatched() const { return m_bBatched; }
 
 	// Create for a single feature
 	void CreateFeatureVisual(int iIndex);
@@ -109,6 +128,7 @@ public:
 
 	void ReleaseGeometry();
 	void ReleaseFeatureGeometry(vtFeature *f);
+	bool GetFeatureBounds(uint iIndex, FBox3 &box);
 
 	// When the underlying feature changes, we need to rebuild the visual
 	void RefreshFeatureVisuals(bool progress_callback(int) = NULL);
@@ -126,6 +146,27 @@ protected:
 	void CreateGeomGroup();
 	void CreateLabelGroup();
 	int GetObjectMaterialIndex(vtTagArray &style, uint iIndex);
+	int GetLineMaterialIndex(vtTagArray &style, uint iIndex);
+	vtTransform *CreateLabel(uint iIndex);
+
+	// Batched visuals
+	struct BatchStyle;
+	struct FeatureGeometry;
+	struct Cell
+	{
+		Cell() : m_pLabels(NULL), m_bDirtyGeom(false), m_bDirtyLabels(false) {}
+		std::vector<uint> m_Features;
+		std::vector<vtMesh*> m_Meshes;
+		vtGroup *m_pLabels;
+		bool m_bDirtyGeom, m_bDirtyLabels;
+	};
+	void SetupCells();
+	bool GetFeatureAnchor(uint iIndex, DPoint2 &p) const;
+	int FindCell(uint iIndex) const;
+	void MarkCellDirty(int iCell, bool bLabels = true);
+	void ReleaseCell(Cell &cell, bool bGeom, bool bLabels);
+	void RebuildCells(bool progress_callback(int) = NULL);
+	void MakeFeatureGeometry(uint iIndex, const BatchStyle &style, FeatureGeometry &geom);
 
 	/// This is the set of features which the layer contains.
 	vtFeatureSet *m_pSet;
@@ -160,9 +201,17 @@ protected:
 	// A transform from the CRS of the featureset to the CRS of the scene they are shown in.
 	std::auto_ptr<OCTransform> m_pOCTransform;
 
+	// Batching
+	bool m_bBatched;
+	DRECT m_CellExtents;
+	int m_iCellsAcross;
+	std::vector<Cell> m_Cells;
+	bool m_bReindexCells;	// features were added or removed
+
 	// Edit tracking
 	bool CreateAtOnce();
 	bool m_bNeedRebuild;
+	bool m_bEditing;
 };
 
 #endif // ABSTRACTLAYERH
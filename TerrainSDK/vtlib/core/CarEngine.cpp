@@ -1,7 +1,7 @@
 //
 // CarEngine.cpp
 //
-// Copyright (c) 2001-2011 Virtual Terrain Project
+// Copyright (c) 2001-2013 Virtual Terrain Project
 // Free for all uses, see license.txt for details.
 //
 
@@ -9,14 +9,11 @@
 #include "CarEngine.h"
 #include "vtdata/vtLog.h"
 
-using namespace std;
+#include <osg/Timer>
 
-// acceleration in meters per second^2 (for the car.)
-#define ACCELERATION 4.0f
-#define ACCEL (ACCELERATION*1000/60/60)
+using namespace std;
 
 static FPoint3 XAXIS = FPoint3(1, 0, 0);
-static FPoint3 YAXIS = FPoint3(0, 1, 0);
 
 
 ///////////////////////////////////////////////////////////////////////
@@ -32,43 +29,80 @@ float angleNormal(float val)
 	return val;
 }
 
+// The center of a wheel, in the frame of its vehicle.
+static FPoint3 WheelOffset(Vehicle *car, osg::Node *wheel)
+{
+	// The wheel's bound is in the frame of its parent, so we need the
+	//  transforms between the vehicle and the wheel, excluding both.
+	osg::Matrix mat;
+	osg::NodePathList paths = wheel->getParentalNodePaths(car);
+	if (!paths.empty() && paths[0].size() >= 2)
+	{
+		osg::NodePath path(paths[0].begin() + 1, paths[0].end() - 1);
+		mat = osg::computeLocalToWorld(path);
+	}
+	osg::Vec3 center = wheel->getBound().center() * mat;
+	return FPoint3(center.x(), center.y(), center.z());
+}
+
 
 ///////////////////////////////////////////////////////////////////////
-// CarEngine class
+// VehicleSim class
 
 /**
- Setup engine to drive freely.
-
- \param vehicle	The vehicle this engine will control.
- \param hf		The surface to drive on.
+ \param hf		The surface the vehicles drive on.
  */
-CarEngine::CarEngine(Vehicle *vehicle, vtHeightField3d *hf)
+VehicleSim::VehicleSim(vtHeightField3d *hf)
 {
-	m_pVehicle = vehicle;
-	AddTarget(vehicle);
-
 	m_pHeightField = hf;
-
-	m_fSpeed = 0;
-
-	m_fSteeringAngle = 0.0f;
-	m_fFriction = 1.0f;
-	m_fCurRotation = PID2f;
-	m_fCurPitch = 0;
-	m_vAxis = XAXIS;
-
-	m_bFirstTime = true;
-	m_bCameraFollow = false;
-	m_bCameraDistance = 20.0f;
-
+	m_iCultureFlags = CE_ROADS;
 	m_fPrevTime = 0.0f;		// we will use engine time (t) from now on
+	m_iCameraFollow = -1;
+	m_fCameraDistance = 20.0f;
+}
+
+/**
+ Add a vehicle to the simulation.  It is settled onto the ground where it
+ stands, facing the direction it already faces.
 
-	m_vCurPos = vehicle->GetTrans();
-	m_eMode = JUST_DRIVE;
+ \return The index of the vehicle, or -1 if it doesn't have four wheels.
+ */
+int VehicleSim::AddVehicle(Vehicle *car)
+{
+	if (!car->m_pFrontLeft || !car->m_pFrontRight ||
+		!car->m_pRearLeft || !car->m_pRearRight)
+		return -1;
+
+	const FPoint3 pos = car->GetTrans();
+	const FPoint3 dir = car->GetDirection();
+
+	m_Vehicles.push_back(car);
+	m_PosX.push_back(pos.x);
+	m_PosY.push_back(pos.y);
+	m_PosZ.push_back(pos.z);
+	m_Rotation.push_back(atan2f(-dir.z, dir.x));
+	m_Pitch.push_back(0.0f);
+	m_Roll.push_back(0.0f);
+	m_Speed.push_back(0.0f);
+	m_Steering.push_back(0.0f);
+	m_Friction.push_back(1.0f);
+	m_WheelSpin.push_back(0.0f);
+	m_Enabled.push_back(true);
+	m_Pose.push_back(osg::Matrix::identity());
+
+	m_WheelOffset.push_back(WheelOffset(car, car->m_pFrontLeft));
+	m_WheelOffset.push_back(WheelOffset(car, car->m_pFrontRight));
+	m_WheelOffset.push_back(WheelOffset(car, car->m_pRearLeft));
+	m_WheelOffset.push_back(WheelOffset(car, car->m_pRearRight));
+	m_Contact.resize(m_WheelOffset.size());
+
+	const int index = (int) m_Vehicles.size() - 1;
+	Settle(index);
+	return index;
 }
 
-// Evaluate the car engine.
-void CarEngine::Eval()
+// Evaluate the simulation.
+void VehicleSim::Eval()
 {
 	float t = vtGetTime();
 	float fDeltaTime = t - m_fPrevTime;
@@ -77,238 +111,282 @@ void CarEngine::Eval()
 	if (fDeltaTime > 1.0f)
 		fDeltaTime = 1.0f;
 
-	//find Next location
-	FPoint3 vNext;
-	switch (m_eMode)
-	{
-	case NONE:	//go nowhere.
-		vNext = m_vCurPos;
-		MoveCarTo(vNext);
-		break;
-	case JUST_DRIVE:
-		// apply friction
-		m_fSpeed *= m_fFriction;
-
-		// move in the direction we're facing
-		vNext.x = m_vCurPos.x + fDeltaTime*m_fSpeed*cosf(m_fCurRotation);
-		vNext.y = m_vCurPos.y;
-		vNext.z = m_vCurPos.z - fDeltaTime*m_fSpeed*sinf(m_fCurRotation);
-		MoveCarTo(vNext);
-		break;
-	case FOLLOW_ROAD:
-	case FOLLOW_PATH:
-		break;
-	}
-	// spin the wheels, adjusted for speed.
-	SpinWheels(fDeltaTime*m_fSpeed/m_pVehicle->GetWheelRadius());
+	Step(fDeltaTime);
 
 	m_fPrevTime = t;
 }
 
-void CarEngine::IgnoreElapsedTime()
+void VehicleSim::IgnoreElapsedTime()
 {
 	m_fPrevTime = vtGetTime();
 }
 
-void CarEngine::SetSpeed(float fMetersPerSec)
+/**
+ Advance all the enabled vehicles by a period of time, and move them in the
+ scene graph.
+ */
+void VehicleSim::Step(float fDeltaTime)
 {
-	m_fSpeed = fMetersPerSec;
+	const int num = (int) m_Vehicles.size();
+	if (num == 0)
+		return;
+
+	Simulate(fDeltaTime);
+
+	// The scene graph is only touched here, from one thread
+	for (int i = 0; i < num; i++)
+	{
+		if (m_Enabled[i])
+			Apply(i);
+	}
+	UpdateCamera();
 }
 
-DPoint2 CarEngine::GetEarthPos(const LocalCS &conv)
+/**
+ Advance all the enabled vehicles by a period of time, without touching the
+ scene graph.
+ */
+void VehicleSim::Simulate(float fDeltaTime)
 {
-	// convert terrain to earth coords
-	DPoint3 d3;
-	conv.LocalToEarth(m_vCurPos, d3);
-	return DPoint2(d3.x, d3.y);
+	const int num = (int) m_Vehicles.size();
+	if (num == 0)
+		return;
+
+	// When the wheels rest on culture, the ground is sampled one point at a
+	//  time through the scene graph, and that dominates the step, so there
+	//  is nothing to gain from starting threads for the rest.
+	const bool bParallel = (m_iCultureFlags == 0);
+
+	// Move each vehicle, and find where its wheels are now
+	#pragma omp parallel for if (bParallel)
+	for (int i = 0; i < num; i++)
+	{
+		if (!m_Enabled[i])
+			continue;
+		Advance(i, fDeltaTime);
+		FindWheelContacts(i);
+	}
+
+	// Sample the ground under all the wheels at once
+	m_pHeightField->FindAltitudesAtPoints(&m_Contact[0], (int) m_Contact.size(),
+		false, m_iCultureFlags);
+
+	// Orient each vehicle to rest on its wheels
+	#pragma omp parallel for if (bParallel)
+	for (int i = 0; i < num; i++)
+	{
+		if (m_Enabled[i])
+			ComputePose(i);
+	}
 }
 
-void CarEngine::SetEarthPos(const LocalCS &conv, const DPoint2 &pos)
-{
-	// convert earth to terrain coords
-	DPoint3 d3(pos.x, pos.y, 0);
-	conv.EarthToLocal(d3, m_vCurPos);
+/**
+ Measure how quickly the simulation runs, by simulating a number of steps
+ with a fixed time step.  The scene graph is not touched, and the state of
+ the vehicles is put back as it was afterwards.
 
-	ApplyCurrentLocation(true);
+ \return The number of vehicles simulated per millisecond.
+ */
+double VehicleSim::Benchmark(int iSteps, float fDeltaTime)
+{
+	const int num = (int) m_Vehicles.size();
+	if (num == 0 || iSteps < 1)
+		return 0.0;
+
+	// Save the state which simulating changes
+	const std::vector<float> x = m_PosX, y = m_PosY, z = m_PosZ;
+	const std::vector<float> rot = m_Rotation, pitch = m_Pitch, roll = m_Roll;
+	const std::vector<float> speed = m_Speed, spin = m_WheelSpin;
+	const std::vector<osg::Matrix> pose = m_Pose;
+
+	osg::Timer_t start = osg::Timer::instance()->tick();
+	for (int s = 0; s < iSteps; s++)
+		Simulate(fDeltaTime);
+	osg::Timer_t end = osg::Timer::instance()->tick();
+	const double ms = osg::Timer::instance()->delta_m(start, end);
+
+	m_PosX = x;
+	m_PosY = y;
+	m_PosZ = z;
+	m_Rotation = rot;
+	m_Pitch = pitch;
+	m_Roll = roll;
+	m_Speed = speed;
+	m_WheelSpin = spin;
+	m_Pose = pose;
+
+	const double rate = (ms > 0.0) ? (double) num * iSteps / ms : 0.0;
+	VTLOG("VehicleSim benchmark: %d vehicles, %d steps in %.2f ms, %.1f vehicles/ms\n",
+		num, iSteps, ms, rate);
+	return rate;
 }
 
-void CarEngine::SetRotation(float fRot)
+// Put one vehicle on the ground where it is, without moving it.
+void VehicleSim::Settle(int i)
 {
-	m_fCurRotation = fRot;
-	ApplyCurrentLocation(true);
+	m_WheelSpin[i] = 0.0f;
+	FindWheelContacts(i);
+	m_pHeightField->FindAltitudesAtPoints(&m_Contact[i*4], 4, false, m_iCultureFlags);
+	ComputePose(i);
+	Apply(i);
 }
 
-void CarEngine::ApplyCurrentLocation(bool bAlignOnGround)
+void VehicleSim::Advance(int i, float fDeltaTime)
 {
-	vtTransform *car = dynamic_cast<vtTransform*> (GetTarget());
-	if (!car)
-		return;
+	// apply friction
+	m_Speed[i] *= m_Friction[i];
 
-	// re-settle vehicle on terrain surface
-	car->Identity();
+	// move in the direction we're facing
+	const float dx = fDeltaTime * m_Speed[i] * cosf(m_Rotation[i]);
+	const float dz = -fDeltaTime * m_Speed[i] * sinf(m_Rotation[i]);
+	if (dx != 0.0f || dz != 0.0f)
+	{
+		// Turn car based on how the steering wheel is turned
+		const float distance_traveled = sqrtf(dx*dx + dz*dz);
+		m_Rotation[i] = angleNormal(m_Rotation[i] + m_Steering[i] * distance_traveled);
+	}
+	m_PosX[i] += dx;
+	m_PosZ[i] += dz;
 
-	car->SetTrans(m_vCurPos);
+	// spin the wheels, adjusted for speed.
+	m_WheelSpin[i] = fDeltaTime * m_Speed[i] / m_Vehicles[i]->GetWheelRadius();
+}
 
+// Find the points in the XZ plane under each wheel, given the vehicle's
+//  position and heading.
+void VehicleSim::FindWheelContacts(int i)
+{
 	// Angle is measure from +X, but our car's "forward" is -Z.  That's a difference
 	//  in angle of PI/2 between them.
-	car->RotateLocal(FPoint3(0,1,0), m_fCurRotation-PID2f);
-
-	if (bAlignOnGround)
+	const float yaw = m_Rotation[i] - PID2f;
+	const float c = cosf(yaw), s = sinf(yaw);
+	for (int w = 0; w < 4; w++)
 	{
-		m_vCurPos.y = SetPitch();
-		car->SetTrans(m_vCurPos);
+		const FPoint3 &off = m_WheelOffset[i*4+w];
+		FPoint3 &contact = m_Contact[i*4+w];
+		contact.x = m_PosX[i] + off.x * c + off.z * s;
+		contact.y = m_PosY[i];	// if there is no ground, stay level
+		contact.z = m_PosZ[i] - off.x * s + off.z * c;
 	}
 }
 
-//
-// Determines the pitch of the car, based on tire positions.
-// Returns height of the center of the car.
-//
-float CarEngine::SetPitch()
+// Determine the pitch and roll of the vehicle, based on its wheel contacts,
+//  and its height as the average of them.
+void VehicleSim::ComputePose(int i)
 {
-	vtTransform *car = dynamic_cast<vtTransform*> (GetTarget());
-	if (!car)
-		return 1.0f;
-
-	FSphere fL, fR, rL, rR;
-
-	// find tire locations, given the current pose of the vehicle
-	FrontLeft()->GetBoundSphere(fL, true);
-	FrontRight()->GetBoundSphere(fR, true);
-	RearLeft()->GetBoundSphere(rL, true);
-	RearRight()->GetBoundSphere(rR, true);
-
-	// get the four points on the ground under the tires
-	m_pHeightField->FindAltitudeAtPoint(fL.center, fL.center.y, false, CE_ROADS);
-	m_pHeightField->FindAltitudeAtPoint(fR.center, fR.center.y, false, CE_ROADS);
-	m_pHeightField->FindAltitudeAtPoint(rL.center, rL.center.y, false, CE_ROADS);
-	m_pHeightField->FindAltitudeAtPoint(rR.center, rR.center.y, false, CE_ROADS);
-
-	// find midpoints between the tires.
-	FPoint3 rM, fM;
-	rM = (rL.center + rR.center)/2;
-	fM = (fL.center + fR.center)/2;
-
-	FPoint3 back_side = rR.center - rL.center;
-	FPoint3 left_side = fL.center - rL.center;
+	const FPoint3 &fL = m_Contact[i*4];
+	const FPoint3 &fR = m_Contact[i*4+1];
+	const FPoint3 &rL = m_Contact[i*4+2];
+	const FPoint3 &rR = m_Contact[i*4+3];
+
+	FPoint3 back_side = rR - rL;
+	FPoint3 left_side = fL - rL;
 	back_side.Normalize();
 	left_side.Normalize();
 
-	// vNormal the upwards vector
-	FPoint3 vNormal = back_side.Cross(left_side);
-	vNormal.Normalize();
-
-	// new pitch
-	FPoint3 horiz = left_side;
-	horiz.y = 0;
-	float xz = horiz.Length();
-
 	// tan(pitch) = y / xz, so pitch = atan(y/xz);
-	m_fCurPitch = atanf(left_side.y / xz);
+	float xz = sqrtf(left_side.x*left_side.x + left_side.z*left_side.z);
+	m_Pitch[i] = atanf(left_side.y / xz);
 
-	car->RotateLocal(FPoint3(1,0,0), m_fCurPitch);
+	// tan(roll) = y / xz, so roll = atan(y/xz);
+	xz = sqrtf(back_side.x*back_side.x + back_side.z*back_side.z);
+	m_Roll[i] = atanf(back_side.y / xz);
 
-	// new roll
-	horiz = back_side;
-	horiz.y = 0;
-	xz = horiz.Length();
+	// height of midpoint of all wheels.
+	m_PosY[i] = (fL.y + fR.y + rL.y + rR.y) / 4;
 
-	// tan(roll) = y / xz, so roll = atan(y/xz);
-	float fRoll = atanf(back_side.y / xz);
+	m_Pose[i] = osg::Matrix::rotate(m_Roll[i], 0, 0, 1) *
+		osg::Matrix::rotate(m_Pitch[i], 1, 0, 0) *
+		osg::Matrix::rotate(m_Rotation[i] - PID2f, 0, 1, 0) *
+		osg::Matrix::translate(m_PosX[i], m_PosY[i], m_PosZ[i]);
+}
 
-	car->RotateLocal(FPoint3(0,0,1), fRoll);
+// Write a vehicle's pose to the scene graph.
+void VehicleSim::Apply(int i)
+{
+	Vehicle *car = m_Vehicles[i];
+	car->setMatrix(m_Pose[i]);
 
-	// return height of midpoint of all wheels.
-	return (fM.y+rM.y)/2;
+	//spin the wheels base on how much we've driven
+	const float radians = m_WheelSpin[i];
+	if (radians != 0.0f)
+	{
+		car->m_pFrontLeft->RotateLocal(XAXIS, -radians);
+		car->m_pFrontRight->RotateLocal(XAXIS, -radians);
+		car->m_pRearLeft->RotateLocal(XAXIS, -radians);
+		car->m_pRearRight->RotateLocal(XAXIS, -radians);
+	}
 }
 
-/**
- Rotate (yaw) body to head toward next location, pitch it based on tire
-  locations, and determine overall height of vehicle.
- Steering of wheels is done in here too.
- */
-void CarEngine::MoveCarTo(const FPoint3 &next_pos)
+// If desired, we can put the camera in a position to observe a car;
+//  this should be a separate engine, but it was quick and easy to add this:
+void VehicleSim::UpdateCamera()
 {
-	vtTransform *carxform = dynamic_cast<vtTransform*> (GetTarget());
-	if (!carxform)
+	if (m_iCameraFollow < 0 || m_iCameraFollow >= (int) m_Vehicles.size())
 		return;
 
-	// Place the car in the XZ plane
-	carxform->Identity();
-	carxform->SetTrans(next_pos);
+	Vehicle *car = m_Vehicles[m_iCameraFollow];
+	const FPoint3 pos = car->GetTrans();
+	FPoint3 direction = car->GetDirection();
+	FPoint3 offset = direction * -1.0f * m_fCameraDistance;
+	offset.y += (m_fCameraDistance / 2.0f);
+	FPoint3 from = pos + offset;
 
-	FPoint3 delta = next_pos - m_vCurPos;
+	vtGetScene()->GetCamera()->SetTrans(from);
+	vtGetScene()->GetCamera()->PointTowards(pos);
+}
 
-	if (delta.x != 0.0f || delta.z != 0.0f)
-	{
-		float distance_traveled = delta.Length();
 
-		// Turn car based on how the steering wheel is turned
-		m_fCurRotation += (m_fSteeringAngle * distance_traveled);
-		m_fCurRotation = angleNormal(m_fCurRotation);
-
-		//VTLOG("Wheel: %-f\t m_CurRot: %f \n", m_fSteeringAngle, m_fCurRotation);
-#if 0
-		// Yaw the wheel objects to show wheel angle?  Don't bother for now,
-		//  it's too subtle an effect.
-		FPoint3 trans;
-		trans = m_pFrontLeft->GetTrans();
-		m_pFrontLeft->Identity();
-		m_pFrontLeft->Rotate(YAXIS, m_fSteeringAngle);
-		m_pFrontLeft->Translate(trans);
-
-		trans = m_pFrontRight->GetTrans();
-		m_pFrontRight->Identity();
-		m_pFrontRight->Rotate(YAXIS, m_fSteeringAngle);
-		m_pFrontRight->Translate(trans);
-#endif
-	}
-	// Angle is measure from +X, but our car's "forward" is -Z.  That's a difference
-	//  in angle of PI/2 between them.
-	carxform->RotateLocal(FPoint3(0,1,0), m_fCurRotation-PID2f);
+///////////////////////////////////////////////////////////////////////
+// CarEngine class
 
-	// Modify the orientation of the car to match the terrain
-	//  points of the tires
-	float elev;
-	if (m_bFirstTime)
-	{
-		m_pHeightField->FindAltitudeAtPoint(m_vCurPos, elev, false, CE_ROADS);
-		m_bFirstTime = false;
-	}
-	else
-		elev = SetPitch();
+CarEngine::CarEngine(VehicleSim *sim, int index)
+{
+	m_pSim = sim;
+	m_iIndex = index;
+}
 
-	// New position is now current
-	m_vCurPos = next_pos;
-	m_vCurPos.y = elev;
-	carxform->SetTrans(m_vCurPos);
+void CarEngine::SetEnabled(bool bOn)
+{
+	m_pSim->m_Enabled[m_iIndex] = bOn;
+}
 
-	// If desired, we can put the camera in a position to observe the car;
-	//  this should be a separate engine, but it was quick and easy to add this:
-	if (m_bCameraFollow)
-	{
-		FPoint3 direction = carxform->GetDirection();
-		FPoint3 offset = direction * -1.0f * m_bCameraDistance;
-		offset.y += (m_bCameraDistance / 2.0f);
-		FPoint3 from = m_vCurPos + offset;
+FPoint3 CarEngine::GetCurPos() const
+{
+	return FPoint3(m_pSim->m_PosX[m_iIndex], m_pSim->m_PosY[m_iIndex],
+		m_pSim->m_PosZ[m_iIndex]);
+}
 
-		vtGetScene()->GetCamera()->SetTrans(from);
-		vtGetScene()->GetCamera()->PointTowards(m_vCurPos);
-	}
+DPoint2 CarEngine::GetEarthPos(const LocalCS &conv) const
+{
+	// convert terrain to earth coords
+	DPoint3 d3;
+	conv.LocalToEarth(GetCurPos(), d3);
+	return DPoint2(d3.x, d3.y);
 }
 
-//spin the wheels base on how much we've driven
-void CarEngine::SpinWheels(float radians)
+void CarEngine::SetEarthPos(const LocalCS &conv, const DPoint2 &pos)
 {
-	FrontLeft()->RotateLocal(XAXIS, -radians);
-	FrontRight()->RotateLocal(XAXIS, -radians);
-	RearLeft()->RotateLocal(XAXIS, -radians);
-	RearRight()->RotateLocal(XAXIS, -radians);
+	// convert earth to terrain coords
+	DPoint3 d3(pos.x, pos.y, 0);
+	FPoint3 p3;
+	conv.EarthToLocal(d3, p3);
+	m_pSim->m_PosX[m_iIndex] = p3.x;
+	m_pSim->m_PosZ[m_iIndex] = p3.z;
+
+	m_pSim->Settle(m_iIndex);
 }
 
-bool CarEngine::Valid()
+void CarEngine::SetRotation(float fRot)
 {
-	return (FrontLeft() != NULL && FrontRight() != NULL &&
-			RearLeft() != NULL && RearRight() != NULL);
+	m_pSim->m_Rotation[m_iIndex] = fRot;
+	m_pSim->Settle(m_iIndex);
 }
 
+void CarEngine::SetCameraFollow(bool bOn)
+{
+	if (bOn)
+		m_pSim->m_iCameraFollow = m_iIndex;
+	else if (m_pSim->m_iCameraFollow == m_iIndex)
+		m_pSim->m_iCameraFollow = -1;
+}
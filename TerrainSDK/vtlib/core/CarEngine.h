@@ -2,7 +2,7 @@
 // CarEngine.h
 // header file for CarEngine.cpp
 //
-// Copyright (c) 2001-2011 Virtual Terrain Project
+// Copyright (c) 2001-2013 Virtual Terrain Project
 // Free for all uses, see license.txt for details.
 //
 
@@ -12,77 +12,113 @@
 #include "vtdata/HeightField.h"
 #include "Vehicles.h"
 
-enum CarEngineMode { NONE, JUST_DRIVE, FOLLOW_ROAD, FOLLOW_PATH };
-
-class CarEngine : public vtEngine
+class CarEngine;
+
+/**
+ * Simulates a whole set of four-wheeled ground vehicles on one heightfield,
+ * as a single engine.
+ *
+ * The state of the vehicles is kept in parallel arrays, one per quantity,
+ * rather than in an object per vehicle.  Each frame is a few passes over
+ * those arrays: the motion of every vehicle is advanced (in parallel), the
+ * ground under all of their wheels is sampled in one batch, the new poses
+ * are computed (in parallel), and finally the transforms are written to the
+ * scene graph in a single pass.
+ *
+ * Individual vehicles are controlled through CarEngine handles, see
+ * VehicleSet::AddVehicle.
+ */
+class VehicleSim : public vtEngine
 {
 public:
-	CarEngine(Vehicle *vehicle, vtHeightField3d *hf);
+	VehicleSim(vtHeightField3d *hf);
+
+	int AddVehicle(Vehicle *vehicle);
+	uint NumVehicles() const { return (uint) m_Vehicles.size(); }
+	Vehicle *GetVehicle(int i) { return m_Vehicles[i]; }
+	vtHeightField3d *GetHeightField() { return m_pHeightField; }
 
-	bool Valid();
 	void Eval();
+	void Step(float fDeltaTime);
+	void Simulate(float fDeltaTime);
 	void IgnoreElapsedTime();
+	double Benchmark(int iSteps, float fDeltaTime = 1.0f/30);
 
-	FPoint3 GetCurPos() { return m_vCurPos; }
-	void SetEarthPos(const LocalCS &conv, const DPoint2 &pos);
-	DPoint2 GetEarthPos(const LocalCS &conv);
-
-	void SetSpeed(float fMeterPerSec);
-
-	void SetRotation(float fRot);
-	float GetRotation() { return m_fCurRotation; }
-
-	void SetSteeringAngle(float fRadians) { m_fSteeringAngle = fRadians; }
-	void SetFriction(float factor) { m_fFriction = factor; }
-
-	void SetCameraFollow(bool bOn) { m_bCameraFollow = bOn; }
-	void SetCameraDistance(float fMeters) { m_bCameraDistance = fMeters; }
+	/// Which culture the wheels rest on, see vtHeightField3d::FindAltitudeAtPoint.
+	void SetCultureFlags(int flags) { m_iCultureFlags = flags; }
 
 protected:
-	void ApplyCurrentLocation(bool bAlignOnGround);
-
-	float SetPitch();  //returns new height for car.
+	friend class CarEngine;
 
-	//move car to the given vector
-	//change rotation about Y axis based on current and next position.
-	//height is average of tire points
-	void MoveCarTo(const FPoint3 &pos);
-
-	//spin all wheels for distance traveled.
-	void SpinWheels(float radians);
+	void Settle(int i);
+	void Advance(int i, float fDeltaTime);
+	void FindWheelContacts(int i);
+	void ComputePose(int i);
+	void Apply(int i);
+	void UpdateCamera();
 
 	vtHeightField3d *m_pHeightField;
+	int m_iCultureFlags;
+	float m_fPrevTime;
+
+	int m_iCameraFollow;		// vehicle the camera follows, or -1
+	float m_fCameraDistance;
+
+	// Vehicle state, one entry per vehicle
+	std::vector<Vehicle*> m_Vehicles;
+	std::vector<float> m_PosX, m_PosY, m_PosZ;
+	std::vector<float> m_Rotation;	// around Y axis (yaw), measured from +X
+	std::vector<float> m_Pitch;
+	std::vector<float> m_Roll;
+	std::vector<float> m_Speed;		// meters per second
+	std::vector<float> m_Steering;	// radians of turn per meter traveled
+	std::vector<float> m_Friction;	// factor applied to speed each step
+	std::vector<float> m_WheelSpin;	// wheel rotation to apply this step
+	std::vector<bool> m_Enabled;
+	std::vector<osg::Matrix> m_Pose;
+
+	// Four entries per vehicle: front left, front right, rear left, rear right
+	std::vector<FPoint3> m_WheelOffset;	// wheel centers, in the vehicle's frame
+	std::vector<FPoint3> m_Contact;		// points under the wheels, on the ground
+};
+typedef osg::ref_ptr<VehicleSim> VehicleSimPtr;
 
-	//what mode the engine is operating at.
-	CarEngineMode m_eMode;
+/**
+ * A handle to one vehicle in a VehicleSim, which lets the application
+ * drive it.
+ */
+class CarEngine : public osg::Referenced
+{
+public:
+	CarEngine(VehicleSim *sim, int index);
 
-	FPoint3 m_vCurPos;		// current position
-	float m_fCurRotation;	// rotation around Y axis(Yaw)
-	float m_fCurPitch;		// rotation around orientation axis (Pitch)
-	FPoint3 m_vAxis;		// orientation axis, determined by where wheels are w/respect to ground
+	Vehicle *GetVehicle() { return m_pSim->m_Vehicles[m_iIndex]; }
+	VehicleSim *GetSim() { return m_pSim.get(); }
+	int GetIndex() const { return m_iIndex; }
 
-	float m_fSpeed;			// speed in meters per second
-	float m_fTargetSpeed;	// target speed
-	float m_fPrevTime;		// last time that eval was run on.
+	void SetEnabled(bool bOn);
+	bool GetEnabled() const { return m_pSim->m_Enabled[m_iIndex]; }
+	void IgnoreElapsedTime() { m_pSim->IgnoreElapsedTime(); }
 
-	//tires
-	vtTransform *FrontLeft() { return m_pVehicle->m_pFrontLeft; }
-	vtTransform *FrontRight() { return m_pVehicle->m_pFrontRight; }
-	vtTransform *RearLeft() { return m_pVehicle->m_pRearLeft; }
-	vtTransform *RearRight() { return m_pVehicle->m_pRearRight; }
+	FPoint3 GetCurPos() const;
+	void SetEarthPos(const LocalCS &conv, const DPoint2 &pos);
+	DPoint2 GetEarthPos(const LocalCS &conv) const;
 
-	float m_fSteeringAngle;
-	float m_fFriction;
+	void SetSpeed(float fMeterPerSec) { m_pSim->m_Speed[m_iIndex] = fMeterPerSec; }
 
-	//a setup flag - first eval doesn't run right...
-	bool m_bFirstTime;
+	void SetRotation(float fRot);
+	float GetRotation() const { return m_pSim->m_Rotation[m_iIndex]; }
+
+	void SetSteeringAngle(float fRadians) { m_pSim->m_Steering[m_iIndex] = fRadians; }
+	void SetFriction(float factor) { m_pSim->m_Friction[m_iIndex] = factor; }
 
-	bool m_bCameraFollow;
-	float m_bCameraDistance;
+	void SetCameraFollow(bool bOn);
+	void SetCameraDistance(float fMeters) { m_pSim->m_fCameraDistance = fMeters; }
 
-	Vehicle *m_pVehicle;
+protected:
+	osg::ref_ptr<VehicleSim> m_pSim;
+	int m_iIndex;
 };
 typedef osg::ref_ptr<CarEngine> CarEnginePtr;
 
-
 #endif // CARENGINEH
@@ -12,6 +12,7 @@
 #include "vtdata/vtLog.h"
 #include "vtdata/DataPath.h"
 #include "Content3d.h"
+#include "ModelCache.h"
 
 
 /**
@@ -41,16 +42,17 @@ bool vtItem3d::LoadModels()
 	{
 		vtModel *model = GetModel(i);
 
-		// perhaps it's directly resolvable
-		NodePtr pNode = vtLoadModel(model->m_filename);
-
-		// if there are some data path(s) to search, use them
-		if (!pNode.valid())
+		// perhaps it's directly resolvable, otherwise if there are some
+		//  data path(s) to search, use them.  The models come from the
+		//  shared cache, which vtModelCache::Prewarm finds the same way.
+		vtString path = model->m_filename;
+		if (!vtFileExists(path))
 		{
-			vtString fullpath = FindFileOnPaths(vtGetDataPath(), model->m_filename);
+			vtString fullpath = FindFileOnPaths(vtGetDataPath(), path);
 			if (fullpath != "")
-				pNode = vtLoadModel(fullpath);
+				path = fullpath;
 		}
+		NodePtr pNode = vtGetModelCache()->Load(path);
 
 		if (pNode.valid())
 			VTLOG(" Loaded successfully.\n");
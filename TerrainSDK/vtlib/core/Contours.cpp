@@ -1,28 +1,17 @@
 //
 // Name:	 Contours.cpp
 // Purpose:  Contour-related code, which interfaces vtlib to the
-//	QuikGrid library.
+//	vtdata contour builder.
 //
-// Copyright (c) 2004-2009 Virtual Terrain Project
+// Copyright (c) 2004-2013 Virtual Terrain Project
 // Free for all uses, see license.txt for details.
 //
 
 #include "vtlib/vtlib.h"
-
-#if SUPPORT_QUIKGRID
-#include "vtdata/QuikGrid.h"
+#include "vtdata/ElevationGrid.h"
 #include "Contours.h"
 #include <vtlib/core/TiledGeom.h>
 
-//
-// This callback function will receive points output from QuikGrid.
-//
-void ReceiveContourPoint2(void *context, float x, float y, bool bStart)
-{
-	vtContourConverter *cc = (vtContourConverter *) context;
-	cc->Coord(x, y, bStart);
-}
-
 
 /////////////////////////////////////////////////////////////////////////////
 // class vtContourConverter
@@ -30,7 +19,8 @@ void ReceiveContourPoint2(void *context, float x, float y, bool bStart)
 vtContourConverter::vtContourConverter()
 {
 	m_pMF = NULL;
-	m_pGrid = NULL;
+	m_pHF = NULL;
+	m_pSampled = NULL;
 	m_pGeode = NULL;
 	m_pLS = NULL;
 }
@@ -38,7 +28,7 @@ vtContourConverter::vtContourConverter()
 vtContourConverter::~vtContourConverter()
 {
 	delete m_pMF;
-	delete m_pGrid;
+	delete m_pSampled;
 }
 
 bool vtContourConverter::SetupTerrain(vtTerrain *pTerr)
@@ -46,82 +36,51 @@ bool vtContourConverter::SetupTerrain(vtTerrain *pTerr)
 	// Make a note of this terrain and its attributes
 	m_pTerrain = pTerr;
 	m_pHF = pTerr->GetHeightFieldGrid3d();
-	int tileLod0Size = 0;
-	if (!m_pHF)
-	{
-		vtTiledGeom *tiledGeom = pTerr->GetTiledGeom();
-		if (!tiledGeom)
-			return false;
-
-		m_ext = tiledGeom->GetEarthExtents();
-		//get highest LOD
-		int minLod = 0;
-		for(int i = 0; i < tiledGeom->rows * tiledGeom->rows; i++)
-			if (tiledGeom->m_elev_info.lodmap.m_min[i] > minLod)
-				minLod = tiledGeom->m_elev_info.lodmap.m_min[i];
-
-		tileLod0Size = 1 << minLod;
-		m_spacing = DPoint2(m_ext.Width() / (tiledGeom->cols * tileLod0Size), m_ext.Height() / (tiledGeom->rows *tileLod0Size));
-	}
-	else
-	{
-		m_ext = m_pHF->GetEarthExtents();
-		m_spacing = m_pHF->GetSpacing();
-	}
-
-	// copy data from our grid to a QuikGrid object
-	int nx, ny;
 	if (m_pHF)
-		m_pHF->GetDimensions(nx, ny);
-	else
-	{
-		vtTiledGeom *tiledGeom = pTerr->GetTiledGeom();
-		nx = tiledGeom->cols * tileLod0Size + 1;
-		ny = tiledGeom->rows * tileLod0Size + 1;
-	}
+		return true;
+
+	// Tiled terrain has no single grid, so sample one from it
+	vtTiledGeom *tiledGeom = pTerr->GetTiledGeom();
+	if (!tiledGeom)
+		return false;
+
+	const DRECT ext = tiledGeom->GetEarthExtents();
+
+	//get highest LOD
+	int minLod = 0;
+	for(int i = 0; i < tiledGeom->rows * tiledGeom->rows; i++)
+		if (tiledGeom->m_elev_info.lodmap.m_min[i] > minLod)
+			minLod = tiledGeom->m_elev_info.lodmap.m_min[i];
+
+	const int tileLod0Size = 1 << minLod;
+	int nx = tiledGeom->cols * tileLod0Size + 1;
+	int ny = tiledGeom->rows * tileLod0Size + 1;
+
 	// we can't allocate too much memory, so reduce the resolution if too large
-	DPoint2 scale(1.0, 1.0);
-	while ((nx/scale.x) > 8192)
-		scale.x *= 2.0;
-	while ((ny/scale.y) > 8192)
-		scale.y *= 2.0;
-
-	m_spacing.x *= scale.x;
-	m_spacing.y *= scale.y;
-	nx /= scale.x;
-	ny /= scale.y;
-
-	m_pGrid = new SurfaceGrid(nx,ny);
-	int i, j;
-	if (m_pHF)
-	{
-		for (i = 0; i < nx; i++)
-		{
-			for (j = 0; j < ny; j++)
-			{
-				// use the true elevation, for true contours
-				m_pGrid->zset(i, j, m_pHF->GetElevation(i, j, true));
-			}
-		}
-	}
-	else
+	while (nx > 8192)
+		nx = nx / 2 + 1;
+	while (ny > 8192)
+		ny = ny / 2 + 1;
+
+	m_pSampled = new vtElevationGrid;
+	if (!m_pSampled->Create(ext, IPoint2(nx, ny), true, pTerr->GetProjection()))
+		return false;
+
+	const DPoint2 spacing = m_pSampled->GetSpacing();
+	float altitude;
+	for (int i = 0; i < nx; i++)
 	{
-		vtTiledGeom *tiledGeom = pTerr->GetTiledGeom();
-		float topBottom = tiledGeom->m_WorldExtents.top - tiledGeom->m_WorldExtents.bottom;
-		float rightLeft = tiledGeom->m_WorldExtents.right - tiledGeom->m_WorldExtents.left;
-		float xwidth = rightLeft / nx;
-		float ywidth = topBottom / ny;
-		float altitude;
-		for (i = 0; i < nx; i++)
+		for (int j = 0; j < ny; j++)
 		{
-			for (j = 0; j < ny; j++)
-			{
-				// use the true elevation, for true contours
-				tiledGeom->FindAltitudeAtPoint(FPoint3(i*xwidth, 0, j*ywidth),altitude, true);
-				m_pGrid->zset(i, j, altitude);
-			}
+			// use the true elevation, for true contours
+			DPoint2 p(ext.left + i * spacing.x, ext.bottom + j * spacing.y);
+			if (!tiledGeom->FindAltitudeOnEarth(p, altitude, true))
+				altitude = INVALID_ELEVATION;
+			m_pSampled->SetFValue(i, j, altitude);
 		}
 	}
+	m_pSampled->ComputeHeightExtents();
+	m_pHF = m_pSampled;
 	return true;
 }
 
@@ -186,9 +145,7 @@ bool vtContourConverter::Setup(vtTerrain *pTerr, vtFeatureSetLineString *fset)
  */
 void vtContourConverter::GenerateContour(float fAlt)
 {
-	SetQuikGridCallbackFunction(ReceiveContourPoint2, this);
-	m_fAltitude = fAlt;
-	Contour(*m_pGrid, fAlt);
+	m_Builder.AddLevel(fAlt);
 }
 
 /**
@@ -200,45 +157,24 @@ void vtContourConverter::GenerateContour(float fAlt)
  */
 void vtContourConverter::GenerateContours(float fInterval)
 {
-	float fMin, fMax;
-	vtHeightField *hf;
 	if (m_pHF)
-		hf = m_pHF;
-	else
-		hf = m_pTerrain->GetTiledGeom();
-	if (!hf)
-		return;
-
-	hf->GetHeightExtents(fMin, fMax);
-	int start = (int) (fMin / fInterval) + 1;
-	int stop = (int) (fMax / fInterval);
-
-	SetQuikGridCallbackFunction(ReceiveContourPoint2, this);
-	for (int i = start; i <= stop; i++)
-	{
-		m_fAltitude = i * fInterval;
-		Contour(*m_pGrid, i * fInterval);
-	}
-}
-
-void vtContourConverter::Coord(float x, float y, bool bStart)
-{
-	if (bStart)
-		Flush();
-
-	DPoint2 p2;
-	p2.x = m_ext.left + x * m_spacing.x;
-	p2.y = m_ext.bottom + y * m_spacing.y;
-	m_line.Append(p2);
+		m_Builder.AddLevels(*m_pHF, fInterval);
 }
 
 /**
  * Finishes the contour generation process.  Call once when you are done
  * using the class to generate contours.
+ *
+ * \param progress_callback If supplied, this function will be called back
+ *		with a value of 0 to 100 as the contours are traced.
  */
-void vtContourConverter::Finish()
+void vtContourConverter::Finish(bool progress_callback(int))
 {
-	Flush();
+	if (!m_pHF || !m_Builder.Build(*m_pHF, progress_callback))
+		return;
+
+	for (uint i = 0; i < m_Builder.NumLines(); i++)
+		AddLine(m_Builder.GetLine(i), m_Builder.GetLineLevel(i));
 
 	if (m_pMF)
 	{
@@ -248,43 +184,21 @@ void vtContourConverter::Finish()
 	}
 }
 
-void vtContourConverter::Flush()
+void vtContourConverter::AddLine(const DLine2 &line, float fAltitude)
 {
-	// we may have some degenerate geometry; we need at least three points
-	if (m_line.GetSize() > 2)
+	if (m_pMF)
 	{
-		// confirm they are not all the same
-		DPoint2 p2 = m_line[0];
-		bool same = true;
-		for (uint i = 1; i < m_line.GetSize(); i++)
-		{
-			if (m_line[i] != p2)
-			{
-				same = false;
-				break;
-			}
-		}
-		if (!same)
-		{
-			if (m_pMF)
-			{
-				const bool bInterpolate = false;		// no need; it already hugs the ground
-				const bool bCurve = false;				// no need; it's already quite smooth
-				const bool bUseTrueElevation = true;	// use true elevation, not scaled
-				const float fSpacing = 0.0f;			// Doesn't matter, no interpolation.
-
-				m_pMF->AddSurfaceLineToMesh(m_pTerrain->GetHeightField(),
-					m_line, fSpacing, m_fHeight, bInterpolate, bCurve, bUseTrueElevation);
-			}
-			else if (m_pLS)
-			{
-				int record = m_pLS->AddPolyLine(m_line);
-				m_pLS->SetValue(record, 0, m_fAltitude);
-			}
-		}
+		const bool bInterpolate = false;		// no need; it already hugs the ground
+		const bool bCurve = false;				// no need; it's already quite smooth
+		const bool bUseTrueElevation = true;	// use true elevation, not scaled
+		const float fSpacing = 0.0f;			// Doesn't matter, no interpolation.
+
+		m_pMF->AddSurfaceLineToMesh(m_pTerrain->GetHeightField(),
+			line, fSpacing, m_fHeight, bInterpolate, bCurve, bUseTrueElevation);
+	}
+	else if (m_pLS)
+	{
+		int record = m_pLS->AddPolyLine(line);
+		m_pLS->SetValue(record, 0, fAltitude);
 	}
-	m_line.Clear();
 }
-
-#endif // SUPPORT_QUIKGRID
-
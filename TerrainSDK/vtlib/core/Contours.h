@@ -1,17 +1,16 @@
 //
 // Contours.h
 //
-// Copyright (c) 2004-2009 Virtual Terrain Project
+// Copyright (c) 2004-2013 Virtual Terrain Project
 // Free for all uses, see license.txt for details.
 //
 
 #ifndef CONTOURSH
 #define CONTOURSH
 
-#if SUPPORT_QUIKGRID
-
+#include "vtdata/ContourBuilder.h"
 #include "Terrain.h"
-class SurfaceGrid;
+class vtElevationGrid;
 
 /** \defgroup utility Utility classes
  */
@@ -19,9 +18,10 @@ class SurfaceGrid;
 
 /**
  * This class provides the ability to easily construct contour lines
- * on a terrain.  It does so by calling the QuikGrid library to generate
+ * on a terrain.  It does so by using vtContourBuilder to generate
  * contour vectors, then converts those vectors into 3D line geometry
- * draped on the terrain.
+ * draped on the terrain.  All the contours are generated together when
+ * you call Finish().
  *
  * \par Here is an example of how to use it:
 	\code
@@ -66,22 +66,18 @@ public:
 
 	void GenerateContour(float fAlt);
 	void GenerateContours(float fAInterval);
-	void Finish();
-	void Coord(float x, float y, bool bStart);
+	void Finish(bool progress_callback(int) = NULL);
 
 protected:
 	bool SetupTerrain(vtTerrain *pTerr);
-	void Flush();
+	void AddLine(const DLine2 &line, float fAltitude);
 
-	SurfaceGrid *m_pGrid;
+	vtContourBuilder m_Builder;
 
 	vtTerrain *m_pTerrain;
-	vtHeightFieldGrid3d *m_pHF;
-	DRECT m_ext;
-	DPoint2 m_spacing;
-	float m_fAltitude;
+	const vtHeightFieldGrid3d *m_pHF;
+	vtElevationGrid *m_pSampled;	// Only used for tiled terrain
 	float m_fHeight;
-	DLine2	m_line;
 
 	// These are used if building geometry directly
 	vtGeode *m_pGeode;
@@ -93,5 +89,4 @@ protected:
 
 /*@}*/  // utility
 
-#endif // SUPPORT_QUIKGRID
 #endif // CONTOURSH
@@ -14,6 +14,8 @@
 vtEngine::vtEngine() : vtEnabledBase()
 {
 	m_pWindow = NULL;
+	m_bIndependent = false;
+	m_fEvalTime = 0.0f;
 }
 
 osg::Referenced *vtEngine::GetTarget(uint which)
@@ -35,6 +37,17 @@ void vtEngine::Eval()
 {
 }
 
+/**
+ * Add a measurement of how long Eval() took to the engine's running average.
+ */
+void vtEngine::SetEvalTime(float fMilliseconds)
+{
+	if (m_fEvalTime == 0.0f)
+		m_fEvalTime = fMilliseconds;
+	else
+		m_fEvalTime = m_fEvalTime * 0.9f + fMilliseconds * 0.1f;
+}
+
 void vtEngine::RemoveChild(vtEngine *pEngine)
 {
 	for (uint i = 0; i < NumChildren(); i++)
@@ -92,6 +92,23 @@ public:
 	void SetWindow(vtWindow *pWin) { m_pWindow = pWin; }
 	vtWindow *GetWindow() { return m_pWindow; }
 
+	/**
+	 * Declare that this engine's Eval() is independent: it changes nothing
+	 * but its own state and its own targets, which no other engine touches,
+	 * and it reads nothing which other independent engines change.  The
+	 * scene may then run it on another thread, at the same time as other
+	 * independent engines.  Note that moving a node dirties the bounds of
+	 * all its parents, so the targets of independent engines must not
+	 * share parent groups.  Engines are not independent by default.
+	 */
+	void SetIndependent(bool bFlag) { m_bIndependent = bFlag; }
+	bool IsIndependent() const { return m_bIndependent; }
+
+	void SetEvalTime(float fMilliseconds);
+	/// The time Eval() takes, in milliseconds, averaged over recent frames.
+	/// This is only measured while the profiler (vtProfiler) is enabled.
+	float GetEvalTime() const { return m_fEvalTime; }
+
 	// Engine tree methods
 	void AddChild(vtEngine *pEngine) { m_Children.push_back(pEngine); }
 	void RemoveChild(vtEngine *pEngine);
@@ -105,6 +122,8 @@ protected:
 	std::vector<vtEnginePtr> m_Children;
 	vtString		 m_strName;
 	vtWindow		*m_pWindow;
+	bool			 m_bIndependent;
+	float			 m_fEvalTime;
 
 protected:
 	~vtEngine() {}
@@ -153,7 +172,10 @@ protected:
 
 /**
  * A simple "Billboard" engine which turns its target to face the
- * camera each frame.
+ * camera each frame.  Moving a target also dirties the bounds of its
+ * parent groups, so the engine is only independent (see
+ * vtEngine::SetIndependent) if its targets are in a subgraph which no
+ * other independent engine's targets share.
  */
 class vtSimpleBillboardEngine : public vtEngine
 {
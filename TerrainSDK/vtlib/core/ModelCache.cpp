@@ -0,0 +1,372 @@
+//
+// ModelCache.cpp
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include "vtlib/vtlib.h"
+#include "vtdata/DataPath.h"
+#include "vtdata/FilePath.h"
+#include "vtdata/vtLog.h"
+#include "Content3d.h"
+#include "ModelCache.h"
+#include "TaskGraph.h"
+
+#include <set>
+#include <string>
+#include <OpenThreads/ScopedLock>
+#include <osg/Texture>
+#include <osgDB/Registry>
+#include <osgDB/SharedStateManager>
+
+typedef OpenThreads::ScopedLock<OpenThreads::Mutex> ScopedLock;
+
+/// The one and only global model cache
+vtModelCache g_ModelCache;
+
+vtModelCache *vtGetModelCache()
+{
+	return &g_ModelCache;
+}
+
+/**
+ * Adds up the memory held by the geometry and textures under a node,
+ * counting each array, primitive set and image only once.
+ */
+class ModelMemoryVisitor : public osg::NodeVisitor
+{
+public:
+	ModelMemoryVisitor() : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), m_iBytes(0) {}
+
+	virtual void apply(osg::Node &node)
+	{
+		AddStateSet(node.getStateSet());
+		traverse(node);
+	}
+	virtual void apply(osg::Geode &geode)
+	{
+		AddStateSet(geode.getStateSet());
+		for (uint i = 0; i < geode.getNumDrawables(); i++)
+		{
+			osg::Drawable *drawable = geode.getDrawable(i);
+			AddStateSet(drawable->getStateSet());
+
+			osg::Geometry *geom = drawable->asGeometry();
+			if (!geom)
+				continue;
+			AddArray(geom->getVertexArray());
+			AddArray(geom->getNormalArray());
+			AddArray(geom->getColorArray());
+			AddArray(geom->getSecondaryColorArray());
+			AddArray(geom->getFogCoordArray());
+			for (uint j = 0; j < geom->getNumTexCoordArrays(); j++)
+				AddArray(geom->getTexCoordArray(j));
+			for (uint j = 0; j < geom->getNumPrimitiveSets(); j++)
+			{
+				osg::PrimitiveSet *ps = geom->getPrimitiveSet(j);
+				if (First(ps))
+					m_iBytes += ps->getTotalDataSize();
+			}
+		}
+		traverse(geode);
+	}
+
+	size_t m_iBytes;
+
+protected:
+	bool First(const void *object)
+	{
+		return object != NULL && m_Seen.insert(object).second;
+	}
+	void AddArray(const osg::Array *array)
+	{
+		if (First(array))
+			m_iBytes += array->getTotalDataSize();
+	}
+	void AddStateSet(osg::StateSet *stateset)
+	{
+		if (!First(stateset))
+			return;
+		const uint units = (uint) stateset->getTextureAttributeList().size();
+		for (uint i = 0; i < units; i++)
+		{
+			osg::Texture *texture = dynamic_cast<osg::Texture*>(
+				stateset->getTextureAttribute(i, osg::StateAttribute::TEXTURE));
+			if (!texture)
+				continue;
+			for (uint j = 0; j < texture->getNumImages(); j++)
+			{
+				const osg::Image *image = texture->getImage(j);
+				if (First(image))
+					m_iBytes += image->getTotalSizeInBytesIncludingMipmaps();
+			}
+		}
+	}
+
+	std::set<const void*> m_Seen;
+};
+
+/**
+ * Return the memory, in bytes, held by the geometry and textures of a model.
+ */
+size_t vtGetModelMemory(osg::Node *node)
+{
+	ModelMemoryVisitor visitor;
+	node->accept(visitor);
+	return visitor.m_iBytes;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// vtModelCache
+//
+
+class vtModelCache::LoadTask : public vtTask
+{
+public:
+	LoadTask(vtModelCache *pCache, const vtString &path, time_t modtime, bool bReload) :
+		m_pCache(pCache), m_path(path), m_ModTime(modtime), m_bReload(bReload) {}
+
+	bool Run()
+	{
+		ThreadLocaleC locale;
+		return m_pCache->_Read(m_path, m_ModTime, m_bReload, false);
+	}
+
+	vtModelCache *m_pCache;
+	vtString m_path;
+	time_t m_ModTime;
+	bool m_bReload;
+};
+
+vtModelCache::vtModelCache()
+{
+	m_pLoader = NULL;
+}
+
+vtModelCache::~vtModelCache()
+{
+	// The global cache is destroyed with the other statics, when it's too
+	//  late to join threads or use OSG's registry, so the loader must
+	//  already have been stopped, by Clear.  vtScene::Shutdown does that.
+}
+
+/**
+ * Get a model from the cache, loading it if it isn't there yet or has
+ * changed on disk.  If the model is being loaded in the background, this
+ * waits for it.  This must be called from the main thread.
+ *
+ * \param filename The model's file.
+ * \param bReload True to load the model again from disk, even if it is in
+ *		the cache.  The new copy is not put in the cache, so it doesn't
+ *		replace the node that others are already sharing.
+ * \return The model, or NULL if it couldn't be loaded.  The cache keeps a
+ *		reference to it, unless it was reloaded.
+ */
+osg::Node *vtModelCache::Load(const char *filename, bool bReload)
+{
+	vtString path = filename;
+	path.Replace('\\', '/');
+	const time_t modtime = GetFileModTime(path);
+
+	int iTask = -1;
+	{
+		ScopedLock lock(m_Mutex);
+		std::map<vtString, Entry>::iterator it = m_Entries.find(path);
+		if (it != m_Entries.end())
+			iTask = it->second.m_iTask;
+	}
+	if (iTask != -1)
+		m_pLoader->Wait(iTask);
+
+	// A private copy, for the caller alone
+	if (bReload)
+		return vtLoadModel(path, false);
+
+	{
+		ScopedLock lock(m_Mutex);
+		std::map<vtString, Entry>::iterator it = m_Entries.find(path);
+		if (it != m_Entries.end())
+		{
+			if (it->second.m_ModTime == modtime)
+				return it->second.m_pNode.get();
+
+			// It has changed on disk, so get past OSG's cache too
+			bReload = true;
+		}
+	}
+	_Read(path, modtime, bReload, true);
+
+	ScopedLock lock(m_Mutex);
+	return m_Entries[path].m_pNode.get();
+}
+
+/**
+ * Start loading a model in the background, if it isn't in the cache or
+ * on its way already.  This must be called from the main thread.
+ */
+void vtModelCache::Request(const char *filename)
+{
+	vtString path = filename;
+	path.Replace('\\', '/');
+	const time_t modtime = GetFileModTime(path);
+
+	ScopedLock lock(m_Mutex);
+	std::map<vtString, Entry>::iterator it = m_Entries.find(path);
+	bool bReload = false;
+	if (it != m_Entries.end())
+	{
+		if (it->second.m_iTask != -1 || it->second.m_ModTime == modtime)
+			return;
+		bReload = true;
+	}
+	if (!m_pLoader)
+		m_pLoader = new vtTaskGraph("Model cache");
+
+	Entry &entry = m_Entries[path];
+	entry.m_iTask = m_pLoader->AddTask(StartOfFilename(path),
+		new LoadTask(this, path, modtime, bReload));
+	m_pLoader->Start();
+}
+
+/**
+ * Start loading, in the background, all the models of all the items of a
+ * content manager.  Models are found the same way as vtItem3d::LoadModels
+ * finds them.
+ */
+void vtModelCache::Prewarm(vtContentManager3d &content)
+{
+	int count = 0;
+	for (uint i = 0; i < content.NumItems(); i++)
+	{
+		vtItem *item = content.GetItem(i);
+		for (uint j = 0; j < item->NumModels(); j++)
+		{
+			vtString path = item->GetModel(j)->m_filename;
+			if (!vtFileExists(path))
+				path = FindFileOnPaths(vtGetDataPath(), path);
+			if (path == "")
+				continue;
+			Request(path);
+			count++;
+		}
+	}
+	VTLOG("Model cache: prewarming %d models.\n", count);
+}
+
+bool vtModelCache::IsPending(const char *filename)
+{
+	vtString path = filename;
+	path.Replace('\\', '/');
+
+	ScopedLock lock(m_Mutex);
+	std::map<vtString, Entry>::iterator it = m_Entries.find(path);
+	return (it != m_Entries.end() && it->second.m_iTask != -1);
+}
+
+/**
+ * Wait for all the background loads to finish.
+ */
+void vtModelCache::WaitAll()
+{
+	if (m_pLoader)
+		m_pLoader->WaitAll();
+}
+
+/**
+ * Release all the models, and any state which no one else is sharing.  This
+ * also stops the loader threads, so it must be called before the program
+ * exits; vtScene::Shutdown does.
+ */
+void vtModelCache::Clear()
+{
+	WaitAll();
+	delete m_pLoader;
+	m_pLoader = NULL;
+	{
+		ScopedLock lock(m_Mutex);
+		m_Entries.clear();
+	}
+	osgDB::SharedStateManager *ssm = osgDB::Registry::instance()->getSharedStateManager();
+	if (ssm)
+		ssm->prune();
+}
+
+int vtModelCache::NumModels()
+{
+	ScopedLock lock(m_Mutex);
+	return (int) m_Entries.size();
+}
+
+/**
+ * Return the memory, in bytes, held by the geometry and textures of a
+ * cached model, or 0 if it isn't loaded.  Textures shared with other
+ * models are counted for each of them.
+ */
+size_t vtModelCache::GetMemoryUsed(const char *filename)
+{
+	vtString path = filename;
+	path.Replace('\\', '/');
+
+	ScopedLock lock(m_Mutex);
+	std::map<vtString, Entry>::iterator it = m_Entries.find(path);
+	return (it == m_Entries.end()) ? 0 : it->second.m_iBytes;
+}
+
+size_t vtModelCache::GetTotalMemoryUsed()
+{
+	ScopedLock lock(m_Mutex);
+	size_t total = 0;
+	for (std::map<vtString, Entry>::iterator it = m_Entries.begin(); it != m_Entries.end(); ++it)
+		total += it->second.m_iBytes;
+	return total;
+}
+
+/**
+ * Write the models in the cache, and the memory each one holds, to the log.
+ */
+void vtModelCache::LogContents()
+{
+	ScopedLock lock(m_Mutex);
+	size_t total = 0;
+	VTLOG("Model cache: %d models\n", (int) m_Entries.size());
+	for (std::map<vtString, Entry>::iterator it = m_Entries.begin(); it != m_Entries.end(); ++it)
+	{
+		const Entry &entry = it->second;
+		const char *state = "";
+		if (entry.m_iTask != -1)
+			state = " (loading)";
+		else if (entry.m_bFailed)
+			state = " (failed)";
+		VTLOG("  %8d KB  %s%s\n", (int) (entry.m_iBytes / 1024),
+			(const char *) it->first, state);
+		total += entry.m_iBytes;
+	}
+	VTLOG("  %8d KB  total\n", (int) (total / 1024));
+}
+
+// Read a model and put it in the cache.  Called on the main thread, or on
+//  a loader thread, which has set its own locale.
+bool vtModelCache::_Read(const vtString &path, time_t modtime, bool bReload,
+						 bool bSetLocale)
+{
+	NodePtr node = vtLoadModel(path, !bReload, false, bSetLocale);
+	if (node.valid())
+	{
+		// Share identical textures and states with the models already loaded
+		ScopedLock lock(m_ShareMutex);
+		osgDB::Registry::instance()->getOrCreateSharedStateManager()->share(node.get());
+	}
+	const size_t bytes = node.valid() ? vtGetModelMemory(node.get()) : 0;
+
+	ScopedLock lock(m_Mutex);
+	Entry &entry = m_Entries[path];
+	entry.m_ModTime = modtime;
+	entry.m_pNode = node;
+	entry.m_iBytes = bytes;
+	entry.m_iTask = -1;
+	entry.m_bFailed = !node.valid();
+	return node.valid();
+}
+
@@ -0,0 +1,90 @@
+//
+// ModelCache.h
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#ifndef VTLIB_MODELCACHEH
+#define VTLIB_MODELCACHEH
+
+#include <map>
+#include <time.h>
+
+#include <OpenThreads/Mutex>
+
+#include "vtdata/vtString.h"
+
+class vtContentManager3d;
+class vtTaskGraph;
+
+/** \addtogroup content */
+/*@{*/
+
+/**
+ * A cache of loaded 3D models, shared by all the terrains in a scene.
+ *
+ * Each model is loaded once, with vtLoadModel, and the same node is then
+ * given to everyone who asks for that file, unless they ask to reload it.
+ * The node must be treated as immutable: put it under your own transform
+ * (as vtTerrain::LoadModel does) rather than changing it.  Identical
+ * textures and states are also shared between the different models, with
+ * OSG's shared state manager.
+ *
+ * Models are keyed by their path, and remember the time the file was
+ * modified; if the file changes on disk, the next request loads it again.
+ *
+ * Models can be loaded ahead of time, on background threads, with Request,
+ * or all the models of a content manager with Prewarm.  Load returns at once
+ * if the model is already there, and otherwise waits for it.  The loader
+ * threads set the "C" numeric locale for themselves only, so they don't
+ * disturb the locale of the main thread.
+ */
+class vtModelCache
+{
+public:
+	vtModelCache();
+	~vtModelCache();
+
+	osg::Node *Load(const char *filename, bool bReload = false);
+	void Request(const char *filename);
+	void Prewarm(vtContentManager3d &content);
+	bool IsPending(const char *filename);
+	void WaitAll();
+	void Clear();
+
+	int NumModels();
+	size_t GetMemoryUsed(const char *filename);
+	size_t GetTotalMemoryUsed();
+	void LogContents();
+
+protected:
+	struct Entry
+	{
+		Entry() : m_ModTime(0), m_iBytes(0), m_iTask(-1), m_bFailed(false) {}
+		time_t m_ModTime;
+		NodePtr m_pNode;
+		size_t m_iBytes;	// memory held by the geometry and textures
+		int m_iTask;		// the background load, or -1
+		bool m_bFailed;
+	};
+	class LoadTask;
+	friend class LoadTask;
+
+	bool _Read(const vtString &path, time_t modtime, bool bReload, bool bSetLocale);
+
+	std::map<vtString, Entry> m_Entries;
+	vtTaskGraph *m_pLoader;
+
+	OpenThreads::Mutex m_Mutex;			// guards m_Entries
+	OpenThreads::Mutex m_ShareMutex;	// guards OSG's shared state manager
+};
+
+vtModelCache *vtGetModelCache();
+
+size_t vtGetModelMemory(osg::Node *node);
+
+/*@}*/	// group content
+
+#endif	// VTLIB_MODELCACHEH
+
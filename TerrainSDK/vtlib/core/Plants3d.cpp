@@ -20,6 +20,7 @@
 #include "vtdata/DataPath.h"
 #include "vtdata/FilePath.h"
 #include "vtdata/HeightField.h"
+#include "ModelCache.h"
 #include "Plants3d.h"
 #include "Light.h"
 #include "GeomUtil.h"	// for CreateBoundSphereGeode
@@ -152,12 +153,12 @@ void vtPlantAppearance3d::LoadAndCreate()
 	}
 	else if (m_eType == AT_MODEL)
 	{
-		m_pExternal = vtLoadModel(m_filename);
+		m_pExternal = vtGetModelCache()->Load(m_filename);
 		if (!m_pExternal)
 		{
 			vtString fname = FindPlantModel(m_filename);
 			if (fname != "")
-				m_pExternal = vtLoadModel(fname);
+				m_pExternal = vtGetModelCache()->Load(fname);
 		}
 		if (m_pExternal != NULL)
 			m_bCreated = true;
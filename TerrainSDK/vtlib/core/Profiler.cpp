@@ -0,0 +1,393 @@
+//
+// Profiler.cpp
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include "vtlib/vtlib.h"
+#include "vtdata/FilePath.h"
+#include "vtdata/vtLog.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <OpenThreads/ScopedLock>
+
+#ifdef WIN32
+#include <windows.h>	// for GetCurrentThreadId
+#else
+#include <pthread.h>
+#endif
+
+typedef OpenThreads::ScopedLock<OpenThreads::Mutex> ScopedLock;
+
+#define DEFAULT_PROFILE_FRAMES	300
+
+/// The one and only global profiler
+vtProfiler g_Profiler;
+
+vtProfiler *vtGetProfiler()
+{
+	return &g_Profiler;
+}
+
+
+vtProfiler::vtProfiler()
+{
+	m_iMaxFrames = DEFAULT_PROFILE_FRAMES;
+	m_StartTick = osg::Timer::instance()->tick();
+	m_FrameTick = m_StartTick;
+	m_iNextFrame = 0;
+	m_iFrames = 0;
+	m_Current.m_fStart = m_Current.m_fDuration = 0;
+}
+
+void vtProfiler::SetEnabled(bool bOn)
+{
+	m_Enabled.exchange(bOn ? 1 : 0);
+}
+
+/**
+ * Set how many of the most recent frames are kept, for the statistics and
+ * the trace.  This also discards the frames kept so far.
+ */
+void vtProfiler::SetFrameCount(int iFrames)
+{
+	ScopedLock lock(m_Mutex);
+	if (iFrames < 1)
+		iFrames = 1;
+	m_iMaxFrames = iFrames;
+	m_Frames.clear();
+	m_iNextFrame = 0;
+	m_iFrames = 0;
+}
+
+/**
+ * Discard all the frames kept so far.
+ */
+void vtProfiler::Reset()
+{
+	ScopedLock lock(m_Mutex);
+	m_Frames.clear();
+	m_iNextFrame = 0;
+	m_iFrames = 0;
+	m_Current.m_Times.clear();
+	m_Current.m_Events.clear();
+}
+
+/**
+ * Get the index of a named section, adding it if it is new.
+ */
+int vtProfiler::AddSection(const char *name)
+{
+	ScopedLock lock(m_Mutex);
+	return _AddSection(name);
+}
+
+// Called with the mutex held.
+int vtProfiler::_AddSection(const char *name)
+{
+	std::map<vtString, int>::iterator it = m_SectionIndex.find(name);
+	if (it != m_SectionIndex.end())
+		return it->second;
+
+	const int index = (int) m_Sections.size();
+	m_Sections.push_back(name);
+	m_SectionIndex[name] = index;
+	return index;
+}
+
+int vtProfiler::NumSections()
+{
+	ScopedLock lock(m_Mutex);
+	return (int) m_Sections.size();
+}
+
+vtString vtProfiler::GetSectionName(int iSection)
+{
+	ScopedLock lock(m_Mutex);
+	return m_Sections[iSection];
+}
+
+void vtProfiler::BeginFrame()
+{
+	if (m_Enabled == 0)
+		return;
+
+	ScopedLock lock(m_Mutex);
+	m_FrameTick = osg::Timer::instance()->tick();
+	m_Current.m_fStart = osg::Timer::instance()->delta_u(m_StartTick, m_FrameTick);
+}
+
+void vtProfiler::EndFrame()
+{
+	if (m_Enabled == 0)
+		return;
+
+	ScopedLock lock(m_Mutex);
+	m_Current.m_fDuration = osg::Timer::instance()->delta_u(m_FrameTick,
+		osg::Timer::instance()->tick());
+
+	if ((int) m_Frames.size() < m_iMaxFrames)
+		m_Frames.resize(m_iMaxFrames);
+
+	// Swap rather than copy, so the vectors' storage gets reused
+	Frame &slot = m_Frames[m_iNextFrame];
+	slot.m_fStart = m_Current.m_fStart;
+	slot.m_fDuration = m_Current.m_fDuration;
+	slot.m_iThread = _ThreadIndex();
+	slot.m_Times.swap(m_Current.m_Times);
+	slot.m_Events.swap(m_Current.m_Events);
+	m_Current.m_Times.clear();
+	m_Current.m_Events.clear();
+
+	m_iNextFrame = (m_iNextFrame + 1) % m_iMaxFrames;
+	if (m_iFrames < m_iMaxFrames)
+		m_iFrames++;
+}
+
+/**
+ * Finish timing a section.
+ *
+ * \param iSection The section, from AddSection.
+ * \param start The tick returned by Begin.
+ */
+void vtProfiler::End(int iSection, osg::Timer_t start)
+{
+	if (m_Enabled == 0)
+		return;
+
+	const osg::Timer_t end = osg::Timer::instance()->tick();
+
+	ScopedLock lock(m_Mutex);
+	_Record(iSection, start, end);
+}
+
+/**
+ * Finish timing a section declared with VTPROFILE.  The section is added
+ * the first time it is timed.
+ */
+void vtProfiler::End(vtProfileSection &section, osg::Timer_t start)
+{
+	if (m_Enabled == 0)
+		return;
+
+	const osg::Timer_t end = osg::Timer::instance()->tick();
+
+	ScopedLock lock(m_Mutex);
+	if (section.m_iIndex < 0)
+		section.m_iIndex = _AddSection(section.m_szName);
+	_Record(section.m_iIndex, start, end);
+}
+
+// Called with the mutex held.
+void vtProfiler::_Record(int iSection, osg::Timer_t start, osg::Timer_t end)
+{
+	Event ev;
+	ev.m_iSection = iSection;
+	ev.m_iThread = _ThreadIndex();
+	ev.m_fStart = osg::Timer::instance()->delta_u(m_StartTick, start);
+	ev.m_fDuration = osg::Timer::instance()->delta_u(start, end);
+	m_Current.m_Events.push_back(ev);
+
+	if ((int) m_Current.m_Times.size() <= iSection)
+		m_Current.m_Times.resize(iSection + 1, -1.0f);
+	float &time = m_Current.m_Times[iSection];
+	if (time < 0)
+		time = 0;
+	time += (float) (ev.m_fDuration / 1000);
+}
+
+int vtProfiler::NumFrames()
+{
+	ScopedLock lock(m_Mutex);
+	return m_iFrames;
+}
+
+/**
+ * Get the statistics for one section, over the frames kept.
+ *
+ * \return False if the section did not run in any of those frames.
+ */
+bool vtProfiler::GetStats(int iSection, vtProfileStats &stats)
+{
+	ScopedLock lock(m_Mutex);
+	std::vector<float> values;
+	values.reserve(m_iFrames);
+	for (int i = 0; i < m_iFrames; i++)
+	{
+		const std::vector<float> &times = m_Frames[i].m_Times;
+		if (iSection < (int) times.size() && times[iSection] >= 0)
+			values.push_back(times[iSection]);
+	}
+	_Stats(values, stats);
+	return (stats.m_iFrames > 0);
+}
+
+/**
+ * Get the statistics for whole frames, over the frames kept.
+ */
+bool vtProfiler::GetFrameStats(vtProfileStats &stats)
+{
+	ScopedLock lock(m_Mutex);
+	std::vector<float> values(m_iFrames);
+	for (int i = 0; i < m_iFrames; i++)
+		values[i] = (float) (m_Frames[i].m_fDuration / 1000);
+	_Stats(values, stats);
+	return (stats.m_iFrames > 0);
+}
+
+// Called with the mutex held.  Sorts the values.
+void vtProfiler::_Stats(std::vector<float> &values, vtProfileStats &stats)
+{
+	stats.m_iFrames = (int) values.size();
+	stats.m_fMean = stats.m_fMedian = stats.m_fP95 = stats.m_fP99 = stats.m_fMax = 0;
+	if (values.empty())
+		return;
+
+	std::sort(values.begin(), values.end());
+	double sum = 0;
+	for (size_t i = 0; i < values.size(); i++)
+		sum += values[i];
+
+	// Nearest-rank percentiles
+	const size_t n = values.size();
+	stats.m_fMean = (float) (sum / n);
+	stats.m_fMedian = values[(n - 1) / 2];
+	stats.m_fP95 = values[(n * 95 + 99) / 100 - 1];
+	stats.m_fP99 = values[(n * 99 + 99) / 100 - 1];
+	stats.m_fMax = values[n - 1];
+}
+
+// An id for the calling thread.  OpenThreads::Thread::CurrentThread can't be
+//  used, because it is NULL on threads which OpenThreads didn't start, such
+//  as the main thread and OpenMP's threads.
+static unsigned long CurrentThreadId()
+{
+#ifdef WIN32
+	return GetCurrentThreadId();
+#else
+	return (unsigned long) pthread_self();
+#endif
+}
+
+// Called with the mutex held.  Gives each thread which records an event a
+//  small number, in order of appearance.
+int vtProfiler::_ThreadIndex()
+{
+	const unsigned long thread = CurrentThreadId();
+	std::map<unsigned long, int>::iterator it = m_Threads.find(thread);
+	if (it != m_Threads.end())
+		return it->second;
+	const int index = (int) m_Threads.size();
+	m_Threads[thread] = index;
+	return index;
+}
+
+/**
+ * Describe the time taken by each section, one line per section, in
+ * milliseconds.
+ */
+void vtProfiler::GetSummary(vtString &str)
+{
+	vtProfileStats stats;
+	str.Format("%-20s %7s %7s %7s %7s\n", "ms", "mean", "median", "95%", "99%");
+	if (GetFrameStats(stats))
+	{
+		vtString line;
+		line.Format("%-20s %7.2f %7.2f %7.2f %7.2f\n", "Frame", stats.m_fMean,
+			stats.m_fMedian, stats.m_fP95, stats.m_fP99);
+		str += line;
+	}
+	const int sections = NumSections();
+	for (int i = 0; i < sections; i++)
+	{
+		if (!GetStats(i, stats))
+			continue;
+		vtString line;
+		line.Format("%-20s %7.2f %7.2f %7.2f %7.2f\n", (const char *) GetSectionName(i),
+			stats.m_fMean, stats.m_fMedian, stats.m_fP95, stats.m_fP99);
+		str += line;
+	}
+}
+
+void vtProfiler::LogSummary()
+{
+	vtString str;
+	GetSummary(str);
+	VTLOG("Profile of the last %d frames:\n", NumFrames());
+	VTLOG1(str);
+}
+
+/**
+ * Quote a string for JSON, such as for the trace or for other results
+ * written as JSON.
+ */
+vtString vtJSONString(const char *str)
+{
+	vtString result = "\"";
+	for (const char *p = str; *p; p++)
+	{
+		const unsigned char c = (unsigned char) *p;
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+			result += (char) c;
+		}
+		else if (c < 0x20)
+		{
+			vtString code;
+			code.Format("\\u%04x", c);
+			result += code;
+		}
+		else
+			result += (char) c;
+	}
+	result += '"';
+	return result;
+}
+
+/**
+ * Write the events of the frames kept to a file, in the Chrome trace event
+ * (JSON) format.  Each frame is a "Frame" event, with the sections that ran
+ * during it.
+ */
+bool vtProfiler::WriteChromeTrace(const char *filename)
+{
+	FILE *fp = vtFileOpen(filename, "wb");
+	if (!fp)
+		return false;
+
+	ScopedLock lock(m_Mutex);
+
+	std::vector<vtString> names(m_Sections.size());
+	for (size_t i = 0; i < m_Sections.size(); i++)
+		names[i] = vtJSONString(m_Sections[i]);
+
+	fprintf(fp, "{\"traceEvents\":[\n");
+	fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+		"\"args\":{\"name\":\"vtlib\"}}");
+
+	// Oldest frame first
+	const int first = (m_iFrames < m_iMaxFrames) ? 0 : m_iNextFrame;
+	for (int f = 0; f < m_iFrames; f++)
+	{
+		const Frame &frame = m_Frames[(first + f) % m_iMaxFrames];
+		fprintf(fp, ",\n{\"name\":\"Frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,"
+			"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", frame.m_iThread, frame.m_fStart,
+			frame.m_fDuration);
+
+		for (size_t i = 0; i < frame.m_Events.size(); i++)
+		{
+			const Event &ev = frame.m_Events[i];
+			fprintf(fp, ",\n{\"name\":%s,\"cat\":\"vtlib\",\"ph\":\"X\",\"pid\":1,"
+				"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				(const char *) names[ev.m_iSection], ev.m_iThread,
+				ev.m_fStart, ev.m_fDuration);
+		}
+	}
+	fprintf(fp, "\n],\n\"displayTimeUnit\":\"ms\"}\n");
+	fclose(fp);
+	return true;
+}
+
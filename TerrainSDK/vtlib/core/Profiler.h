@@ -0,0 +1,180 @@
+//
+// Profiler.h
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#ifndef VTLIB_PROFILERH
+#define VTLIB_PROFILERH
+
+#include <map>
+#include <vector>
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Mutex>
+#include <osg/Timer>
+
+#include "vtdata/vtString.h"
+
+/** \addtogroup sg */
+/*@{*/
+
+/// Statistics for one section, over the frames kept by a vtProfiler.
+struct vtProfileStats
+{
+	int m_iFrames;		// frames in which the section ran
+	float m_fMean;		// milliseconds per frame, over those frames
+	float m_fMedian;
+	float m_fP95;
+	float m_fP99;
+	float m_fMax;
+};
+
+/**
+ * A section of code declared with VTPROFILE.  This is a plain struct, so a
+ * static one is initialized before any code runs, which makes it safe to
+ * reach from any thread, unlike a static which calls a function.  The
+ * profiler gives it an index the first time it is timed.
+ */
+struct vtProfileSection
+{
+	const char *m_szName;
+	int m_iIndex;		// -1 until timed; guarded by the profiler's mutex
+};
+
+/**
+ * A simple instrumenting profiler, which measures where the time goes in
+ * each frame.
+ *
+ * Code marks the parts of a frame which are worth measuring with named
+ * sections, most easily with the VTPROFILE macro, which times the rest of
+ * the enclosing block:
+ \code
+	void vtTerrain::DoSomething()
+	{
+		VTPROFILE("Something");
+		...
+	}
+ \endcode
+ * vtScene::DoUpdate marks the start and end of each frame.  The time spent
+ * in each section, and the events themselves, are kept for the most recent
+ * frames in a ring buffer.  From that, the profiler can report percentiles
+ * for each section, and write the events in the Chrome trace event format,
+ * for viewing with chrome://tracing or similar tools.
+ *
+ * Sections may be timed from any thread.  The profiler is off by default;
+ * when it is off, a section costs only a test of a flag.
+ */
+class vtProfiler
+{
+public:
+	vtProfiler();
+
+	void SetEnabled(bool bOn);
+	bool GetEnabled() const { return m_Enabled != 0; }
+
+	void SetFrameCount(int iFrames);
+	int GetFrameCount() const { return m_iMaxFrames; }
+	void Reset();
+
+	int AddSection(const char *name);
+	int NumSections();
+	vtString GetSectionName(int iSection);
+
+	/// Call these at the start and end of each frame.
+	void BeginFrame();
+	void EndFrame();
+
+	/// Return a tick to pass to End, for timing one section.
+	osg::Timer_t Begin() const { return m_Enabled != 0 ? osg::Timer::instance()->tick() : 0; }
+	void End(int iSection, osg::Timer_t start);
+	void End(vtProfileSection &section, osg::Timer_t start);
+
+	int NumFrames();
+	bool GetStats(int iSection, vtProfileStats &stats);
+	bool GetFrameStats(vtProfileStats &stats);
+	void GetSummary(vtString &str);
+	void LogSummary();
+
+	bool WriteChromeTrace(const char *filename);
+
+protected:
+	struct Event
+	{
+		int m_iSection;
+		int m_iThread;
+		double m_fStart;	// microseconds since the profiler was created
+		double m_fDuration;
+	};
+	struct Frame
+	{
+		double m_fStart, m_fDuration;		// microseconds
+		int m_iThread;						// which called EndFrame
+		std::vector<float> m_Times;			// per section, milliseconds
+		std::vector<Event> m_Events;
+	};
+
+	int _AddSection(const char *name);
+	void _Record(int iSection, osg::Timer_t start, osg::Timer_t end);
+	void _Stats(std::vector<float> &values, vtProfileStats &stats);
+	int _ThreadIndex();
+
+	// Atomic, because sections test it on any thread without the mutex
+	OpenThreads::Atomic m_Enabled;
+	int m_iMaxFrames;
+	osg::Timer_t m_StartTick;
+	osg::Timer_t m_FrameTick;
+
+	std::vector<vtString> m_Sections;
+	std::map<vtString, int> m_SectionIndex;
+	std::map<unsigned long, int> m_Threads;	// by native thread id
+
+	Frame m_Current;
+	std::vector<Frame> m_Frames;	// the ring buffer
+	int m_iNextFrame;				// where the next finished frame goes
+	int m_iFrames;					// how many of m_Frames are in use
+
+	OpenThreads::Mutex m_Mutex;
+};
+
+vtProfiler *vtGetProfiler();
+
+/// Quote a string for JSON, escaping quotes, backslashes and control
+/// characters.
+vtString vtJSONString(const char *str);
+
+/**
+ * Times a section of code, from its construction to its destruction.
+ */
+class vtProfileScope
+{
+public:
+	vtProfileScope(vtProfileSection &section) : m_Section(section)
+	{
+		m_Start = vtGetProfiler()->Begin();
+	}
+	~vtProfileScope()
+	{
+		if (m_Start != 0)
+			vtGetProfiler()->End(m_Section, m_Start);
+	}
+
+protected:
+	vtProfileSection &m_Section;
+	osg::Timer_t m_Start;
+};
+
+#define VTPROFILE_CAT2(a, b) a##b
+#define VTPROFILE_CAT(a, b) VTPROFILE_CAT2(a, b)
+
+/// Time the rest of the enclosing block as a profiler section.  The name
+/// must be a string literal.
+#define VTPROFILE(name) \
+	static vtProfileSection VTPROFILE_CAT(vtprofile_section_, __LINE__) = { name, -1 }; \
+	vtProfileScope VTPROFILE_CAT(vtprofile_scope_, __LINE__)(VTPROFILE_CAT(vtprofile_section_, __LINE__))
+
+/*@}*/	// Group sg
+
+#endif	// VTLIB_PROFILERH
+
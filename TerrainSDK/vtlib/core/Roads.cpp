@@ -15,6 +15,8 @@
 #include "Roads.h"
 #include "Content3d.h"	// content manager for sign models
 
+#include <osg/Timer>
+
 #define ROADSIDE_WIDTH		2.0f
 #define ROADSIDE_DEPTH		-ROADSIDE_WIDTH
 
@@ -26,6 +28,9 @@
 
 #define ROAD_REZ 2048
 
+// The most vertices put in one road mesh, so that 16-bit indices will do
+#define ROAD_MESH_MAX_VERTS	65535
+
 
 ////////////////////////////////////////////////////////////////////
 
@@ -125,7 +130,6 @@ void NodeGeom::ComputeIntersectionVertices()
 		m_v[0].Set(m_p3.x + v.z, m_p3.y, m_p3.z - v.x);
 		m_v[1].Set(m_p3.x - v.z, m_p3.y, m_p3.z + v.x);
 
-		one++;
 	}
 	else if (NumLinks() == 2)
 	{
@@ -144,7 +148,6 @@ void NodeGeom::ComputeIntersectionVertices()
 		m_v[0].Set(m_p3.x + v.z, m_p3.y, m_p3.z - v.x);
 		m_v[1].Set(m_p3.x - v.z, m_p3.y, m_p3.z + v.x);
 
-		two++;
 	}
 	else
 	{
@@ -230,7 +233,6 @@ void NodeGeom::ComputeIntersectionVertices()
 			m_v[i * 2 + 0] = m_p3 + norm + (v * dist);
 			m_v[i * 2 + 1] = m_p3 - norm + (v * dist);
 		}
-		many++;
 	}
 }
 
@@ -276,49 +278,95 @@ void NodeGeom::FindVerticesForLink(TLink *pL, bool bStart, FPoint3 &p0, FPoint3
 }
 
 
-vtMesh *NodeGeom::GenerateGeometry(const VirtualTexture &vt)
+bool NodeGeom::GenerateGeometry(const VirtualTexture &vt, RoadMeshData &data)
 {
 	if (NumLinks() < 3)
-		return NULL;
+		return false;
 
 	FPoint2 uv;
 
 	const FPoint3 upvector(0.0f, 1.0f, 0.0f);
 
-	vtMesh *pMesh = new vtMesh(osg::PrimitiveSet::TRIANGLE_FAN, VT_TexCoords | VT_Normals, NumLinks()*2 + 1);
-	int verts = 0;
+	// a fan around the center of the intersection
+	std::vector<int> idx;
+	idx.reserve(NumLinks()*2 + 2);
 
 	vt.Adapt(FPoint2(0.5f, 0.5f), uv);
-
-	pMesh->SetVtxPUV(verts, m_p3, uv.x, uv.y);
-	pMesh->SetVtxNormal(verts, upvector);
-	verts++;
+	idx.push_back(data.AddVertex(m_p3, upvector, uv));
 
 	for (int j = 0; j < NumLinks(); j++)
 	{
 		vt.Adapt(FPoint2(0.0f, 1.0f), uv);
-		pMesh->SetVtxPUV(verts, m_v[j*2+1], uv.x, uv.y);
+		idx.push_back(data.AddVertex(m_v[j*2+1], upvector, uv));
 
 		vt.Adapt(FPoint2(1.0f, 1.0f), uv);
-		pMesh->SetVtxPUV(verts+1, m_v[j*2], uv.x, uv.y);
+		idx.push_back(data.AddVertex(m_v[j*2], upvector, uv));
+	}
+	idx.push_back(idx[1]);	// close it
+	data.AddFan(&idx[0], (int) idx.size());
+	data.m_iMatIdx = vt.m_idx;
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+void RoadMeshData::Clear()
+{
+	m_iMatIdx = -1;
+	m_Pos.clear();
+	m_Normal.clear();
+	m_UV.clear();
+	m_Index.clear();
+}
+
+int RoadMeshData::AddVertex(const FPoint3 &p, const FPoint3 &norm, const FPoint2 &uv)
+{
+	m_Pos.push_back(p);
+	m_Normal.push_back(norm);
+	m_UV.push_back(uv);
+	return (int) m_Pos.size() - 1;
+}
 
-		pMesh->SetVtxNormal(verts, upvector);
-		pMesh->SetVtxNormal(verts+1, upvector);
-		verts += 2;
+/**
+ * Adds a triangle strip of vertices which are in linear order, as a set of
+ * triangles.
+ */
+void RoadMeshData::AddStrip(int iNVerts, int iStartIndex)
+{
+	for (int i = 0; i < iNVerts - 2; i++)
+	{
+		// every other triangle of a strip is wound the other way
+		const int v = iStartIndex + i;
+		m_Index.push_back((i & 1) ? v + 1 : v);
+		m_Index.push_back((i & 1) ? v : v + 1);
+		m_Index.push_back(v + 2);
 	}
+}
 
-	// create triangles
-	verts = 0;
-	int idx[100];
-	idx[verts++] = 0;
-	for (int j = 0; j < NumLinks(); j++)
+/**
+ * Adds a triangle fan, as a set of triangles.
+ */
+void RoadMeshData::AddFan(const int *idx, int iNVerts)
+{
+	for (int i = 1; i < iNVerts - 1; i++)
 	{
-		idx[verts++] = (j*2+1);
-		idx[verts++] = (j*2+2);
+		m_Index.push_back(idx[0]);
+		m_Index.push_back(idx[i]);
+		m_Index.push_back(idx[i+1]);
 	}
-	idx[verts++] = 1;	// close it
-	pMesh->AddFan(idx, verts);
-	return pMesh;
+}
+
+/**
+ * Return the center of the extents of the vertices.
+ */
+FPoint3 RoadMeshData::Center() const
+{
+	FBox3 box;
+	box.InsideOut();
+	for (size_t i = 0; i < m_Pos.size(); i++)
+		box.GrowToContainPoint(m_Pos[i]);
+	return box.Center();
 }
 
 
@@ -399,10 +447,10 @@ void LinkGeom::SetupBuildInfo(RoadBuildInfo &bi)
 	}
 }
 
-void LinkGeom::AddRoadStrip(vtMesh *pMesh, RoadBuildInfo &bi,
+void LinkGeom::AddRoadStrip(RoadMeshData &data, RoadBuildInfo &bi,
 							float offset_left, float offset_right,
 							float height_left, float height_right,
-							VirtualTexture &vt,
+							const VirtualTexture &vt,
 							float u1, float u2, float uv_scale,
 							normal_direction nd)
 {
@@ -427,24 +475,25 @@ void LinkGeom::AddRoadStrip(vtMesh *pMesh, RoadBuildInfo &bi,
 			normal = bi.crossvector[j];		// right
 
 		vt.Adapt(FPoint2(u2, texture_v), uv);
-		pMesh->AddVertexUV(local1, uv);
+		data.AddVertex(local1, normal, uv);
 
 		vt.Adapt(FPoint2(u1, texture_v), uv);
-		pMesh->AddVertexUV(local0, uv);
-
-		pMesh->SetVtxNormal(bi.verts, normal);
-		pMesh->SetVtxNormal(bi.verts+1, normal);
+		data.AddVertex(local0, normal, uv);
 		bi.verts += 2;
 	}
 	// create tristrip
-	pMesh->AddStrip2(GetSize() * 2, bi.vert_index);
+	data.AddStrip(GetSize() * 2, bi.vert_index);
 	bi.vert_index += (GetSize() * 2);
 }
 
-void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
+/**
+ * Build the geometry of this link, adding it to the supplied mesh data.
+ * This only changes the link itself, so many links can be built at once.
+ */
+bool LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom, RoadMeshData &data)
 {
 	if (GetSize() < 2)	// safety check
-		return;
+		return false;
 
 	bool do_roadside = true;
 	switch (m_Surface)
@@ -481,11 +530,14 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	if (do_roadside)
 		total_vertices += (GetSize() * 2 * 2);		// 2 roadside strips
 
-	vtMesh *pMesh = new vtMesh(osg::PrimitiveSet::TRIANGLE_STRIP, VT_TexCoords | VT_Normals,
-		total_vertices);
+	data.m_Pos.reserve(data.m_Pos.size() + total_vertices);
+	data.m_Normal.reserve(data.m_Normal.size() + total_vertices);
+	data.m_UV.reserve(data.m_UV.size() + total_vertices);
 
 	RoadBuildInfo bi(GetSize());
 	SetupBuildInfo(bi);
+	bi.verts = bi.vert_index = data.NumVertices();
+	const int first_vertex = bi.verts;
 
 	const float center_width = m_iLanes * m_fLaneWidth;
 	float offset = -(center_width / 2);
@@ -502,7 +554,7 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	// create left roadside strip
 	if (do_roadside)
 	{
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset, offset+ROADSIDE_WIDTH,
 					ROADSIDE_DEPTH,
 					(m_iFlags & RF_SIDEWALK) ? m_fCurbHeight : 0.0f,
@@ -516,7 +568,7 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	// create left sidwalk
 	if (m_iFlags & RF_SIDEWALK_LEFT)
 	{
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset,
 					offset + m_fSidewalkWidth,
 					m_fCurbHeight, m_fCurbHeight,
@@ -524,7 +576,7 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 					0.0f, 0.93f, UV_SCALE_SIDEWALK,
 					ND_UP);
 		offset += m_fSidewalkWidth;
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset,
 					offset,
 					m_fCurbHeight, 0.0f,
@@ -535,7 +587,7 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	// create left parking lane
 	if (m_iFlags & RF_PARKING_LEFT)
 	{
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset,
 					offset + m_fParkingWidth,
 					0.0f, 0.0f,
@@ -547,7 +599,7 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	// create left margin
 	if (m_iFlags & RF_MARGIN)
 	{
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset,
 					offset + m_fMarginWidth,
 					0.0f, 0.0f,
@@ -558,7 +610,7 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	}
 
 	// create main road surface
-	AddRoadStrip(pMesh, bi,
+	AddRoadStrip(data, bi,
 				-center_width/2, center_width/2,
 				0.0f, 0.0f,
 				rmgeom->m_vt[m_vti],
@@ -569,7 +621,7 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	// create right margin
 	if (m_iFlags & RF_MARGIN)
 	{
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset,
 					offset + m_fMarginWidth,
 					0.0f, 0.0f,
@@ -581,7 +633,7 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	// create left parking lane
 	if (m_iFlags & RF_PARKING_RIGHT)
 	{
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset,
 					offset + m_fParkingWidth,
 					0.0f, 0.0f,
@@ -594,14 +646,14 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	// create right sidwalk
 	if (m_iFlags & RF_SIDEWALK_RIGHT)
 	{
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset,
 					offset,
 					0.0f, m_fCurbHeight,
 					rmgeom->m_vt[VTI_SIDEWALK],
 					1.0f, 0.93f, UV_SCALE_SIDEWALK,
 					ND_LEFT);
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset,
 					offset + m_fSidewalkWidth,
 					m_fCurbHeight, m_fCurbHeight,
@@ -615,7 +667,7 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 	if (do_roadside)
 	{
 		// create left roadside strip
-		AddRoadStrip(pMesh, bi,
+		AddRoadStrip(data, bi,
 					offset, offset+ROADSIDE_WIDTH,
 					(m_iFlags & RF_SIDEWALK) ? m_fCurbHeight : 0.0f,
 					ROADSIDE_DEPTH,
@@ -642,8 +694,9 @@ void LinkGeom::GenerateGeometry(vtRoadMap3d *rmgeom)
 		}
 	}
 
-	assert(total_vertices == bi.verts);
-	rmgeom->AddMeshToGrid(pMesh, rmgeom->m_vt[m_vti].m_idx);
+	assert(total_vertices == bi.verts - first_vertex);
+	data.m_iMatIdx = rmgeom->m_vt[m_vti].m_idx;
+	return true;
 }
 
 
@@ -723,72 +776,184 @@ vtRoadMap3d::~vtRoadMap3d()
 
 void vtRoadMap3d::ComputeIntersectionVertices()
 {
-	for (NodeGeom *pN = GetFirstNode(); pN; pN = pN->GetNext())
-		pN->ComputeIntersectionVertices();
+	osg::Timer *timer = osg::Timer::instance();
+	osg::Timer_t start = timer->tick();
+
+	// Each node only changes itself, and reads the centerlines of its links,
+	//  so they can all be done at once.
+	const int iNodes = NumNodes();
+	#pragma omp parallel for schedule(dynamic, 256)
+	for (int i = 0; i < iNodes; i++)
+		GetNode(i)->ComputeIntersectionVertices();
+
+	for (int i = 0; i < iNodes; i++)
+	{
+		const int links = GetNode(i)->NumLinks();
+		if (links == 1)
+			one++;
+		else if (links == 2)
+			two++;
+		else if (links > 2)
+			many++;
+	}
+	VTLOG("   Intersections: %d nodes in %.1f ms\n", iNodes,
+		timer->delta_m(start, timer->tick()));
 }
 
 
 int clusters_used = 0;	// for statistical purposes
 
-void vtRoadMap3d::AddMeshToGrid(vtMesh *pMesh, int iMatIdx)
+/**
+ * Find which LOD cell of the road geometry a point belongs to.
+ */
+void vtRoadMap3d::_FindCell(const FPoint3 &center, int &a, int &b) const
 {
-	// which cluster does it belong to?
-	int a, b;
-
-	FBox3 bound;
-	pMesh->GetBoundBox(bound);
-	FPoint3 center = bound.Center();
-
 	a = (int)((center.x - m_extents.min.x) / m_extent_range.x * ROAD_CLUSTER);
 	b = (int)((center.z - m_extents.min.z) / m_extent_range.z * ROAD_CLUSTER);
 
 	// safety check: if the following is true, then the geometry
 	// has somehow gotten mangled, so it's producing extents
-	// outside of what they should be, go no further
+	// outside of what they should be
 	assert(a >= 0 && a < ROAD_CLUSTER && b >= 0 && b < ROAD_CLUSTER);
+	if (a < 0) a = 0;
+	if (a > ROAD_CLUSTER-1) a = ROAD_CLUSTER-1;
+	if (b < 0) b = 0;
+	if (b > ROAD_CLUSTER-1) b = ROAD_CLUSTER-1;
+}
 
-	vtGeode *pGeode;
+/**
+ * Return the geode which holds the geometry of a LOD cell, creating the
+ * cell if it doesn't exist yet.
+ */
+vtGeode *vtRoadMap3d::_GetCellGeode(int a, int b)
+{
 	if (m_pRoads[a][b])
-	{
-		pGeode = (vtGeode *) m_pRoads[a][b]->getChild(0);
-	}
-	else
-	{
-		m_pRoads[a][b] = new vtLOD;
-		m_pGroup->addChild(m_pRoads[a][b]);
+		return (vtGeode *) m_pRoads[a][b]->getChild(0);
+
+	m_pRoads[a][b] = new vtLOD;
+	m_pGroup->addChild(m_pRoads[a][b]);
 
-		FPoint3 lod_center;
-		lod_center.x = m_extents.min.x + ((m_extent_range.x / ROAD_CLUSTER) * (a + 0.5f));
-		lod_center.y = m_extents.min.y + (m_extent_range.y / 2.0f);
-		lod_center.z = m_extents.min.z + ((m_extent_range.z / ROAD_CLUSTER) * (b + 0.5f));
-		m_pRoads[a][b]->SetCenter(lod_center);
+	FPoint3 lod_center;
+	lod_center.x = m_extents.min.x + ((m_extent_range.x / ROAD_CLUSTER) * (a + 0.5f));
+	lod_center.y = m_extents.min.y + (m_extent_range.y / 2.0f);
+	lod_center.z = m_extents.min.z + ((m_extent_range.z / ROAD_CLUSTER) * (b + 0.5f));
+	m_pRoads[a][b]->SetCenter(lod_center);
 
 #if 0
-		vtGeode *pSphere = CreateSphereGeom(m_pMats, m_mi_red, 1000.0f, 8);
-		vtMovGeode *pSphere2 = new vtMovGeode(pSphere);
-		m_pGroup->addChild(pSphere2);
-		pSphere2->SetTrans(lod_center);
+	vtGeode *pSphere = CreateSphereGeom(m_pMats, m_mi_red, 1000.0f, 8);
+	vtMovGeode *pSphere2 = new vtMovGeode(pSphere);
+	m_pGroup->addChild(pSphere2);
+	pSphere2->SetTrans(lod_center);
 #endif
 
-		pGeode = new vtGeode;
-		pGeode->setName("road");
-		pGeode->SetMaterials(m_pMats);
+	vtGeode *pGeode = new vtGeode;
+	pGeode->setName("road");
+	pGeode->SetMaterials(m_pMats);
 
-		// Visible from 0 to the desired distance
-		m_pRoads[a][b]->addChild(pGeode, 0.0f, m_fLodDistance);
+	// Visible from 0 to the desired distance
+	m_pRoads[a][b]->addChild(pGeode, 0.0f, m_fLodDistance);
+
+	clusters_used++;
+	return pGeode;
+}
+
+void vtRoadMap3d::AddMeshToGrid(vtMesh *pMesh, int iMatIdx)
+{
+	// which cluster does it belong to?
+	FBox3 bound;
+	pMesh->GetBoundBox(bound);
+
+	int a, b;
+	_FindCell(bound.Center(), a, b);
+	_GetCellGeode(a, b)->AddMesh(pMesh, iMatIdx);
+}
 
-		clusters_used++;
+/**
+ * Decide whether to construct a link, given which kinds of road are wanted.
+ */
+bool vtRoadMap3d::_IncludeLink(const LinkGeom *pL, bool bHwy, bool bPaved,
+	bool bDirt) const
+{
+	if (bHwy && bPaved && bDirt)
+		return true;
+
+	bool bIsDirt = (pL->m_Surface == SURFT_2TRACK || pL->m_Surface == SURFT_DIRT);
+	if (bHwy && pL->m_iHwy != -1)
+		return true;
+	if (bPaved && !bIsDirt)
+		return true;
+	if (bDirt && bIsDirt)
+		return true;
+	return false;
+}
+
+/**
+ * What material to use for an intersection?  We used to simply use
+ * "pavement", but that is bad when they are e.g. trail or stone.  Now, we
+ * try to guess what to use by looking at the links there.
+ */
+int vtRoadMap3d::_NodeTexture(NodeGeom *pN)
+{
+	int node_vti = VTI_PAVEMENT;
+	for (int i = 0; i < pN->NumLinks(); i++)
+	{
+		LinkGeom *pL = pN->GetLink(i);
+		switch (pL->m_vti)
+		{
+		case VTI_RAIL:
+		case VTI_4WD:
+		case VTI_TRAIL:
+		case VTI_GRAVEL:
+		case VTI_STONE:
+			node_vti = pL->m_vti;
+		}
 	}
-	pGeode->AddMesh(pMesh, iMatIdx);
+	return node_vti;
 }
 
+// The pieces of road geometry which go into one mesh: those in the same LOD
+//  cell which use the same material.
+struct RoadMeshBatch
+{
+	int a, b;
+	int iMatIdx;
+	uint iVerts;
+	std::vector<const RoadMeshData*> parts;
+	vtMesh *pMesh;
+};
 
+static vtMesh *CreateBatchMesh(const RoadMeshBatch &batch)
+{
+	vtMesh *pMesh = new vtMesh(osg::PrimitiveSet::TRIANGLES,
+		VT_TexCoords | VT_Normals, batch.iVerts);
+
+	for (size_t i = 0; i < batch.parts.size(); i++)
+	{
+		const RoadMeshData &part = *(batch.parts[i]);
+		const int base = pMesh->NumVertices();
+		for (uint j = 0; j < part.NumVertices(); j++)
+			pMesh->AddVertexNUV(part.m_Pos[j], part.m_Normal[j], part.m_UV[j]);
+		for (size_t j = 0; j + 2 < part.m_Index.size(); j += 3)
+			pMesh->AddTri(base + part.m_Index[j], base + part.m_Index[j+1],
+				base + part.m_Index[j+2]);
+	}
+	return pMesh;
+}
+
+/**
+ * Create the geometry of the roads.  The geometry of the links and
+ * intersections is built in parallel, then gathered into one mesh for each
+ * material in each LOD cell.
+ */
 vtTransform *vtRoadMap3d::GenerateGeometry(bool do_texture,
 	bool bHwy, bool bPaved, bool bDirt, bool progress_callback(int))
 {
 	VTLOG("   vtRoadMap3d::GenerateGeometry\n");
 	VTLOG("   Nodes %d, Links %d\n", NumNodes(), NumLinks());
 
+	osg::Timer *timer = osg::Timer::instance();
+	osg::Timer_t start = timer->tick();
+
 	_CreateMaterials(do_texture);
 
 	m_pGroup = new vtGroup;
@@ -814,60 +979,89 @@ vtTransform *vtRoadMap3d::GenerateGeometry(bool do_texture,
 	m_pGroup->addChild(pGeode);
 #endif
 
-	vtMesh *pMesh;
-	int count = 0, total = NumLinks() + NumNodes();
-	for (LinkGeom *pL = GetFirstLink(); pL; pL = pL->GetNext())
+	// Build the links, then the intersections.  Each only changes itself, so
+	//  they are built in parallel, a block at a time so that progress can be
+	//  reported from this thread between the blocks.
+	const int iLinks = NumLinks();
+	const int total = iLinks + NumNodes();
+	std::vector<RoadMeshData> pieces(total);
+	const int block = 1024;
+	for (int first = 0; first < total; first += block)
 	{
-		// Decide whether to construct this link
-		bool include = false;
-		if (bHwy && bPaved && bDirt)
-			include = true;
-		else
+		const int last = std::min(first + block, total);
+		#pragma omp parallel for schedule(dynamic, 16)
+		for (int i = first; i < last; i++)
 		{
-			bool bIsDirt = (pL->m_Surface == SURFT_2TRACK || pL->m_Surface == SURFT_DIRT);
-			if (bHwy && pL->m_iHwy != -1)
-				include = true;
-			if (bPaved && !bIsDirt)
-				include = true;
-			if (bDirt && bIsDirt)
-				include = true;
+			if (i < iLinks)
+			{
+				LinkGeom *pL = GetLink(i);
+				if (_IncludeLink(pL, bHwy, bPaved, bDirt))
+					pL->GenerateGeometry(this, pieces[i]);
+			}
+			else
+			{
+				NodeGeom *pN = GetNode(i - iLinks);
+				pN->GenerateGeometry(m_vt[_NodeTexture(pN)], pieces[i]);
+			}
 		}
-		if (include)
-			pL->GenerateGeometry(this);
-		count++;
 		if (progress_callback != NULL)
-			progress_callback(count * 100 / total);
+			progress_callback(last * 100 / total);
 	}
-	count = 0;
-	for (NodeGeom *pN = GetFirstNode(); pN; pN = pN->GetNext())
+	osg::Timer_t built = timer->tick();
+
+	// Gather the pieces into batches, in order so that the result doesn't
+	//  depend on the threads.  A batch which gets too large for one mesh is
+	//  continued in another.
+	std::vector<RoadMeshBatch> batches;
+	std::map<std::pair<int,int>, int> open_batch;	// (cell, material) -> batch
+	for (int i = 0; i < total; i++)
 	{
-		// What material to use?  We used to simply use "pavement", but that is
-		// bad when they are e.g. trail or stone.  Now, we will try to guess
-		// what to use by looking at the links here.
-		int node_vti = VTI_PAVEMENT;
-		for (int i = 0; i < pN->NumLinks(); i++)
+		const RoadMeshData &piece = pieces[i];
+		if (piece.IsEmpty())
+			continue;
+
+		_FindCell(piece.Center(), a, b);
+		const std::pair<int,int> key(a * ROAD_CLUSTER + b, piece.m_iMatIdx);
+		std::map<std::pair<int,int>, int>::iterator it = open_batch.find(key);
+		int batch;
+		if (it != open_batch.end() &&
+			batches[it->second].iVerts + piece.NumVertices() <= ROAD_MESH_MAX_VERTS)
 		{
-			LinkGeom *pL = pN->GetLink(i);
-			switch (pL->m_vti)
-			{
-			case VTI_RAIL:
-			case VTI_4WD:
-			case VTI_TRAIL:
-			case VTI_GRAVEL:
-			case VTI_STONE:
-				node_vti = pL->m_vti;
-			}
+			batch = it->second;
 		}
-		VirtualTexture &vt = m_vt[node_vti];
-
-		pMesh = pN->GenerateGeometry(vt);
-		if (pMesh)
-			AddMeshToGrid(pMesh, vt.m_idx);
-		count++;
-		if (progress_callback != NULL)
-			progress_callback(count * 100 / total);
+		else
+		{
+			batch = (int) batches.size();
+			batches.resize(batch + 1);
+			batches[batch].a = a;
+			batches[batch].b = b;
+			batches[batch].iMatIdx = piece.m_iMatIdx;
+			batches[batch].iVerts = 0;
+			batches[batch].pMesh = NULL;
+			open_batch[key] = batch;
+		}
+		batches[batch].parts.push_back(&piece);
+		batches[batch].iVerts += piece.NumVertices();
 	}
 
+	// Each mesh is a separate object, so they can be filled at once
+	const int iBatches = (int) batches.size();
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < iBatches; i++)
+		batches[i].pMesh = CreateBatchMesh(batches[i]);
+	osg::Timer_t meshed = timer->tick();
+
+	// The scene graph is only touched from this thread
+	for (int i = 0; i < iBatches; i++)
+		_GetCellGeode(batches[i].a, batches[i].b)->AddMesh(batches[i].pMesh,
+			batches[i].iMatIdx);
+	osg::Timer_t end = timer->tick();
+
+	VTLOG("   Built %d pieces in %.1f ms, %d meshes in %.1f ms, "
+		"scene graph in %.1f ms (total %.1f ms)\n", total,
+		timer->delta_m(start, built), iBatches, timer->delta_m(built, meshed),
+		timer->delta_m(meshed, end), timer->delta_m(start, end));
+
 	// return the top group, ready to be added to scene graph
 	return m_pTransform;
 }
@@ -1132,16 +1326,13 @@ float vtRoadMap3d::GetLodDistance()
 
 void vtRoadMap3d::DrapeOnTerrain(vtHeightField3d *pHeightField)
 {
-	FPoint3 p;
-	NodeGeom *pN;
-
 #if 0
 	// This code attempts to identify cases where a node actually
 	// represents something like an overpass: two links that don't
 	// actually connect.  However, it's better to take care of this
 	// as a preprocess, rather than at runtime.
 	float height;
-	for (pN = GetFirstNode(); pN; pN = (NodeGeom *)pN->m_pNext)
+	for (NodeGeom *pN = GetFirstNode(); pN; pN = pN->GetNext())
 	{
 		bool all_same_height = true;
 		height = pN->GetLink(0)->GetHeightAt(pN);
@@ -1168,9 +1359,47 @@ void vtRoadMap3d::DrapeOnTerrain(vtHeightField3d *pHeightField)
 		}
 	}
 #endif
-	for (pN = GetFirstNode(); pN; pN = pN->GetNext())
+	osg::Timer *timer = osg::Timer::instance();
+	osg::Timer_t start = timer->tick();
+
+	// Every node, and every point of every link, gets a place in one array
+	//  of points, so that the ground can be found under all of them at once.
+	const int iNodes = NumNodes();
+	const int iLinks = NumLinks();
+	std::vector<int> first(iLinks);
+	int count = iNodes;
+	for (int i = 0; i < iLinks; i++)
 	{
-		pHeightField->ConvertEarthToSurfacePoint(pN->Pos(), pN->m_p3);
+		first[i] = count;
+		count += GetLink(i)->GetSize();
+	}
+	std::vector<FPoint3> points(count);
+
+	// convert earth -> XZ
+	const LocalCS &conv = pHeightField->m_LocalCS;
+	#pragma omp parallel for
+	for (int i = 0; i < iNodes; i++)
+		conv.EarthToLocal(GetNode(i)->Pos(), points[i].x, points[i].z);
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (int i = 0; i < iLinks; i++)
+	{
+		LinkGeom *pL = GetLink(i);
+		if (pL->GetSize() > 0)
+			conv.EarthToLocal(pL->GetData(), &points[first[i]], pL->GetSize());
+	}
+	osg::Timer_t converted = timer->tick();
+
+	// look up altitudes
+	if (count > 0)
+		pHeightField->FindAltitudesAtPoints(&points[0], count);
+	osg::Timer_t found = timer->tick();
+
+	#pragma omp parallel for
+	for (int i = 0; i < iNodes; i++)
+	{
+		NodeGeom *pN = GetNode(i);
+		pN->m_p3 = points[i];
 #if 0
 		if (pN->NumLinks() > 0)
 		{
@@ -1179,16 +1408,23 @@ void vtRoadMap3d::DrapeOnTerrain(vtHeightField3d *pHeightField)
 		}
 #endif
 	}
-	for (LinkGeom *pL = GetFirstLink(); pL; pL = pL->GetNext())
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (int i = 0; i < iLinks; i++)
 	{
+		LinkGeom *pL = GetLink(i);
 		pL->m_centerline.SetSize(pL->GetSize());
 		for (uint j = 0; j < pL->GetSize(); j++)
-		{
-			pHeightField->ConvertEarthToSurfacePoint(pL->GetAt(j), p);
-			pL->m_centerline[j] = p;
-		}
+			pL->m_centerline[j] = points[first[i]+j];
+
 		// ignore width from file - imply from properties
 		pL->EstimateWidth();
 	}
+	osg::Timer_t end = timer->tick();
+
+	VTLOG("   Draped %d points: convert %.1f ms, altitudes %.1f ms, "
+		"total %.1f ms\n", count, timer->delta_m(start, converted),
+		timer->delta_m(converted, found), timer->delta_m(start, end));
+
 }
 
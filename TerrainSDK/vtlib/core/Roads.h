@@ -70,6 +70,32 @@ enum RoadVTIndices
 	VTI_TOTAL
 };
 
+/**
+ * Road surface geometry, kept in plain arrays while it is being built.
+ * Unlike a vtMesh, it can be built on any thread; vtRoadMap3d gathers many
+ * of these into a few large meshes once they are all built.  The primitives
+ * are indexed triangles.
+ */
+class RoadMeshData
+{
+public:
+	RoadMeshData() { m_iMatIdx = -1; }
+
+	void Clear();
+	bool IsEmpty() const { return m_Index.empty(); }
+	uint NumVertices() const { return (uint) m_Pos.size(); }
+	int AddVertex(const FPoint3 &p, const FPoint3 &norm, const FPoint2 &uv);
+	void AddStrip(int iNVerts, int iStartIndex);
+	void AddFan(const int *idx, int iNVerts);
+	FPoint3 Center() const;
+
+	int m_iMatIdx;
+	std::vector<FPoint3> m_Pos;
+	std::vector<FPoint3> m_Normal;
+	std::vector<FPoint2> m_UV;
+	std::vector<int> m_Index;	// three per triangle
+};
+
 /**
  * A Node is a place where 2 or more links meet.  NodeGeom extents Node
  * with 3D geometry.
@@ -86,7 +112,7 @@ public:
 	}
 	void ComputeIntersectionVertices();
 	void FindVerticesForLink(TLink *pR, bool bStart, FPoint3 &p0, FPoint3 &p1);
-	vtMesh *GenerateGeometry(const VirtualTexture &vt);
+	bool GenerateGeometry(const VirtualTexture &vt, RoadMeshData &data);
 	FPoint3 GetUnitLinkVector(int i);
 	const FPoint3 &GetAdjacentRoadpoint(int iLinkNumber);
 	NodeGeom *GetNext() { return (NodeGeom*) m_pNext; }
@@ -133,13 +159,13 @@ public:
 
 	// link-construction methods
 	void SetupBuildInfo(RoadBuildInfo &bi);
-	void AddRoadStrip(vtMesh *pGeom, RoadBuildInfo &bi,
+	void AddRoadStrip(RoadMeshData &data, RoadBuildInfo &bi,
 					float offset_left, float offset_right,
 					float height_left, float height_right,
-					VirtualTexture &vt,
+					const VirtualTexture &vt,
 					float u1, float u2, float uv_scale,
 					normal_direction nd);
-	void GenerateGeometry(class vtRoadMap3d *rmgeom);
+	bool GenerateGeometry(class vtRoadMap3d *rmgeom, RoadMeshData &data);
 
 	NodeGeom *GetNode(int n) { return (NodeGeom *)m_pNode[n]; }
 	LinkGeom *GetNext() { return (LinkGeom *)m_pNext; }
@@ -165,8 +191,10 @@ public:
 	~vtRoadMap3d();
 
 	// overrides for virtual methods
-	NodeGeom *GetFirstNode() { return (NodeGeom *) m_pFirstNode; }
-	LinkGeom *GetFirstLink() { return (LinkGeom *) m_pFirstLink; }
+	NodeGeom *GetFirstNode() { return (NodeGeom *) vtRoadMap::GetFirstNode(); }
+	LinkGeom *GetFirstLink() { return (LinkGeom *) vtRoadMap::GetFirstLink(); }
+	NodeGeom *GetNode(int i) { return (NodeGeom *) m_Nodes[i]; }
+	LinkGeom *GetLink(int i) { return (LinkGeom *) m_Links[i]; }
 	NodeGeom *NewNode() { return new NodeGeom; }
 	LinkGeom *NewLink() { return new LinkGeom; }
 	NodeGeom *AddNewNode()
@@ -213,6 +241,10 @@ protected:
 	int _CreateMaterial(const char *texture_filename, bool bTransparency);
 	void _CreateMaterials(bool do_texture);
 	void _GatherExtents();
+	void _FindCell(const FPoint3 &center, int &a, int &b) const;
+	vtGeode *_GetCellGeode(int a, int b);
+	bool _IncludeLink(const LinkGeom *pL, bool bHwy, bool bPaved, bool bDirt) const;
+	int _NodeTexture(NodeGeom *pN);
 
 	vtTransform	*m_pTransform;	// For elevating the roads above the terrain.
 	vtGroup		*m_pGroup;
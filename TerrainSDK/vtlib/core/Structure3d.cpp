@@ -10,6 +10,7 @@
 #include "vtdata/vtLog.h"
 #include "vtdata/DataPath.h"
 
+#include "ModelCache.h"
 #include "Structure3d.h"
 #include "Building3d.h"
 #include "Fence3d.h"
@@ -144,7 +145,7 @@ bool vtStructInstance3d::CreateNode(vtTerrain *pTerr)
 #if VTDEBUG
 		VTLOG("Loading Model from '%s'\n", (const char *)fullpath);
 #endif
-		m_pModel = vtLoadModel(fullpath, !bForce);
+		m_pModel = vtGetModelCache()->Load(fullpath, bForce);
 		if (!m_pModel)
 		{
 			VTLOG("Couldn't load model from file '%s'\n", filename);
@@ -77,6 +77,7 @@ TParams::TParams() : vtTagArray()
 	AddTag(STR_VERTCOUNT, "20000");
 	AddTag(STR_TILE_CACHE_SIZE, "80");	// 80 MB
 	AddTag(STR_TILE_THREADING, "false");
+	AddTag(STR_TILE_UPLOAD_TIME, "10");	// 10 ms
 
 	AddTag(STR_TIMEON, "false");
 	AddTag(STR_INITTIME, "104 3 21 10 0 0");	// 2004, spring equinox, 10am
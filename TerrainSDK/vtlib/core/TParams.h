@@ -392,6 +392,7 @@ private:
 #define STR_VERTCOUNT "Vert_Count"
 #define STR_TILE_CACHE_SIZE "Tile_Cache_Size"	// in MB
 #define STR_TILE_THREADING "Tile_Threading"
+#define STR_TILE_UPLOAD_TIME "Tile_Upload_Time"	// in milliseconds per frame
 
 #define STR_TIMEON "Time_On"
 #define STR_INITTIME "Init_Time"
@@ -0,0 +1,307 @@
+//
+// TaskGraph.cpp
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#include "vtlib/vtlib.h"
+#include "vtdata/vtLog.h"
+#include "TaskGraph.h"
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/ScopedLock>
+
+typedef OpenThreads::ScopedLock<OpenThreads::Mutex> ScopedLock;
+
+class vtTaskGraph::Worker : public OpenThreads::Thread
+{
+public:
+	Worker(vtTaskGraph *pGraph, int iIndex) : m_pGraph(pGraph), m_iIndex(iIndex) {}
+	void run() { m_pGraph->_WorkerLoop(m_iIndex); }
+
+	vtTaskGraph *m_pGraph;
+	int m_iIndex;
+};
+
+
+vtTaskGraph::vtTaskGraph(const char *name)
+{
+	m_name = name;
+	m_bQuit = false;
+	m_StartTick = osg::Timer::instance()->tick();
+	m_fWaited = 0;
+}
+
+/**
+ * The destructor waits for all the tasks which have been started to finish.
+ */
+vtTaskGraph::~vtTaskGraph()
+{
+	WaitAll();
+	{
+		ScopedLock lock(m_Mutex);
+		m_bQuit = true;
+		m_Changed.broadcast();
+	}
+	for (size_t i = 0; i < m_Workers.size(); i++)
+	{
+		m_Workers[i]->join();
+		delete m_Workers[i];
+	}
+	for (size_t i = 0; i < m_Tasks.size(); i++)
+	{
+		delete m_Tasks[i]->m_pTask;
+		delete m_Tasks[i];
+	}
+}
+
+/**
+ * Add a task to the graph.  The graph takes ownership of the task object.
+ *
+ * \param name A short name for the task, for the log.
+ * \param task The work to do.
+ * \param bBackground True to run it on a worker thread, false to run it on
+ *		the thread which owns the graph.
+ * \return The index of the task.
+ */
+int vtTaskGraph::AddTask(const char *name, vtTask *task, bool bBackground)
+{
+	Node *node = new Node;
+	node->m_name = name;
+	node->m_pTask = task;
+	node->m_bBackground = bBackground;
+	node->m_state = TS_HELD;
+	node->m_iWaitingFor = 0;
+	node->m_bBlocked = false;
+	node->m_bSuccess = false;
+	node->m_iThread = -1;
+	node->m_fStart = node->m_fTime = 0;
+
+	ScopedLock lock(m_Mutex);
+	m_Tasks.push_back(node);
+	return (int) m_Tasks.size() - 1;
+}
+
+/**
+ * State that a task can't start until another one has finished.  The task
+ * must not have been started yet.
+ */
+void vtTaskGraph::AddDependency(int iTask, int iPrerequisite)
+{
+	ScopedLock lock(m_Mutex);
+	Node *node = m_Tasks[iTask];
+	Node *pre = m_Tasks[iPrerequisite];
+	if (node->m_state != TS_HELD)
+		return;
+	if (pre->m_state == TS_DONE)
+	{
+		if (!pre->m_bSuccess)
+			node->m_bBlocked = true;
+		return;
+	}
+	pre->m_Dependents.push_back(iTask);
+	node->m_iWaitingFor++;
+}
+
+/**
+ * Let all the tasks added so far run, once their prerequisites are done.
+ * The first call also starts the worker threads.
+ *
+ * \param iThreads The number of worker threads, or 0 to pick one from the
+ *		number of processors.
+ */
+void vtTaskGraph::Start(int iThreads)
+{
+	ScopedLock lock(m_Mutex);
+
+	if (m_Workers.empty())
+	{
+		if (iThreads <= 0)
+			iThreads = OpenThreads::GetNumberOfProcessors() - 1;
+		for (int i = 0; i < iThreads; i++)
+		{
+			Worker *worker = new Worker(this, i);
+			m_Workers.push_back(worker);
+			worker->start();
+		}
+	}
+	for (size_t i = 0; i < m_Tasks.size(); i++)
+	{
+		if (m_Tasks[i]->m_state == TS_HELD)
+			_Release((int) i);
+	}
+}
+
+/**
+ * Wait for a task to finish, running any of the owner's tasks which become
+ * ready in the meantime.  This must only be called by the owning thread.
+ *
+ * \return True if the task succeeded.
+ */
+bool vtTaskGraph::Wait(int iTask)
+{
+	ScopedLock lock(m_Mutex);
+	if (m_Tasks[iTask]->m_state == TS_HELD)
+		return false;	// never started, so it would never finish
+
+	while (m_Tasks[iTask]->m_state != TS_DONE)
+	{
+		if (_RunOneOnOwner())
+			continue;
+
+		osg::Timer_t start = osg::Timer::instance()->tick();
+		m_Changed.wait(&m_Mutex);
+		m_fWaited += osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+	}
+	return m_Tasks[iTask]->m_bSuccess;
+}
+
+/**
+ * Wait for every task which has been started to finish.
+ *
+ * \return True if they all succeeded (tasks which were never started count
+ *		as failed).
+ */
+bool vtTaskGraph::WaitAll()
+{
+	bool bAll = true;
+	for (int i = 0; i < NumTasks(); i++)
+	{
+		if (!Wait(i))
+			bAll = false;
+	}
+	return bAll;
+}
+
+bool vtTaskGraph::IsDone(int iTask)
+{
+	ScopedLock lock(m_Mutex);
+	return (m_Tasks[iTask]->m_state == TS_DONE);
+}
+
+int vtTaskGraph::NumTasks()
+{
+	ScopedLock lock(m_Mutex);
+	return (int) m_Tasks.size();
+}
+
+/**
+ * Write the time taken by each task to the log.
+ */
+void vtTaskGraph::LogTimes()
+{
+	ScopedLock lock(m_Mutex);
+
+	const double elapsed = osg::Timer::instance()->delta_m(m_StartTick,
+		osg::Timer::instance()->tick());
+	double total = 0;
+	for (size_t i = 0; i < m_Tasks.size(); i++)
+		total += m_Tasks[i]->m_fTime;
+
+	VTLOG("Task graph '%s': %d tasks on %d threads, %.1f ms of work in %.1f ms, "
+		"%.1f ms spent waiting.\n", (const char *) m_name, (int) m_Tasks.size(),
+		(int) m_Workers.size(), total, elapsed, m_fWaited);
+	for (size_t i = 0; i < m_Tasks.size(); i++)
+	{
+		const Node *node = m_Tasks[i];
+		if (node->m_state != TS_DONE)
+		{
+			VTLOG("  %-24s not finished\n", (const char *) node->m_name);
+			continue;
+		}
+		VTLOG("  %-24s %8.1f ms, at %8.1f ms, thread %2d%s\n",
+			(const char *) node->m_name, node->m_fTime, node->m_fStart,
+			node->m_iThread, node->m_bSuccess ? "" : " (failed)");
+	}
+}
+
+// Called with the mutex held.
+void vtTaskGraph::_Release(int iTask)
+{
+	Node *node = m_Tasks[iTask];
+	node->m_state = TS_WAITING;
+	if (node->m_iWaitingFor > 0)
+		return;
+
+	if (node->m_bBlocked)
+		_Finish(iTask, false);
+	else
+	{
+		node->m_state = TS_READY;
+		if (node->m_bBackground && !m_Workers.empty())
+			m_Ready.push_back(iTask);
+		else
+			m_ReadyOwner.push_back(iTask);
+		m_Changed.broadcast();
+	}
+}
+
+// Called with the mutex held; releases it while the task runs.
+void vtTaskGraph::_Execute(int iTask, int iThread)
+{
+	Node *node = m_Tasks[iTask];
+	node->m_state = TS_RUNNING;
+	node->m_iThread = iThread;
+
+	osg::Timer *timer = osg::Timer::instance();
+	osg::Timer_t start = timer->tick();
+
+	m_Mutex.unlock();
+	bool bSuccess = node->m_pTask->Run();
+	osg::Timer_t end = timer->tick();
+	m_Mutex.lock();
+
+	node->m_fStart = timer->delta_m(m_StartTick, start);
+	node->m_fTime = timer->delta_m(start, end);
+	_Finish(iTask, bSuccess);
+}
+
+// Called with the mutex held.
+void vtTaskGraph::_Finish(int iTask, bool bSuccess)
+{
+	Node *node = m_Tasks[iTask];
+	node->m_state = TS_DONE;
+	node->m_bSuccess = bSuccess;
+
+	for (size_t i = 0; i < node->m_Dependents.size(); i++)
+	{
+		const int dep = node->m_Dependents[i];
+		Node *dnode = m_Tasks[dep];
+		if (!bSuccess)
+			dnode->m_bBlocked = true;
+		dnode->m_iWaitingFor--;
+		if (dnode->m_iWaitingFor == 0 && dnode->m_state == TS_WAITING)
+			_Release(dep);
+	}
+	m_Changed.broadcast();
+}
+
+// Called with the mutex held, by the owning thread.
+bool vtTaskGraph::_RunOneOnOwner()
+{
+	if (m_ReadyOwner.empty())
+		return false;
+
+	const int iTask = m_ReadyOwner.front();
+	m_ReadyOwner.pop_front();
+	_Execute(iTask, -1);
+	return true;
+}
+
+void vtTaskGraph::_WorkerLoop(int iThread)
+{
+	ScopedLock lock(m_Mutex);
+	while (true)
+	{
+		while (!m_bQuit && m_Ready.empty())
+			m_Changed.wait(&m_Mutex);
+		if (m_bQuit)
+			break;
+
+		const int iTask = m_Ready.front();
+		m_Ready.pop_front();
+		_Execute(iTask, iThread);
+	}
+}
+
@@ -0,0 +1,160 @@
+//
+// TaskGraph.h
+//
+// Copyright (c) 2013 Virtual Terrain Project
+// Free for all uses, see license.txt for details.
+//
+
+#ifndef VTLIB_TASKGRAPHH
+#define VTLIB_TASKGRAPHH
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <locale.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+#include <osg/Timer>
+
+#include "vtdata/vtString.h"
+
+/** \addtogroup terrain */
+/*@{*/
+
+/**
+ * Sets the "C" numeric locale for the current thread only, for as long as
+ * it exists.  Use it in tasks which parse numbers; ScopedLocale can't be
+ * used on worker threads, because it changes the locale of the whole
+ * process.
+ */
+class ThreadLocaleC
+{
+public:
+	ThreadLocaleC()
+	{
+#ifdef WIN32
+		m_iOldConfig = _configthreadlocale(_ENABLE_PER_THREAD_LOCALE);
+		m_old = setlocale(LC_NUMERIC, NULL);
+		setlocale(LC_NUMERIC, "C");
+#else
+		m_locale = newlocale(LC_NUMERIC_MASK, "C", duplocale(LC_GLOBAL_LOCALE));
+		m_old = uselocale(m_locale);
+#endif
+	}
+	~ThreadLocaleC()
+	{
+#ifdef WIN32
+		setlocale(LC_NUMERIC, m_old.c_str());
+		_configthreadlocale(m_iOldConfig);
+#else
+		uselocale(m_old);
+		freelocale(m_locale);
+#endif
+	}
+
+protected:
+#ifdef WIN32
+	int m_iOldConfig;
+	std::string m_old;
+#else
+	locale_t m_locale;
+	locale_t m_old;
+#endif
+};
+
+
+/**
+ * A piece of work to be done by a vtTaskGraph.  Subclass it and implement
+ * Run().
+ */
+class vtTask
+{
+public:
+	virtual ~vtTask() {}
+
+	/// Do the work.  Return false if it failed.
+	virtual bool Run() = 0;
+};
+
+/**
+ * A set of tasks, some of which can only start once others are finished.
+ *
+ * Background tasks are run by a small pool of worker threads, as soon as
+ * all the tasks they depend on are finished.  Other tasks are run on the
+ * thread which owns the graph (normally the main thread, which is the only
+ * one allowed to change the scene graph) while it waits in Wait().  If a
+ * task fails, the tasks which depend on it are not run, and fail too.
+ *
+ * Tasks are added with AddTask, and their prerequisites given with
+ * AddDependency.  A task doesn't become eligible to run until Start() is
+ * called.  More tasks can be added after that, and another call to Start()
+ * will release them.
+ *
+ * The wall time of every task is measured; LogTimes writes them to the log.
+ */
+class vtTaskGraph
+{
+public:
+	vtTaskGraph(const char *name);
+	~vtTaskGraph();
+
+	int AddTask(const char *name, vtTask *task, bool bBackground = true);
+	void AddDependency(int iTask, int iPrerequisite);
+	void Start(int iThreads = 0);
+
+	bool Wait(int iTask);
+	bool WaitAll();
+	bool IsDone(int iTask);
+
+	int NumTasks();
+	int NumThreads() const { return (int) m_Workers.size(); }
+	void LogTimes();
+
+protected:
+	class Worker;
+	friend class Worker;
+
+	enum TaskState { TS_HELD, TS_WAITING, TS_READY, TS_RUNNING, TS_DONE };
+	struct Node
+	{
+		vtString m_name;
+		vtTask *m_pTask;
+		bool m_bBackground;
+		TaskState m_state;
+		int m_iWaitingFor;		// number of unfinished prerequisites
+		bool m_bBlocked;		// a prerequisite failed
+		bool m_bSuccess;
+		std::vector<int> m_Dependents;
+		int m_iThread;			// which ran it: -1 for the owning thread
+		double m_fStart, m_fTime;	// milliseconds
+	};
+
+	// These must be called with the mutex held
+	void _Release(int iTask);
+	void _Execute(int iTask, int iThread);
+	void _Finish(int iTask, bool bSuccess);
+	bool _RunOneOnOwner();
+
+	void _WorkerLoop(int iThread);
+
+	vtString m_name;
+	std::vector<Node*> m_Tasks;
+	std::deque<int> m_Ready;		// background tasks which can run now
+	std::deque<int> m_ReadyOwner;	// owner's tasks which can run now
+	std::vector<Worker*> m_Workers;
+	bool m_bQuit;
+	osg::Timer_t m_StartTick;
+	double m_fWaited;		// time the owner spent blocked, milliseconds
+
+	OpenThreads::Mutex m_Mutex;
+	OpenThreads::Condition m_Changed;
+};
+
+/*@}*/	// Group terrain
+
+#endif	// VTLIB_TASKGRAPHH
+
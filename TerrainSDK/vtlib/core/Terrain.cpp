@@ -19,7 +19,9 @@
 #include "Fence3d.h"
 #include "ImageSprite.h"
 #include "Light.h"
+#include "ModelCache.h"
 #include "PagedLodGrid.h"
+#include "Profiler.h"
 #include "vtTin3d.h"
 
 #include "SMTerrain.h"
@@ -34,6 +36,43 @@
 //  This allows them to be culled more efficiently.
 #define LOD_GRIDSIZE		128
 
+// A task for the terrain's loader, which calls one of the terrain's loading
+//  methods on another thread.
+class vtTerrainTask : public vtTask
+{
+public:
+	typedef bool (vtTerrain::*Method)(int);
+	vtTerrainTask(vtTerrain *pTerr, Method method, int arg = 0) :
+		m_pTerr(pTerr), m_method(method), m_arg(arg) {}
+	bool Run()
+	{
+		// GetValueFloat and the file readers need the "C" numeric locale
+		ThreadLocaleC normal_numbers;
+		return (m_pTerr->*m_method)(m_arg);
+	}
+
+	vtTerrain *m_pTerr;
+	Method m_method;
+	int m_arg;
+};
+
+// Logs the wall time of a terrain creation step, when it goes out of scope.
+class StepTimer
+{
+public:
+	StepTimer(const char *name) : m_name(name)
+	{
+		m_start = osg::Timer::instance()->tick();
+	}
+	~StepTimer()
+	{
+		VTLOG("%s took %.1f ms\n", m_name, osg::Timer::instance()->delta_m(m_start,
+			osg::Timer::instance()->tick()));
+	}
+	const char *m_name;
+	osg::Timer_t m_start;
+};
+
 
 //////////////////////////////////////////////////////////////////////
 
@@ -89,12 +128,24 @@ vtTerrain::vtTerrain()
 
 	m_pExternalHeightField = NULL;
 	m_bTextureCompression = false;
+
+	m_pLoader = NULL;
+	m_iTaskContent = -1;
+	m_iTaskRoads = -1;
+	m_iTaskUtility = -1;
+	m_iTaskTexture = -1;
+	m_iTaskShade = -1;
+	m_pTextureGrid = NULL;
+	m_bTextureMade = false;
 }
 
 vtTerrain::~vtTerrain()
 {
 	VTLOG("Terrain destructing: '%s' ..", (const char *) GetName());
 
+	// If creation was abandoned, the loader may still be busy.
+	_FinishLoading();
+
 	// Remove/release the things this terrain has added to the scene.
 	m_Content.ReleaseContents();
 	m_Content.Clear();
@@ -235,28 +286,46 @@ void vtTerrain::SetTin(vtTin3d *pTin)
 
 ///////////////////////////////////////////////////////////////////////
 
-void vtTerrain::_CreateRoads()
+/**
+ * Read the road map.  This may run on a loader thread, so it doesn't touch
+ * the scene graph.
+ */
+bool vtTerrain::_LoadRoads(int)
 {
-	// for GetValueFloat below
-	ScopedLocale normal_numbers(LC_NUMERIC, "C");
-
 	vtString road_fname = "RoadData/";
 	road_fname += m_Params.GetValueString(STR_ROADFILE);
 	vtString road_path = FindFileOnPaths(vtGetDataPath(), road_fname);
 	if (road_path == "")
-		return;
+		return false;
+
+	VTLOG("Loading Roads from file '%s'\n", (const char *) road_path);
+	vtRoadMap3d *pRoadMap = new vtRoadMap3d;
+	if (!pRoadMap->ReadRMF(road_path))
+	{
+		VTLOG1("	read failed.\n");
+		delete pRoadMap;
+		return false;
+	}
+	//some nodes may not have any roads attached to them.  delete them.
+	pRoadMap->RemoveUnusedNodes();
 
-	VTLOG("Creating Roads: ");
-	m_pRoadMap = new vtRoadMap3d;
+	pRoadMap->DetermineSurfaceAppearance();
 
-	VTLOG("  Reading from file '%s'\n", (const char *) road_path);
-	bool success = m_pRoadMap->ReadRMF(road_path);
-	if (!success)
+	m_pRoadMap = pRoadMap;
+	return true;
+}
+
+void vtTerrain::_CreateRoads()
+{
+	// for GetValueFloat below
+	ScopedLocale normal_numbers(LC_NUMERIC, "C");
+
+	if (!_FinishTask(m_iTaskRoads, &vtTerrain::_LoadRoads, 0))
 	{
-		VTLOG("	read failed.\n");
 		m_pRoadMap = NULL;
 		return;
 	}
+	VTLOG1("Creating Roads.\n");
 
 	// Sanity checks: The roads might be off our terrain completely, either
 	//  from mismatched data or perhaps a wrong CRS.
@@ -269,11 +338,6 @@ void vtTerrain::_CreateRoads()
 		return;
 	}
 
-	//some nodes may not have any roads attached to them.  delete them.
-	m_pRoadMap->RemoveUnusedNodes();
-
-	m_pRoadMap->DetermineSurfaceAppearance();
-
 	m_pRoadMap->SetHeightOffGround(m_Params.GetValueFloat(STR_ROADHEIGHT));
 	m_pRoadMap->DrapeOnTerrain(m_pHeightField);
 	m_pRoadMap->ComputeIntersectionVertices();
@@ -462,6 +526,10 @@ bool vtTerrain::_CreateDynamicTerrain()
 		return false;
 	}
 
+	// The texture has been made in the background while the CLOD was
+	//  initializing; we need its materials now.
+	_WaitForTexture();
+
 	//
 	// This is a hack to allow a transparent terrain surface.
 	//  In order for OSG to draw the transparent surface correctly, it needs
@@ -942,7 +1010,9 @@ void vtTerrain::DeselectAllStructures()
 /**
  * Loads an external 3D model as a movable node.  The file will be looked for
  * on the Terrain's data path, and wrapped with a vtTransform so that it can
- * be moved.
+ * be moved.  The model itself comes from the global vtModelCache, so it is
+ * shared with any other terrains that load the same file; pass bAllowCache
+ * false to load a copy of your own from disk.
  *
  * To add the model to the Terrain's scene graph, use <b>AddModel</b> or
  * <b>AddModelToLodGrid</b>.  To plant the model on the terrain, use
@@ -974,7 +1044,8 @@ vtTransform *vtTerrain::LoadModel(const char *filename, bool bAllowCache)
 		VTLOG("Couldn't locate file '%s'\n", filename);
 		return NULL;
 	}
-	NodePtr node = vtLoadModel(path, bAllowCache);
+	// Share the model with any other terrains which use it
+	NodePtr node = vtGetModelCache()->Load(path, !bAllowCache);
 	if (node.valid())
 	{
 		vtTransform *trans = new vtTransform;
@@ -1022,19 +1093,25 @@ void vtTerrain::PlantModelAtPoint(vtTransform *model, const DPoint2 &pos)
 	model->SetTrans(wpos);
 }
 
+/**
+ * Read the utility (power line) file.  This may run on a loader thread.
+ */
+bool vtTerrain::_LoadUtilityMap(int)
+{
+	vtString util_file = m_Params.GetValueString(STR_UTILITY_FILE);
+	if (util_file == "" || !m_UtilityMap.ReadOSM(util_file))
+		return false;
+	m_UtilityMap.TransformTo(m_proj);
+	return true;
+}
+
 void vtTerrain::_CreateOtherCulture()
 {
 	m_pTerrainGroup->addChild(m_UtilityMap.Setup());
 
 	// create utility structures (routes = towers and wires)
-	vtString util_file = m_Params.GetValueString(STR_UTILITY_FILE);
-	if (util_file != "")
-	{
-		if (m_UtilityMap.ReadOSM(util_file))
-		{
-			m_UtilityMap.TransformTo(m_proj);
-		}
-	}
+	if (m_Params.GetValueString(STR_UTILITY_FILE) != "")
+		_FinishTask(m_iTaskUtility, &vtTerrain::_LoadUtilityMap, 0);
 
 	// create any utility geometry
 	m_UtilityMap.ComputePoleStructures();
@@ -1103,37 +1180,51 @@ void vtTerrain::_CreateVegetation()
 		if (m_Params.GetLayerType(i) != LT_VEG)
 			continue;
 
-		const vtTagArray &tags = m_Params.m_Layers[i];
-
 		VTLOG(" Layer %d: Vegetation\n", i);
-		vtString fname = tags.GetValueString("Filename");
-
-		// Read the VF file
-		vtString plants_fname = "PlantData/";
-		plants_fname += fname;
+		if (!_FinishTask(_LayerTask(i), &vtTerrain::_LoadVegLayer, i))
+			continue;
 
-		VTLOG("\tLooking for plants file: %s\n", (const char *) plants_fname);
+		// The plants were read against the elevation grid; place them on
+		//  the runtime heightfield.
+		vtVegLayer *v_layer = dynamic_cast<vtVegLayer*>(m_LoadedLayers[i].get());
+		v_layer->SetHeightField(m_pHeightField);
+		m_Layers.push_back(v_layer);
+		m_LoadedLayers[i] = NULL;
 
-		vtString plants_path = FindFileOnPaths(vtGetDataPath(), plants_fname);
-		if (plants_path == "")
-		{
-			VTLOG1("\tNot found.\n");
-			continue;
-		}
-		VTLOG("\tFound: %s\n", (const char *) plants_path);
+		_CreateVegetationNodes(v_layer);
 
-		vtVegLayer *v_layer = LoadVegetation(plants_path);
-		if (v_layer)
-		{
-			// If the user wants it to start hidden, hide it
-			bool bVisible;
-			if (tags.GetValueBool("visible", bVisible))
-				v_layer->SetEnabled(bVisible);
-		}
+		// If the user wants it to start hidden, hide it
+		bool bVisible;
+		if (m_Params.m_Layers[i].GetValueBool("visible", bVisible))
+			v_layer->SetEnabled(bVisible);
 	}
 	VTLOG(" Vegetation: %.3f seconds.\n", (float)(clock() - r1) / CLOCKS_PER_SEC);
 }
 
+/**
+ * Read the plants of a vegetation layer.  This may run on a loader thread.
+ */
+bool vtTerrain::_LoadVegLayer(int iLayer)
+{
+	vtString plants_fname = "PlantData/";
+	plants_fname += m_Params.m_Layers[iLayer].GetValueString("Filename");
+
+	VTLOG("\tLooking for plants file: %s\n", (const char *) plants_fname);
+
+	vtString plants_path = FindFileOnPaths(vtGetDataPath(), plants_fname);
+	if (plants_path == "")
+	{
+		VTLOG1("\tNot found.\n");
+		return false;
+	}
+	VTLOG("\tFound: %s\n", (const char *) plants_path);
+
+	if (m_LoadedLayers.size() < m_Params.NumLayers())
+		m_LoadedLayers.resize(m_Params.NumLayers());
+	m_LoadedLayers[iLayer] = _ReadVegetation(plants_path);
+	return (m_LoadedLayers[iLayer] != NULL);
+}
+
 //
 // Create an LOD grid to contain and efficiently hide stuff that's far away
 //
@@ -1169,31 +1260,66 @@ void vtTerrain::_SetupStructGrid(float fLODDistance)
 	m_pTerrainGroup->addChild(m_pStructGrid);
 }
 
+/**
+ * Read the terrain-specific content file.  This may run on a loader thread.
+ */
+bool vtTerrain::_LoadContent(int)
+{
+	vtString con_file = m_Params.GetValueString(STR_CONTENT_FILE);
+	VTLOG(" Looking for terrain-specific content file: '%s'\n", (const char *) con_file);
+	vtString fname = FindFileOnPaths(vtGetDataPath(), con_file);
+	if (fname == "")
+	{
+		VTLOG("  Not found.\n");
+		return true;
+	}
+	VTLOG("  Found.\n");
+	try
+	{
+		m_Content.ReadXML(fname);
+	}
+	catch (xh_io_exception &ex)
+	{
+		// display (or a least log) error message here
+		VTLOG("  XML error:");
+		VTLOG(ex.getFormattedMessage().c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Read the structures of a structure layer.  This may run on a loader thread.
+ */
+bool vtTerrain::_LoadStructureLayer(int iLayer)
+{
+	vtStructureLayer *st_layer = new vtStructureLayer;
+
+	// these structures will use the heightfield and projection of this terrain
+	st_layer->SetTerrain(this);
+	st_layer->m_proj = m_proj;
+	st_layer->SetProps(m_Params.m_Layers[iLayer]);
+
+	if (m_LoadedLayers.size() < m_Params.NumLayers())
+		m_LoadedLayers.resize(m_Params.NumLayers());
+	m_LoadedLayers[iLayer] = st_layer;	// takes ownership
+
+	if (!st_layer->Load(m_pLoader ? NULL : m_progress_callback))
+	{
+		VTLOG("\tCouldn't load structures.\n");
+		m_LoadedLayers[iLayer] = NULL;
+		return false;
+	}
+	return true;
+}
+
 void vtTerrain::_CreateStructures()
 {
 	// Read terrain-specific content file
-	vtString con_file = m_Params.GetValueString(STR_CONTENT_FILE);
-	if (con_file != "")
+	if (m_Params.GetValueString(STR_CONTENT_FILE) != "")
 	{
-		VTLOG(" Looking for terrain-specific content file: '%s'\n", (const char *) con_file);
-		vtString fname = FindFileOnPaths(vtGetDataPath(), con_file);
-		if (fname != "")
-		{
-			VTLOG("  Found.\n");
-			try
-			{
-				m_Content.ReadXML(fname);
-			}
-			catch (xh_io_exception &ex)
-			{
-				// display (or a least log) error message here
-				VTLOG("  XML error:");
-				VTLOG(ex.getFormattedMessage().c_str());
-				return;
-			}
-		}
-		else
-			VTLOG("  Not found.\n");
+		if (!_FinishTask(m_iTaskContent, &vtTerrain::_LoadContent, 0))
+			return;
 	}
 
 	// Always create a LOD grid for structures, as the user might create some
@@ -1211,21 +1337,23 @@ void vtTerrain::_CreateStructures()
 			continue;
 
 		VTLOG(" Layer %d: Structure\n", i);
-
-		vtStructureLayer *st_layer = NewStructureLayer();
-		st_layer->SetProps(m_Params.m_Layers[i]);
-		if (!st_layer->Load(m_progress_callback))
+		if (_FinishTask(_LayerTask(i), &vtTerrain::_LoadStructureLayer, i))
 		{
-			VTLOG("\tCouldn't load structures.\n");
-			// Removing the layer deletes it, by dereference.
-			m_Layers.Remove(st_layer);
+			m_Layers.push_back(m_LoadedLayers[i]);
+			m_LoadedLayers[i] = NULL;
 		}
 	}
 	for (uint i = 0; i < m_Layers.size(); i++)
 	{
 		vtStructureLayer *slay = dynamic_cast<vtStructureLayer*>(m_Layers[i].get());
 		if (slay)
+		{
 			CreateStructures(slay);
+
+			// Now that the layer is ours, on this thread, and the structure
+			//  grid exists
+			slay->SetVisibleFromProps();
+		}
 	}
 }
 
@@ -1255,23 +1383,39 @@ bool vtTerrain::_CreateAbstractLayerFromParams(int index)
 		VTLOG("   Tag '%s': '%s'\n", (const char *)tag->name, (const char *)tag->value);
 	}
 
-	vtAbstractLayer *ab_layer = new vtAbstractLayer;
+	if (!_FinishTask(_LayerTask(index), &vtTerrain::_LoadAbstractLayer, index))
+		return false;
 
-	// Copy all the properties from params to the new layer
-	VTLOG1("  Setting layer properties.\n");
-	ab_layer->SetProps(lay);
+	vtAbstractLayer *ab_layer = dynamic_cast<vtAbstractLayer*>(m_LoadedLayers[index].get());
 	m_Layers.push_back(ab_layer);
+	m_LoadedLayers[index] = NULL;
 
 	// Abstract geometry goes into the scale features group, so it will be
 	//  scaled up/down with the vertical exaggeration.
-	bool success = ab_layer->Load(GetProjection(), NULL, m_progress_callback);
-	if (!success)
+	CreateAbstractLayerVisuals(ab_layer);
+	return true;
+}
+
+/**
+ * Read the features of an abstract layer.  This may run on a loader thread.
+ */
+bool vtTerrain::_LoadAbstractLayer(int iLayer)
+{
+	vtAbstractLayer *ab_layer = new vtAbstractLayer;
+
+	// Copy all the properties from params to the new layer
+	VTLOG1("  Setting layer properties.\n");
+	ab_layer->SetProps(m_Params.m_Layers[iLayer]);
+
+	if (m_LoadedLayers.size() < m_Params.NumLayers())
+		m_LoadedLayers.resize(m_Params.NumLayers());
+	m_LoadedLayers[iLayer] = ab_layer;	// takes ownership
+
+	if (!ab_layer->Load(GetProjection(), NULL, m_pLoader ? NULL : m_progress_callback))
 	{
-		m_Layers.Remove(ab_layer);
+		m_LoadedLayers[iLayer] = NULL;
 		return false;
 	}
-
-	CreateAbstractLayerVisuals(ab_layer);
 	return true;
 }
 
@@ -1641,7 +1785,19 @@ void vtTerrain::CreateStep1()
 bool vtTerrain::CreateStep2()
 {
 	VTLOG1("Step2\n");
+	StepTimer timer("Step2");
+
+	if (!_LoadElevation())
+		return false;
+
+	// Now that we know the CRS, the culture can be read while the surface
+	//  is being built.
+	_StartLoading();
+	return true;
+}
 
+bool vtTerrain::_LoadElevation()
+{
 	// for GetValueFloat below
 	ScopedLocale normal_numbers(LC_NUMERIC, "C");
 
@@ -1798,6 +1954,9 @@ bool vtTerrain::CreateStep2()
 		int tile_cache_mb = m_Params.GetValueInt(STR_TILE_CACHE_SIZE);
 		//m_pTiledGeom->SetTileCacheSize(tile_cache_mb * 1024 * 1024);
 
+		// time per frame the render thread may spend uploading paged tiles
+		m_pTiledGeom->SetUploadTime(m_Params.GetValueFloat(STR_TILE_UPLOAD_TIME));
+
 		bool bThread = m_Params.GetValueBool(STR_TILE_THREADING);
 		bool bGradual = m_Params.GetValueBool(STR_TEXTURE_GRADUAL);
 		bool status = m_pTiledGeom->ReadTileList(elev_path, tex_path,
@@ -1843,6 +2002,7 @@ bool vtTerrain::CreateStep2()
 bool vtTerrain::CreateStep3(vtTransform *pSunLight, vtLightSource *pLightSource)
 {
 	VTLOG1("Step3\n");
+	StepTimer timer("Step3");
 
 	// Remember the lightsource in case we need it later for shadows
 	m_pLightSource = pLightSource;
@@ -1854,19 +2014,24 @@ bool vtTerrain::CreateStep3(vtTransform *pSunLight, vtLightSource *pLightSource)
 	int type = m_Params.GetValueInt(STR_SURFACE_TYPE);
 	if (type == 0)		// Single grid
 	{
-		// measure total texture processing time
-		clock_t c1 = clock();
-
-		bool success = m_Texture.MakeTexture(m_Params, GetHeightFieldGrid3d(),
-			m_bTextureCompression, m_progress_callback);
-
-		if (success)
+		m_pTextureGrid = GetHeightFieldGrid3d();
+		m_SunDirection = pSunLight->GetDirection();
+		if (m_pLoader)
 		{
-			m_Texture.ShadeTexture(m_Params, GetHeightFieldGrid3d(), pSunLight->GetDirection(),
-				m_progress_callback);
-
-			// The terrain's base texture will always use unit 0
-			m_TextureUnits.ReserveTextureUnit();
+			// Make the texture in the background; the CLOD surface, which
+			//  is built next, only needs it at the end.
+			m_iTaskTexture = m_pLoader->AddTask("texture",
+				new vtTerrainTask(this, &vtTerrain::_MakeTexture));
+			m_iTaskShade = m_pLoader->AddTask("texture shading",
+				new vtTerrainTask(this, &vtTerrain::_ShadeTexture));
+			m_pLoader->AddDependency(m_iTaskShade, m_iTaskTexture);
+			m_pLoader->Start();
+		}
+		else
+		{
+			if (_MakeTexture(0))
+				_ShadeTexture(0);
+			_WaitForTexture();
 		}
 	}
 	if (type == 1)	// TIN
@@ -1889,6 +2054,7 @@ bool vtTerrain::CreateStep3(vtTransform *pSunLight, vtLightSource *pLightSource)
 bool vtTerrain::CreateStep4()
 {
 	VTLOG1("Step4\n");
+	StepTimer timer("Step4");
 
 	// if we aren't going to produce the terrain surface, nothing to do
 	if (m_Params.GetValueBool(STR_SUPPRESS))
@@ -1968,6 +2134,10 @@ bool vtTerrain::CreateFromExternal()
 bool vtTerrain::CreateStep5()
 {
 	VTLOG1("Step5\n");
+	StepTimer timer("Step5");
+
+	// In case the surface didn't need it, don't leave the texture unfinished
+	_WaitForTexture();
 
 	// some algorithms need an additional stage of initialization
 	if (m_pDynGeom != NULL)
@@ -1994,6 +2164,7 @@ bool vtTerrain::CreateStep5()
 void vtTerrain::CreateStep6()
 {
 	VTLOG1("Step6\n");
+	StepTimer timer("Step6");
 
 	// must have a heightfield by this point
 	if (!m_pHeightField)
@@ -2012,6 +2183,7 @@ void vtTerrain::CreateStep6()
 void vtTerrain::CreateStep7()
 {
 	VTLOG1("Step7\n");
+	StepTimer timer("Step7");
 
 	// create roads
 	if (m_Params.GetValueBool(STR_ROADS))
@@ -2021,6 +2193,7 @@ void vtTerrain::CreateStep7()
 void vtTerrain::CreateStep8()
 {
 	VTLOG1("Step8\n");
+	StepTimer timer("Step8");
 
 	_CreateVegetation();
 }
@@ -2028,6 +2201,7 @@ void vtTerrain::CreateStep8()
 void vtTerrain::CreateStep9()
 {
 	VTLOG1("Step9\n");
+	StepTimer timer("Step9");
 
 	_CreateOtherCulture();
 
@@ -2052,6 +2226,7 @@ void vtTerrain::CreateStep9()
 void vtTerrain::CreateStep10()
 {
 	VTLOG1("Step10\n");
+	StepTimer timer("Step10");
 
 	_CreateAbstractLayersFromParams();
 }
@@ -2059,6 +2234,7 @@ void vtTerrain::CreateStep10()
 void vtTerrain::CreateStep11()
 {
 	VTLOG1("Step11\n");
+	StepTimer timer("Step11");
 
 	CreateImageLayers();
 }
@@ -2066,6 +2242,7 @@ void vtTerrain::CreateStep11()
 void vtTerrain::CreateStep12()
 {
 	VTLOG1("Step12\n");
+	StepTimer timer("Step12");
 
 	_CreateElevLayers();
 
@@ -2124,6 +2301,143 @@ void vtTerrain::CreateStep12()
 		entry.m_Name = fname1;
 		m_AnimContainer.AppendEntry(entry);
 	}
+
+	// Everything the loader read has been used by now.
+	_FinishLoading();
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Loading in the background
+//
+// Once the elevation is loaded, everything else that comes from disk
+//  (content, structures, plants, roads, utilities, abstract features and
+//  the texture) is read by a task graph on other threads.  Those tasks
+//  don't touch the scene graph.  The creation steps, which do, wait for
+//  the tasks they need on the main thread, then build the 3D nodes from
+//  the data that was loaded.
+
+void vtTerrain::_StartLoading()
+{
+	m_pLoader = new vtTaskGraph(GetName());
+
+	const uint iLayers = m_Params.NumLayers();
+	m_LayerTasks.clear();
+	m_LayerTasks.resize(iLayers, -1);
+	m_LoadedLayers.clear();
+	m_LoadedLayers.resize(iLayers);
+
+	if (m_Params.GetValueString(STR_CONTENT_FILE) != "")
+		m_iTaskContent = m_pLoader->AddTask("content",
+			new vtTerrainTask(this, &vtTerrain::_LoadContent));
+
+	bool bStructures = false;
+	for (uint i = 0; i < iLayers; i++)
+	{
+		vtString name = m_Params.m_Layers[i].GetValueString("Filename");
+		switch (m_Params.GetLayerType(i))
+		{
+		case LT_STRUCTURE:
+			m_LayerTasks[i] = m_pLoader->AddTask(name,
+				new vtTerrainTask(this, &vtTerrain::_LoadStructureLayer, i));
+			// Structures may refer to the content
+			if (m_iTaskContent != -1)
+				m_pLoader->AddDependency(m_LayerTasks[i], m_iTaskContent);
+			bStructures = true;
+			break;
+		case LT_VEG:
+			m_LayerTasks[i] = m_pLoader->AddTask(name,
+				new vtTerrainTask(this, &vtTerrain::_LoadVegLayer, i));
+			break;
+		case LT_RAW:
+			m_LayerTasks[i] = m_pLoader->AddTask(name,
+				new vtTerrainTask(this, &vtTerrain::_LoadAbstractLayer, i));
+			break;
+		default:
+			break;
+		}
+	}
+	if (m_Params.GetValueBool(STR_ROADS))
+		m_iTaskRoads = m_pLoader->AddTask("roads",
+			new vtTerrainTask(this, &vtTerrain::_LoadRoads));
+	if (m_Params.GetValueString(STR_UTILITY_FILE) != "")
+		m_iTaskUtility = m_pLoader->AddTask("utilities",
+			new vtTerrainTask(this, &vtTerrain::_LoadUtilityMap));
+
+	// The global structure materials are shared, so make them before any
+	//  structures are read.
+	if (bStructures)
+		vtStructure3d::InitializeMaterialArrays();
+
+	m_pLoader->Start();
+	VTLOG("Loading %d items on %d threads.\n", m_pLoader->NumTasks(),
+		m_pLoader->NumThreads());
+}
+
+void vtTerrain::_FinishLoading()
+{
+	if (!m_pLoader)
+		return;
+
+	m_pLoader->WaitAll();
+	m_pLoader->LogTimes();
+	delete m_pLoader;
+	m_pLoader = NULL;
+
+	m_LayerTasks.clear();
+	m_LoadedLayers.clear();
+	m_iTaskContent = m_iTaskRoads = m_iTaskUtility = -1;
+	m_iTaskTexture = m_iTaskShade = -1;
+}
+
+int vtTerrain::_LayerTask(uint iLayer) const
+{
+	if (iLayer < m_LayerTasks.size())
+		return m_LayerTasks[iLayer];
+	return -1;
+}
+
+/**
+ * Wait for a loading task to finish.  If there is no loader, or the task
+ * was never added to it, do the loading right now on this thread instead.
+ */
+bool vtTerrain::_FinishTask(int iTask, LoadMethod method, int arg)
+{
+	if (m_pLoader && iTask != -1)
+		return m_pLoader->Wait(iTask);
+	ScopedLocale normal_numbers(LC_NUMERIC, "C");
+	return (this->*method)(arg);
+}
+
+void vtTerrain::_WaitForTexture()
+{
+	if (m_pLoader && m_iTaskShade != -1)
+	{
+		// If making the texture failed, the shading fails without running
+		m_pLoader->Wait(m_iTaskShade);
+		m_iTaskTexture = m_iTaskShade = -1;
+	}
+
+	// The terrain's base texture will always use unit 0
+	if (m_bTextureMade)
+	{
+		m_TextureUnits.ReserveTextureUnit();
+		m_bTextureMade = false;
+	}
+}
+
+bool vtTerrain::_MakeTexture(int)
+{
+	m_bTextureMade = m_Texture.MakeTexture(m_Params, m_pTextureGrid,
+		m_bTextureCompression, m_pLoader ? NULL : m_progress_callback);
+	return m_bTextureMade;
+}
+
+bool vtTerrain::_ShadeTexture(int)
+{
+	m_Texture.ShadeTexture(m_Params, m_pTextureGrid, m_SunDirection,
+		m_pLoader ? NULL : m_progress_callback);
+	return true;
 }
 
 void vtTerrain::SetProgressCallback(ProgFuncPtrType progress_callback)
@@ -2541,23 +2855,41 @@ vtVegLayer *vtTerrain::NewVegLayer()
 
 vtVegLayer *vtTerrain::LoadVegetation(const vtString &fname)
 {
-	vtVegLayer *v_layer = NewVegLayer();
+	vtVegLayer *v_layer = _ReadVegetation(fname);
+	if (!v_layer)
+		return NULL;
+
+	v_layer->SetHeightField(m_pHeightField);
+	m_Layers.push_back(v_layer);
+	_CreateVegetationNodes(v_layer);
+	return v_layer;
+}
+
+// Read a plants file into a new layer, which is not yet part of the terrain.
+//  This doesn't touch the scene graph, so it may run on a loader thread.
+vtVegLayer *vtTerrain::_ReadVegetation(const vtString &fname)
+{
+	osg::ref_ptr<vtVegLayer> v_layer = new vtVegLayer;
+	v_layer->SetSpeciesList(m_pSpeciesList);
+	v_layer->SetProjection(m_proj);
+
 	bool success;
 	if (!fname.Right(3).CompareNoCase("shp"))
 		success = v_layer->ReadSHP(fname);
 	else
 		success = v_layer->ReadVF(fname);
-	if (success)
-	{
-		VTLOG("\tLoaded plants file, %d plants.\n", v_layer->NumEntities());
-		v_layer->SetFilename(fname);
-	}
-	else
+	if (!success)
 	{
 		VTLOG1("\tCouldn't load plants file.\n");
 		return NULL;
 	}
+	VTLOG("\tLoaded plants file, %d plants.\n", v_layer->NumEntities());
+	v_layer->SetFilename(fname);
+	return v_layer.release();
+}
 
+void vtTerrain::_CreateVegetationNodes(vtVegLayer *v_layer)
+{
 	// Create the 3d plants
 	VTLOG1(" Creating Plant geometry..\n");
 	if (m_Params.GetValueBool(STR_TREES_USE_SHADERS))
@@ -2584,7 +2916,6 @@ vtVegLayer *vtTerrain::LoadVegetation(const vtString &fname)
 				AddNodeToVegGrid(pTrans);
 		}
 	}
-	return v_layer;
 }
 
 /**
@@ -2776,6 +3107,7 @@ int vtTerrain::DoStructurePaging()
 	if (!m_pPagedStructGrid)
 		return 0;
 
+	VTPROFILE("Structure paging");
 	vtCamera *cam = vtGetScene()->GetCamera();
 	FPoint3 CamPos = cam->GetTrans();
 
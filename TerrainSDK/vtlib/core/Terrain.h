@@ -20,6 +20,7 @@
 #include "Plants3d.h"	// for vtSpeciesList3d, vtPlantInstanceArray3d
 #include "Roads.h"
 #include "SurfaceTexture.h"
+#include "TaskGraph.h"
 #include "TextureUnitManager.h"
 #include "TiledGeom.h"
 #include "TParams.h"
@@ -394,6 +395,25 @@ protected:
 	bool _CreateDynamicTerrain();
 	void _CreateErrorMessage(DTErr error, vtElevationGrid *pGrid);
 	void _SetErrorMessage(const vtString &msg);
+	bool _LoadElevation();
+	vtVegLayer *_ReadVegetation(const vtString &fname);
+	void _CreateVegetationNodes(vtVegLayer *v_layer);
+
+	// Loading of data in the background, during terrain creation
+	typedef bool (vtTerrain::*LoadMethod)(int);
+	void _StartLoading();
+	void _FinishLoading();
+	int _LayerTask(uint iLayer) const;
+	bool _FinishTask(int iTask, LoadMethod method, int arg);
+	void _WaitForTexture();
+	bool _LoadContent(int);
+	bool _LoadStructureLayer(int iLayer);
+	bool _LoadVegLayer(int iLayer);
+	bool _LoadAbstractLayer(int iLayer);
+	bool _LoadRoads(int);
+	bool _LoadUtilityMap(int);
+	bool _MakeTexture(int);
+	bool _ShadeTexture(int);
 
 	void CreateWaterPlane();
 	void MakeWaterMaterial();
@@ -497,6 +517,21 @@ protected:
 	// only used during initialization
 	auto_ptr<vtElevationGrid>	m_pElevGrid;
 
+	// Loading which runs on other threads during initialization.  Layers
+	//  are kept in m_LoadedLayers, by index of the layer in m_Params, until
+	//  the creation step for them adds them to the terrain.
+	vtTaskGraph		*m_pLoader;
+	int				m_iTaskContent;
+	int				m_iTaskRoads;
+	int				m_iTaskUtility;
+	int				m_iTaskTexture;
+	int				m_iTaskShade;
+	std::vector<int>	m_LayerTasks;
+	std::vector<vtLayerPtr>	m_LoadedLayers;
+	const vtHeightFieldGrid3d *m_pTextureGrid;
+	FPoint3			m_SunDirection;
+	bool			m_bTextureMade;
+
 	// A useful value for computing "local time", the location of the
 	//  center of the terrain in Geographic coords.
 	DPoint2			m_CenterGeoLocation;
@@ -27,7 +27,9 @@ vtStructureLayer::vtStructureLayer() : vtLayer(LT_STRUCTURE)
 }
 
 /**
- * Attempt to load structures from its VTST file.
+ * Attempt to load structures from its VTST file.  This doesn't touch the
+ * scene graph, so it may be called on another thread; the layer's
+ * "visible" property is applied afterwards, by SetVisibleFromProps.
  */
 bool vtStructureLayer::Load(bool progress_callback(int))
 {
@@ -55,12 +57,17 @@ bool vtStructureLayer::Load(bool progress_callback(int))
 	if (!ReadXML(building_path, progress_callback))
 		return false;
 
-	// If the user wants it to start hidden, hide it
+	return true;
+}
+
+/**
+ * If the user wants the layer to start hidden, hide it.
+ */
+void vtStructureLayer::SetVisibleFromProps()
+{
 	bool bVisible;
 	if (m_Props.GetValueBool("visible", bVisible))
 		SetEnabled(bVisible);
-
-	return true;
 }
 
 void vtStructureLayer::SetLayerName(const vtString &fname)
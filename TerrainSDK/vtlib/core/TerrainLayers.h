@@ -50,6 +50,7 @@ public:
 	vtStructureLayer();
 
 	bool Load(bool progress_callback(int) = NULL);
+	void SetVisibleFromProps();
 
 	void SetLayerName(const vtString &fname);
 	vtString GetLayerName() { return GetFilename(); }
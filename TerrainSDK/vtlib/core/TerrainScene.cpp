@@ -14,6 +14,7 @@
 #include "Terrain.h"
 #include "TimeEngines.h"
 #include "LodGrid.h"
+#include "ModelCache.h"
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -86,6 +87,7 @@ void vtTerrainScene::CleanupScene()
 
 	m_Content.ReleaseContents();
 	m_Content.Clear();
+	vtGetModelCache()->Clear();
 
 	SetCurrentTerrain(NULL);
 
@@ -9,6 +9,8 @@
 #include "vtdata/FilePath.h"
 #include "vtdata/vtLog.h"
 #include "vtdata/TripDub.h"
+#include "minidata/TilePack.h"
+#include "Profiler.h"
 #include "TiledGeom.h"
 
 #include <mini/mini.h>
@@ -279,6 +281,21 @@ int file_exists(const char *filename)
 	return(1);
 }
 
+// open the packed form of a tileset folder, if there is one
+static vtTilePack *OpenTilePack(const vtString &folder)
+{
+	vtString fname = folder + TILEPACK_EXTENSION;
+	if (!vtFileExists(fname))
+		return NULL;
+	vtTilePack *pack = new vtTilePack;
+	if (!pack->Open(fname))
+	{
+		delete pack;
+		return NULL;
+	}
+	return pack;
+}
+
 ///////////////////////////////////////////////////////////////////////
 
 int request_callback(int col,int row,const uchar *mapfile,int hlod,
@@ -375,8 +392,8 @@ void request_callback_async(const uchar *mapfile, databuf *map,
 ////			map->loaddataJPEG(fname);
 //			map->loaddata(fname);
 //		}
-		// normal disk load
-		map->loaddata((char *)mapfile);
+		// normal disk load, or from the tile pack
+		tg->LoadTile((char *)mapfile, *map);
 	}
 	if (tg->m_progress_callback != NULL)
 	{
@@ -452,6 +469,7 @@ vtTiledGeom::vtTiledGeom()
 	m_fHResolution = 2 * m_fResolution;
 	m_fLResolution = TILEDGEOM_RESOLUTION_MIN;
 	m_bNeedResolutionAdjust = false;
+	m_fUploadTime = 10.0f;
 
 	m_iFrame = 0;
 	m_iTileLoads = 0;
@@ -466,6 +484,8 @@ vtTiledGeom::vtTiledGeom()
 	m_pPlainMaterial->SetLighting(true);
 
 	m_pReqContext = NULL;
+	m_pPackElev = NULL;
+	m_pPackImage = NULL;
 
 	// register libMini conversion hook (JPEG/PNG)
 	InitMiniConvHook();
@@ -489,6 +509,8 @@ vtTiledGeom::~vtTiledGeom()
 	delete m_pMiniLoad;
 	delete m_pPlainMaterial;
 	delete m_pReqContext;
+	delete m_pPackElev;
+	delete m_pPackImage;
 }
 
 bool vtTiledGeom::ReadTileList(const char *dataset_fname_elev,
@@ -532,6 +554,10 @@ bool vtTiledGeom::ReadTileList(const char *dataset_fname_elev,
 	m_folder_image = dataset_fname_image;
 	RemoveFileExtensions(m_folder_image);
 
+	// If the tilesets have been packed into single files, read from those
+	m_pPackElev = OpenTilePack(m_folder_elev);
+	m_pPackImage = OpenTilePack(m_folder_image);
+
 	hfields = new ucharptr[cols*rows];
 	textures = new ucharptr[cols*rows];
 	vtString str, str2;
@@ -553,6 +579,8 @@ bool vtTiledGeom::ReadTileList(const char *dataset_fname_elev,
 				if (mmin > 0)
 					elev_exists = true;
 			}
+			else if (m_pPackElev)
+				elev_exists = m_pPackElev->HasTile(i, j, 0);
 			else
 			{
 				// we don't already know, so we must test file existence
@@ -584,6 +612,8 @@ bool vtTiledGeom::ReadTileList(const char *dataset_fname_elev,
 				if (mmin > 0)
 					image_exists = true;
 			}
+			else if (m_pPackImage)
+				image_exists = m_pPackImage->HasTile(i, j, 0);
 			else
 			{
 				// we don't already know, so we must test file existence
@@ -781,8 +811,17 @@ void vtTiledGeom::SetupMiniLoad(bool bThreading, bool bGradual)
 		// optional callback for better paging performance
 		m_pDataCloud->setquery(query_callback, this);
 
-		// upload for 10ms and keep for 18 seconds (0.3 minutes)
-		m_pDataCloud->setschedule(0.01, 0.3);
+		// Upload for m_fUploadTime ms per frame and keep for 18 seconds
+		//  (0.3 minutes).  The tiles are decoded into their final buffers on
+		//  the loader thread, so what's left on the render thread is the
+		//  texture upload itself; a smaller budget spreads it over more frames.
+		//
+		// The upload (glTexImage2D) is done inside libMini: miniload hands
+		//  the delivered databuf to miniOGL, which creates and owns the
+		//  texture object.  There is no hook to give it a pixel buffer object
+		//  or a texture id of our own, so uploading from mapped PBOs would
+		//  need a change to libMini; this budget is what we can control.
+		m_pDataCloud->setschedule(m_fUploadTime / 1000.0f, 0.3);
 
 		// allow 512 MB tile cache size?
 	//	m_pDataCloud->setmaxsize(512.0);
@@ -811,6 +850,18 @@ void vtTiledGeom::SetupMiniLoad(bool bThreading, bool bGradual)
 	VTLOG1(" SetupMiniLoad finished.\n");
 }
 
+/**
+ * Set how much time (in milliseconds) the render thread may spend each frame
+ * passing newly loaded tiles to OpenGL, when using threaded paging.  Lower
+ * values avoid frame spikes, at the cost of tiles appearing more slowly.
+ */
+void vtTiledGeom::SetUploadTime(float fMilliseconds)
+{
+	m_fUploadTime = fMilliseconds;
+	if (m_pDataCloud)
+		m_pDataCloud->setschedule(m_fUploadTime / 1000.0f, 0.3);
+}
+
 void vtTiledGeom::SetPagingRange(float val)
 {
 	prange = val;
@@ -837,11 +888,47 @@ databuf vtTiledGeom::FetchTile(const char *fname)
 	m_iTileLoads++;
 
 	// Load data buffer directly
-	result.loaddata(fname);
+	LoadTile(fname, result);
 
 	return result;
 }
 
+/**
+ * Load a tile into a data buffer, from the tile pack if there is one,
+ * otherwise from its own file.
+ */
+bool vtTiledGeom::LoadTile(const char *fname, databuf &buf)
+{
+	vtTilePack *pack = GetPackForFile(fname);
+	if (pack)
+	{
+		// The folder is packed, so there is no loose file to fall back on
+		int col, row, lod;
+		if (vtTilePack::ParseTileName(fname, col, row, lod) &&
+			pack->LoadTile(col, row, lod, buf))
+			return true;
+		VTLOG("Couldn't load tile '%s' from its pack.\n", fname);
+		return false;
+	}
+
+	buf.loaddata(fname);
+	return (buf.data != NULL);
+}
+
+vtTilePack *vtTiledGeom::GetPackForFile(const char *fname) const
+{
+	// Tile filenames are always "<folder>/tile.c-r.db<lod>"
+	const int len_image = m_folder_image.GetLength();
+	if (m_pPackImage && !strncmp(fname, m_folder_image, len_image) &&
+		fname[len_image] == '/')
+		return m_pPackImage;
+	const int len_elev = m_folder_elev.GetLength();
+	if (m_pPackElev && !strncmp(fname, m_folder_elev, len_elev) &&
+		fname[len_elev] == '/')
+		return m_pPackElev;
+	return NULL;
+}
+
 bool vtTiledGeom::CheckMapFile(const char *mapfile, bool bIsTexture)
 {
 	// we don't need to check file existence if we already know which LODs exist
@@ -873,7 +960,13 @@ bool vtTiledGeom::CheckMapFile(const char *mapfile, bool bIsTexture)
 	}
 	else
 	{
-		// no lod info, must check file
+		// no lod info, but the pack index knows without touching the disk
+		vtTilePack *pack = GetPackForFile(mapfile);
+		int col, row, lod;
+		if (pack && vtTilePack::ParseTileName(mapfile, col, row, lod))
+			return pack->HasTile(col, row, lod);
+
+		// must check file
 		return (file_exists((char *)mapfile) != 0);
 	}
 	return false;
@@ -920,13 +1013,17 @@ void vtTiledGeom::DoRender()
 #if USE_VERTEX_CACHE
 	m_pMiniCache->makecurrent();
 #endif
-	m_pMiniLoad->draw(m_fResolution,
-				m_eyepos_ogl.x, m_eyepos_ogl.y, m_eyepos_ogl.z,
-				eye_forward.x, eye_forward.y, eye_forward.z,
-				eye_up.x, eye_up.y, eye_up.z,
-				m_fFOVY, m_fAspect,
-				m_fNear, m_fFar,
-				fpu);
+	{
+		// This is where libMini pages tiles in and out, and updates the mesh
+		VTPROFILE("Tile paging");
+		m_pMiniLoad->draw(m_fResolution,
+					m_eyepos_ogl.x, m_eyepos_ogl.y, m_eyepos_ogl.z,
+					eye_forward.x, eye_forward.y, eye_forward.z,
+					eye_up.x, eye_up.y, eye_up.z,
+					m_fFOVY, m_fAspect,
+					m_fNear, m_fFar,
+					fpu);
+	}
 
 #if USE_VERTEX_CACHE
 	// By enabling alpha test, we can support image tilesets with alpha
@@ -39,6 +39,7 @@ public:
 typedef uchar *ucharptr;
 class databuf;
 class ReqContext;
+class vtTilePack;
 
 typedef bool (*ProgFuncPtrType)(int);
 
@@ -61,6 +62,8 @@ public:
 	int GetVertexTarget() const { return m_iVertexTarget; }
 	FPoint2 GetWorldSpacingAtPoint(const DPoint2 &p) const;
 	void SetTexLODFactor(float factor);
+	void SetUploadTime(float fMilliseconds);
+	float GetUploadTime() const { return m_fUploadTime; }
 
 	// overrides for vtDynGeom
 	void DoRender();
@@ -79,6 +82,7 @@ public:
 
 	// Tile methods
 	databuf FetchTile(const char *fname);
+	bool LoadTile(const char *fname, databuf &buf);
 
 	// CRS of this tileset
 	vtProjection m_proj;
@@ -117,6 +121,10 @@ public:
 	vtString m_folder_image;
 	TiledDatasetDescription m_elev_info, m_image_info;
 
+	// Optional packed tilesets (.tpk), used instead of the folders when present
+	vtTilePack *m_pPackElev, *m_pPackImage;
+	vtTilePack *GetPackForFile(const char *fname) const;
+
 	void SetProgressCallback(ProgFuncPtrType progress_callback)
 	{ m_progress_callback = progress_callback; }
 	ProgFuncPtrType m_progress_callback;
@@ -139,6 +147,9 @@ protected:
 	FPoint3 eye_up, eye_forward;
 	bool m_bNeedResolutionAdjust;
 
+	// render thread budget for delivering paged tiles to OpenGL, per frame
+	float m_fUploadTime;
+
 	// vertical scale (exaggeration)
 	float m_fMaximumScale;
 	float m_fHeightScale;
@@ -5,11 +5,14 @@
 // Free for all uses, see license.txt for details.
 //
 
+#include <algorithm>
+
 #include "vtlib/vtlib.h"
 #include "vtlib/core/Content3d.h"	// for vtGetContent
 #include "vtlib/core/GeomUtil.h"		// for CreateBoundSphereGeode
 #include "vtdata/vtLog.h"
 #include "CarEngine.h"
+#include "Terrain.h"
 #include "Vehicles.h"
 
 
@@ -196,9 +199,79 @@ VehicleSet::VehicleSet()
 	m_iSelected = -1;
 }
 
-void VehicleSet::AddEngine(CarEngine *e)
+VehicleSet::~VehicleSet()
+{
+}
+
+/**
+ Add a vehicle which has been placed on a terrain, to be simulated along
+ with all the other vehicles on that terrain.
+
+ \return A handle by which the vehicle can be driven, or NULL if the
+	vehicle doesn't have four wheels.
+ */
+CarEngine *VehicleSet::AddVehicle(Vehicle *vehicle, vtTerrain *pTerr)
+{
+	// Look for the simulation among the terrain's engines
+	VehicleSim *sim = NULL;
+	vtEngine *engines = pTerr->GetEngineGroup();
+	for (uint i = 0; engines && i < engines->NumChildren() && !sim; i++)
+		sim = dynamic_cast<VehicleSim*>(engines->GetChild(i));
+	if (!sim)
+	{
+		// The first vehicle on this terrain
+		sim = new VehicleSim(pTerr->GetHeightField());
+		sim->setName("Vehicles");
+		pTerr->AddEngine(sim);
+	}
+	int index = sim->AddVehicle(vehicle);
+	if (index == -1)
+		return NULL;
+
+	CarEnginePtr eng = new CarEngine(sim, index);
+	m_Engines.push_back(eng);
+	return eng.get();
+}
+
+/**
+ Measure the speed of the vehicle simulation on each terrain, writing the
+ results to the log.
+
+ \return The rate, in vehicles simulated per millisecond, for the terrain
+	with the most vehicles.
+ */
+double VehicleSet::Benchmark(int iSteps)
+{
+	// Each simulation once, although it has many vehicles
+	std::vector<VehicleSim*> sims;
+	for (uint i = 0; i < m_Engines.size(); i++)
+	{
+		VehicleSim *sim = m_Engines[i]->GetSim();
+		if (std::find(sims.begin(), sims.end(), sim) == sims.end())
+			sims.push_back(sim);
+	}
+	double rate = 0.0;
+	uint most = 0;
+	for (uint i = 0; i < sims.size(); i++)
+	{
+		double r = sims[i]->Benchmark(iSteps);
+		if (sims[i]->NumVehicles() > most)
+		{
+			most = sims[i]->NumVehicles();
+			rate = r;
+		}
+	}
+	return rate;
+}
+
+/**
+ Forget all the vehicles.  Call this before the terrains they are on are
+ deleted.
+ */
+void VehicleSet::Clear()
 {
-	m_Engines.push_back(e);
+	m_Engines.clear();
+	m_iSelected = -1;
 }
 
 int VehicleSet::FindClosestVehicle(const FPoint3 &point, double &closest)
@@ -221,13 +294,10 @@ int VehicleSet::FindClosestVehicle(const FPoint3 &point, double &closest)
 void VehicleSet::VisualSelect(int vehicle)
 {
 	// Stop vehicle simulation while it is selected
-	CarEngine *eng = m_Engines[vehicle];
+	CarEngine *eng = m_Engines[vehicle].get();
 	eng->SetEnabled(false);
 
-	Vehicle *car = dynamic_cast<Vehicle*> (eng->GetTarget());
-	if (!car)
-		return;
-	car->ShowBounds(true);
+	eng->GetVehicle()->ShowBounds(true);
 	m_iSelected = vehicle;
 }
 
@@ -237,27 +307,25 @@ void VehicleSet::VisualDeselectAll()
 	for (uint i = 0; i < size; i++)
 	{
 		// Resume vehicle simulation while it is deselected
-		CarEngine *eng = m_Engines[i];
+		CarEngine *eng = m_Engines[i].get();
 		eng->SetEnabled(true);
 		eng->IgnoreElapsedTime();
 
-		Vehicle *car = dynamic_cast<Vehicle*> (eng->GetTarget());
-		if (car)
-			car->ShowBounds(false);
+		eng->GetVehicle()->ShowBounds(false);
 	}
 	m_iSelected = -1;
 }
 
 void VehicleSet::SetVehicleSpeed(int vehicle, float fMetersPerSec)
 {
-	CarEngine *eng = m_Engines[vehicle];
+	CarEngine *eng = m_Engines[vehicle].get();
 	eng->SetSpeed(fMetersPerSec);
 }
 
 CarEngine *VehicleSet::GetSelectedCarEngine()
 {
 	if (m_iSelected != -1)
-		return m_Engines[m_iSelected];
+		return m_Engines[m_iSelected].get();
 	else
 		return NULL;
 }
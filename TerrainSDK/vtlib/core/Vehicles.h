@@ -11,6 +11,8 @@
 #define VEHICLEH
 
 class CarEngine;
+class VehicleSim;
+class vtTerrain;
 
 class Vehicle : public vtTransform
 {
@@ -42,12 +44,20 @@ protected:
 	Vehicle *CreateVehicleFromNode(osg::Node *node, const RGBf &cColor);
 };
 
+/**
+ * All the vehicles, with one VehicleSim for each terrain which has vehicles
+ * on it.  Each VehicleSim is an engine of its terrain, so it goes away with
+ * the terrain.
+ */
 class VehicleSet
 {
 public:
 	VehicleSet();
+	~VehicleSet();
 
-	void AddEngine(CarEngine *e);
+	CarEngine *AddVehicle(Vehicle *vehicle, vtTerrain *pTerr);
+	void Clear();
+	double Benchmark(int iSteps = 100);
 	int FindClosestVehicle(const FPoint3 &point, double &closest);
 	void VisualSelect(int vehicle);
 	void VisualDeselectAll();
@@ -57,7 +67,7 @@ public:
 	CarEngine *GetSelectedCarEngine();
 	void SetSelectedRotation(float fRot);
 
-	std::vector<CarEngine*> m_Engines;
+	std::vector<osg::ref_ptr<CarEngine> > m_Engines;
 	int m_iSelected;
 };
 
@@ -191,33 +191,17 @@ void vtImage::_CreateFromDIB(vtDIB *pDIB, bool b16bit)
 		memcpy(image + i * SizeRow, data + (h-1-i) * SizeRow, SizeRow);
 #endif
 
-	int z;
 	int pixelFormat = GL_RGB;
-	GLubyte tmp;
 	if ( bpp == 24 )
 	{
-		z = 3;
-
 		/* BGR --> RGB */
-		for (i = 0; i < w * h; i++)
-		{
-			tmp = image [ 3 * i ];
-			image [ 3 * i ] = image [ 3 * i + 2 ];
-			image [ 3 * i + 2 ] = tmp;
-		}
+		vtConvertRow(image, PF_BGR24, NULL, image, PF_RGB24, w * h);
 		pixelFormat = GL_RGB;
 	}
 	else if ( bpp == 32 )
 	{
-		z = 4;
-
 		/* BGRA --> RGBA */
-		for (i = 0; i < w * h; i++ )
-		{
-			tmp = image [ 4 * i ];
-			image [ 4 * i ] = image [ 4 * i + 2 ];
-			image [ 4 * i + 2 ] = tmp;
-		}
+		vtConvertRow(image, PF_BGRA32, NULL, image, PF_RGBA32, w * h);
 		pixelFormat = GL_RGBA;
 	}
 	else if ( bpp == 8 )
@@ -454,10 +438,20 @@ uint vtImage::GetDepth() const
 	return getPixelSizeInBits();
 }
 
+bool vtImage::GetPixelSpan(vtPixelSpan &span) const
+{
+	return ::GetPixelSpan(this, span);
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 // vtImageWrapper
 
+bool vtImageWrapper::GetPixelSpan(vtPixelSpan &span) const
+{
+	return ::GetPixelSpan(m_image, span);
+}
+
 uchar vtImageWrapper::GetPixel8(int x, int y) const
 {
 	// OSG appears to reference y=0 as the bottom of the image
@@ -581,6 +575,33 @@ uint GetDepth(const osg::Image *image)
 	return image->getPixelSizeInBits();
 }
 
+/**
+ * Get direct access to the pixels of an image of bytes, which is gray,
+ * RGB or RGBA.  As with the other helpers, row 0 is the top of the image.
+ */
+bool GetPixelSpan(const osg::Image *image, vtPixelSpan &span)
+{
+	if (image->data() == NULL || image->getDataType() != GL_UNSIGNED_BYTE)
+		return false;
+	const GLenum pixf = image->getPixelFormat();
+	if (pixf == GL_LUMINANCE || pixf == GL_ALPHA)
+		span.m_Format = PF_GRAY8;
+	else if (pixf == GL_RGB)
+		span.m_Format = PF_RGB24;
+	else if (pixf == GL_RGBA)
+		span.m_Format = PF_RGBA32;
+	else
+		return false;
+
+	// OSG appears to reference y=0 as the bottom of the image
+	const int rows = image->t();
+	span.m_pOrigin = (uchar *) image->data(0, rows-1);
+	span.m_iStride = -(int) image->getRowSizeInBytes();
+	span.m_Size.Set(image->s(), rows);
+	span.m_pPalette = NULL;
+	return true;
+}
+
 /**
  * Call this method to tell vtlib that you want it to use a 16-bit texture
  * (internal memory format) to be sent to the graphics card.
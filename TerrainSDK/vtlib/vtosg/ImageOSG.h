@@ -49,6 +49,7 @@ public:
 
 	IPoint2 GetSize() const;
 	uint GetDepth() const;
+	bool GetPixelSpan(vtPixelSpan &span) const;
 
 	uchar *GetData() { return data(); }
 	uchar *GetRowData(int row) { return data(0, row); }
@@ -83,6 +84,7 @@ public:
 
 	IPoint2 GetSize() const { return IPoint2(m_image->s(), m_image->t()); }
 	uint GetDepth() const { return m_image->getPixelSizeInBits(); }
+	bool GetPixelSpan(vtPixelSpan &span) const;
 
 	uchar *GetData() { return m_image->data(); }
 	uchar *GetRowData(int row) { return m_image->data(0, row); }
@@ -100,6 +102,7 @@ void SetPixel32(osg::Image *image, int x, int y, const RGBAi &rgba);
 uint GetWidth(const osg::Image *image);
 uint GetHeight(const osg::Image *image);
 uint GetDepth(const osg::Image *image);
+bool GetPixelSpan(const osg::Image *image, vtPixelSpan &span);
 void Set16BitInternal(osg::Image *image, bool bFlag);
 
 
@@ -10,6 +10,7 @@
 #include "vtlib/vtlib.h"
 #include "vtdata/vtLog.h"
 #include "vtdata/vtString.h"
+#include "vtlib/core/Profiler.h"
 
 #if VTLISPSM
 #include "LightSpacePerspectiveShadowTechnique.h"
@@ -777,38 +778,37 @@ bool g_bDisableMipmaps = false;		// global
  *	pass false.
  * \param bDisableMipmaps Pass true to turn off mipmapping in the texture maps
  *	in the loaded model.  Default is false (enable mipmapping).
+ * \param bSetLocale Default is true, to set the "C" numeric locale while
+ *	loading, which some file readers need.  That locale is global to the
+ *	process, so a thread other than the main one should set it for itself
+ *	and pass false.
  *
  * \return A node pointer if successful, or NULL if the load failed.
+ *
+ * To share models between terrains, and load them in the background, use
+ * vtModelCache, which calls this function.
  */
-osg::Node *vtLoadModel(const char *filename, bool bAllowCache, bool bDisableMipmaps)
+osg::Node *vtLoadModel(const char *filename, bool bAllowCache, bool bDisableMipmaps,
+					   bool bSetLocale)
 {
-	// Some of OSG's file readers, such as the Wavefront OBJ reader, have
-	//  sensitivity to stdio issues with '.' and ',' in European locales.
-	ScopedLocale normal_numbers(LC_NUMERIC, "C");
-
 	// Workaround for OSG's OBJ-MTL reader which doesn't like backslashes
 	vtString fname = filename;
 	fname.Replace('\\', '/');
 
 #define HINT osgDB::ReaderWriter::Options::CacheHintOptions
-	// In case of reloading a previously loaded model, we must empty
-	//  our own cache as well as disable OSG's cache.
+	// In case of reloading a previously loaded model, we must get past
+	//  OSG's cache.  The registry's options are shared by every thread, so
+	//  disable the cache in a copy of them, for this read only.
 	osgDB::Registry *reg = osgDB::Registry::instance();
-	osgDB::ReaderWriter::Options *opts;
+	osg::ref_ptr<osgDB::ReaderWriter::Options> opts = reg->getOptions();
 
 	if (!bAllowCache)
 	{
-		opts = reg->getOptions();
-		if (!opts)
-		{
+		if (opts.valid())
+			opts = new osgDB::ReaderWriter::Options(*opts);
+		else
 			opts = new osgDB::ReaderWriter::Options;
-			opts->ref();	// workaround!  otherwise OSG might crash when
-				// closing its DLL, as the options get deleted twice (?) or
-				// perhaps it doesn't like deleting the object WE allocated.
-		}
-		// Disable OSG's cache
 		opts->setObjectCacheHint((HINT) ((opts->getObjectCacheHint() & ~(osgDB::ReaderWriter::Options::CACHE_NODES))));
-		reg->setOptions(opts);
 	}
 
 	// OSG doesn't yet support utf-8 or wide filenames, so convert
@@ -818,7 +818,16 @@ osg::Node *vtLoadModel(const char *filename, bool bAllowCache, bool bDisableMipm
 #if VTDEBUG
 	VTLOG("[");
 #endif
-	NodePtr node = osgDB::readNodeFile((const char *)fname_local);
+	NodePtr node;
+	if (bSetLocale)
+	{
+		// Some of OSG's file readers, such as the Wavefront OBJ reader, have
+		//  sensitivity to stdio issues with '.' and ',' in European locales.
+		ScopedLocale normal_numbers(LC_NUMERIC, "C");
+		node = osgDB::readNodeFile((const char *)fname_local, opts.get());
+	}
+	else
+		node = osgDB::readNodeFile((const char *)fname_local, opts.get());
 #if VTDEBUG
 	VTLOG("]");
 #endif
@@ -1645,8 +1654,14 @@ void OsgDynMesh::drawImplementation(osg::RenderInfo& renderInfo) const
 		m_pDynGeom->m_cullPlanes[i++].Set(-pvec.x(), -pvec.y(), -pvec.z(), -pvec.w());
 	}
 
-	m_pDynGeom->DoCull(pVtCamera.get());
-	m_pDynGeom->DoRender();
+	{
+		VTPROFILE("Dynamic geometry cull");
+		m_pDynGeom->DoCull(pVtCamera.get());
+	}
+	{
+		VTPROFILE("Dynamic geometry render");
+		m_pDynGeom->DoRender();
+	}
 }
 
 
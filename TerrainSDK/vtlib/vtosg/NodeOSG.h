@@ -156,7 +156,7 @@ void WriteDotFile(osg::Group *node, const char *filename);
 
 /// Load a 3D model file
 osg::Node *vtLoadModel(const char *filename, bool bAllowCache = true,
-					   bool bDisableMipmaps = false);
+					   bool bDisableMipmaps = false, bool bSetLocale = true);
 bool vtSaveModel(osg::Node *node, const char *filename);
 extern bool g_bDisableMipmaps;	// set to disable ALL mipmaps
 
@@ -8,6 +8,8 @@
 //
 
 #include "vtlib/vtlib.h"
+#include "vtlib/core/ModelCache.h"
+#include "vtlib/core/Profiler.h"
 
 #include <osgViewer/ViewerEventHandlers>
 
@@ -20,6 +22,7 @@
 #  include <sys/resource.h>
 #endif
 
+#include <algorithm>
 #include <iostream>			// For redirecting OSG's stdout messages
 #include "vtdata/vtLog.h"	// to the VTP log.
 
@@ -61,6 +64,9 @@ vtScene::vtScene()
 	m_bWireframe = false;
 	m_bWinInfo = false;
 	m_pHUD = NULL;
+
+	m_fFixedFrameTime = 0;
+	m_fFixedTime = 0;
 }
 
 vtScene::~vtScene()
@@ -258,6 +264,9 @@ void vtScene::Shutdown()
 	m_pDefaultWindow = NULL;
 	m_Windows.Clear();
 
+	// Stop the model loader threads, while it's still safe to
+	vtGetModelCache()->Clear();
+
 	// Also clear the OSG cache
 	osgDB::Registry::instance()->clearObjectCache();
 
@@ -315,15 +324,83 @@ IPoint2 vtScene::GetWindowSize(vtWindow *pWindow)
 	return pWindow->GetSize();
 }
 
+// Independent engines are run in parallel when there are at least this many
+//  of them in a row.
+#define MIN_PARALLEL_ENGINES	8
+
+static void EvalEngine(vtEngine *pEng, bool bTime)
+{
+	if (!pEng->GetEnabled())
+		return;
+	if (!bTime)
+	{
+		pEng->Eval();
+		return;
+	}
+	osg::Timer *timer = osg::Timer::instance();
+	osg::Timer_t start = timer->tick();
+	pEng->Eval();
+	pEng->SetEvalTime((float) timer->delta_m(start, timer->tick()));
+}
+
+/**
+ * Evaluate the engines in a tree, in order.  Where there is a long enough
+ * run of independent engines (see vtEngine::SetIndependent), they are
+ * evaluated in parallel, and all of them finish before the next engine
+ * which isn't independent.  While the profiler is on, each engine's time
+ * is measured.
+ */
 void vtScene::DoEngines(vtEngine *eng)
 {
 	// Evaluate Engines
 	vtEngineArray list(eng);
-	for (uint i = 0; i < list.size(); i++)
+	const bool bTime = vtGetProfiler()->GetEnabled();
+	const int count = (int) list.size();
+	int i = 0;
+	while (i < count)
+	{
+		int end = i;
+		while (end < count && list[end]->IsIndependent())
+			end++;
+		if (end - i < MIN_PARALLEL_ENGINES)
+		{
+			EvalEngine(list[i], bTime);
+			i++;
+			continue;
+		}
+
+		VTPROFILE("Parallel engines");
+#pragma omp parallel for schedule(dynamic, 4)
+		for (int j = i; j < end; j++)
+			EvalEngine(list[j], bTime);
+		i = end;
+	}
+}
+
+static bool EngineTimeGreater(vtEngine *e1, vtEngine *e2)
+{
+	return e1->GetEvalTime() > e2->GetEvalTime();
+}
+
+/**
+ * Write the engines which take the most time to the log.  The times are
+ * only measured while the profiler (vtProfiler) is enabled.
+ *
+ * \param iMax The most engines to list.
+ */
+void vtScene::LogEngineTimes(int iMax)
+{
+	vtEngineArray list(m_pRootEngine, false);
+	vtEngineArray post(m_pRootEnginePostDraw, false);
+	list.insert(list.end(), post.begin(), post.end());
+	std::sort(list.begin(), list.end(), EngineTimeGreater);
+
+	VTLOG("Engine times (of %d engines):\n", (int) list.size());
+	for (int i = 0; i < (int) list.size() && i < iMax; i++)
 	{
 		vtEngine *pEng = list[i];
-		if (pEng->GetEnabled())
-			pEng->Eval();
+		VTLOG("  %-24s %8.3f ms%s\n", pEng->getName(), pEng->GetEvalTime(),
+			pEng->IsIndependent() ? " (independent)" : "");
 	}
 }
 
@@ -366,6 +443,21 @@ void vtScene::TimerRunning(bool bRun)
 		_lastRunningTick = _timer.tick();
 }
 
+/**
+ * Make every frame advance the scene's time by the same amount, regardless
+ * of how long it really took.  This makes animation and navigation
+ * repeatable, for example when measuring performance.
+ *
+ * \param fSeconds The time each frame takes, or 0 to go back to measuring
+ *		time with the clock.
+ */
+void vtScene::SetFixedFrameTime(float fSeconds)
+{
+	// Carry on from the current time
+	m_fFixedTime = GetTime();
+	m_fFixedFrameTime = fSeconds;
+}
+
 void vtScene::UpdateBegin()
 {
 	_lastFrameTick = _frameTick;
@@ -382,17 +474,25 @@ void vtScene::UpdateBegin()
 		m_fLastFrameTime = _timer.delta_s(_lastFrameTick,_frameTick);
 
 	_lastRunningTick = _frameTick;
+
+	if (m_fFixedFrameTime > 0)
+	{
+		m_fLastFrameTime = m_fFixedFrameTime;
+		m_fFixedTime += m_fFixedFrameTime;
+	}
 }
 
 void vtScene::UpdateEngines()
 {
 	if (!m_bInitialized) return;
+	VTPROFILE("Engines");
 	DoEngines(m_pRootEngine);
 }
 
 void vtScene::PostDrawEngines()
 {
 	if (!m_bInitialized) return;
+	VTPROFILE("Post-draw engines");
 	DoEngines(m_pRootEnginePostDraw);
 }
 
@@ -453,6 +553,8 @@ void vtScene::UpdateWindow(vtWindow *pWindow)
 	m_pOsgViewer->getCamera()->setCullMaskLeft(0x3);
 	m_pOsgViewer->getCamera()->setCullMaskRight(0x3);
 
+	// OSG's update, cull and draw traversals
+	VTPROFILE("Draw");
 	m_pOsgViewer->frame();
 }
 
@@ -484,12 +586,17 @@ void vtScene::ComputeViewMatrix(FMatrix4 &mat)
 
 void vtScene::DoUpdate()
 {
+	vtProfiler *profiler = vtGetProfiler();
+	profiler->BeginFrame();
+
 	UpdateBegin();
 	UpdateEngines();
 	UpdateWindow(GetWindow(0));
 
 	// Some engines need to run after the cull-draw phase
 	PostDrawEngines();
+
+	profiler->EndFrame();
 }
 
 void vtScene::SetRoot(vtGroup *pRoot)
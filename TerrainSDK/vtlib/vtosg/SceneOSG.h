@@ -78,6 +78,9 @@ public:
 	void Shutdown();
 
 	void TimerRunning(bool bRun);
+	void SetFixedFrameTime(float fSeconds);
+	/// The fixed frame time, or 0 if time is measured by the clock.
+	float GetFixedFrameTime() const { return m_fFixedFrameTime; }
 	void UpdateBegin();
 	void UpdateEngines();
 	void UpdateWindow(vtWindow *window);
@@ -95,6 +98,8 @@ public:
 	/// Time in seconds since the scene began.
 	float GetTime()
 	{
+		if (m_fFixedFrameTime > 0)
+			return m_fFixedTime;
 		return _timer.delta_s(_initialTick,_frameTick);
 	}
 	/// Time in seconds between the start of the previous frame and the current frame.
@@ -183,6 +188,8 @@ public:
 	virtual CVisualImpactCalculatorOSG& GetVisualImpactCalculator() { return m_VisualImpactCalculator; }
 #endif
 
+	void LogEngineTimes(int iMax = 20);
+
 protected:
 	void DoEngines(vtEngine *eng);
 
@@ -208,6 +215,7 @@ protected:
 	osg::Timer_t _lastRunningTick;
 	osg::Timer_t _frameTick;
 	double	m_fAccumulatedFrameTime, m_fLastFrameTime;
+	double	m_fFixedFrameTime, m_fFixedTime;
 
 	bool	m_bWinInfo;
 	bool	m_bInitialized;
@@ -21,10 +21,6 @@
 
 #include "Canvas.h"
 
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-#include "PerformanceMonitor.h"
-#endif
-
 #if WIN32
 // Support for the SpaceNavigator
 #include "vtlib/core/SpaceNav.h"
@@ -88,18 +84,12 @@ vtGLCanvas::vtGLCanvas(wxWindow *parent, wxWindowID id, const wxPoint &pos,
 	SetLayoutDirection(wxLayout_LeftToRight);
 
 	s_canvas = this;
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-	CPerformanceMonitorDialog::NVPM_init();
-#endif
 	VTLOG1("vtGLCanvas, leaving constructor\n");
 }
 
 vtGLCanvas::~vtGLCanvas(void)
 {
 	VTLOG1("Deleting Canvas\n");
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-	CPerformanceMonitorDialog::NVPM_shutdown();
-#endif
 	((GraphicsWindowWX*)vtGetScene()->GetGraphicsContext())->CloseOsgContext();
 }
 
@@ -207,10 +197,6 @@ void vtGLCanvas::OnPaint( wxPaintEvent& event )
 	if (m_bFirstPaint)
 		m_bFirstPaint = false;
 
-#ifdef VTP_NVIDIA_PERFORMANCE_MONITORING
-	CPerformanceMonitorDialog::NVPM_frame();
-#endif
-
 	bInside = false;
 }
 #endif	// not __WXMAC__